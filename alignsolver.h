@@ -0,0 +1,258 @@
+// alignsolver.h
+// MillePede global alignment kept in memory: the same records as written
+// to the Mille file go here, per track the local (track) parameters are
+// eliminated, the reduced normal equations of the global labels are summed.
+// This is the linear system pede solves with its inversion method,
+// without pede's outlier down-weighting and chisq cut iterations.
+
+// AlignSolver solver( 24 ); // labels 1..24
+// solver.fix( 1 ); // reference planes
+// per track: fourfit.milleOut( solver, ... ); // mille( ... ) and end() as Mille
+// per thread: solver.add( solverOfThread );
+// end: solver.solve( par, err );
+
+#ifndef ALIGNSOLVER_H
+#define ALIGNSOLVER_H
+
+#include <vector>
+#include <set>
+#include <cmath>
+
+#include <TMatrixDSym.h>
+#include <TVectorD.h>
+
+class AlignSolver {
+
+ public:
+
+  AlignSolver( int npar ) : fN(npar), fC(npar*npar), fB(npar), fTracks(0), fBad(0), fNlc(0)
+  {
+  }
+
+  void fix( int label ) { fFixed.insert( label ); }
+
+  //----------------------------------------------------------------------------
+  // one measurement of the current track, arguments as Mille::mille:
+  // nlc local derivatives (same nlc for all data of a track),
+  // ngl global derivatives with labels 1..npar, measurement and error
+
+  void mille( int nlc, const float * derlc, int ngl, const float * dergl,
+	      const int * label, float meas, float sigma )
+  {
+    if( sigma <= 0 ) return;
+
+    if( fMeas.empty() )
+      fNlc = nlc;
+    if( nlc != fNlc ) return;
+
+    fMeas.push_back( meas );
+    fW.push_back( 1.0 / sigma / sigma );
+
+    for( int i = 0; i < nlc; ++i )
+      fDl.push_back( derlc[i] );
+
+    for( int i = 0; i < ngl; ++i ) {
+      if( label[i] < 1 || label[i] > fN || dergl[i] == 0 ) continue;
+      fGlab.push_back( label[i] - 1 );
+      fGder.push_back( dergl[i] );
+    }
+    fGend.resize( fMeas.size(), fGlab.size() );
+  }
+
+  //----------------------------------------------------------------------------
+  // end of track: eliminate the local parameters,
+  // C += sum w dg dg^T - G^T Gam^-1 G, b += sum w dg y - G^T Gam^-1 beta
+  // with Gam = sum w dl dl^T, G = sum w dl dg^T, beta = sum w dl y
+
+  void end()
+  {
+    int nd = fMeas.size();
+    int nl = fNlc;
+
+    if( nd > 0 && invertLocal( nd, nl ) ) {
+
+      // global labels of this track, G and the direct part:
+
+      fTlab.clear();
+      fTG.clear();
+
+      for( int id = 0; id < nd; ++id ) {
+	double w = fW[id];
+	double y = fMeas[id];
+	const double * dl = &fDl[id*nl];
+	int k0 = id ? fGend[id-1] : 0;
+	for( int k = k0; k < fGend[id]; ++k ) {
+	  int t = trackIndex( fGlab[k] );
+	  double dg = fGder[k];
+	  for( int a = 0; a < nl; ++a )
+	    fTG[t*nl+a] += w * dl[a] * dg;
+	  fB[fGlab[k]] += w * dg * y;
+	  for( int k2 = k0; k2 < fGend[id]; ++k2 )
+	    fC[fGlab[k]*fN+fGlab[k2]] += w * dg * fGder[k2];
+	}
+      }
+
+      // Schur complement: G^T Gam^-1 G and G^T Gam^-1 beta
+
+      int nt = fTlab.size();
+      fTH.assign( nt*nl, 0 ); // G^T Gam^-1
+
+      for( int t = 0; t < nt; ++t )
+	for( int a = 0; a < nl; ++a )
+	  for( int c = 0; c < nl; ++c )
+	    fTH[t*nl+a] += fTG[t*nl+c] * fGam[c*nl+a];
+
+      for( int t = 0; t < nt; ++t ) {
+	int lt = fTlab[t];
+	for( int a = 0; a < nl; ++a )
+	  fB[lt] -= fTH[t*nl+a] * fBeta[a];
+	for( int t2 = 0; t2 < nt; ++t2 ) {
+	  double s = 0;
+	  for( int a = 0; a < nl; ++a )
+	    s += fTH[t*nl+a] * fTG[t2*nl+a];
+	  fC[lt*fN+fTlab[t2]] -= s;
+	}
+      }
+
+      ++fTracks;
+
+    }
+    else if( nd > 0 )
+      ++fBad;
+
+    fMeas.clear(); // keeps capacity
+    fW.clear();
+    fDl.clear();
+    fGlab.clear();
+    fGder.clear();
+    fGend.clear();
+  }
+
+  //----------------------------------------------------------------------------
+  // sum of a solver filled in another thread, same npar
+
+  void add( const AlignSolver & o )
+  {
+    if( o.fN != fN ) return;
+    for( int i = 0; i < fN*fN; ++i )
+      fC[i] += o.fC[i];
+    for( int i = 0; i < fN; ++i )
+      fB[i] += o.fB[i];
+    fTracks += o.fTracks;
+    fBad += o.fBad;
+  }
+
+  int tracks() const { return fTracks; }
+  int badTracks() const { return fBad; } // singular in the local parameters
+
+  //----------------------------------------------------------------------------
+  // corrections and errors, index = label-1, zero for fixed labels
+
+  bool solve( std::vector<double> & par, std::vector<double> & err ) const
+  {
+    par.assign( fN, 0 );
+    err.assign( fN, 0 );
+
+    std::vector<int> free;
+    for( int i = 0; i < fN; ++i )
+      if( !fFixed.count( i+1 ) && fC[i*fN+i] > 0 )
+	free.push_back( i );
+
+    int nf = free.size();
+    if( nf == 0 ) return false;
+
+    TMatrixDSym C( nf );
+    TVectorD B( nf );
+    for( int i = 0; i < nf; ++i ) {
+      B[i] = fB[free[i]];
+      for( int j = 0; j < nf; ++j )
+	C[i][j] = fC[free[i]*fN+free[j]];
+    }
+
+    double det;
+    C.Invert( &det );
+    if( det == 0 ) return false;
+
+    TVectorD x = C * B;
+
+    for( int i = 0; i < nf; ++i ) {
+      par[free[i]] = x[i];
+      err[free[i]] = sqrt( C[i][i] );
+    }
+
+    return true;
+  }
+
+ private:
+
+  // Gam and beta of the current track, Gam inverted in place (Gauss-Jordan)
+
+  bool invertLocal( int nd, int nl )
+  {
+    fGam.assign( nl*nl, 0 );
+    fBeta.assign( nl, 0 );
+
+    for( int id = 0; id < nd; ++id ) {
+      const double * dl = &fDl[id*nl];
+      for( int a = 0; a < nl; ++a ) {
+	fBeta[a] += fW[id] * dl[a] * fMeas[id];
+	for( int c = 0; c < nl; ++c )
+	  fGam[a*nl+c] += fW[id] * dl[a] * dl[c];
+      }
+    }
+
+    fInv.assign( nl*nl, 0 );
+    for( int a = 0; a < nl; ++a )
+      fInv[a*nl+a] = 1;
+
+    for( int i = 0; i < nl; ++i ) {
+      double piv = fGam[i*nl+i];
+      if( fabs(piv) < 1E-30 ) return 0;
+      for( int j = 0; j < nl; ++j ) {
+	fGam[i*nl+j] /= piv;
+	fInv[i*nl+j] /= piv;
+      }
+      for( int k = 0; k < nl; ++k ) {
+	if( k == i ) continue;
+	double fk = fGam[k*nl+i];
+	for( int j = 0; j < nl; ++j ) {
+	  fGam[k*nl+j] -= fk * fGam[i*nl+j];
+	  fInv[k*nl+j] -= fk * fInv[i*nl+j];
+	}
+      }
+    }
+
+    fGam.swap( fInv );
+    return 1;
+  }
+
+  // index of a global label among the labels of this track
+
+  int trackIndex( int l )
+  {
+    for( unsigned t = 0; t < fTlab.size(); ++t )
+      if( fTlab[t] == l ) return t;
+    fTlab.push_back( l );
+    fTG.resize( fTlab.size()*fNlc, 0 );
+    return fTlab.size() - 1;
+  }
+
+  int fN;
+  std::vector<double> fC; // reduced normal matrix, fN x fN
+  std::vector<double> fB; // reduced right hand side
+  std::set<int> fFixed;
+  int fTracks;
+  int fBad;
+
+  // current track, capacity kept:
+
+  int fNlc;
+  std::vector<double> fMeas, fW, fDl;
+  std::vector<int> fGlab, fGend; // globals of the data, end per datum
+  std::vector<double> fGder;
+  std::vector<double> fGam, fInv, fBeta, fTG, fTH;
+  std::vector<int> fTlab;
+
+}; // AlignSolver
+
+#endif
@@ -0,0 +1,404 @@
+// local multi-run driver: tele iterations, then scope53m, for a run list,
+// on all cores, resumable after an interruption
+
+// make campaign
+// campaign -r 33095-33110,33120
+// (runs, geo and GeV from runs.dat, default: all runs in it)
+// (per run: tele 3 times, then scope53m -a, one log file per step in logs/)
+// (steps done are recorded in campaign.state, a second call continues there;
+//  a step run with other options, geo or GeV is not done)
+// (-t 3: tele iterations, -s 3: scope53m iterations instead of -a,
+//  -j 16: jobs at once, default all cores, -l 99999: events,
+//  -f runs.dat, -n: show the plan only)
+
+// Steps of one run depend on each other, runs do not. Free slots take
+// the ready step of the run with the most steps left, so long chains
+// start first. The parallelism is over runs: one single-threaded step
+// per core (OMP_NUM_THREADS=1, tele's per-plane clustering sections
+// and the scope53m event workers included), -j steps at once.
+
+#include <sys/types.h>
+#include <sys/wait.h> // waitpid
+#include <sys/stat.h> // mkdir
+#include <unistd.h> // fork, exec
+#include <fcntl.h> // open
+#include <time.h>
+
+#include <iostream> // cout
+#include <fstream> // files
+#include <sstream> // stringstream
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <cstring> // strcmp
+#include <cstdlib> // atoi
+
+using namespace std;
+
+struct step {
+  string prog; // tele or scope53m
+  int iter; // 1..
+  vector <string> args;
+};
+
+struct runjob {
+  int run;
+  string geo;
+  double GeV;
+  vector <step> steps;
+  size_t next; // first step not done
+  bool running;
+  bool failed;
+};
+
+//------------------------------------------------------------------------------
+set <int> parseRange( const string & s ) // 1440-1450,2590
+{
+  set <int> runs;
+  istringstream tokenizer( s );
+  string item;
+  while( getline( tokenizer, item, ',' ) ) {
+    size_t dash = item.find( '-' );
+    if( dash == string::npos )
+      runs.insert( atoi( item.c_str() ) );
+    else
+      for( int r = atoi( item.substr( 0, dash ).c_str() );
+	   r <= atoi( item.substr( dash+1 ).c_str() ); ++r )
+	runs.insert( r );
+  }
+  return runs;
+}
+
+//------------------------------------------------------------------------------
+string stepName( int run, const step & st )
+{
+  ostringstream name;
+  name << st.prog << "_" << run << "_" << st.iter;
+  return name.str();
+}
+
+//------------------------------------------------------------------------------
+// key in campaign.state: step name and a hash (FNV-1a) of what it ran with,
+// the arguments and the geo and GeV of runs.dat (scope53m reads them there)
+
+string stateKey( const runjob & rj, const step & st )
+{
+  ostringstream all;
+  all << st.prog;
+  for( size_t ia = 0; ia < st.args.size(); ++ia )
+    all << " " << st.args[ia];
+  all << " " << rj.geo << " " << rj.GeV;
+
+  string a = all.str();
+  unsigned h = 2166136261u;
+  for( size_t i = 0; i < a.size(); ++i ) {
+    h ^= (unsigned char) a[i];
+    h *= 16777619u;
+  }
+
+  ostringstream key;
+  key << stepName( rj.run, st ) << "_" << hex << h;
+  return key.str();
+}
+
+//------------------------------------------------------------------------------
+double now()
+{
+  timespec ts;
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+//------------------------------------------------------------------------------
+int main( int argc, char* argv[] )
+{
+  cout << "main " << argv[0] << " called with " << argc << " arguments" << endl;
+
+  string runsFileName( "runs.dat" );
+  string stateFileName( "campaign.state" );
+  set <int> only; // empty = all runs
+  int ntele = 3;
+  int nscope = 0; // 0 = one scope53m -a
+  int njobs = sysconf( _SC_NPROCESSORS_ONLN );
+  int ncores = njobs;
+  string lev;
+  bool ldry = 0;
+
+  for( int i = 1; i < argc; ++i ) {
+
+    if( !strcmp( argv[i], "-r" ) )
+      only = parseRange( argv[++i] );
+
+    if( !strcmp( argv[i], "-f" ) )
+      runsFileName = argv[++i];
+
+    if( !strcmp( argv[i], "-t" ) )
+      ntele = atoi( argv[++i] );
+
+    if( !strcmp( argv[i], "-s" ) )
+      nscope = atoi( argv[++i] );
+
+    if( !strcmp( argv[i], "-j" ) )
+      njobs = atoi( argv[++i] );
+
+    if( !strcmp( argv[i], "-l" ) )
+      lev = argv[++i];
+
+    if( !strcmp( argv[i], "-n" ) )
+      ldry = 1;
+
+  } // argc
+
+  if( njobs < 1 ) njobs = 1;
+
+  // programs next to this one:
+
+  string bin( argv[0] );
+  size_t slash = bin.rfind( '/' );
+  bin = slash == string::npos ? "./" : bin.substr( 0, slash+1 );
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+  // runs.dat: geo and GeV tags hold for the runs below them
+
+  ifstream runsFile( runsFileName );
+
+  if( !runsFile ) {
+    cout << "Error opening " << runsFileName << endl;
+    return 1;
+  }
+
+  vector <runjob> jobs;
+
+  string geo( "geo.dat" );
+  double GeV = 4.8;
+
+  string line;
+  while( getline( runsFile, line ) ) {
+
+    istringstream tokenizer( line );
+    string tag;
+    tokenizer >> tag;
+    if( tag.empty() || tag[0] == '#' ) continue;
+
+    if( tag == "geo" )
+      tokenizer >> geo;
+
+    else if( tag == "GeV" )
+      tokenizer >> GeV;
+
+    else if( tag == "run" ) {
+
+      runjob rj;
+      tokenizer >> rj.run;
+      if( only.size() && only.count( rj.run ) == 0 ) continue;
+
+      rj.geo = geo;
+      rj.GeV = GeV;
+      rj.next = 0;
+      rj.running = 0;
+      rj.failed = 0;
+
+      ostringstream srun, sGeV;
+      srun << rj.run;
+      sGeV << GeV;
+
+      for( int it = 1; it <= ntele; ++it ) {
+	step st;
+	st.prog = "tele";
+	st.iter = it;
+	if( lev.size() ) { st.args.push_back( "-l" ); st.args.push_back( lev ); }
+	st.args.push_back( "-g" ); st.args.push_back( geo );
+	st.args.push_back( "-p" ); st.args.push_back( sGeV.str() );
+	st.args.push_back( srun.str() );
+	rj.steps.push_back( st );
+      }
+
+      for( int it = 1; it <= ( nscope > 0 ? nscope : 1 ); ++it ) {
+	step st;
+	st.prog = "scope53m";
+	st.iter = it;
+	if( lev.size() ) { st.args.push_back( "-l" ); st.args.push_back( lev ); }
+	if( nscope == 0 ) st.args.push_back( "-a" ); // all iterations in one job
+	st.args.push_back( srun.str() );
+	rj.steps.push_back( st );
+      }
+
+      jobs.push_back( rj );
+
+    } // run
+
+  } // runsFile
+
+  if( only.size() && jobs.size() < only.size() )
+    cout << only.size() - jobs.size() << " requested runs not in " << runsFileName << endl;
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+  // state: steps done in earlier calls
+
+  set <string> done;
+
+  ifstream stateFile( stateFileName );
+  while( getline( stateFile, line ) ) {
+    istringstream tokenizer( line );
+    string name, status;
+    tokenizer >> name >> status;
+    if( status == "ok" )
+      done.insert( name );
+  }
+  stateFile.close();
+
+  int nsteps = 0;
+  int nleft = 0;
+
+  for( size_t ij = 0; ij < jobs.size(); ++ij ) {
+    runjob & rj = jobs[ij];
+    while( rj.next < rj.steps.size() && done.count( stateKey( rj, rj.steps[rj.next] ) ) )
+      ++rj.next; // in order: a later step is redone if an earlier one is
+    nsteps += rj.steps.size();
+    nleft += rj.steps.size() - rj.next;
+  }
+
+  cout << jobs.size() << " runs, " << nsteps << " steps, "
+       << nsteps - nleft << " done before, "
+       << njobs << " jobs at once on " << ncores << " cores" << endl;
+
+  if( ldry ) {
+    for( size_t ij = 0; ij < jobs.size(); ++ij )
+      for( size_t is = jobs[ij].next; is < jobs[ij].steps.size(); ++is ) {
+	const step & st = jobs[ij].steps[is];
+	cout << "  " << st.prog;
+	for( size_t ia = 0; ia < st.args.size(); ++ia )
+	  cout << " " << st.args[ia];
+	cout << endl;
+      }
+    return 0;
+  }
+
+  mkdir( "logs", 0755 );
+
+  ofstream state( stateFileName, ios::app );
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+  // schedule:
+
+  map <pid_t, size_t> running; // pid -> job
+  map <pid_t, double> started;
+
+  int nok = 0;
+  int nfail = 0;
+
+  while( 1 ) {
+
+    // ready steps, longest remaining chain first:
+
+    while( (int) running.size() < njobs ) {
+
+      int best = -1;
+      size_t bestleft = 0;
+
+      for( size_t ij = 0; ij < jobs.size(); ++ij ) {
+	const runjob & rj = jobs[ij];
+	if( rj.running || rj.failed || rj.next >= rj.steps.size() ) continue;
+	size_t left = rj.steps.size() - rj.next;
+	if( best < 0 || left > bestleft ) {
+	  best = ij;
+	  bestleft = left;
+	}
+      }
+
+      if( best < 0 ) break; // nothing ready
+
+      runjob & rj = jobs[best];
+      const step & st = rj.steps[rj.next];
+
+      string log = "logs/" + stepName( rj.run, st ) + ".log";
+
+      pid_t pid = fork();
+
+      if( pid == 0 ) { // child
+
+	int fd = open( log.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+	if( fd >= 0 ) {
+	  dup2( fd, 1 );
+	  dup2( fd, 2 );
+	  close( fd );
+	}
+
+	setenv( "OMP_NUM_THREADS", "1", 1 ); // one core per step
+
+	string prog = bin + st.prog;
+	vector <char*> cargs;
+	cargs.push_back( (char*) prog.c_str() );
+	for( size_t ia = 0; ia < st.args.size(); ++ia )
+	  cargs.push_back( (char*) st.args[ia].c_str() );
+	cargs.push_back( 0 );
+
+	execv( prog.c_str(), &cargs[0] );
+	perror( prog.c_str() );
+	_exit( 127 );
+
+      }
+
+      if( pid < 0 ) {
+	perror( "fork" );
+	break;
+      }
+
+      rj.running = 1;
+      running[pid] = best;
+      started[pid] = now();
+
+      cout << "start " << stepName( rj.run, st )
+	   << " (" << running.size() << " running)" << endl;
+
+    } // launch
+
+    if( running.empty() ) break; // all done or blocked by failures
+
+    // wait for any child:
+
+    int status;
+    pid_t pid = waitpid( -1, &status, 0 );
+
+    if( pid < 0 ) {
+      perror( "waitpid" );
+      break;
+    }
+
+    map <pid_t, size_t>::iterator ir = running.find( pid );
+    if( ir == running.end() ) continue;
+
+    runjob & rj = jobs[ir->second];
+    const step & st = rj.steps[rj.next];
+    double dt = now() - started[pid];
+
+    rj.running = 0;
+    running.erase( ir );
+    started.erase( pid );
+
+    bool ok = WIFEXITED( status ) && WEXITSTATUS( status ) == 0;
+
+    state << stateKey( rj, st ) << ( ok ? " ok " : " failed " ) << dt << endl; // flushed
+
+    if( ok ) {
+      ++nok;
+      ++rj.next;
+    }
+    else {
+      ++nfail;
+      rj.failed = 1; // later steps of this run wait for the next call
+    }
+
+    cout << ( ok ? "done  " : "FAIL  " ) << stepName( rj.run, st )
+	 << " after " << dt << " s"
+	 << ", " << nleft - nok - nfail << " steps left" << endl;
+
+  } // schedule
+
+  cout << nok << " steps done, " << nfail << " failed" << endl;
+  if( nfail )
+    cout << "see logs/, the failed steps are redone in the next call" << endl;
+
+  return nfail > 0;
+}
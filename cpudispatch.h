@@ -0,0 +1,38 @@
+// cpudispatch.h
+// one binary for all batch nodes: hot array loops are compiled for
+// several instruction sets, at program start the loader picks the widest
+// one the CPU has (gcc target_clones, ifunc). No -march in the Makefile.
+
+// CPU_DISPATCH void kernel( unsigned n, const double * x, double * y ) { plain loop }
+// cout << "vector kernels: " << cpuLevel() << endl; // for the log
+
+// Vectorizer and FP flags come from the Makefile, per program ($(VECFLAGS)):
+// -ftree-vectorize for gcc before 12, no contraction to FMA in the clones,
+// same bits on all nodes. -DNO_CPU_DISPATCH for a single plain -O2 version.
+
+#ifndef CPUDISPATCH_H
+#define CPUDISPATCH_H
+
+#if defined(__GNUC__) && !defined(__clang__) && !defined(__CLING__) \
+  && defined(__x86_64__) && !defined(NO_CPU_DISPATCH)
+
+#define CPU_DISPATCH __attribute__(( \
+  target_clones( "default", "avx2", "avx512f" ) ))
+
+inline const char * cpuLevel() // the clone the loader picks
+{
+  __builtin_cpu_init();
+  if( __builtin_cpu_supports( "avx512f" ) ) return "avx512f";
+  if( __builtin_cpu_supports( "avx2" ) ) return "avx2";
+  return "sse2";
+}
+
+#else
+
+#define CPU_DISPATCH
+
+inline const char * cpuLevel() { return "default"; }
+
+#endif
+
+#endif
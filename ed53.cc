@@ -5,6 +5,8 @@
 // make ed53
 // ed53 34239
 // ed53 36619
+// ed53 -B pics -l 50000 36619
+// (batch: no window, pixel maps to pics/ed53_36619_EVENT.png)
 // needs runs.dat
 
 #include "eudaq/FileReader.hh"
@@ -14,11 +16,19 @@
 #include <TApplication.h>
 #include <TSystem.h>
 #include <TCanvas.h>
+#include <TROOT.h> // gROOT
 #include <TStyle.h>
 #include <TH2.h>
 
 #include <map>
-#include <sys/ioctl.h>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <poll.h>
+
+#include "telecore.h" // clustering, hot pixels
 
 using namespace std;
 using namespace eudaq;
@@ -40,12 +50,19 @@ struct cluster {
   double mindxy;
 };
 
+struct edevent { // from the prefetch thread
+  int iev;
+  vector <cluster> vcl;
+  int maxncol, maxnrow;
+};
+
 //------------------------------------------------------------------------------
-bool kbhit()
+bool keyhit( int ms ) // wait up to ms for input on stdin
 {
-  int byteswaiting;
-  ioctl( 0, FIONREAD, &byteswaiting );
-  return byteswaiting > 0;
+  pollfd pfd;
+  pfd.fd = 0;
+  pfd.events = POLLIN;
+  return poll( &pfd, 1, ms ) > 0;
 }
 
 //------------------------------------------------------------------------------
@@ -54,47 +71,9 @@ vector <cluster> getClusq( vector <pixel> pb, int fCluCut = 1 ) // 1 = no gap
   // returns clusters with pixel coordinates
   // next-neighbour topological clustering (allows fCluCut-1 empty pixels)
 
-  vector <cluster> vc;
-  if( pb.size() == 0 ) return vc;
-
-  int* gone = new int[pb.size()];
-  for( unsigned i = 0; i < pb.size(); ++i )
-    gone[i] = 0;
-
-  unsigned seed = 0;
-
-  while( seed < pb.size() ) {
-
-    // start a new cluster
-
-    cluster c;
-    c.vpix.push_back( pb[seed] );
-    gone[seed] = 1;
-
-    // let it grow as much as possible:
-
-    int growing;
-    do {
-      growing = 0;
-      for( unsigned i = 0; i < pb.size(); ++i ) {
-        if( !gone[i] ){ // unused pixel
-          for( unsigned int p = 0; p < c.vpix.size(); ++p ) { // vpix in cluster so far
-            int dr = c.vpix.at(p).row - pb[i].row;
-            int dc = c.vpix.at(p).col - pb[i].col;
-            if( (   dr>=-fCluCut) && (dr<=fCluCut) 
-		&& (dc>=-fCluCut) && (dc<=fCluCut) ) {
-              c.vpix.push_back(pb[i]);
-	      gone[i] = 1;
-              growing = 1;
-              break; // important!
-            }
-          } // loop over vpix
-        } // not gone
-      } // loop over all pix
-    }
-    while( growing );
+  return clusterPixels<cluster>( pb, NearSquare( fCluCut ), []( cluster & c ) {
 
-    // added all I could. determine position and append it to the list of clusters:
+    // added all I could. determine position:
 
     c.size = c.vpix.size();
     c.col = 0;
@@ -143,17 +122,7 @@ vector <cluster> getClusq( vector <pixel> pb, int fCluCut = 1 ) // 1 = no gap
     c.nfrm = maxf-minf+1;
     c.mindxy = 999;
 
-    vc.push_back(c); // add cluster to vector
-
-    // look for a new seed = used pixel:
-
-    while( ( ++seed < pb.size() ) && gone[seed] );
-
-  } // while over seeds
-
-  delete gone;
-
-  return vc; // vector of clusters
+  } );
 }
 
 //------------------------------------------------------------------------------
@@ -177,14 +146,20 @@ int main( int argc, char* argv[] )
   // further arguments:
 
   int lev = 999222111; // last event
+  string batchDir; // batch: images, no window
 
   for( int i = 1; i < argc; ++i ) {
 
     if( !strcmp( argv[i], "-l" ) )
       lev = atoi( argv[++i] ); // last event
 
+    if( !strcmp( argv[i], "-B" ) )
+      batchDir = argv[++i]; // batch output directory
+
   } // argc
 
+  bool lbatch = ! batchDir.empty();
+
   gStyle->SetTextFont(62); // 62 = Helvetica bold
   gStyle->SetTextAlign(11);
 
@@ -229,6 +204,11 @@ int main( int argc, char* argv[] )
   //gStyle->SetPalette(109); // sea blue to magenta
   gStyle->SetNumberContours(16); // 0..16
 
+  if( lbatch ) {
+    gROOT->SetBatch( 1 ); // no X, before TApplication
+    gSystem->mkdir( batchDir.c_str(), kTRUE );
+  }
+
   TApplication app( "app", 0, 0 );
   TCanvas c1( "c1", "RD53A event display", 900, 800 ); // square
   c1.SetTopMargin( 0.12 );
@@ -343,24 +323,25 @@ int main( int argc, char* argv[] )
   else
     reader = new FileReader( runnum.c_str(), "data/run$6R$X" );
 
-  int iev = 0;
+  // prefetch thread: reads, converts and clusters ahead,
+  // queues the events that will be shown
 
   bool ldbg = 0;
-  bool more = 1;
-
-  do {
 
-    DetectorEvent evt = reader->GetDetectorEvent();
+  unsigned nahead = 16; // events queued
 
-    if( evt.IsBORE() )
-      eudaq::PluginManager::Initialize(evt);
+  deque <edevent> queue;
+  mutex qmtx;
+  condition_variable qcv;
+  bool qdone = 0; // end of file or lev
+  bool qstop = 0; // display closed
 
+  auto decode = [&]( DetectorEvent & evt, edevent & ev )
+  {
     StandardEvent sevt = eudaq::PluginManager::ConvertToStandard(evt);
 
     if( ldbg ) cout << "planes " << sevt.NumPlanes() << endl;
 
-    vector < cluster > vcl;
-
     map <int, int> cols;
     map <int, int> rows;
 
@@ -435,13 +416,84 @@ int main( int argc, char* argv[] )
 
       // clustering:
 
-      vcl = getClusq( pb );
+      ev.vcl = getClusq( pb );
 
       if( ldbg )
-	cout << "    clusters " << vcl.size() << endl;
+	cout << "    clusters " << ev.vcl.size() << endl;
 
     } // planes
 
+    ev.maxncol = 0;
+    ev.maxnrow = 0;
+    for( vector<cluster>::iterator c = ev.vcl.begin(); c != ev.vcl.end(); ++c ) {
+      if( c->ncol > ev.maxncol )
+	ev.maxncol = c->ncol;
+      if( c->nrow > ev.maxnrow )
+	ev.maxnrow = c->nrow;
+    }
+  };
+
+  thread prefetch( [&]() {
+
+      int jev = 0;
+
+      do {
+
+	DetectorEvent evt = reader->GetDetectorEvent();
+
+	if( evt.IsBORE() )
+	  eudaq::PluginManager::Initialize(evt);
+
+	edevent ev;
+	ev.iev = jev;
+	decode( evt, ev );
+
+	//if( ev.maxncol > 33 ) {
+	if( ev.maxncol > 22 ) { // show
+	  //if( rows.size() > 22 ) {
+	  unique_lock<mutex> lock( qmtx );
+	  qcv.wait( lock, [&]() { return queue.size() < nahead || qstop; } );
+	  if( qstop ) break;
+	  queue.push_back( ev );
+	  qcv.notify_all();
+	}
+
+	++jev;
+
+      } while( !qstop && reader->NextEvent() && jev < lev );
+
+      unique_lock<mutex> lock( qmtx );
+      qdone = 1;
+      qcv.notify_all();
+
+    } ); // prefetch
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+  // display:
+
+  int iev = 0;
+
+  while( 1 ) {
+
+    edevent ev;
+
+    { // next event, keep the window alive while the prefetch catches up
+
+      unique_lock<mutex> lock( qmtx );
+      while( queue.empty() && !qdone ) {
+	qcv.wait_for( lock, chrono::milliseconds(50) );
+	lock.unlock();
+	gSystem->ProcessEvents(); // ROOT
+	lock.lock();
+      }
+      if( queue.empty() ) break; // done
+      ev = queue.front();
+      queue.pop_front();
+      qcv.notify_all();
+    }
+
+    iev = ev.iev;
+
     // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
     // DUT:
 
@@ -451,15 +503,7 @@ int main( int argc, char* argv[] )
     hpxmap.SetMinimum(0);
     hpxmap.SetMaximum(16);
 
-    int maxncol = 0;
-    int maxnrow = 0;
-    for( vector<cluster>::iterator c = vcl.begin(); c != vcl.end(); ++c ) {
-
-      if( c->ncol > maxncol )
-	maxncol = c->ncol;
-
-      if( c->nrow > maxnrow )
-	maxnrow = c->nrow;
+    for( vector<cluster>::iterator c = ev.vcl.begin(); c != ev.vcl.end(); ++c ) {
 
       for( vector<pixel>::iterator px = c->vpix.begin(); px != c->vpix.end(); ++px ) {
 
@@ -469,30 +513,34 @@ int main( int argc, char* argv[] )
 
     } // clus
 
-    //if( maxncol > 33 ) {
-    if( maxncol > 22 ) {
-      //if( rows.size() > 22 ) {
-
-      hpxmap.Draw( "colz" );
-      c1.Update();
+    hpxmap.Draw( "colz" );
+    c1.Update();
 
-      cout << "event " << iev
-	   << ". enter any key, q to stop" << endl;
+    if( lbatch ) { // the prefetch thread decodes the next ones meanwhile
+      c1.Print( Form( "%s/ed53_%i_%i.png", batchDir.c_str(), run, iev ) );
+      continue;
+    }
 
-      while( !kbhit() ) // ioctl
-	gSystem->ProcessEvents(); // ROOT
+    cout << "event " << iev
+	 << ". enter any key, q to stop" << endl;
 
-      string q {"q"};
-      string any;
-      cin >> any;
-      if( any == q )
-	more = 0;
+    while( !keyhit( 50 ) ) // sleeps in poll
+      gSystem->ProcessEvents(); // ROOT
 
-    } // show
+    string q {"q"};
+    string any;
+    cin >> any;
+    if( any == q )
+      break;
 
-    ++iev;
+  } // display
 
-  } while( more && reader->NextEvent() && iev < lev );
+  {
+    unique_lock<mutex> lock( qmtx );
+    qstop = 1;
+    qcv.notify_all();
+  }
+  prefetch.join();
 
   delete reader;
 
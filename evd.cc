@@ -3,7 +3,17 @@
 // telescope event display using ROOT
 
 // make evd
-// evd -l 9 24500
+// evd 24500
+// a pass without drawing writes the selection index evd_24500.idx,
+// in the background: the display starts at once and waits only when it
+// reaches the end of the index
+// then enter = next selected event, b = back, number = jump, q = quit
+// (-t 2 -u 1: at least 2 triplets and 1 driplet, -k dmr: DUT, MOD, REF linked)
+// (-j 1234: start at event 1234, -i: rebuild the index)
+// (-a: no keyboard, 0.5 s per event, -l 9 events)
+// evd -B pics -P 8 -l 500 24500
+// (batch: no window, selected events to pics/evd_24500_EVENT.png, 8 processes)
+// (-E list.txt: events from a file, one per line, instead of the selection)
 
 #include "eudaq/FileReader.hh"
 #include "eudaq/PluginManager.hh"
@@ -21,12 +31,21 @@
 #include <TH2I.h>
 #include <TF1.h>
 #include <TLine.h>
+#include <TSystem.h>
+#include <TROOT.h> // gROOT
 
 #include <sstream> // stringstream
 #include <fstream> // filestream
 #include <set>
 #include <cmath> // fabs
-#include <unistd.h> // usleep
+#include <algorithm> // upper_bound
+#include <thread> // background index
+#include <mutex>
+#include <condition_variable>
+#include <sys/wait.h> // waitpid
+#include <unistd.h> // fork
+
+#include "telecore.h" // clustering, hot pixels
 
 using namespace std;
 using namespace eudaq;
@@ -73,10 +92,23 @@ struct triplet {
   double ttdmin;
 };
 
+struct evdindex { // one line in evd_RUN.idx
+  int event;
+  int ncl; // all planes
+  int ntri;
+  int ndri;
+  bool dutlk; // triplet at a DUT cluster
+  bool modlk; // driplet at a MOD cluster
+  bool reflk; // driplet at a REF cluster
+  int npl[9]; // clusters per plane
+};
+
 // globals:
 
-pixel pb[999]; // global declaration: array of pixel hits
-int fNHit; // global
+thread_local pixel pb[999]; // pixel hits, per thread: display and index
+thread_local int fNHit;
+
+mutex pluginMutex; // eudaq converters are not thread-safe
 
 //------------------------------------------------------------------------------
 MyMainFrame::MyMainFrame( const TGWindow * p, UInt_t w, UInt_t h )
@@ -141,48 +173,9 @@ vector<cluster> getClus()
   const int fCluCut = 1; // clustering: 1 = no gap (15.7.2012)
   //const int fCluCut = 2;
 
-  vector<cluster> v;
-  if( fNHit == 0 ) return v;
-
-  int* gone = new int[fNHit];
-
-  for( int i = 0; i < fNHit; ++i )
-    gone[i] = 0;
-
-  int seed = 0;
+  return clusterPixels<cluster>( pb, fNHit, NearSquare( fCluCut ), []( cluster & c ) {
 
-  while( seed < fNHit ) {
-
-    // start a new cluster
-
-    cluster c;
-    c.vpix.push_back( pb[seed] );
-    gone[seed] = 1;
-
-    // let it grow as much as possible:
-
-    int growing;
-    do {
-      growing = 0;
-      for( int i = 0; i < fNHit; ++i ) {
-        if( !gone[i] ){ // unused pixel
-          for( unsigned int p = 0; p < c.vpix.size(); ++p ) { // vpix in cluster so far
-            int dr = c.vpix.at(p).row - pb[i].row;
-            int dc = c.vpix.at(p).col - pb[i].col;
-            if( (   dr>=-fCluCut) && (dr<=fCluCut) 
-		&& (dc>=-fCluCut) && (dc<=fCluCut) ) {
-              c.vpix.push_back(pb[i]);
-	      gone[i] = 1;
-              growing = 1;
-              break; // important!
-            }
-          } // loop over vpix
-        } // not gone
-      } // loop over all pix
-    }
-    while( growing );
-
-    // added all I could. determine position and append it to the list of clusters:
+    // added all I could. determine position:
 
     c.size = c.vpix.size();
     c.col = 0;
@@ -223,18 +216,7 @@ vector<cluster> getClus()
     c.ncol = maxx-minx+1;
     c.nrow = maxy-miny+1;
 
-    v.push_back(c); // add cluster to vector
-
-    // look for a new seed = used pixel:
-
-    while( (++seed < fNHit) && gone[seed] );
-
-  } // while over seeds
-
-  // nothing left, return clusters
-
-  delete gone;
-  return v;
+  } );
 }
 
 //------------------------------------------------------------------------------
@@ -265,6 +247,18 @@ int main( int argc, char* argv[] )
 
   double thr = 0; // offline pixel threshold [ke]
 
+  bool lindex = 0; // rebuild the index
+  bool lauto = 0; // slide show
+  int jev = 0; // first event displayed
+  int mintri = 0;
+  int mindri = 0;
+  bool lkdut = 0;
+  bool lkmod = 0;
+  bool lkref = 0;
+  string batchDir; // batch: images, no window
+  int nproc = 1; // batch processes
+  string listFileName; // batch: events from a file
+
   for( int i = 1; i < argc; ++i ) {
 
     if( !strcmp( argv[i], "-l" ) )
@@ -282,8 +276,42 @@ int main( int argc, char* argv[] )
     if( !strcmp( argv[i], "-r" ) )
       syncref = 1;
 
+    if( !strcmp( argv[i], "-i" ) )
+      lindex = 1;
+
+    if( !strcmp( argv[i], "-a" ) )
+      lauto = 1;
+
+    if( !strcmp( argv[i], "-j" ) )
+      jev = atoi( argv[++i] ); // jump to event
+
+    if( !strcmp( argv[i], "-t" ) )
+      mintri = atoi( argv[++i] ); // min triplets
+
+    if( !strcmp( argv[i], "-u" ) )
+      mindri = atoi( argv[++i] ); // min driplets
+
+    if( !strcmp( argv[i], "-k" ) ) { // linked: d = DUT, m = MOD, r = REF
+      string lk( argv[++i] );
+      lkdut = lk.find( 'd' ) != string::npos;
+      lkmod = lk.find( 'm' ) != string::npos;
+      lkref = lk.find( 'r' ) != string::npos;
+    }
+
+    if( !strcmp( argv[i], "-B" ) )
+      batchDir = argv[++i]; // batch output directory
+
+    if( !strcmp( argv[i], "-P" ) )
+      nproc = atoi( argv[++i] ); // batch processes
+
+    if( !strcmp( argv[i], "-E" ) )
+      listFileName = argv[++i]; // event list
+
   } // argc
 
+  bool lbatch = ! batchDir.empty();
+  if( nproc < 1 ) nproc = 1;
+
   if( syncdut )
     cout << "re-sync DUT" << endl;
   if( syncref )
@@ -386,7 +414,7 @@ int main( int argc, char* argv[] )
 	continue;
       }
 
-      if( tag == weib ) {
+      if( tag == WEIB ) {
 	tokenizer >> weib;
 	continue;
       }
@@ -430,120 +458,21 @@ int main( int argc, char* argv[] )
 
   double zz[9];
 
-  for( int ipl = 0; ipl < 9; ++ipl )
-    nx[ipl] = 0; // missing plane flag
-
-  ifstream geoFile( geoFileName );
-
   cout << endl;
 
-  if( geoFile.bad() || ! geoFile.is_open() ) {
+  if( ! readGeo( geoFileName, 0, 8,
+		 nx, ny, sizex, sizey, zz, ptchx, ptchy, midx, midy ) ) {
     cout << "Error opening " << geoFileName << endl;
     return 1;
   }
 
-  cout << "read geometry from " << geoFileName << endl;
-
-  { // open local scope
-
-    string hash( "#" );
-    string plane( "plane" );
-    string type( "type" );
-    string sizexs( "sizex" );
-    string sizeys( "sizey" );
-    string npixelx( "npixelx" );
-    string npixely( "npixely" );
-    string zpos( "zpos" );
-
-    int ipl = 0;
-    string chiptype;
-
-    while( ! geoFile.eof() ) {
-
-      string line;
-      getline( geoFile, line );
-      cout << line << endl;
-
-      if( line.empty() ) continue;
-
-      stringstream tokenizer( line );
-      string tag;
-      tokenizer >> tag; // leading white space is suppressed
-      if( tag.substr(0,1) == hash ) // comments start with #
-	continue;
-
-      if( tag == plane ) {
-	tokenizer >> ipl;
-	continue;
-      }
-
-      if( ipl < 0 || ipl >= 9 ) {
-	cout << "wrong plane number " << ipl << endl;
-	continue;
-      }
-
-      if( tag == type ) {
-	tokenizer >> chiptype;
-	continue;
-      }
-
-      if( tag == sizexs ) {
-	double val;
-	tokenizer >> val;
-	sizex[ipl] = val;
-	continue;
-      }
-
-      if( tag == sizeys ) {
-	double val;
-	tokenizer >> val;
-	sizey[ipl] = val;
-	continue;
-      }
-
-      if( tag == npixelx ) {
-	int val;
-	tokenizer >> val;
-	nx[ipl] = val;
-	continue;
-      }
-
-      if( tag == npixely ) {
-	int val;
-	tokenizer >> val;
-	ny[ipl] = val;
-	continue;
-      }
-
-      if( tag == zpos ) {
-	double val;
-	tokenizer >> val;
-	zz[ipl] = val;
-	continue;
-      }
-
-      // anything else on the line and in the file gets ignored
-
-    } // while getline
-
-    for( int ipl = 0; ipl < 9; ++ipl ) {
-      if( nx[ipl] == 0 ) continue; // missing plane flag
-      ptchx[ipl] = sizex[ipl] / nx[ipl]; // pixel size
-      ptchy[ipl] = sizey[ipl] / ny[ipl];
-      midx[ipl] = 0.5 * sizex[ipl]; // mid plane
-      midy[ipl] = 0.5 * sizey[ipl]; // mid plane
-    }
-
-  } // geo scope
-
-  geoFile.close();
-
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
   // alignments:
 
   int aligniteration = 0;
   double alignx[9];
   double aligny[9];
+  double alignz[9];
   double rotx[9];
   double roty[9];
 
@@ -551,74 +480,15 @@ int main( int argc, char* argv[] )
 
   alignFileName << "align_" << run << ".dat";
 
-  ifstream ialignFile( alignFileName.str() );
-
   cout << endl;
 
-  if( ialignFile.bad() || ! ialignFile.is_open() ) {
+  if( ! readAlign( alignFileName.str(), 0, 8,
+		   aligniteration, alignx, aligny, alignz, rotx, roty ) ) {
     cout << "Error opening " << alignFileName.str() << endl
 	 << "  please do: tele -g " << geoFileName << " " << run << endl
 	 << endl;
     return 1;
   }
-  // can there be instructions between if and else ?
-  else {
-
-    cout << "read alignment from " << alignFileName.str() << endl;
-
-    string hash( "#" );
-    string iteration( "iteration" );
-    string plane( "plane" );
-    string shiftx( "shiftx" );
-    string shifty( "shifty" );
-    string rotxvsy( "rotxvsy" );
-    string rotyvsx( "rotyvsx" );
-
-    int ipl = 0;
-
-    while( ! ialignFile.eof() ) {
-
-      string line;
-      getline( ialignFile, line );
-      cout << line << endl;
-
-      if( line.empty() ) continue;
-
-      stringstream tokenizer( line );
-      string tag;
-      tokenizer >> tag; // leading white space is suppressed
-      if( tag.substr(0,1) == hash ) // comments start with #
-	continue;
-
-      if( tag == iteration ) 
-	tokenizer >> aligniteration;
-
-      if( tag == plane )
-	tokenizer >> ipl;
-
-      if( ipl < 0 || ipl >= 9 ) {
-	cout << "wrong plane number " << ipl << endl;
-	continue;
-      }
-
-      double val;
-      tokenizer >> val;
-      if(      tag == shiftx )
-	alignx[ipl] = val;
-      else if( tag == shifty )
-	aligny[ipl] = val;
-      else if( tag == rotxvsy )
-	rotx[ipl] = val;
-      else if( tag == rotyvsx )
-	roty[ipl] = val;
-
-      // anything else on the line and in the file gets ignored
-
-    } // while getline
-
-  } // alignFile
-
-  ialignFile.close();
 
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
   // hot pixels:
@@ -627,58 +497,10 @@ int main( int argc, char* argv[] )
 
   hotFileName << "hot_" << run << ".dat";
 
-  ifstream ihotFile( hotFileName.str() );
-
   set <int> hotset[9];
 
-  if( ihotFile.bad() || ! ihotFile.is_open() ) {
+  if( ! readHotPixels( hotFileName.str(), ny, hotset, 0, 5 ) )
     cout << "no " << hotFileName.str() << " (created by tele)" << endl;
-  }
-  else {
-
-    cout << "read hot pixel list from " << hotFileName.str() << endl;
-
-    string hash( "#" );
-    string plane( "plane" );
-    string pix( "pix" );
-
-    int ipl = 0;
-
-    while( ! ihotFile.eof() ) {
-
-      string line;
-      getline( ihotFile, line );
-      cout << line << endl;
-
-      if( line.empty() ) continue;
-
-      stringstream tokenizer( line );
-      string tag;
-      tokenizer >> tag; // leading white space is suppressed
-      if( tag.substr(0,1) == hash ) // comments start with #
-	continue;
-
-      if( tag == plane )
-	tokenizer >> ipl;
-
-      if( ipl < 0 || ipl >= 6 ) {
-	//cout << "wrong plane number " << ipl << endl;
-	continue;
-      }
-
-      if( tag == pix ) {
-	int ix, iy;
-	tokenizer >> ix;
-	tokenizer >> iy;
-	int ipx = ix*ny[ipl]+iy;
-	hotset[ipl].insert(ipx);
-      }
-
-    } // while getline
-
-  } // hotFile
-
-  ihotFile.close();
 
   for( int ipl = 0; ipl < 6; ++ipl )
     cout << ipl << ": hot " << hotset[ipl].size() << endl;
@@ -717,65 +539,11 @@ int main( int argc, char* argv[] )
 
   DUTalignFileName << "alignDUT_" << run << ".dat";
 
-  ifstream iDUTalignFile( DUTalignFileName.str() );
-
   cout << endl;
 
-  if( iDUTalignFile.bad() || ! iDUTalignFile.is_open() ) {
+  if( ! readDUTAlign( DUTalignFileName.str(), DUTaligniteration,
+		      DUTalignx, DUTaligny, DUTrot, DUTtilt, DUTturn, DUTz, zz[2] ) )
     cout << "no " << DUTalignFileName.str() << ", will bootstrap" << endl;
-  }
-  else {
-
-    cout << "read DUTalignment from " << DUTalignFileName.str() << endl;
-
-    string hash( "#" );
-    string iteration( "iteration" );
-    string alignx( "alignx" );
-    string aligny( "aligny" );
-    string rot( "rot" );
-    string tilt( "tilt" );
-    string turn( "turn" );
-    string dz( "dz" );
-
-    while( ! iDUTalignFile.eof() ) {
-
-      string line;
-      getline( iDUTalignFile, line );
-      cout << line << endl;
-
-      if( line.empty() ) continue;
-
-      stringstream tokenizer( line );
-      string tag;
-      tokenizer >> tag; // leading white space is suppressed
-      if( tag.substr(0,1) == hash ) // comments start with #
-	continue;
-
-      if( tag == iteration ) 
-	tokenizer >> DUTaligniteration;
-
-      double val;
-      tokenizer >> val;
-      if(      tag == alignx )
-	DUTalignx = val;
-      else if( tag == aligny )
-	DUTaligny = val;
-      else if( tag == rot )
-	DUTrot = val;
-      else if( tag == tilt )
-	DUTtilt = val;
-      else if( tag == turn )
-	DUTturn = val;
-      else if( tag == dz )
-	DUTz = val + zz[2];
-
-      // anything else on the line and in the file gets ignored
-
-    } // while getline
-
-  } // alignFile
-
-  iDUTalignFile.close();
 
   if( DUTaligniteration == 0 )
     DUTtilt = DUTtilt0; // from runs.dat
@@ -812,59 +580,13 @@ int main( int argc, char* argv[] )
 
   REFalignFileName << "alignREF_" << run << ".dat";
 
-  ifstream iREFalignFile( REFalignFileName.str() );
-
   cout << endl;
 
-  if( iREFalignFile.bad() || ! iREFalignFile.is_open() ) {
-    cout << "no " << REFalignFileName.str() << ", will bootstrap" << endl;
-  }
-  else {
-
-    cout << "read REFalignment from " << REFalignFileName.str() << endl;
-
-    string hash( "#" );
-    string iteration( "iteration" );
-    string alignx( "alignx" );
-    string aligny( "aligny" );
-    string rot( "rot" );
-    string dz( "dz" );
-
-    while( ! iREFalignFile.eof() ) {
-
-      string line;
-      getline( iREFalignFile, line );
-      cout << line << endl;
+  double REFtilt = 0, REFturn = 0; // not in the REF file
 
-      if( line.empty() ) continue;
-
-      stringstream tokenizer( line );
-      string tag;
-      tokenizer >> tag; // leading white space is suppressed
-      if( tag.substr(0,1) == hash ) // comments start with #
-	continue;
-
-      if( tag == iteration ) 
-	tokenizer >> REFaligniteration;
-
-      double val;
-      tokenizer >> val;
-      if(      tag == alignx )
-	REFalignx = val;
-      else if( tag == aligny )
-	REFaligny = val;
-      else if( tag == rot )
-	REFrot = val;
-      else if( tag == dz )
-	REFz = val + zz[5];
-
-      // anything else on the line and in the file gets ignored
-
-    } // while getline
-
-  } // alignFile
-
-  iREFalignFile.close();
+  if( ! readDUTAlign( REFalignFileName.str(), REFaligniteration,
+		      REFalignx, REFaligny, REFrot, REFtilt, REFturn, REFz, zz[5] ) )
+    cout << "no " << REFalignFileName.str() << ", will bootstrap" << endl;
 
   zz[iREF] = REFz;
   alignx[iREF] = REFalignx;
@@ -889,65 +611,11 @@ int main( int argc, char* argv[] )
 
   MODalignFileName << "alignMOD_" << run << ".dat";
 
-  ifstream iMODalignFile( MODalignFileName.str() );
-
   cout << endl;
 
-  if( iMODalignFile.bad() || ! iMODalignFile.is_open() ) {
+  if( ! readDUTAlign( MODalignFileName.str(), MODaligniteration,
+		      MODalignx, MODaligny, MODrot, MODtilt, MODturn, MODz, zz[4] ) )
     cout << "no " << MODalignFileName.str() << ", will bootstrap" << endl;
-  }
-  else {
-
-    cout << "read MODalignment from " << MODalignFileName.str() << endl;
-
-    string hash( "#" );
-    string iteration( "iteration" );
-    string alignx( "alignx" );
-    string aligny( "aligny" );
-    string rot( "rot" );
-    string tilt( "tilt" );
-    string turn( "turn" );
-    string dz( "dz" );
-
-    while( ! iMODalignFile.eof() ) {
-
-      string line;
-      getline( iMODalignFile, line );
-      cout << line << endl;
-
-      if( line.empty() ) continue;
-
-      stringstream tokenizer( line );
-      string tag;
-      tokenizer >> tag; // leading white space is suppressed
-      if( tag.substr(0,1) == hash ) // comments start with #
-	continue;
-
-      if( tag == iteration ) 
-	tokenizer >> MODaligniteration;
-
-      double val;
-      tokenizer >> val;
-      if(      tag == alignx )
-	MODalignx = val;
-      else if( tag == aligny )
-	MODaligny = val;
-      else if( tag == rot )
-	MODrot = val;
-      else if( tag == tilt )
-	MODtilt = val;
-      else if( tag == turn )
-	MODturn = val;
-      else if( tag == dz )
-	MODz = val + zz[4];
-
-      // anything else on the line and in the file gets ignored
-
-    } // while getline
-
-  } // alignFile
-
-  iMODalignFile.close();
 
   zz[iMOD] = MODz;
   alignx[iMOD] = MODalignx;
@@ -1053,6 +721,9 @@ int main( int argc, char* argv[] )
 
   cout << "ROOT application..." << endl;
 
+  if( lbatch )
+    gROOT->SetBatch( 1 ); // no X, before TApplication
+
   TApplication theApp( "comet", &argc, argv );
 
   gStyle->SetTextFont( 62 ); // 62 = Helvetica bold
@@ -1109,14 +780,28 @@ int main( int argc, char* argv[] )
 
   gStyle->SetOptDate( 0 );
 
-  cout << "open ROOT window..." << endl;
-  MyMainFrame *myMF = new
-    MyMainFrame( gClient->GetRoot(  ), 1400, 800 );
+  MyMainFrame *myMF = 0;
+  TCanvas * cb = 0; // batch: both views in one image
+
+  TVirtualPad * c1;
+  TVirtualPad * c2;
+
+  if( lbatch ) {
+    cb = new TCanvas( "cb", "evd", 1400, 800 ); // same size as the window
+    cb->Divide( 1, 2, 0, 0 );
+    c1 = cb->cd(1);
+    c2 = cb->cd(2);
+  }
+  else {
+    cout << "open ROOT window..." << endl;
+    myMF = new
+      MyMainFrame( gClient->GetRoot(  ), 1400, 800 );
 
-  cout << "open Canvas..." << endl;
+    cout << "open Canvas..." << endl;
 
-  TCanvas * c1 = myMF->GetCanvas1(  );
-  TCanvas * c2 = myMF->GetCanvas2(  );
+    c1 = myMF->GetCanvas1(  );
+    c2 = myMF->GetCanvas2(  );
+  }
 
   c1->SetBottomMargin( 0.08 );
   c1->SetLeftMargin( 0.03 );
@@ -1129,65 +814,70 @@ int main( int argc, char* argv[] )
   gPad->Update(  ); // required
 
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-  // event loop:
+  // event reconstruction:
 
-  cout << endl;
+  // DUT, MOD and REF hits in the telescope frame:
 
-  FileReader * reader;
-  if(      run <    100 )
-    reader = new FileReader( runnum.c_str(), "data/run0000$2R$X" );
-  else if( run <   1000 )
-    reader = new FileReader( runnum.c_str(), "data/run000$3R$X" );
-  else if( run <  10000 )
-    reader = new FileReader( runnum.c_str(), "data/run00$4R$X" );
-  else if( run < 100000 )
-    reader = new FileReader( runnum.c_str(), "data/run0$5R$X" );
-  else
-    reader = new FileReader( runnum.c_str(), "data/run$6R$X" );
+  auto hitxyz = [&]( int ipl, const cluster & c, double & xA, double & yA, double & zA )
+  {
+    xA = c.col*ptchx[ipl] - alignx[ipl];
+    yA = c.row*ptchy[ipl] - aligny[ipl];
+    double xmid = xA - midx[ipl];
+    double ymid = yA - midy[ipl];
+    zA = zz[ipl];
 
-  int event_nr = 0;
-  int nevd = 0;
-  uint64_t evTLU0 = 0;
-  const double fTLU = 384E6; // 384 MHz TLU clock
+    if( ipl == iDUT ) {
 
-  vector <cluster> cl0[9]; // remember from previous event
+      xmid = upsignx*xmid;
+      ymid =-upsigny*ymid;
+      xA = xmid - ymid*rotx[iDUT];
+      yA = ymid + xmid*roty[iDUT];
 
-  do {
-    // Get next event:
-    DetectorEvent evt = reader->GetDetectorEvent();
+      double x2 = xA;
+      double y2 = ca*yA; // tilt -a
+      double z2 = sa*yA;
+
+      xA = co*x2 + so*z2; // turn -o
+      yA = y2;
+      zA+=-so*x2 + co*z2;
 
-    if( evt.IsBORE() ) {
-      eudaq::PluginManager::Initialize(evt);
-      continue;
     }
+    else if( ipl == iMOD ) {
 
-    ++event_nr;
+      xmid =-xmid;
 
-    bool ldbg = 0;
+      xA = cfm*xmid - sfm*ymid; // -rot
+      yA = sfm*xmid + cfm*ymid;
 
-    if( event_nr == 1 )
-      ldbg = 1;
+      double x2 = xA;
+      double y2 = cam*yA; // tilt -a
+      double z2 = sam*yA;
 
-    if( lev < 100 )
-      ldbg = 1;
+      xA = com*x2 + som*z2; // turn -o
+      yA = y2;
+      zA+=-som*x2 + com*z2;
+
+    }
+    else { // REF
 
-    uint64_t evTLU = evt.GetTimestamp(); // 384 MHz = 2.6 ns
-    if( event_nr < 2  )
-      evTLU0 = evTLU;
-    double evsec = (evTLU - evTLU0) / fTLU;
+      xmid =-xmid;
+      xA = xmid - ymid*rotx[iREF];
+      yA = ymid + xmid*roty[iREF];
 
-    if( event_nr < 10 )
-      cout << "scope processing  " << event_nr << "  taken " << evsec << endl;
-    else if( event_nr < 100 && event_nr%10 == 0 )
-      cout << "scope processing  " << event_nr << "  taken " << evsec << endl;
-    else if( event_nr < 1000 && event_nr%100 == 0 )
-      cout << "scope processing  " << event_nr << "  taken " << evsec << endl;
-    else if( event_nr%1000 == 0 )
-      cout << "scope processing  " << event_nr << "  taken " << evsec << endl;
+    }
+  };
+
+  // pixels, clusters, driplets and triplets of one event:
 
+  auto reco = [&]( DetectorEvent & evt, int event_nr, bool ldbg,
+		   vector <cluster> * cl,
+		   vector <triplet> & triplets, vector <triplet> & driplets,
+		   bool ltrk ) // ltrk = 0: clusters only, for re-sync
+  {
+    unique_lock <mutex> plk( pluginMutex );
     StandardEvent sevt = eudaq::PluginManager::ConvertToStandard(evt);
+    plk.unlock();
 
-    vector <cluster> cl[9];
     int ncl = 0;
 
     for( size_t iplane = 0; iplane < sevt.NumPlanes(); ++iplane ) {
@@ -1377,24 +1067,14 @@ int main( int argc, char* argv[] )
 
     } // planes
 
-    if( ! syncdut )
-      cl0[iDUT] = cl[iDUT];
-    if( ! syncref )
-      cl0[iREF] = cl[iREF];
-    if( ! syncmod )
-      cl0[iMOD] = cl[iMOD];
+    driplets.clear();
+    triplets.clear();
 
-    // event selection:
-
-    if( ncl < 6 ) continue;
-    if( cl0[iDUT].size() < 1 ) continue;
-    if( cl0[iREF].size() < 1 ) continue;
+    if( ! ltrk ) return ncl;
 
     // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
     // make driplets 3+5-4:
 
-    vector <triplet> driplets;
-
     double driCut = 0.1; // [mm]
 
     for( vector<cluster>::iterator cA = cl[3].begin(); cA != cl[3].end(); ++cA ) {
@@ -1477,7 +1157,7 @@ int main( int argc, char* argv[] )
     // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
     // make triplets 2+0-1:
 
-    vector <triplet> triplets;
+    triplets.clear();
 
     double triCut = 0.1; // [mm]
 
@@ -1554,6 +1234,418 @@ int main( int argc, char* argv[] )
 
     } // cl A
 
+    return ncl;
+
+  }; // reco
+
+  // a track passes a hit in plane ipl:
+
+  double lkCut = 0.5; // [mm] loose, the display alignment is rough
+
+  auto linked = [&]( const vector <triplet> & tracks, int ipl, const vector <cluster> & hits )
+  {
+    for( unsigned it = 0; it < tracks.size(); ++it )
+      for( unsigned ic = 0; ic < hits.size(); ++ic ) {
+	double xA, yA, zA;
+	hitxyz( ipl, hits[ic], xA, yA, zA );
+	double dz = zA - tracks[it].zm;
+	double dx = xA - tracks[it].xm - tracks[it].sx * dz;
+	double dy = yA - tracks[it].ym - tracks[it].sy * dz;
+	if( fabs( dx ) < lkCut && fabs( dy ) < lkCut )
+	  return true;
+      }
+    return false;
+  };
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+  // raw file: no random access, re-open to go back
+
+  auto newReader = [&]( int & pos ) // pos: event the reader is at, 0 = BORE
+  {
+    FileReader * rd;
+    if(      run <    100 )
+      rd = new FileReader( runnum.c_str(), "data/run0000$2R$X" );
+    else if( run <   1000 )
+      rd = new FileReader( runnum.c_str(), "data/run000$3R$X" );
+    else if( run <  10000 )
+      rd = new FileReader( runnum.c_str(), "data/run00$4R$X" );
+    else if( run < 100000 )
+      rd = new FileReader( runnum.c_str(), "data/run0$5R$X" );
+    else
+      rd = new FileReader( runnum.c_str(), "data/run$6R$X" );
+
+    DetectorEvent evt = rd->GetDetectorEvent();
+    pos = 1;
+    if( evt.IsBORE() ) {
+      lock_guard <mutex> lk( pluginMutex );
+      eudaq::PluginManager::Initialize(evt);
+      pos = 0;
+    }
+    return rd;
+  };
+
+  auto seekIn = [&]( FileReader * & rd, int & pos, int iev ) // raw decoding only
+  {
+    if( rd == 0 || iev < pos ) {
+      delete rd;
+      rd = newReader( pos );
+    }
+    while( pos < iev ) {
+      if( ! rd->NextEvent() ) return false;
+      ++pos;
+    }
+    return true;
+  };
+
+  FileReader * reader = 0; // display
+  int evpos = 0;
+
+  auto seek = [&]( int iev ) { return seekIn( reader, evpos, iev ); };
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+  // selection index: one pass without drawing, kept in evd_RUN.idx,
+  // built on a thread with its own reader while the display runs
+
+  vector <evdindex> index; // index[iev-1]
+  vector <int> sel; // selected events
+  bool indexed = 0; // index complete
+  bool indexStop = 0; // display done first: index not kept
+  mutex indexMutex; // index, sel, indexed, indexStop
+  condition_variable indexGrew;
+
+  auto selected = [&]( const evdindex & ix )
+  {
+    if( ix.ncl < 6 ) return false;
+    if( ix.npl[iDUT] < 1 ) return false;
+    if( ix.npl[iREF] < 1 ) return false;
+    if( ix.ntri < mintri ) return false;
+    if( ix.ndri < mindri ) return false;
+    if( lkdut && ! ix.dutlk ) return false;
+    if( lkmod && ! ix.modlk ) return false;
+    if( lkref && ! ix.reflk ) return false;
+    return true;
+  };
+
+  ostringstream indexFileName; // output string stream
+
+  indexFileName << "evd_" << run << ".idx";
+
+  auto selSummary = [&]()
+  {
+    cout << sel.size() << " of " << index.size() << " events selected"
+	 << ", index in " << indexFileName.str() << endl;
+  };
+
+  ifstream iindexFile( indexFileName.str() );
+
+  if( !lindex && iindexFile ) {
+
+    string line;
+    while( getline( iindexFile, line ) ) {
+      if( line.empty() || line[0] == '#' ) continue;
+      istringstream tokenizer( line );
+      vector <int> v;
+      int k;
+      while( tokenizer >> k )
+	v.push_back( k );
+      if( v.size() != 16 ) { // older layout without track counts
+	cout << "index " << indexFileName.str() << " has another layout, rebuild" << endl;
+	index.clear();
+	break;
+      }
+      evdindex ix;
+      ix.event = v[0];
+      ix.ncl = v[1];
+      ix.ntri = v[2];
+      ix.ndri = v[3];
+      ix.dutlk = v[4];
+      ix.modlk = v[5];
+      ix.reflk = v[6];
+      for( int ipl = 0; ipl < 9; ++ipl )
+	ix.npl[ipl] = v[7+ipl];
+      index.push_back( ix );
+    }
+    if( index.size() ) {
+      cout << "read index of " << index.size() << " events from " << indexFileName.str() << endl;
+      for( unsigned i = 0; i < index.size(); ++i )
+	if( selected( index[i] ) )
+	  sel.push_back( index[i].event );
+      indexed = 1;
+    }
+
+  }
+
+  iindexFile.close();
+
+  if( indexed )
+    selSummary();
+
+  auto writeIndex = [&]() // after the last event
+  {
+    ofstream indexFile( indexFileName.str() );
+    indexFile << "# evd index for run " << run << endl;
+    indexFile << "# event clusters triplets driplets DUTlk MODlk REFlk, clusters per plane 0..8" << endl;
+    for( unsigned i = 0; i < index.size(); ++i ) {
+      indexFile << index[i].event
+		<< " " << index[i].ncl
+		<< " " << index[i].ntri
+		<< " " << index[i].ndri
+		<< " " << index[i].dutlk
+		<< " " << index[i].modlk
+		<< " " << index[i].reflk;
+      for( int ipl = 0; ipl < 9; ++ipl )
+	indexFile << " " << index[i].npl[ipl];
+      indexFile << endl;
+    }
+    indexFile.close();
+  };
+
+  auto buildIndex = [&]()
+  {
+    FileReader * ird = 0;
+    int ipos = 0;
+
+    vector <cluster> clp[9]; // previous event, for re-sync
+    bool lstop = 0;
+
+    for( int iev = 1; seekIn( ird, ipos, iev ); ++iev ) {
+
+      DetectorEvent evt = ird->GetDetectorEvent();
+
+      vector <cluster> cl[9];
+      vector <triplet> triplets;
+      vector <triplet> driplets;
+
+      evdindex ix;
+      ix.event = iev;
+      ix.ncl = reco( evt, iev, 0, cl, triplets, driplets, 1 );
+      ix.ntri = triplets.size();
+      ix.ndri = driplets.size();
+
+      vector <cluster> * cl0[9]; // DUT, REF, MOD as displayed
+      for( int ipl = 0; ipl < 9; ++ipl )
+	cl0[ipl] = &cl[ipl];
+      if( syncdut ) cl0[iDUT] = &clp[iDUT];
+      if( syncref ) cl0[iREF] = &clp[iREF];
+      if( syncmod ) cl0[iMOD] = &clp[iMOD];
+
+      for( int ipl = 0; ipl < 9; ++ipl )
+	ix.npl[ipl] = cl0[ipl]->size();
+
+      ix.dutlk = linked( triplets, iDUT, *cl0[iDUT] );
+      ix.modlk = linked( driplets, iMOD, *cl0[iMOD] );
+      ix.reflk = linked( driplets, iREF, *cl0[iREF] );
+
+      for( int ipl = 0; ipl < 9; ++ipl )
+	clp[ipl].swap( cl[ipl] );
+
+      {
+	lock_guard <mutex> lk( indexMutex );
+	if( indexStop ) {
+	  lstop = 1;
+	  break;
+	}
+	index.push_back( ix );
+	if( selected( ix ) )
+	  sel.push_back( iev );
+      }
+      indexGrew.notify_all();
+
+    } // events
+
+    delete ird;
+
+    if( lstop ) {
+      cout << "index stopped at event " << index.size() << ", not written" << endl;
+      return;
+    }
+
+    writeIndex(); // index is final, the display only reads it
+    selSummary();
+
+    {
+      lock_guard <mutex> lk( indexMutex );
+      indexed = 1;
+    }
+    indexGrew.notify_all();
+  };
+
+  thread indexer;
+
+  if( ! indexed ) {
+    cout << "indexing run " << run << endl;
+    if( lbatch )
+      buildIndex(); // blocks for the processes need the whole selection
+    else
+      indexer = thread( buildIndex );
+  }
+
+  // next selected event after iev, waits for the indexer, 0 = none:
+
+  auto nextSel = [&]( int iev )
+  {
+    unique_lock <mutex> lk( indexMutex );
+    bool lwait = 0;
+    while( true ) {
+      vector<int>::iterator inext = upper_bound( sel.begin(), sel.end(), iev );
+      if( inext != sel.end() ) return *inext;
+      if( indexed ) return 0;
+      if( !lwait )
+	cout << "waiting for the index at event " << index.size() << endl;
+      lwait = 1;
+      indexGrew.wait( lk );
+    }
+  };
+
+  // previous selected event before iev, 0 = none:
+
+  auto prevSel = [&]( int iev )
+  {
+    unique_lock <mutex> lk( indexMutex );
+    if( !indexed && (int) index.size() < iev ) // after a jump ahead
+      cout << "waiting for the index at event " << index.size() << endl;
+    while( !indexed && (int) index.size() < iev )
+      indexGrew.wait( lk );
+    vector<int>::iterator iprev = lower_bound( sel.begin(), sel.end(), iev );
+    return iprev == sel.begin() ? 0 : *(--iprev);
+  };
+
+  auto runEvents = [&]() // 0 = still indexing
+  {
+    lock_guard <mutex> lk( indexMutex );
+    return indexed ? (int) index.size() : 0;
+  };
+
+  if( runEvents() && jev > runEvents() )
+    cout << "no event " << jev << ", the run has " << runEvents() << " events" << endl;
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+  // batch: events to render, split in contiguous blocks over processes,
+  // each process reads the raw file forward once
+
+  int iproc = 0; // batch process, 0 = parent
+  vector <pid_t> pids; // parent: children
+
+  if( lbatch ) {
+
+    vector <int> all;
+
+    if( listFileName.size() ) {
+      ifstream listFile( listFileName );
+      if( !listFile ) {
+	cout << "no event list " << listFileName << endl;
+	return 1;
+      }
+      int ev;
+      int nout = 0;
+      while( listFile >> ev )
+	if( ev > 0 && ev <= (int) index.size() )
+	  all.push_back( ev );
+	else
+	  ++nout;
+      if( nout )
+	cout << nout << " events of " << listFileName << " not in the run of "
+	     << index.size() << " events" << endl;
+      sort( all.begin(), all.end() );
+    }
+    else
+      for( unsigned i = 0; i < sel.size(); ++i )
+	if( sel[i] >= jev )
+	  all.push_back( sel[i] );
+
+    if( (int) all.size() > lev )
+      all.resize( lev );
+
+    gSystem->mkdir( batchDir.c_str(), kTRUE );
+
+    cout << "render " << all.size() << " events to " << batchDir
+	 << " with " << nproc << " processes" << endl;
+
+    delete reader; // each process opens its own
+    reader = 0;
+
+    int nfork = nproc; // processes started
+
+    for( int ip = 1; ip < nproc; ++ip ) {
+      pid_t pid = fork();
+      if( pid == 0 ) {
+	iproc = ip;
+	pids.clear();
+	break;
+      }
+      if( pid < 0 ) {
+	cout << "fork failed, " << ip << " processes" << endl;
+	nfork = ip;
+	break;
+      }
+      pids.push_back( pid );
+    }
+
+    unsigned nall = all.size();
+    unsigned nstart = nall * iproc / nproc;
+    unsigned nend = nall * (iproc+1) / nproc;
+
+    sel.assign( all.begin() + nstart, all.begin() + nend ); // this block
+
+    if( iproc == 0 ) // blocks of processes not started
+      sel.insert( sel.end(), all.begin() + nall * nfork / nproc, all.end() );
+
+  } // batch
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+  // display loop:
+
+  cout << endl;
+
+  int nevd = 0;
+
+  int iev = 0; // event to display
+  if( jev > 0 && !lbatch )
+    iev = jev;
+  else
+    iev = nextSel( 0 );
+
+  int ilast = 0; // last event displayed
+
+  while( iev > 0 ) {
+
+    int event_nr = iev;
+
+    bool ldbg = 0;
+
+    if( lev < 100 && !lbatch )
+      ldbg = 1;
+
+    vector <cluster> cl[9];
+    vector <cluster> cl0[9];
+    vector <triplet> triplets;
+    vector <triplet> driplets;
+
+    if( ( syncdut || syncref || syncmod ) && iev > 1 && seek( iev-1 ) ) {
+      DetectorEvent evp = reader->GetDetectorEvent();
+      reco( evp, iev-1, 0, cl0, triplets, driplets, 0 ); // previous event, clusters
+    }
+
+    if( ! seek( iev ) ) { // a jump while indexing can pass the run end
+      cout << "no event " << iev << ", the run has " << evpos << " events" << endl;
+      if( lbatch || ilast == 0 ) break;
+      iev = ilast;
+      continue;
+    }
+
+    DetectorEvent evt = reader->GetDetectorEvent();
+
+    int ncl = reco( evt, event_nr, ldbg, cl, triplets, driplets, 1 );
+
+    if( ! syncdut )
+      cl0[iDUT] = cl[iDUT];
+    if( ! syncref )
+      cl0[iREF] = cl[iREF];
+    if( ! syncmod )
+      cl0[iMOD] = cl[iMOD];
+
+    ilast = iev;
+
     // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
     // book event histos:
 
@@ -1631,23 +1723,8 @@ int main( int argc, char* argv[] )
 
     for( vector<cluster>::iterator cA = cl0[iDUT].begin(); cA != cl0[iDUT].end(); ++cA ) {
 
-      double xA = cA->col*ptchx[iDUT] - alignx[iDUT];
-      double yA = cA->row*ptchy[iDUT] - aligny[iDUT];
-      double xmid = xA - midx[iDUT];
-      double ymid = yA - midy[iDUT];
-      xmid = upsignx*xmid;
-      ymid =-upsigny*ymid;
-      xA = xmid - ymid*rotx[iDUT];
-      yA = ymid + xmid*roty[iDUT];
-      double zA = zz[iDUT];
-
-      double x2 = xA;
-      double y2 = ca*yA; // tilt -a
-      double z2 = sa*yA;
-
-      xA = co*x2 + so*z2; // turn -o
-      yA = y2;
-      zA+=-so*x2 + co*z2;
+      double xA, yA, zA;
+      hitxyz( iDUT, *cA, xA, yA, zA );
 
       vx.at(icl) = xA;
       vy.at(icl) = yA;
@@ -1682,26 +1759,8 @@ int main( int argc, char* argv[] )
 
     for( vector<cluster>::iterator cA = cl0[iMOD].begin(); cA != cl0[iMOD].end(); ++cA ) {
 
-      double xA = cA->col*ptchx[iMOD] - alignx[iMOD];
-      double yA = cA->row*ptchy[iMOD] - aligny[iMOD];
-
-      double xmid = xA - midx[iMOD];
-      double ymid = yA - midy[iMOD];
-
-      xmid =-xmid;
-      ymid = ymid;
-
-      xA = cfm*xmid - sfm*ymid; // -rot
-      yA = sfm*xmid + cfm*ymid;
-      double zA = zz[iMOD];
-
-      double x2 = xA;
-      double y2 = cam*yA; // tilt -a
-      double z2 = sam*yA;
-
-      xA = com*x2 + som*z2; // turn -o
-      yA = y2;
-      zA+=-som*x2 + com*z2;
+      double xA, yA, zA;
+      hitxyz( iMOD, *cA, xA, yA, zA );
 
       vx.at(icl) = xA;
       vy.at(icl) = yA;
@@ -1736,15 +1795,8 @@ int main( int argc, char* argv[] )
 
     for( vector<cluster>::iterator cA = cl0[iREF].begin(); cA != cl0[iREF].end(); ++cA ) {
 
-      double xA = cA->col*ptchx[iREF] - alignx[iREF];
-      double yA = cA->row*ptchy[iREF] - aligny[iREF];
-      double xmid = xA - midx[iREF];
-      double ymid = yA - midy[iREF];
-      xmid =-xmid;
-      ymid = ymid;
-      xA = xmid - ymid*rotx[iREF];
-      yA = ymid + xmid*roty[iREF];
-      double zA = zz[iREF];
+      double xA, yA, zA;
+      hitxyz( iREF, *cA, xA, yA, zA );
 
       vx.at(icl) = xA;
       vy.at(icl) = yA;
@@ -1842,30 +1894,82 @@ int main( int argc, char* argv[] )
       ylines[ii].Draw("same");
     c2->Update();
 
-    if( syncdut )
-      cl0[iDUT] = cl[iDUT]; // remember for re-sync
-    if( syncref )
-      cl0[iREF] = cl[iREF];
-    if( syncmod )
-      cl0[iMOD] = cl[iMOD];
+    // next event:
+
+    if( lbatch ) {
+
+      cb->Print( Form( "%s/evd_%i_%i.png", batchDir.c_str(), run, iev ) );
+
+      iev = nextSel( iev );
+
+    }
+    else if( lauto ) {
+
+      for( int i = 0; i < 50; ++i ) { // 0.5 s, window stays alive
+	gSystem->ProcessEvents();
+	gSystem->Sleep( 10 );
+      }
+
+      if( nevd >= lev ) break;
+
+      iev = nextSel( iev );
+
+    }
+    else {
 
-    // keyboard interaction:
-    /*
-    string input;
-    cout << "hit enter for next...";
-    getline( cin, input, '\n' );
-    */
+      // keyboard interaction:
 
-    usleep( 500000 ); // sleep some micro-seconds
+      string input;
+      cout << "event " << iev
+	   << ": enter = next, b = back, number = jump, q = quit: " << flush;
+
+      if( ! getline( cin, input, '\n' ) ) break;
+
+      if( input.empty() )
+	iev = nextSel( iev );
+
+      else if( input[0] == 'q' )
+	break;
+
+      else if( input[0] == 'b' ) {
+	int iprev = prevSel( iev );
+	if( iprev > 0 )
+	  iev = iprev;
+      }
+
+      else if( runEvents() && atoi( input.c_str() ) > runEvents() )
+	cout << "no event " << atoi( input.c_str() ) << ", the run has "
+	     << runEvents() << " events" << endl;
+
+      else if( atoi( input.c_str() ) > 0 )
+	iev = atoi( input.c_str() ); // any event, selected or not
+
+    } // interactive
+
+  } // display loop
+
+  delete reader;
+
+  if( indexer.joinable() ) {
+    {
+      lock_guard <mutex> lk( indexMutex );
+      indexStop = 1;
+    }
+    indexer.join();
+  }
 
-  } while( reader->NextEvent() && nevd < lev );
+  if( lbatch )
+    cout << "process " << iproc << ": ";
+  cout << "done after " << nevd << " displays" << endl;
 
-  cout << "done after " << event_nr << " events" << endl;
+  for( size_t ip = 0; ip < pids.size(); ++ip ) // batch: wait for the children
+    waitpid( pids[ip], 0, 0 );
 
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
   // done
 
   delete myMF;
+  delete cb;
 
   cout << endl;
 
@@ -3,6 +3,7 @@
 // event display 4 module planes, B-field, sagitta A C D
 
 // evds -l 19 2321 # 2.0 GeV, 1.4 T, sagitta spacing
+// evds -B pics -l 500 2321 # batch: no window, displays to pics/evds_2321_EVENT.png
 
 #include "eudaq/FileReader.hh"
 #include "eudaq/PluginManager.hh"
@@ -12,6 +13,8 @@
 #include <TGFrame.h>
 #include <TRootEmbeddedCanvas.h>
 #include <TCanvas.h>
+#include <TROOT.h> // gROOT
+#include <TSystem.h> // gSystem
 #include <TStyle.h> // gStyle
 #include <TFile.h>
 #include <TH2D.h>
@@ -26,6 +29,8 @@
 #include <vector>
 #include <unistd.h> // usleep
 
+#include "telecore.h" // clustering, hot pixels
+
 using namespace std;
 using namespace eudaq;
 
@@ -123,46 +128,7 @@ vector<cluster> getClus()
   const int fCluCut = 1; // clustering: 1 = no gap (15.7.2012)
   //const int fCluCut = 2;
 
-  vector<cluster> v;
-  if( fNHit == 0 ) return v;
-
-  int* gone = new int[fNHit];
-
-  for( int i = 0; i < fNHit; ++i )
-    gone[i] = 0;
-
-  int seed = 0;
-
-  while( seed < fNHit ) {
-
-    // start a new cluster
-
-    cluster c;
-    c.vpix.push_back( pb[seed] );
-    gone[seed] = 1;
-
-    // let it grow as much as possible:
-
-    int growing;
-    do{
-      growing = 0;
-      for( int i = 0; i < fNHit; ++i ) {
-        if( !gone[i] ){ // unused pixel
-          for( unsigned int p = 0; p < c.vpix.size(); ++p ) { // vpix in cluster so far
-            int dr = c.vpix.at(p).row - pb[i].row;
-            int dc = c.vpix.at(p).col - pb[i].col;
-            if( (   dr>=-fCluCut) && (dr<=fCluCut) 
-		&& (dc>=-fCluCut) && (dc<=fCluCut) ) {
-              c.vpix.push_back(pb[i]);
-	      gone[i] = 1;
-              growing = 1;
-              break; // important!
-            }
-          } // loop over vpix
-        } // not gone
-      } // loop over all pix
-    }
-    while( growing );
+  return clusterPixels<cluster>( pb, fNHit, NearSquare( fCluCut ), []( cluster & c ) {
 
     // added all I could. determine position and append it to the list o f clusters:
 
@@ -202,18 +168,7 @@ vector<cluster> getClus()
       cout << "GetClus: cluster with zero charge" << endl;
     }
 
-    v.push_back(c); // add cluster to vector
-
-    // look for a new seed = used pixel:
-
-    while( (++seed < fNHit) && gone[seed] );
-
-  } // while over seeds
-
-  // nothing left, return clusters
-
-  delete gone;
-  return v;
+  } );
 }
 
 //------------------------------------------------------------------------------
@@ -238,14 +193,20 @@ int main( int argc, char* argv[] )
   // further arguments:
 
   int lev = 99;
+  string batchDir; // batch: images, no window
 
   for( int i = 1; i < argc; ++i ) {
 
     if( !strcmp( argv[i], "-l" ) )
       lev = atoi( argv[++i] );
 
+    if( !strcmp( argv[i], "-B" ) )
+      batchDir = argv[++i]; // batch output directory
+
   } // argc
 
+  bool lbatch = ! batchDir.empty();
+
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
   // (re-)create root file:
 
@@ -253,6 +214,11 @@ int main( int argc, char* argv[] )
 
   cout << "ROOT application..." << endl;
 
+  if( lbatch ) {
+    gROOT->SetBatch( 1 ); // no X, before TApplication
+    gSystem->mkdir( batchDir.c_str(), kTRUE );
+  }
+
   TApplication theApp( "comet", &argc, argv );
 
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -312,12 +278,19 @@ int main( int argc, char* argv[] )
 
   gStyle->SetOptDate( 0 );
 
-  cout << "open ROOT window..." << endl;
-  MyMainFrame *myMF = new
-    MyMainFrame( gClient->GetRoot(  ), 1400, 700 ); // 4 planes
+  MyMainFrame *myMF = 0;
+  TCanvas * c1;
 
-  cout << "open Canvas..." << endl;
-  TCanvas * c1 = myMF->GetCanvas(  );
+  if( lbatch )
+    c1 = new TCanvas( "cb", "evds", 1400, 700 ); // same size as the window
+  else {
+    cout << "open ROOT window..." << endl;
+    myMF = new
+      MyMainFrame( gClient->GetRoot(  ), 1400, 700 ); // 4 planes
+
+    cout << "open Canvas..." << endl;
+    c1 = myMF->GetCanvas(  );
+  }
 
   c1->SetBottomMargin( 0.11 );
   c1->SetLeftMargin( 0.06 );
@@ -821,7 +794,10 @@ int main( int argc, char* argv[] )
     //cout << "hit enter";
     //getline( cin, input, '\n' );
 
-    usleep( 1900*1000 ); // sleep some micro-seconds
+    if( lbatch )
+      c1->Print( Form( "%s/evds_%i_%i.png", batchDir.c_str(), run, (int) nev ) );
+    else
+      usleep( 1900*1000 ); // sleep some micro-seconds
 
   } while( reader.NextEvent() && kev < lev );
 
@@ -833,6 +809,8 @@ int main( int argc, char* argv[] )
   cout << "write " << histoFile->GetName() << endl;
   delete histoFile;
 
+  if( lbatch )
+    delete c1;
   delete myMF;
 
   return 0;
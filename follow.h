@@ -0,0 +1,109 @@
+// follow.h
+// follow mode: analyse a raw file while the DAQ is still writing it.
+// At the current end of the file NextEvent() is false: wait and retry,
+// until the EORE came or nothing arrived for a while. The output is
+// written every few seconds, so the histograms can be watched live.
+
+// RawFollow follow( 30 ); // snapshot every 30 s, 0 = off
+// follow.onSnapshot( [&]() { histoFile.Write( "", TObject::kOverwrite ); } );
+// do { ... if( evt.IsEORE() ) follow.stop(); ... follow.event(); }
+// while( follow.next( *reader ) && iev < lev );
+
+// eudaq's FileDeserializer clears EOF before it refills its buffer and
+// waits inside an event that is only partly written, so retrying
+// NextEvent() on the same reader continues where it stopped.
+
+#ifndef FOLLOW_H
+#define FOLLOW_H
+
+#include <time.h> // clock_gettime, nanosleep
+#include <functional>
+#include <iostream>
+
+class RawFollow {
+
+ public:
+
+  RawFollow( double snap = 0, double idle = 300 ) :
+    fSnap(snap), fIdle(idle), fStop(0), fPending(0), fNsnap(0)
+  {
+    if( fIdle < 10*fSnap ) fIdle = 10*fSnap;
+    fLast = now();
+    fLastSnap = fLast;
+  }
+
+  bool on() const { return fSnap > 0; }
+  int snapshots() const { return fNsnap; }
+
+  void onSnapshot( std::function<void()> f ) { fWrite = f; }
+
+  void stop() { fStop = 1; } // EORE: no more events will come
+
+  void event() // after each event: snapshot when due
+  {
+    if( !on() ) return;
+    ++fPending;
+    double t = now();
+    if( t - fLastSnap >= fSnap )
+      snapshot( t );
+  }
+
+  template<class R> bool next( R & reader )
+  {
+    if( reader.NextEvent() ) {
+      fLast = now();
+      return 1;
+    }
+
+    if( !on() || fStop ) return 0;
+
+    if( fPending > 0 )
+      snapshot( now() ); // up to date before the wait
+
+    std::cout << "follow: waiting for events" << std::endl;
+
+    while( now() - fLast < fIdle ) {
+
+      timespec ts = { 0, 200000000 }; // 0.2 s
+      nanosleep( &ts, 0 );
+
+      if( reader.NextEvent() ) {
+	fLast = now();
+	return 1;
+      }
+
+    }
+
+    std::cout << "follow: no events for " << fIdle << " s, stop" << std::endl;
+
+    return 0;
+  }
+
+ private:
+
+  static double now()
+  {
+    timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+  }
+
+  void snapshot( double t )
+  {
+    if( fWrite ) fWrite();
+    fLastSnap = t;
+    fPending = 0;
+    ++fNsnap;
+  }
+
+  double fSnap; // [s] between snapshots
+  double fIdle; // [s] without new events: run is over
+  bool fStop;
+  long fPending; // events since the last snapshot
+  int fNsnap;
+  double fLast, fLastSnap;
+  std::function<void()> fWrite;
+
+}; // RawFollow
+
+#endif
@@ -0,0 +1,211 @@
+// fourfit.h
+// broken-lines fit of a straight track through the four quad planes A,B,C,D
+// at equal spacing dz, no B-field: the GBL problem of quad with fixed sizes.
+// Fit parameters are the offsets u at the four planes, per projection.
+// Kinks at the inner planes B and C are pseudo-measurements with weight
+// 1/tet^2 (GBL uses no kinks at the end planes).
+// x and y decouple: two 4x4 systems. Their normal matrices depend only on
+// resolution, dz and scattering: inverted once per run, a track is then
+// a few dot products, no heap.
+
+// FourFit ff( dz, resx, resy, tetSi );
+// ff.fit( mx, my ); // measured residuals at A,B,C,D
+// ff.chi2, ff.ndf, ff.res[ipt][ixy] // fitted residuals as GBL getMeasResults
+// ff.getResults( ipt, ixy, u, s, cov ); // as GBL getResults( ipt+1, ... )
+// ff.milleOut( mille, 6, lab, der ); // records as GBL milleOut
+
+#ifndef FOURFIT_H
+#define FOURFIT_H
+
+#include <cmath>
+
+class FourFit {
+
+ public:
+
+  // dz [mm], resolution [mm], scattering angle [rad] per plane
+
+  FourFit( double dz, double resx, double resy, double tet )
+    : fDz(dz), fTet(tet), ndf(4), chi2(0)
+  {
+    fRes[0] = resx;
+    fRes[1] = resy;
+
+    for( int ixy = 0; ixy < 2; ++ixy ) {
+
+      double p = 1 / ( resx*resx );
+      if( ixy ) p = 1 / ( resy*resy );
+      fPrec[ixy] = p;
+      fWkink[ixy] = 1 / ( tet*tet );
+
+      // normal matrix: p * 1 + w/dz^2 * sum over kinks of a a^T
+
+      double N[4][4];
+      for( int i = 0; i < 4; ++i )
+	for( int j = 0; j < 4; ++j )
+	  N[i][j] = p * ( i == j );
+
+      double wk = fWkink[ixy] / ( dz*dz );
+      for( int ik = 1; ik <= 2; ++ik ) {
+	double a[4] = { 0, 0, 0, 0 };
+	a[ik-1] = 1;
+	a[ik] = -2;
+	a[ik+1] = 1;
+	for( int i = 0; i < 4; ++i )
+	  for( int j = 0; j < 4; ++j )
+	    N[i][j] += wk * a[i] * a[j];
+      }
+
+      invert( N, fV[ixy] );
+
+    } // ixy
+
+  } // constructor
+
+  //----------------------------------------------------------------------------
+  // one track: measured residuals mx[4], my[4] at A,B,C,D
+
+  void fit( const double * mx, const double * my )
+  {
+    chi2 = 0;
+
+    for( int ixy = 0; ixy < 2; ++ixy ) {
+
+      const double * m = mx;
+      if( ixy ) m = my;
+
+      double p = fPrec[ixy];
+
+      for( int i = 0; i < 4; ++i ) {
+	double ui = 0;
+	for( int j = 0; j < 4; ++j )
+	  ui += fV[ixy][i][j] * p * m[j];
+	fMeas[i][ixy] = m[i];
+	u[i][ixy] = ui;
+	res[i][ixy] = m[i] - ui;
+	chi2 += p * res[i][ixy] * res[i][ixy];
+      }
+
+      for( int ik = 1; ik <= 2; ++ik ) {
+	double k = kink( ik, ixy );
+	chi2 += fWkink[ixy] * k * k;
+      }
+
+    } // ixy
+  }
+
+  // kink at inner plane ik = 1 (B) or 2 (C) [rad]
+
+  double kink( int ik, int ixy ) const
+  {
+    return ( u[ik-1][ixy] - 2*u[ik][ixy] + u[ik+1][ixy] ) / fDz;
+  }
+
+  // error of the fitted residual, as GBL: sqrt( sigma^2 - var(u) )
+
+  double resErr( int ipt, int ixy ) const
+  {
+    return sqrt( fRes[ixy]*fRes[ixy] - fV[ixy][ipt][ipt] );
+  }
+
+  //----------------------------------------------------------------------------
+  // offset u and slope s after plane ipt (0..2) with covariance
+  // cov[0] = var(s), cov[1] = cov(s,u), cov[2] = var(u):
+  // GBL getResults( ipt+1 ) elements (1,1), (1,3), (3,3) in x, 2 and 4 in y
+
+  void getResults( int ipt, int ixy, double & uo, double & s, double * cov ) const
+  {
+    const double (*V)[4] = fV[ixy];
+    uo = u[ipt][ixy];
+    s = ( u[ipt+1][ixy] - u[ipt][ixy] ) / fDz;
+    cov[0] = ( V[ipt+1][ipt+1] - 2*V[ipt+1][ipt] + V[ipt][ipt] ) / ( fDz*fDz );
+    cov[1] = ( V[ipt+1][ipt] - V[ipt][ipt] ) / fDz;
+    cov[2] = V[ipt][ipt];
+  }
+
+  //----------------------------------------------------------------------------
+  // Mille records of the last track, as GBL milleOut:
+  // local parameters 2*ipt+ixy+1 = offsets, measurements first, then kinks.
+  // Plane ipt has ngl global labels lab[ipt][] and derivatives
+  // der[ipt][ixy*ngl+k] (row-major 2 x ngl, as given to addGlobals).
+  // mille.mille( nlc, derlc, ngl, dergl, label, meas, sigma ); mille.end();
+
+  template<class M>
+  void milleOut( M & mille, int ngl, const int * const * lab,
+		 const double * const * der ) const
+  {
+    float derlc[8];
+    float dergl[16];
+    int label[16];
+    if( ngl > 16 ) ngl = 16;
+
+    for( int ipt = 0; ipt < 4; ++ipt )
+      for( int ixy = 0; ixy < 2; ++ixy ) {
+	for( int l = 0; l < 8; ++l )
+	  derlc[l] = 0;
+	derlc[2*ipt+ixy] = 1;
+	for( int k = 0; k < ngl; ++k ) {
+	  dergl[k] = der[ipt][ixy*ngl+k];
+	  label[k] = lab[ipt][k];
+	}
+	mille.mille( 8, derlc, ngl, dergl, label, fMeas[ipt][ixy], fRes[ixy] );
+      }
+
+    for( int ik = 1; ik <= 2; ++ik )
+      for( int ixy = 0; ixy < 2; ++ixy ) {
+	for( int l = 0; l < 8; ++l )
+	  derlc[l] = 0;
+	derlc[2*(ik-1)+ixy] = 1 / fDz;
+	derlc[2*ik+ixy] = -2 / fDz;
+	derlc[2*(ik+1)+ixy] = 1 / fDz;
+	mille.mille( 8, derlc, 0, dergl, label, 0, fTet ); // kink 0 expected
+      }
+
+    mille.end();
+  }
+
+ private:
+
+  // in place Gauss-Jordan, N symmetric positive
+
+  static void invert( double N[4][4], double V[4][4] )
+  {
+    for( int i = 0; i < 4; ++i )
+      for( int j = 0; j < 4; ++j )
+	V[i][j] = ( i == j );
+
+    for( int i = 0; i < 4; ++i ) {
+      double piv = N[i][i];
+      for( int j = 0; j < 4; ++j ) {
+	N[i][j] /= piv;
+	V[i][j] /= piv;
+      }
+      for( int k = 0; k < 4; ++k ) {
+	if( k == i ) continue;
+	double fk = N[k][i];
+	for( int j = 0; j < 4; ++j ) {
+	  N[k][j] -= fk * N[i][j];
+	  V[k][j] -= fk * V[i][j];
+	}
+      }
+    }
+  }
+
+  double fDz;
+  double fTet;
+  double fRes[2];
+  double fPrec[2];
+  double fWkink[2];
+  double fV[2][4][4]; // covariance of the offsets, per projection
+  double fMeas[4][2]; // last track
+
+ public:
+
+  int ndf; // 8 measurements + 4 kinks - 8 offsets
+  double chi2;
+  double u[4][2]; // fitted offsets at A,B,C,D in x,y
+  double res[4][2]; // measured - fitted
+
+}; // FourFit
+
+#endif
@@ -0,0 +1,165 @@
+// gridindex.h
+// per-event 2D grid over points (cluster positions, track intercepts):
+// neighbour and isolation queries only look at nearby cells
+
+// GridIndex grid;
+// per event: grid.build( x, y, cell ); // buffers are reused
+// grid.visit( x0, y0, r, f ); // f(i) for all i in cells within r
+// grid.nearest( x0, y0, dmax, margin, dist ); // min of dist(i)
+
+#ifndef GRIDINDEX_H
+#define GRIDINDEX_H
+
+#include <vector>
+#include <cmath>
+
+class GridIndex {
+
+ public:
+
+  GridIndex() : fN(0), fNx(0), fNy(0), fX0(0), fY0(0), fCell(1) {}
+
+  // cell: typical query radius. The grid is at most maxc x maxc cells,
+  // cells grow for wide spreads.
+
+  void build( const std::vector<double> & x, const std::vector<double> & y,
+	      double cell, int maxc = 64 )
+  {
+    fN = x.size();
+    fX.assign( x.begin(), x.end() );
+    fY.assign( y.begin(), y.end() );
+
+    if( fN == 0 ) {
+      fNx = 0;
+      fNy = 0;
+      return;
+    }
+
+    double x9 = fX[0];
+    double y9 = fY[0];
+    fX0 = fX[0];
+    fY0 = fY[0];
+    for( unsigned i = 1; i < fN; ++i ) {
+      if( fX[i] < fX0 ) fX0 = fX[i];
+      if( fX[i] > x9 ) x9 = fX[i];
+      if( fY[i] < fY0 ) fY0 = fY[i];
+      if( fY[i] > y9 ) y9 = fY[i];
+    }
+
+    fCell = cell;
+    if( ( x9 - fX0 ) / fCell >= maxc ) fCell = ( x9 - fX0 ) / ( maxc - 1 );
+    if( ( y9 - fY0 ) / fCell >= maxc ) fCell = ( y9 - fY0 ) / ( maxc - 1 );
+
+    fNx = int( ( x9 - fX0 ) / fCell ) + 1;
+    fNy = int( ( y9 - fY0 ) / fCell ) + 1;
+
+    // counting sort into cells:
+
+    fStart.assign( fNx*fNy + 1, 0 );
+    fCellOf.resize( fN );
+    for( unsigned i = 0; i < fN; ++i ) {
+      int ic = cellx( fX[i] ) * fNy + celly( fY[i] );
+      fCellOf[i] = ic;
+      ++fStart[ic+1];
+    }
+    for( int ic = 0; ic < fNx*fNy; ++ic )
+      fStart[ic+1] += fStart[ic];
+
+    fIdx.resize( fN );
+    fFill.assign( fStart.begin(), fStart.end() - 1 );
+    for( unsigned i = 0; i < fN; ++i )
+      fIdx[ fFill[ fCellOf[i] ]++ ] = i;
+  }
+
+  unsigned size() const { return fN; }
+
+  // f(i) for all points in the cells touching the square x0 +- r, y0 +- r
+
+  template<class F> void visit( double x0, double y0, double r, F f ) const
+  {
+    if( fN == 0 ) return;
+    int i0 = cellx( x0 - r );
+    int i9 = cellx( x0 + r );
+    int j0 = celly( y0 - r );
+    int j9 = celly( y0 + r );
+    for( int i = i0; i <= i9; ++i )
+      for( int j = j0; j <= j9; ++j ) {
+	int ic = i*fNy + j;
+	for( int k = fStart[ic]; k < fStart[ic+1]; ++k )
+	  f( fIdx[k] );
+      }
+  }
+
+  // min of dist(i) over all points, searched in growing rings.
+  // dist may differ from the grid position by up to margin,
+  // return negative to skip a point. dmax if none.
+
+  template<class D> double nearest( double x0, double y0, double dmax,
+				    double margin, D dist ) const
+  {
+    double dmin = dmax;
+    if( fN == 0 ) return dmin;
+
+    int ic = int( floor( ( x0 - fX0 ) / fCell ) ); // may be off grid
+    int jc = int( floor( ( y0 - fY0 ) / fCell ) );
+
+    for( int k = 0; ; ++k ) {
+
+      int i0 = ic - k;
+      int i9 = ic + k;
+      int j0 = jc - k;
+      int j9 = jc + k;
+
+      for( int i = i0; i <= i9; ++i ) {
+	if( i < 0 || i >= fNx ) continue;
+	bool edge = ( i == i0 || i == i9 );
+	for( int j = j0; j <= j9; ++j ) {
+	  if( j < 0 || j >= fNy ) continue;
+	  if( !edge && j != j0 && j != j9 ) continue; // ring only
+	  int kc = i*fNy + j;
+	  for( int l = fStart[kc]; l < fStart[kc+1]; ++l ) {
+	    double d = dist( fIdx[l] );
+	    if( d >= 0 && d < dmin )
+	      dmin = d;
+	  }
+	}
+      }
+
+      // points outside the ring are at least k cells away:
+
+      if( k*fCell - margin >= dmin ) break;
+      if( i0 <= 0 && j0 <= 0 && i9 >= fNx-1 && j9 >= fNy-1 ) break; // all seen
+
+    } // rings
+
+    return dmin;
+  }
+
+ private:
+
+  int cellx( double x ) const
+  {
+    int i = int( ( x - fX0 ) / fCell );
+    if( x < fX0 ) i = 0;
+    return i < fNx ? i : fNx-1;
+  }
+
+  int celly( double y ) const
+  {
+    int j = int( ( y - fY0 ) / fCell );
+    if( y < fY0 ) j = 0;
+    return j < fNy ? j : fNy-1;
+  }
+
+  unsigned fN;
+  int fNx, fNy;
+  double fX0, fY0, fCell;
+  std::vector<double> fX, fY;
+  std::vector<int> fStart; // first point of each cell in fIdx
+  std::vector<int> fFill;
+  std::vector<int> fCellOf;
+  std::vector<int> fIdx; // point indices sorted by cell
+
+}; // GridIndex
+
+#endif
@@ -0,0 +1,146 @@
+// histfit.h
+// fit functions for residual and charge histograms, without globals:
+// the bin width is given, the data belong to the caller,
+// many histograms can be fitted in one session or in threads
+
+// TF1 f( "tp0", TP0Fcn( h->GetBinWidth(1) ), x1, x9, 5 ); // Student's t + p0
+// TF1 f( "lg", LanGauFcn( h->GetBinWidth(1) ), x0, x9, 4 ); // Landau x Gauss
+// BinData d( h, x1, x9 ); double chisq = d.chisq( TP0Fcn( d.dx ), par );
+// double mpv = fitLanGauPeak( h, 10, 40 ); // quad: peak of the Landau x Gauss
+
+// In threads: each fit its own TF1 with its own name (fitLanGauPeak does),
+// ROOT::EnableThreadSafety() and Minuit2 as default minimizer.
+
+#ifndef HISTFIT_H
+#define HISTFIT_H
+
+#include <vector>
+#include <cmath>
+#include <atomic>
+
+#include <TH1.h>
+#include <TF1.h>
+#include <TMath.h> // Gamma
+
+#include "langau.h"
+
+//------------------------------------------------------------------------------
+// Student's t + constant, area in entries, dx = bin width
+// par: 0 mean, 1 sigma, 2 nu, 3 area, 4 BG
+
+inline double tp0( double x, const double * par, double dx )
+{
+  double t = ( x - par[0] ) / par[1];
+  double tt = t*t;
+
+  double rn = par[2]; // exponent
+  double xn = 0.5 * ( rn + 1.0 );
+
+  double pk = 0.0;
+
+  if( rn > 0.0 && fabs( xn * log( 1.0 + tt/rn ) ) < 333 ) {
+
+    double pi = 3.14159265358979323846;
+    double aa = dx / par[1] / sqrt(rn*pi) * TMath::Gamma(xn) / TMath::Gamma(0.5*rn);
+
+    pk = par[3] * aa * exp( -xn * log( 1.0 + tt/rn ) );
+
+    // lim n->inf (1+a/n)^n = e^a
+
+  }
+
+  return pk + par[4];
+}
+
+//------------------------------------------------------------------------------
+// Landau x Gauss, area in entries, dx = bin width
+// par: 0 Landau peak, 1 Landau width, 2 area, 3 Gaussian smearing
+
+inline double lanGau( double x, const double * par, double dx )
+{
+  return par[2] * dx * langau( x, par[0], par[1], par[3] );
+}
+
+//------------------------------------------------------------------------------
+// TF1 functors, the bin width is a member
+
+struct TP0Fcn {
+  double dx;
+  TP0Fcn( double w ) : dx(w) {}
+  double operator()( const double * x, const double * par ) const { return tp0( x[0], par, dx ); }
+};
+
+struct LanGauFcn {
+  double dx;
+  LanGauFcn( double w ) : dx(w) {}
+  double operator()( const double * x, const double * par ) const { return lanGau( x[0], par, dx ); }
+};
+
+//------------------------------------------------------------------------------
+// histogram contents in a range, for chisq scans outside of Minuit
+
+struct BinData {
+
+  std::vector<double> x, y;
+  double dx;
+
+  BinData( const TH1 * h, double x1, double x9 )
+  {
+    dx = h->GetBinWidth(1);
+    int i1 = h->FindBin(x1);
+    int i9 = h->FindBin(x9);
+    for( int ii = i1; ii <= i9; ++ii ) {
+      x.push_back( h->GetBinCenter(ii) );
+      y.push_back( h->GetBinContent(ii) );
+    }
+  }
+
+  template<class F> double chisq( const F & f, const double * par ) const
+  {
+    double sum = 0;
+    for( size_t ii = 0; ii < x.size(); ++ii ) {
+      double e = 1;
+      if( y[ii] > 0.5 ) e = sqrt( y[ii] );
+      double r = ( y[ii] - f( &x[ii], par ) ) / e; // resid = data - fit
+      sum += r*r;
+    }
+    return sum;
+  }
+
+}; // BinData
+
+//------------------------------------------------------------------------------
+// Landau x Gauss fit of a charge histogram in [q0,q9], returns the peak
+
+inline double fitLanGauPeak( TH1 * h, double q0, double q9 )
+{
+  static std::atomic<int> nfit(0); // unique TF1 names
+
+  double aa = h->GetEntries(); // normalization
+
+  // find peak:
+  int ipk = h->GetMaximumBin();
+  double xpk = h->GetBinCenter(ipk);
+  double sm = xpk / 9; // sigma
+  double ns = sm; // noise
+
+  // fit range:
+  int ib0 = h->FindBin(q0);
+  int ib9 = h->FindBin(q9);
+  double x0 = h->GetBinLowEdge(ib0);
+  double x9 = h->GetBinLowEdge(ib9) + h->GetBinWidth(ib9);
+
+  TF1 fitFcn( Form( "langau%i", nfit++ ), LanGauFcn( h->GetBinWidth(1) ), x0, x9, 4 );
+
+  // set start values:
+  fitFcn.SetParameter( 0, xpk ); // peak position, defined above
+  fitFcn.SetParameter( 1, sm ); // width
+  fitFcn.SetParameter( 2, aa ); // area
+  fitFcn.SetParameter( 3, ns ); // noise
+
+  h->Fit( &fitFcn, "R Q", "ep" ); // R = range from fitFcn, a copy stays with h
+
+  return fitFcn.GetParameter(0);
+}
+
+#endif
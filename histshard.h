@@ -0,0 +1,351 @@
+// histshard.h
+// thread-private accumulators for fixed-bin TH1, TProfile and TProfile2D:
+// fill in a worker without touching the ROOT object, merge at the end
+
+// H1Shard sh; sh.book( h ); // binning of the ROOT histogram h
+// in the thread: sh.fill( x ); or sh.fill( n, x ); // batch
+// after the threads, in a fixed order: sh.mergeInto( h );
+// P1Shard: sh.fill( x, y ); P2Shard: sh.fill( x, y, z ); same book and merge
+
+// Bin contents and statistics are accumulated exactly as TH1::Fill,
+// TProfile::Fill and TProfile2D::Fill do, so one shard per histogram,
+// filled in event order, gives the same file contents as serial filling
+// (kerncheck compares them). Unit weights only.
+
+#ifndef HISTSHARD_H
+#define HISTSHARD_H
+
+#include <vector>
+#include <cmath>
+
+#include <TH1.h>
+#include <TProfile.h>
+#include <TProfile2D.h>
+
+#include "cpudispatch.h"
+
+class H1Shard {
+
+ public:
+
+  H1Shard() : fN(0), fMin(0), fMax(1) { reset(); }
+
+  void book( const TH1 & h )
+  {
+    fN = h.GetNbinsX();
+    fMin = h.GetXaxis()->GetXmin();
+    fMax = h.GetXaxis()->GetXmax();
+    reset();
+  }
+
+  void reset()
+  {
+    fBin.assign( fN+2, 0 );
+    fEntries = 0;
+    fSumw = 0;
+    fSumw2 = 0;
+    fSumwx = 0;
+    fSumwx2 = 0;
+  }
+
+  int findBin( double x ) const // as TAxis::FindFixBin
+  {
+    if( x < fMin ) return 0;
+    if( !( x < fMax ) ) return fN+1;
+    return 1 + int( fN * ( x - fMin ) / ( fMax - fMin ) );
+  }
+
+  void fill( double x )
+  {
+    int ib = findBin( x );
+    ++fEntries;
+    ++fBin[ib];
+    if( ib == 0 || ib > fN ) return; // no stats from under/overflow
+    fSumw += 1;
+    fSumw2 += 1;
+    fSumwx += x;
+    fSumwx2 += x*x;
+  }
+
+  // batch: bin numbers in one branch-free loop, then counts and stats
+  // in order. Same arithmetic as findBin, no precomputed scale.
+  // The bin loop is vectorized for the widest unit of the node.
+
+  CPU_DISPATCH
+  void fill( unsigned n, const double * x )
+  {
+    fIdx.resize( n );
+    int * idx = fIdx.data();
+    const int nb = fN; // locals: the int stores could change fN
+    const double x0 = fMin;
+    const double x9 = fMax;
+    double wid = x9 - x0;
+    for( unsigned i = 0; i < n; ++i ) {
+      double u = nb * ( x[i] - x0 ) / wid;
+      int ib = 1 + int( u > -1 ? ( u < nb ? u : nb ) : -1 ); // clamp before int
+      ib = x[i] < x0 ? 0 : ib;
+      ib = x[i] < x9 ? ib : nb+1;
+      idx[i] = ib;
+    }
+    for( unsigned i = 0; i < n; ++i ) {
+      int ib = fIdx[i];
+      ++fEntries;
+      ++fBin[ib];
+      if( ib == 0 || ib > fN ) continue;
+      fSumw += 1;
+      fSumw2 += 1;
+      fSumwx += x[i];
+      fSumwx2 += x[i]*x[i];
+    }
+  }
+
+  // stats first: SetBinContent would reset them and GetStats would
+  // recount sumw from the bins. AddBinContent leaves them alone.
+
+  void mergeInto( TH1 & h ) const
+  {
+    double stats[4];
+    h.GetStats( stats );
+    double entries = h.GetEntries() + fEntries;
+
+    bool lsumw2 = h.GetSumw2N() > 0;
+    for( int ib = 0; ib <= fN+1; ++ib )
+      if( fBin[ib] > 0 ) {
+	h.AddBinContent( ib, fBin[ib] );
+	if( lsumw2 )
+	  h.GetSumw2()->AddAt( h.GetSumw2()->At( ib ) + fBin[ib], ib ); // weights 1
+      }
+
+    stats[0] += fSumw;
+    stats[1] += fSumw2;
+    stats[2] += fSumwx;
+    stats[3] += fSumwx2;
+    h.PutStats( stats );
+    h.SetEntries( entries );
+  }
+
+  double entries() const { return fEntries; }
+
+ private:
+
+  int fN;
+  double fMin, fMax;
+  std::vector<double> fBin; // 0 = underflow, fN+1 = overflow
+  double fEntries, fSumw, fSumw2, fSumwx, fSumwx2;
+  std::vector<int> fIdx; // batch scratch
+
+}; // H1Shard
+
+//------------------------------------------------------------------------------
+// TProfile: per bin sum of y, sum of y^2 and entries. Fills outside the
+// y range of the profile are dropped, as in TProfile::Fill.
+
+class P1Shard {
+
+ public:
+
+  P1Shard() : fN(0), fMin(0), fMax(1), fYmin(0), fYmax(0) { reset(); }
+
+  void book( const TProfile & h )
+  {
+    fN = h.GetNbinsX();
+    fMin = h.GetXaxis()->GetXmin();
+    fMax = h.GetXaxis()->GetXmax();
+    fYmin = h.GetYmin();
+    fYmax = h.GetYmax();
+    reset();
+  }
+
+  void reset()
+  {
+    fSumy.assign( fN+2, 0 );
+    fSumy2.assign( fN+2, 0 );
+    fBinN.assign( fN+2, 0 );
+    fEntries = 0;
+    fSumw = 0;
+    fSumwx = 0;
+    fSumwx2 = 0;
+    fSumwy = 0;
+    fSumwy2 = 0;
+  }
+
+  int findBin( double x ) const // as TAxis::FindFixBin
+  {
+    if( x < fMin ) return 0;
+    if( !( x < fMax ) ) return fN+1;
+    return 1 + int( fN * ( x - fMin ) / ( fMax - fMin ) );
+  }
+
+  void fill( double x, double y )
+  {
+    if( fYmin != fYmax && ( y < fYmin || y > fYmax || std::isnan(y) ) ) return;
+    int ib = findBin( x );
+    ++fEntries;
+    fSumy[ib] += y;
+    fSumy2[ib] += y*y;
+    ++fBinN[ib];
+    if( ib == 0 || ib > fN ) return; // no stats from under/overflow
+    fSumw += 1;
+    fSumwx += x;
+    fSumwx2 += x*x;
+    fSumwy += y;
+    fSumwy2 += y*y;
+  }
+
+  // through the arrays: a profile has no AddBinContent for y
+
+  void mergeInto( TProfile & h ) const
+  {
+    double stats[6];
+    h.GetStats( stats );
+    double entries = h.GetEntries() + fEntries;
+
+    double * sumy = h.GetArray();
+    TArrayD * sumy2 = h.GetSumw2();
+    TArrayD * binw2 = h.GetBinSumw2();
+    bool lbinw2 = binw2->GetSize() > 0;
+    for( int ib = 0; ib <= fN+1; ++ib )
+      if( fBinN[ib] > 0 ) {
+	sumy[ib] += fSumy[ib];
+	sumy2->AddAt( sumy2->At( ib ) + fSumy2[ib], ib );
+	h.SetBinEntries( ib, h.GetBinEntries( ib ) + fBinN[ib] );
+	if( lbinw2 )
+	  binw2->AddAt( binw2->At( ib ) + fBinN[ib], ib ); // weights 1
+      }
+
+    stats[0] += fSumw;
+    stats[1] += fSumw; // weights 1
+    stats[2] += fSumwx;
+    stats[3] += fSumwx2;
+    stats[4] += fSumwy;
+    stats[5] += fSumwy2;
+    h.PutStats( stats );
+    h.SetEntries( entries );
+  }
+
+  double entries() const { return fEntries; }
+
+ private:
+
+  int fN;
+  double fMin, fMax;
+  double fYmin, fYmax; // equal: no y range
+  std::vector<double> fSumy, fSumy2, fBinN; // 0 = underflow, fN+1 = overflow
+  double fEntries, fSumw, fSumwx, fSumwx2, fSumwy, fSumwy2;
+
+}; // P1Shard
+
+//------------------------------------------------------------------------------
+// TProfile2D: global bin binx + (nx+2)*biny, as TH2::GetBin
+
+class P2Shard {
+
+ public:
+
+  P2Shard() : fNx(0), fNy(0), fXmin(0), fXmax(1), fYmin(0), fYmax(1),
+	      fZmin(0), fZmax(0) { reset(); }
+
+  void book( const TProfile2D & h )
+  {
+    fNx = h.GetNbinsX();
+    fNy = h.GetNbinsY();
+    fXmin = h.GetXaxis()->GetXmin();
+    fXmax = h.GetXaxis()->GetXmax();
+    fYmin = h.GetYaxis()->GetXmin();
+    fYmax = h.GetYaxis()->GetXmax();
+    fZmin = h.GetZmin();
+    fZmax = h.GetZmax();
+    reset();
+  }
+
+  void reset()
+  {
+    unsigned nb = ( fNx+2 ) * ( fNy+2 );
+    fSumz.assign( nb, 0 );
+    fSumz2.assign( nb, 0 );
+    fBinN.assign( nb, 0 );
+    fEntries = 0;
+    fSumw = 0;
+    fSumwx = 0;
+    fSumwx2 = 0;
+    fSumwy = 0;
+    fSumwy2 = 0;
+    fSumwxy = 0;
+    fSumwz = 0;
+    fSumwz2 = 0;
+  }
+
+  static int findBin( double x, int n, double x0, double x9 ) // as TAxis::FindFixBin
+  {
+    if( x < x0 ) return 0;
+    if( !( x < x9 ) ) return n+1;
+    return 1 + int( n * ( x - x0 ) / ( x9 - x0 ) );
+  }
+
+  void fill( double x, double y, double z )
+  {
+    if( fZmin != fZmax && ( z < fZmin || z > fZmax || std::isnan(z) ) ) return;
+    int ibx = findBin( x, fNx, fXmin, fXmax );
+    int iby = findBin( y, fNy, fYmin, fYmax );
+    int ib = ibx + ( fNx+2 ) * iby;
+    ++fEntries;
+    fSumz[ib] += z;
+    fSumz2[ib] += z*z;
+    ++fBinN[ib];
+    if( ibx == 0 || ibx > fNx ) return;
+    if( iby == 0 || iby > fNy ) return;
+    fSumw += 1;
+    fSumwx += x;
+    fSumwx2 += x*x;
+    fSumwy += y;
+    fSumwy2 += y*y;
+    fSumwxy += x*y;
+    fSumwz += z;
+    fSumwz2 += z*z;
+  }
+
+  void mergeInto( TProfile2D & h ) const
+  {
+    double stats[9];
+    h.GetStats( stats );
+    double entries = h.GetEntries() + fEntries;
+
+    double * sumz = h.GetArray();
+    TArrayD * sumz2 = h.GetSumw2();
+    TArrayD * binw2 = h.GetBinSumw2();
+    bool lbinw2 = binw2->GetSize() > 0;
+    for( unsigned ib = 0; ib < fBinN.size(); ++ib )
+      if( fBinN[ib] > 0 ) {
+	sumz[ib] += fSumz[ib];
+	sumz2->AddAt( sumz2->At( ib ) + fSumz2[ib], ib );
+	h.SetBinEntries( ib, h.GetBinEntries( ib ) + fBinN[ib] );
+	if( lbinw2 )
+	  binw2->AddAt( binw2->At( ib ) + fBinN[ib], ib );
+      }
+
+    stats[0] += fSumw;
+    stats[1] += fSumw;
+    stats[2] += fSumwx;
+    stats[3] += fSumwx2;
+    stats[4] += fSumwy;
+    stats[5] += fSumwy2;
+    stats[6] += fSumwxy;
+    stats[7] += fSumwz;
+    stats[8] += fSumwz2;
+    h.PutStats( stats );
+    h.SetEntries( entries );
+  }
+
+  double entries() const { return fEntries; }
+
+ private:
+
+  int fNx, fNy;
+  double fXmin, fXmax, fYmin, fYmax;
+  double fZmin, fZmax; // equal: no z range
+  std::vector<double> fSumz, fSumz2, fBinN;
+  double fEntries, fSumw, fSumwx, fSumwx2, fSumwy, fSumwy2, fSumwxy, fSumwz, fSumwz2;
+
+}; // P2Shard
+
+#endif
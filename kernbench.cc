@@ -0,0 +1,538 @@
+// hot kernels of tele, scope53m, scopes and quad on synthetic events,
+// timed in isolation: ns per event and per hit in occupancy bins,
+// compared to a stored baseline
+
+// make kernbench
+// kernbench -g geo_2019_02d.dat -w   (write baseline kernbench.dat)
+// kernbench -g geo_2019_02d.dat      (compare, exit 1 on regression)
+// (-n events per bin, -b baseline file, -t minimal tolerance, -s sigmas)
+
+// Each kernel is timed in 11 windows of at least 0.1 s, each followed by
+// 0.05 s of fixed reference work: a busy or slower node slows both, the
+// ratio stays. The median ratio is compared to the baseline. The spread
+// is the scatter of one window (MAD), not the error of the median: on a
+// shared node the drift between runs is as large as that. A slow-down is
+// a regression if it is above -s 4 combined spreads of baseline and run,
+// and above -t 0.05.
+
+// The kernels are the ones of the programs, from the same headers:
+// teleclus.h, scope53clus.h, phvcal.h, r4scm.h and telecore.h
+// (grouping, triplets, six-plane match), with empty histogram callbacks.
+
+#include <sstream> // stringstream
+#include <fstream> // filestream
+#include <iomanip>
+#include <vector>
+#include <map>
+#include <algorithm> // sort
+#include <unordered_map>
+#include <functional>
+#include <cmath>
+#include <cstring> // strcmp
+
+#include "simtele.h"
+#include "stageprof.h"
+#include "telecore.h"
+#include "teleclus.h"
+#include "scope53clus.h"
+#include "phvcal.h"
+#include "r4scm.h"
+
+using namespace std;
+
+//------------------------------------------------------------------------------
+namespace r4s { // scopes_2017.cc: ROI pixels and Fermi constants
+
+  struct pixel {
+    int col;
+    int row;
+    double adc;
+    double q;
+    int ord;
+    bool big;
+  };
+
+  double p0[155][160]; // Fermi
+  double p1[155][160];
+  double p2[155][160];
+  double p3[155][160];
+  double ke = 0.036;
+
+  // columns-wise common mode correction, then inverse Fermi,
+  // the loop of scopes_2017 with 50x50 pixels
+
+  int commonmode( const vector <pixel> & vpx, pixel * pb )
+  {
+    int npx = 0;
+
+    for( unsigned ipx = 0; ipx < vpx.size(); ++ipx ) {
+
+      double dph;
+      if( ! r4sDph( vpx, ipx, dph ) ) continue; // Randpixel
+
+      int col4 = vpx[ipx].col;
+      int row4 = vpx[ipx].row;
+
+      double vcal = r4sVcal( dph, p0[col4][row4], p1[col4][row4], p2[col4][row4], p3[col4][row4] );
+
+      double q = ke*vcal;
+
+      if( dph > 20 ) {
+	pb[npx].col = col4;
+	pb[npx].row = row4;
+	pb[npx].adc = dph;
+	pb[npx].q = q;
+	pb[npx].ord = npx;
+	pb[npx].big = 0;
+	++npx;
+	if( npx > 990 ) break;
+      }
+
+    } // roi px
+
+    return npx;
+  }
+
+} // r4s
+
+//------------------------------------------------------------------------------
+// per-event inputs of one occupancy bin
+
+struct benchEvent {
+  vector <tele::pixel> mim[7]; // Mimosa 1..6
+  vector <s53::pixel> dut;
+  vector <r4s::pixel> roi; // R4S ROI: hit rows and their column neighbours
+  vector <double> ph; // quad pulse heights
+};
+
+struct benchResult {
+  string kernel;
+  double ntrk;
+  double nsev; // per event
+  double nshit; // per pixel
+  double rel; // per call, in reference work units
+  double spread; // relative scatter of rel per window
+};
+
+double sink = 0; // keep results alive
+
+//------------------------------------------------------------------------------
+// median of a few values
+
+double median( vector <double> v )
+{
+  sort( v.begin(), v.end() );
+  unsigned n = v.size();
+  return n%2 ? v[n/2] : 0.5 * ( v[n/2-1] + v[n/2] );
+}
+
+//------------------------------------------------------------------------------
+// fixed reference work: a dependent chain over 512 kB, as the kernels
+// a mix of arithmetic and memory
+
+double refwork()
+{
+  static vector <double> a( 1 << 16, 1.0 );
+  double s = 0;
+  for( unsigned i = 0; i < a.size(); ++i )
+    s = s*0.999 + a[i]*sqrt( i+1.0 );
+  return s;
+}
+
+// seconds per call of f, at least twin [s]
+
+template<class F> double percall( F f, double twin )
+{
+  unsigned nrep = 0;
+  double t0 = StageProf::wall();
+  double dt = 0;
+  do {
+    f();
+    ++nrep;
+    dt = StageProf::wall() - t0;
+  }
+  while( dt < twin );
+  return dt/nrep;
+}
+
+//------------------------------------------------------------------------------
+// median over windows: ns per event and per hit, ratio to the reference
+
+template<class F> void timeit( const string & name, double ntrk,
+			       unsigned nev, double nhit, F f,
+			       vector <benchResult> & res )
+{
+  const int nwin = 11;
+  const double twin = 0.1; // [s]
+
+  f(); // warm up: caches, heap
+
+  vector <double> tw( nwin ); // per call
+  vector <double> rw( nwin ); // per call / reference
+  for( int iwin = 0; iwin < nwin; ++iwin ) {
+    tw[iwin] = percall( f, twin );
+    rw[iwin] = tw[iwin] / percall( []() { sink += refwork(); }, 0.5*twin );
+  }
+
+  double tmed = median( tw );
+  double rmed = median( rw );
+  vector <double> dev( nwin );
+  for( int iwin = 0; iwin < nwin; ++iwin )
+    dev[iwin] = fabs( rw[iwin] - rmed );
+
+  benchResult r;
+  r.kernel = name;
+  r.ntrk = ntrk;
+  r.nsev = tmed / nev * 1E9;
+  r.nshit = nhit > 0 ? tmed / nhit * 1E9 : 0;
+  r.rel = rmed;
+  r.spread = 1.4826 * median( dev ) / rmed; // as rms for gaussian noise
+  res.push_back( r );
+
+  cout << "  " << setw(12) << left << name << right
+       << setw(8) << ntrk
+       << setw(12) << setprecision(4) << r.nsev << " ns/event"
+       << setw(10) << r.nshit << " ns/hit"
+       << setw(8) << setprecision(2) << r.spread*100 << " %"
+       << setprecision(6) << endl;
+}
+
+//------------------------------------------------------------------------------
+int main( int argc, char* argv[] )
+{
+  cout << "main " << argv[0] << " called with " << argc << " arguments" << endl;
+
+  string geoFileName{ "geo.dat" };
+  string baseFileName{ "kernbench.dat" };
+  unsigned nev = 2000; // per bin
+  double tol = 0.05; // minimal allowed slow-down
+  double nsig = 4; // allowed slow-down in spreads
+  bool lwrite = 0;
+
+  for( int i = 1; i < argc; ++i ) {
+
+    if( !strcmp( argv[i], "-g" ) )
+      geoFileName = argv[++i];
+
+    if( !strcmp( argv[i], "-b" ) )
+      baseFileName = argv[++i];
+
+    if( !strcmp( argv[i], "-n" ) )
+      nev = atoi( argv[++i] );
+
+    if( !strcmp( argv[i], "-t" ) )
+      tol = atof( argv[++i] );
+
+    if( !strcmp( argv[i], "-s" ) )
+      nsig = atof( argv[++i] );
+
+    if( !strcmp( argv[i], "-w" ) )
+      lwrite = 1;
+
+  } // argc
+
+  SimTele sim;
+  if( ! sim.readGeo( geoFileName ) )
+    return 1;
+  if( ! sim.have[SimTele::iDUT] ) {
+    cout << "no DUT in " << geoFileName << endl;
+    return 1;
+  }
+
+  // geometry as in tele:
+
+  double ptchx[7], ptchy[7], midx[7], midy[7];
+  for( int ipl = 1; ipl <= 6; ++ipl ) {
+    ptchx[ipl] = sim.sizex[ipl] / sim.nx[ipl];
+    ptchy[ipl] = sim.sizey[ipl] / sim.ny[ipl];
+    midx[ipl] = 0.5 * sim.sizex[ipl];
+    midy[ipl] = 0.5 * sim.sizey[ipl];
+  }
+
+  // RD53A gains, as scope53m builds them:
+
+  using namespace std::placeholders;
+  int nrows = sim.nyroc( SimTele::iDUT );
+  unordered_map<int,function<int(int)> > calcurves;
+  for( int col = 0; col < sim.nxroc( SimTele::iDUT ); ++col )
+    for( int row = 0; row < nrows; ++row )
+      calcurves.emplace( col*nrows + row,
+			 std::bind( s53::__calcurve, sim.gaina, sim.gainb, sim.gainc, sim.gaint, _1 ) );
+
+  // R4S Fermi constants, typical:
+
+  for( int col = 0; col < 155; ++col )
+    for( int row = 0; row < 160; ++row ) {
+      r4s::p0[col][row] = 100;
+      r4s::p1[col][row] = 40;
+      r4s::p2[col][row] = 400;
+      r4s::p3[col][row] = -20;
+    }
+
+  // quad Weibull constants, typical:
+
+  double a0 = 0.5, a1 = 100, a2 = 1.2, a3 = 200, a4 = 220, a5 = 7;
+
+  vector <benchResult> res;
+
+  double ntrks[] = { 1, 3, 10, 30 };
+
+  for( double ntrk : ntrks ) {
+
+    sim.ntrk = ntrk;
+    sim.noise = 1E-5;
+    sim.init( 12345 );
+
+    cout << endl << ntrk << " tracks per event, " << nev << " events" << endl;
+
+    // inputs:
+
+    vector <benchEvent> evs( nev );
+    vector<SimPixel> px[SimTele::npl];
+    double nmim = 0, ndut = 0, nroi = 0, nph = 0;
+
+    std::mt19937 rnd( 7 );
+    std::normal_distribution<double> noise( 0, 3 );
+
+    for( unsigned iev = 0; iev < nev; ++iev ) {
+
+      sim.event( px );
+      benchEvent & ev = evs[iev];
+
+      for( int ipl = 1; ipl <= 6; ++ipl ) {
+	for( unsigned i = 0; i < px[ipl].size(); ++i ) {
+	  tele::pixel p = { px[ipl][i].col, px[ipl][i].row, 0 };
+	  ev.mim[ipl].push_back( p );
+	}
+	nmim += px[ipl].size();
+      }
+
+      for( unsigned i = 0; i < px[0].size(); ++i ) {
+
+	s53::pixel p = { px[0][i].col, px[0][i].row, px[0][i].tot + 1, px[0][i].frm, 0 }; // ToT shifted from zero, as in scope53m
+	ev.dut.push_back( p );
+
+	// R4S ROI: the hit and two rows above and below, on a 155x160 chip
+
+	int col = px[0][i].col % 155;
+	int row = px[0][i].row % 156 + 2;
+	for( int dr = -2; dr <= 2; ++dr ) {
+	  double adc = noise( rnd ) + ( dr == 0 ? 40 + 10*px[0][i].tot : 0 );
+	  r4s::pixel q = { col, row + dr, adc, adc, 0, 0 };
+	  ev.roi.push_back( q );
+	}
+
+	// quad: a pulse height per pixel
+
+	double t = a0 + ( 20 + 10*px[0][i].tot ) / a1;
+	ev.ph.push_back( a4 - a3*exp( -pow( t, a2 ) ) );
+
+      }
+      ndut += ev.dut.size();
+      nroi += ev.roi.size();
+      nph += ev.ph.size();
+
+    } // events
+
+    // clustering:
+
+    timeit( "getClus", ntrk, nev, nmim, [&]() {
+	for( unsigned iev = 0; iev < nev; ++iev )
+	  for( int ipl = 1; ipl <= 6; ++ipl )
+	    sink += tele::getClus( evs[iev].mim[ipl] ).size();
+      }, res );
+
+    vector < vector <tele::cluster> > cls( 7*nev );
+    double ncls = 0;
+    for( unsigned iev = 0; iev < nev; ++iev )
+      for( int ipl = 1; ipl <= 6; ++ipl ) {
+	cls[7*iev+ipl] = tele::getClus( evs[iev].mim[ipl] );
+	ncls += cls[7*iev+ipl].size();
+      }
+
+    timeit( "mindxy", ntrk, nev, ncls, [&]() {
+	for( unsigned i = 0; i < cls.size(); ++i ) {
+	  tele::isolation( cls[i] );
+	  if( cls[i].size() ) sink += cls[i][0].mindxy;
+	}
+      }, res );
+
+    timeit( "getClusn", ntrk, nev, ndut, [&]() {
+	for( unsigned iev = 0; iev < nev; ++iev )
+	  sink += s53::getClusn( evs[iev].dut ).size();
+      }, res );
+
+    timeit( "getClusq", ntrk, nev, ndut, [&]() {
+	for( unsigned iev = 0; iev < nev; ++iev )
+	  sink += s53::getClusq( evs[iev].dut ).size();
+      }, res );
+
+    // calibration:
+
+    timeit( "calcurve", ntrk, nev, ndut, [&]() {
+	for( unsigned iev = 0; iev < nev; ++iev )
+	  for( unsigned i = 0; i < evs[iev].dut.size(); ++i ) {
+	    const s53::pixel & p = evs[iev].dut[i];
+	    int thechan = p.col*nrows + p.row;
+	    if( calcurves.find( thechan ) == calcurves.end() ) continue;
+	    sink += calcurves[thechan]( p.tot );
+	  }
+      }, res );
+
+    timeit( "PHtoVcal", ntrk, nev, nph, [&]() {
+	for( unsigned iev = 0; iev < nev; ++iev )
+	  for( unsigned i = 0; i < evs[iev].ph.size(); ++i )
+	    sink += PHtoVcal( evs[iev].ph[i], a0, a1, a2, a3, a4, a5 );
+      }, res );
+
+    vector <r4s::pixel> pb( 999 );
+    timeit( "R4Scm", ntrk, nev, nroi, [&]() {
+	for( unsigned iev = 0; iev < nev; ++iev )
+	  sink += r4s::commonmode( evs[iev].roi, pb.data() );
+      }, res );
+
+    // tracking, as in scope53m:
+
+    TelePlane tp[7];
+    for( int ipl = 1; ipl <= 6; ++ipl ) {
+      TelePlane p = { ptchx[ipl], ptchy[ipl], midx[ipl], midy[ipl],
+		      sim.alignx[ipl], sim.aligny[ipl], sim.rotx[ipl], sim.roty[ipl],
+		      sim.zz[ipl] + sim.alignz[ipl] };
+      tp[ipl] = p;
+    }
+    double f = 4.8/sim.GeV;
+    double triCut = 0.05; // [mm] like tele
+    double DUTz = sim.DUTz;
+
+    vector < vector <s53::triplet> > tris( nev ), dris( nev );
+    PlaneXY pxy[7]; // hits of the event, SoA
+
+    // triplets A-C-B with planes ( 1, 3, 2 ) and driplets ( 4, 6, 5 )
+
+    auto mkplets = [&]( unsigned iev, int iA, int iB, int iC,
+			double acut, vector <s53::triplet> & plets ) {
+
+      plets.clear();
+
+      pxy[iA].fill( tp[iA], cls[7*iev+iA] );
+      pxy[iB].fill( tp[iB], cls[7*iev+iB] );
+      pxy[iC].fill( tp[iC], cls[7*iev+iC] );
+
+      makeTriplets( pxy[iA], pxy[iB], pxy[iC], acut, triCut,
+		    []( unsigned, unsigned, double, double ) {},
+		    []( unsigned, double, double, double, double, double, double ) {},
+		    [&]( unsigned jA, unsigned jB, unsigned jC,
+			 double avx, double avy, double avz, double slpx, double slpy ) {
+		      s53::triplet tri;
+		      tri.xm = avx;
+		      tri.ym = avy;
+		      tri.zm = avz;
+		      tri.sx = slpx;
+		      tri.sy = slpy;
+		      tri.lk = 0;
+		      tri.ttdmin = 99.9;
+		      tri.iA = jA;
+		      tri.iB = jB;
+		      tri.iC = jC;
+		      plets.push_back(tri);
+		    } );
+
+    }; // mkplets
+
+    timeit( "triplets", ntrk, nev, ncls, [&]() {
+	for( unsigned iev = 0; iev < nev; ++iev ) {
+	  mkplets( iev, 1, 2, 3, 0.005*f, tris[iev] );
+	  mkplets( iev, 4, 5, 6, 0.005, dris[iev] );
+	  sink += tris[iev].size() + dris[iev].size();
+	}
+      }, res );
+
+    double ntri = 0;
+    for( unsigned iev = 0; iev < nev; ++iev )
+      ntri += tris[iev].size();
+
+    timeit( "sixmatch", ntrk, nev, ntri, [&]() {
+	double sixcut = 0.1; // [mm]
+	for( unsigned iev = 0; iev < nev; ++iev ) {
+	  const vector <s53::triplet> & triplets = tris[iev];
+	  for( unsigned iA = 0; iA < triplets.size(); ++iA ) {
+	    double xc, yc;
+	    tripletAt( triplets[iA], DUTz, xc, yc ); // normal incidence
+	    matchAt( dris[iev], DUTz, xc, yc,
+		     [&]( unsigned, double, double, double dx, double dy ) {
+		       if( fabs(dx) < sixcut && fabs(dy) < sixcut )
+			 sink += 1;
+		     } );
+	  }
+	}
+      }, res );
+
+  } // ntrk
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+  // baseline:
+
+  if( lwrite ) {
+    ofstream baseFile( baseFileName );
+    baseFile << "# kernbench baseline: kernel tracks/event ns/event ns/hit ref-units spread" << endl;
+    for( unsigned i = 0; i < res.size(); ++i )
+      baseFile << res[i].kernel
+	       << " " << res[i].ntrk
+	       << " " << res[i].nsev
+	       << " " << res[i].nshit
+	       << " " << res[i].rel
+	       << " " << res[i].spread
+	       << endl;
+    cout << endl << "wrote baseline " << baseFileName << endl;
+    return 0;
+  }
+
+  ifstream baseFile( baseFileName );
+  if( ! baseFile.is_open() ) {
+    cout << endl << "no baseline " << baseFileName << ", write one with -w" << endl;
+    return 0;
+  }
+
+  map < pair<string,double>, benchResult > base;
+  string line;
+  while( getline( baseFile, line ) ) {
+    if( line.empty() || line[0] == '#' ) continue;
+    istringstream tokenizer( line );
+    benchResult b;
+    b.rel = 0; // old baselines: write a new one
+    b.spread = 0;
+    tokenizer >> b.kernel >> b.ntrk >> b.nsev >> b.nshit >> b.rel >> b.spread;
+    base[ make_pair( b.kernel, b.ntrk ) ] = b;
+  }
+
+  cout << endl << "compared to " << baseFileName
+       << " (limit " << nsig << " spreads, at least " << tol*100 << "%):" << endl;
+
+  int nslow = 0;
+
+  for( unsigned i = 0; i < res.size(); ++i ) {
+    map < pair<string,double>, benchResult >::iterator it =
+      base.find( make_pair( res[i].kernel, res[i].ntrk ) );
+    if( it == base.end() || it->second.rel <= 0 ) continue;
+    double r = res[i].rel / it->second.rel;
+    double sb = it->second.spread;
+    double sr = res[i].spread;
+    double lim = nsig * sqrt( sb*sb + sr*sr );
+    if( lim < tol ) lim = tol;
+    if( r > 1 + lim ) {
+      ++nslow;
+      cout << "  REGRESSION " << setw(12) << left << res[i].kernel << right
+	   << setw(8) << res[i].ntrk
+	   << "  " << setprecision(3) << r << " x baseline"
+	   << " (limit " << 1 + lim << ")"
+	   << setprecision(6) << endl;
+    }
+  }
+
+  if( nslow == 0 )
+    cout << "  no regression" << endl;
+
+  if( sink < 0 ) cout << sink << endl;
+
+  return nslow > 0;
+}
@@ -0,0 +1,277 @@
+// numerical checks of the shared kernels against the code they replace:
+// exit 1 if a result differs
+
+// make kerncheck
+// kerncheck
+
+// histshard.h: shards merged into a histogram vs serial TH1::Fill,
+//   profile shards vs serial TProfile::Fill and TProfile2D::Fill
+// langau.h: Landau x Gauss tables vs the direct sums
+// telecore.h: batch plane transform and residuals vs TelePlane::xy, bitwise
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <cmath>
+
+#include <TH1D.h>
+#include <TProfile.h>
+#include <TProfile2D.h>
+
+#include "histshard.h"
+#include "langau.h"
+#include "telecore.h"
+
+using namespace std;
+
+//------------------------------------------------------------------------------
+// relative difference, 0 for equal values
+
+double reldiff( double a, double b )
+{
+  double s = fabs(a) + fabs(b);
+  return s > 0 ? fabs( a - b ) / s : 0;
+}
+
+//------------------------------------------------------------------------------
+// fill the same numbers serially and through shards, some direct fills
+// before the merge, with and without Sumw2
+
+bool checkShards( bool lsumw2 )
+{
+  mt19937 gen( 11 );
+  normal_distribution<double> gauss( 0.1, 0.3 );
+
+  vector<double> x( 100000 );
+  for( unsigned i = 0; i < x.size(); ++i )
+    x[i] = gauss( gen ); // some in under and overflow
+
+  TH1D hs( "hs", "serial", 80, -0.5, 0.7 );
+  TH1D hm( "hm", "merged", 80, -0.5, 0.7 );
+  if( lsumw2 ) {
+    hs.Sumw2();
+    hm.Sumw2();
+  }
+
+  for( unsigned i = 0; i < x.size(); ++i )
+    hs.Fill( x[i] );
+
+  unsigned n0 = 1000; // direct
+  for( unsigned i = 0; i < n0; ++i )
+    hm.Fill( x[i] );
+
+  H1Shard sh[3];
+  for( int k = 0; k < 3; ++k )
+    sh[k].book( hm );
+
+  unsigned n1 = 40000;
+  for( unsigned i = n0; i < n1; ++i )
+    sh[0].fill( x[i] );
+  sh[1].fill( 30000, &x[n1] ); // batch
+  sh[2].fill( x.size() - n1 - 30000, &x[n1+30000] );
+
+  for( int k = 0; k < 3; ++k ) // in order
+    sh[k].mergeInto( hm );
+
+  double dbin = 0;
+  double derr = 0;
+  for( int ib = 0; ib <= hs.GetNbinsX()+1; ++ib ) {
+    dbin = max( dbin, fabs( hs.GetBinContent(ib) - hm.GetBinContent(ib) ) );
+    derr = max( derr, reldiff( hs.GetBinError(ib), hm.GetBinError(ib) ) );
+  }
+
+  double ss[4], sm[4];
+  hs.GetStats( ss );
+  hm.GetStats( sm );
+  double dstat = 0;
+  for( int i = 0; i < 4; ++i )
+    dstat = max( dstat, reldiff( ss[i], sm[i] ) );
+
+  double dent = fabs( hs.GetEntries() - hm.GetEntries() );
+  double dmean = reldiff( hs.GetMean(), hm.GetMean() );
+  double drms = reldiff( hs.GetRMS(), hm.GetRMS() );
+
+  bool ok = dbin == 0 && dent == 0 && derr < 1E-12 &&
+    dstat < 1E-12 && dmean < 1E-12 && drms < 1E-12;
+
+  cout << "histshard" << ( lsumw2 ? " Sumw2" : "" )
+       << ": bins " << dbin
+       << ", errors " << derr
+       << ", entries " << dent
+       << ", stats " << dstat
+       << ", mean " << dmean
+       << ", rms " << drms
+       << ( ok ? "  ok" : "  DIFFERS" ) << endl;
+
+  return ok;
+}
+
+//------------------------------------------------------------------------------
+// profiles: the same for TProfile and TProfile2D, with y and z out of
+// the profile range. Sums of y in a different order: not bitwise.
+
+template<class P> double maxBinDiff( const P & ps, const P & pm, int nb,
+				      double & dent, double & derr )
+{
+  double dbin = 0;
+  for( int ib = 0; ib < nb; ++ib ) {
+    dbin = max( dbin, reldiff( ps.GetBinContent(ib), pm.GetBinContent(ib) ) );
+    dent = max( dent, fabs( ps.GetBinEntries(ib) - pm.GetBinEntries(ib) ) );
+    derr = max( derr, reldiff( ps.GetBinError(ib), pm.GetBinError(ib) ) );
+  }
+  return dbin;
+}
+
+bool checkProfileShards( bool lsumw2 )
+{
+  mt19937 gen( 17 );
+  normal_distribution<double> gauss( 0.1, 0.3 );
+
+  unsigned n = 100000;
+  vector<double> x( n ), y( n ), z( n );
+  for( unsigned i = 0; i < n; ++i ) {
+    x[i] = gauss( gen );
+    y[i] = gauss( gen );
+    z[i] = gauss( gen );
+  }
+
+  TProfile ps( "ps", "serial", 60, -0.5, 0.7, -0.4, 0.6 );
+  TProfile pm( "pm", "merged", 60, -0.5, 0.7, -0.4, 0.6 );
+  TProfile2D qs( "qs", "serial", 30, -0.5, 0.7, 20, -0.4, 0.6, -0.4, 0.6 );
+  TProfile2D qm( "qm", "merged", 30, -0.5, 0.7, 20, -0.4, 0.6, -0.4, 0.6 );
+  if( lsumw2 ) {
+    ps.Sumw2();
+    pm.Sumw2();
+    qs.Sumw2();
+    qm.Sumw2();
+  }
+
+  for( unsigned i = 0; i < n; ++i ) {
+    ps.Fill( x[i], y[i] );
+    qs.Fill( x[i], y[i], z[i] );
+  }
+
+  unsigned n0 = 1000; // direct
+  for( unsigned i = 0; i < n0; ++i ) {
+    pm.Fill( x[i], y[i] );
+    qm.Fill( x[i], y[i], z[i] );
+  }
+
+  P1Shard sp[3];
+  P2Shard sq[3];
+  for( int k = 0; k < 3; ++k ) {
+    sp[k].book( pm );
+    sq[k].book( qm );
+  }
+  for( unsigned i = n0; i < n; ++i ) {
+    int k = i < 40000 ? 0 : i < 70000 ? 1 : 2;
+    sp[k].fill( x[i], y[i] );
+    sq[k].fill( x[i], y[i], z[i] );
+  }
+  for( int k = 0; k < 3; ++k ) { // in order
+    sp[k].mergeInto( pm );
+    sq[k].mergeInto( qm );
+  }
+
+  double dent = 0;
+  double derr = 0;
+  double dbin = maxBinDiff( ps, pm, ps.GetNbinsX()+2, dent, derr );
+  dbin = max( dbin, maxBinDiff( qs, qm, ( qs.GetNbinsX()+2 ) * ( qs.GetNbinsY()+2 ),
+				dent, derr ) );
+
+  double ss[9], sm[9];
+  double dstat = 0;
+  ps.GetStats( ss );
+  pm.GetStats( sm );
+  for( int i = 0; i < 6; ++i )
+    dstat = max( dstat, reldiff( ss[i], sm[i] ) );
+  qs.GetStats( ss );
+  qm.GetStats( sm );
+  for( int i = 0; i < 9; ++i )
+    dstat = max( dstat, reldiff( ss[i], sm[i] ) );
+
+  dent = max( dent, fabs( ps.GetEntries() - pm.GetEntries() ) );
+  dent = max( dent, fabs( qs.GetEntries() - qm.GetEntries() ) );
+
+  bool ok = dent == 0 && dbin < 1E-12 && derr < 1E-9 && dstat < 1E-12;
+
+  cout << "profile shards" << ( lsumw2 ? " Sumw2" : "" )
+       << ": bins " << dbin
+       << ", errors " << derr
+       << ", entries " << dent
+       << ", stats " << dstat
+       << ( ok ? "  ok" : "  DIFFERS" ) << endl;
+
+  return ok;
+}
+
+//------------------------------------------------------------------------------
+// Mimosa clusters through the vectorized clone and the scalar transform:
+// the same bits, also for hit counts that leave a vector remainder
+
+bool checkPlaneXY()
+{
+  mt19937 gen( 13 );
+  uniform_real_distribution<double> ucol( 0, 1152 );
+  uniform_real_distribution<double> urow( 0, 576 );
+
+  struct clus { double col, row; };
+
+  TelePlane tp = { 21.2/1152, 10.6/576, 10.6, 5.3,
+		   0.0123, -0.0456, 0.00078, -0.00034, 153.2 };
+
+  PlaneXY pxy;
+  unsigned ndiff = 0;
+  unsigned nhit = 0;
+
+  for( unsigned n = 0; n < 40; ++n ) {
+
+    vector<clus> cl( n );
+    for( unsigned i = 0; i < n; ++i ) {
+      cl[i].col = ucol( gen );
+      cl[i].row = urow( gen );
+    }
+
+    pxy.fill( tp, cl );
+    double xt = ucol( gen ) * tp.ptchx - tp.midx;
+    double yt = urow( gen ) * tp.ptchy - tp.midy;
+    pxy.residuals( xt, yt );
+
+    for( unsigned i = 0; i < n; ++i ) {
+      double x, y;
+      tp.xy( cl[i], x, y );
+      if( x != pxy.x[i] || y != pxy.y[i] ||
+	  x - xt != pxy.dx[i] || y - yt != pxy.dy[i] )
+	++ndiff;
+    }
+    nhit += n;
+  }
+
+  bool ok = ndiff == 0;
+
+  cout << "PlaneXY " << cpuLevel()
+       << ": " << nhit << " hits, " << ndiff << " differ"
+       << ( ok ? "  ok" : "  DIFFERS" ) << endl;
+
+  return ok;
+}
+
+//------------------------------------------------------------------------------
+int main()
+{
+  cout << setprecision(3);
+
+  bool ok = 1;
+
+  ok &= checkShards( 0 );
+  ok &= checkShards( 1 );
+  ok &= checkProfileShards( 0 );
+  ok &= checkProfileShards( 1 );
+  ok &= langauCheck( cout );
+  ok &= checkPlaneXY();
+
+  cout << ( ok ? "all ok" : "FAILED" ) << endl;
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,215 @@
+// langau.h
+// Landau x Gauss convolution for charge fits, from tables instead of
+// 100 Landau and Gauss calls per function value
+
+// double g = langau( x, peak, width, smear ); // density, integral 1
+// bool ok = langauCheck( cout ); // deviation from the direct sums (kerncheck)
+
+// With the Landau most probable value mpc = peak + 0.2228 width the
+// convolution only depends on u = (x-mpc)/width and r = smear/width:
+//   g = F( u, r ) / width
+// F is kept on a fine u grid, one column per r value (r grid in steps
+// of 2%). A column is filled when a fit first needs it, as discrete
+// convolution of a Landau grid with Gauss weights, then F is
+// interpolated linearly in u and r. Outside the tables (r < 0.1,
+// r > 20, u far in the tails, width or smear <= 0) the direct sum is used,
+// as before.
+
+#ifndef LANGAU_H
+#define LANGAU_H
+
+#include <vector>
+#include <cmath>
+#include <iostream>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <algorithm> // max
+
+#include <TMath.h>
+
+//------------------------------------------------------------------------------
+inline double langauSum( double x, double peak, double width, double smear,
+			 int np = 100 ) // direct sum, the original fitlang code
+{
+  double invsq2pi = 0.3989422804014; // (2 pi)^(-1/2)
+  double mpshift  = -0.22278298; // Landau maximum location
+
+  double mpc = peak - mpshift * width; // most probable value
+
+  double sc = 5.0; // convolution extends to +-sc Gaussian sigmas
+
+  double xlow = x - sc * smear;
+  double xupp = x + sc * smear;
+
+  double step = (xupp-xlow) / np;
+
+  double sum = 0;
+
+  for( int i = 1; i <= np/2; i++ ) {
+
+    double xx = xlow + ( i - 0.5 ) * step;
+    sum += TMath::Landau( xx, mpc, width ) / width * TMath::Gaus( x, xx, smear );
+
+    xx = xupp - ( i - 0.5 ) * step;
+    sum += TMath::Landau( xx, mpc, width ) / width * TMath::Gaus( x, xx, smear );
+  }
+
+  return invsq2pi * step * sum / smear;
+}
+
+//------------------------------------------------------------------------------
+class LanGauTable {
+
+ public:
+
+  static LanGauTable & get()
+  {
+    static LanGauTable t; // thread safe init
+    return t;
+  }
+
+  // F( u, r ), false if outside the tables
+  bool eval( double u, double r, double & F )
+  {
+    if( r < rmin || r >= rmax ) return false;
+
+    double fu = ( u - u0 ) / du;
+    if( fu < 0 || fu >= nu-1 ) return false;
+
+    double fr = std::log( r / rmin ) / lq;
+    int j = fr;
+    if( j >= nr-1 ) return false;
+
+    int i = fu;
+    double tu = fu - i;
+    double tr = fr - j;
+
+    const double * c0 = column( j );
+    const double * c1 = column( j+1 );
+
+    double f0 = c0[i] + tu * ( c0[i+1] - c0[i] );
+    double f1 = c1[i] + tu * ( c1[i+1] - c1[i] );
+
+    F = f0 + tr * ( f1 - f0 );
+
+    return true;
+  }
+
+  static constexpr double u0 = -30; // u grid
+  static constexpr double du = 0.02;
+  static const int nu = 9001; // u up to 150
+  static constexpr double rmin = 0.1; // Gauss: 5 grid steps per sigma
+  static constexpr double rmax = 20;
+
+ private:
+
+  LanGauTable()
+  {
+    lq = std::log( 1.02 ); // r grid
+    nr = std::log( rmax / rmin ) / lq + 2;
+    fCol.resize( nr );
+    fReady.reset( new std::atomic<bool>[nr] );
+    for( int j = 0; j < nr; ++j )
+      fReady[j] = 0;
+  }
+
+  const double * column( int j )
+  {
+    if( !fReady[j] ) {
+
+      std::lock_guard<std::mutex> lock( fMutex );
+
+      if( !fReady[j] ) {
+
+	if( fLandau.empty() ) { // Landau density on the u grid plus margins
+	  fMargin = 5 * rmin * std::exp( lq * nr ) / du + 2;
+	  fLandau.resize( nu + 2*fMargin );
+	  for( size_t k = 0; k < fLandau.size(); ++k )
+	    fLandau[k] = TMath::Landau( u0 + ( (int) k - fMargin ) * du );
+	}
+
+	double r = rmin * std::exp( lq * j );
+	int K = 5 * r / du; // +-5 sigma, as the direct sum
+
+	std::vector<double> w( 2*K+1 ); // Gauss weights
+	for( int k = -K; k <= K; ++k )
+	  w[k+K] = du * TMath::Gaus( k*du, 0, r, 1 ); // normalised
+
+	std::vector<double> & c = fCol[j];
+	c.resize( nu );
+	for( int i = 0; i < nu; ++i ) {
+	  const double * l = &fLandau[i + fMargin - K];
+	  double sum = 0;
+	  for( int k = 0; k <= 2*K; ++k )
+	    sum += l[k] * w[2*K-k]; // L( u - k du ) N( k du )
+	  c[i] = sum;
+	}
+
+	fReady[j] = 1;
+
+      }
+
+    }
+
+    return &fCol[j][0];
+  }
+
+  double lq;
+  int nr;
+  int fMargin;
+  std::vector<double> fLandau;
+  std::vector< std::vector<double> > fCol;
+  std::unique_ptr< std::atomic<bool>[] > fReady;
+  std::mutex fMutex;
+
+}; // LanGauTable
+
+//------------------------------------------------------------------------------
+inline double langau( double x, double peak, double width, double smear )
+{
+  if( width > 0 && smear > 0 ) {
+    double mpshift  = -0.22278298; // Landau maximum location
+    double u = ( x - peak ) / width + mpshift;
+    double F;
+    if( LanGauTable::get().eval( u, smear / width, F ) )
+      return F / width;
+  }
+  return langauSum( x, peak, width, smear );
+}
+
+//------------------------------------------------------------------------------
+// tables vs direct sums: false if the tables deviate from a 1000 step sum
+// by more than tol of the peak height, or more than the 100 step sum
+// the fits used before
+
+inline bool langauCheck( std::ostream & out, double tol = 1E-3 )
+{
+  double dtab = 0; // tables vs a fine sum, relative to the peak height
+  double dsum = 0; // the old 100 step sum vs the fine sum
+
+  for( double r = 0.15; r < 15; r *= 1.37 ) {
+
+    double fpk = 0;
+    for( double u = -5; u < 10; u += 0.05 )
+      fpk = std::max( fpk, langauSum( u, 0, 1, r, 1000 ) );
+
+    for( double u = -5 - 5*r; u < 40 + 5*r; u += 0.0537 ) {
+      double f = langauSum( u, 0, 1, r, 1000 );
+      dtab = std::max( dtab, std::fabs( langau( u, 0, 1, r ) - f ) / fpk );
+      dsum = std::max( dsum, std::fabs( langauSum( u, 0, 1, r ) - f ) / fpk );
+    }
+
+  }
+
+  bool ok = dtab < tol && dtab <= dsum;
+
+  out << "langau: max deviation from a 1000 step sum "
+      << dtab << " for the tables, "
+      << dsum << " for the 100 step sum (of the peak height)"
+      << ( ok ? "  ok" : "  DIFFERS" ) << std::endl;
+
+  return ok;
+}
+
+#endif
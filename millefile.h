@@ -0,0 +1,132 @@
+// millefile.h
+// Mille binary records for pede, written without the Millepede library:
+// same layout as Mille::mille and Mille::end (float version).
+// Records are collected in memory and written in blocks of 4 MB.
+
+// MilleFile mille( "mille.bin" );
+// MilleFile mille( "mille.bin", ithread ); // mille_t<ithread>.bin, one per thread
+// per measurement: mille.mille( nlc, derlc, ngl, dergl, label, meas, sigma );
+// per track: mille.end();
+// records are self-contained: cat mille_t*.bin > mille.bin
+
+#ifndef MILLEFILE_H
+#define MILLEFILE_H
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+
+class MilleFile {
+
+ public:
+
+  MilleFile( const std::string & fileName )
+    : fFile( fileName, std::ios::binary | std::ios::out )
+  {
+    reserve();
+  }
+
+  MilleFile( const std::string & fileName, int ithread )
+    : fFile( threadName( fileName, ithread ), std::ios::binary | std::ios::out )
+  {
+    reserve();
+  }
+
+  ~MilleFile() { flush(); }
+
+  // mille.bin, 3 -> mille_t3.bin
+
+  static std::string threadName( const std::string & fileName, int ithread )
+  {
+    std::ostringstream name;
+    size_t dot = fileName.rfind( '.' );
+    size_t slash = fileName.rfind( '/' );
+    if( dot == std::string::npos || ( slash != std::string::npos && dot < slash ) )
+      name << fileName << "_t" << ithread;
+    else
+      name << fileName.substr( 0, dot ) << "_t" << ithread << fileName.substr( dot );
+    return name.str();
+  }
+
+  // one measurement: nlc local and ngl global derivatives,
+  // zero derivatives are not stored, as in Mille
+
+  void mille( int nlc, const float * derlc, int ngl, const float * dergl,
+	      const int * label, float meas, float sigma )
+  {
+    if( sigma <= 0 ) return;
+
+    if( fFloat.empty() ) { // new track: word 0 is the error counter
+      fFloat.push_back( 0 );
+      fInt.push_back( 0 );
+    }
+
+    fFloat.push_back( meas );
+    fInt.push_back( 0 );
+
+    for( int i = 0; i < nlc; ++i )
+      if( derlc[i] != 0 ) {
+	fFloat.push_back( derlc[i] );
+	fInt.push_back( i+1 ); // local index
+      }
+
+    fFloat.push_back( sigma );
+    fInt.push_back( 0 );
+
+    for( int i = 0; i < ngl; ++i )
+      if( dergl[i] != 0 && label[i] > 0 ) {
+	fFloat.push_back( dergl[i] );
+	fInt.push_back( label[i] );
+      }
+  }
+
+  // the record of this track into the buffer
+
+  void end()
+  {
+    if( fFloat.size() > 1 ) {
+      int nwords = 2 * fFloat.size();
+      append( &nwords, sizeof(int) );
+      append( fFloat.data(), fFloat.size() * sizeof(float) );
+      append( fInt.data(), fInt.size() * sizeof(int) );
+      if( fBuf.size() > kBlock )
+	flush();
+    }
+    fFloat.clear(); // keeps capacity
+    fInt.clear();
+  }
+
+  void flush()
+  {
+    if( fBuf.empty() ) return;
+    fFile.write( fBuf.data(), fBuf.size() );
+    fFile.flush();
+    fBuf.clear();
+  }
+
+ private:
+
+  static const size_t kBlock = 4 << 20; // [bytes]
+
+  void reserve()
+  {
+    fFloat.reserve( 256 );
+    fInt.reserve( 256 );
+    fBuf.reserve( kBlock + 4096 );
+  }
+
+  void append( const void * p, size_t n )
+  {
+    const char * c = (const char *) p;
+    fBuf.insert( fBuf.end(), c, c+n );
+  }
+
+  std::ofstream fFile;
+  std::vector<float> fFloat;
+  std::vector<int> fInt;
+  std::vector<char> fBuf;
+
+}; // MilleFile
+
+#endif
@@ -0,0 +1,138 @@
+// modtransform.h
+// local <-> global for a tilted and turned module, spread along z and
+// rotated with the plate: rotation matrix computed once per module
+
+// ModTransform tf( tilt, turn, phi, dz ); // [deg], [mm]
+// Vec3 g = tf.toGlobal( xl, yl, zl );
+// tf.toLocal( n, xg, yg, zg, xl, yl, zl ); // batch, SoA
+
+#ifndef MODTRANSFORM_H
+#define MODTRANSFORM_H
+
+#include <cmath>
+
+#include "cpudispatch.h"
+
+struct Vec3 {
+  double x, y, z;
+};
+
+class ModTransform {
+
+ public:
+
+  ModTransform() { set( 0, 0, 0, 0 ); }
+
+  ModTransform( double tilt, double turn, double phi, double dz )
+  {
+    set( tilt, turn, phi, dz );
+  }
+
+  // tilt around local x, turn around y, shift dz along z, phi around y
+
+  void set( double tilt, double turn, double phi, double dz )
+  {
+    double wt = atan(1.0) / 45.0; // pi/180 deg
+
+    double ca = cos( tilt*wt );
+    double sa = sin( tilt*wt );
+    double co = cos( turn*wt );
+    double so = sin( turn*wt );
+    double cp = cos( phi*wt );
+    double sp = sin( phi*wt );
+
+    // turn * tilt:
+
+    double T[3][3] = {
+      { co, -so*sa, so*ca },
+      {  0,     ca,    sa },
+      {-so, -co*sa, co*ca } };
+
+    // phi * turn * tilt:
+
+    for( int j = 0; j < 3; ++j ) {
+      fR[0][j] = cp*T[0][j] + sp*T[2][j];
+      fR[1][j] = T[1][j];
+      fR[2][j] =-sp*T[0][j] + cp*T[2][j];
+    }
+
+    // local origin in global:
+
+    fT[0] = sp*dz;
+    fT[1] = 0;
+    fT[2] = cp*dz;
+  }
+
+  Vec3 toGlobal( double xl, double yl, double zl ) const
+  {
+    Vec3 g;
+    g.x = fR[0][0]*xl + fR[0][1]*yl + fR[0][2]*zl + fT[0];
+    g.y = fR[1][0]*xl + fR[1][1]*yl + fR[1][2]*zl + fT[1];
+    g.z = fR[2][0]*xl + fR[2][1]*yl + fR[2][2]*zl + fT[2];
+    return g;
+  }
+
+  Vec3 toLocal( double xg, double yg, double zg ) const
+  {
+    double x = xg - fT[0];
+    double y = yg - fT[1];
+    double z = zg - fT[2];
+    Vec3 l;
+    l.x = fR[0][0]*x + fR[1][0]*y + fR[2][0]*z; // R^T
+    l.y = fR[0][1]*x + fR[1][1]*y + fR[2][1]*z;
+    l.z = fR[0][2]*x + fR[1][2]*y + fR[2][2]*z;
+    return l;
+  }
+
+  // batches: plain loops over arrays, vectorized by the compiler,
+  // for the widest vector unit of the node. The matrix is copied to
+  // locals first, else every store could change it and the loop stays scalar.
+
+  CPU_DISPATCH
+  void toGlobal( unsigned n,
+		 const double * xl, const double * yl, const double * zl,
+		 double * xg, double * yg, double * zg ) const
+  {
+    double R[3][3], T[3];
+    copy( R, T );
+    for( unsigned i = 0; i < n; ++i ) {
+      xg[i] = R[0][0]*xl[i] + R[0][1]*yl[i] + R[0][2]*zl[i] + T[0];
+      yg[i] = R[1][0]*xl[i] + R[1][1]*yl[i] + R[1][2]*zl[i] + T[1];
+      zg[i] = R[2][0]*xl[i] + R[2][1]*yl[i] + R[2][2]*zl[i] + T[2];
+    }
+  }
+
+  CPU_DISPATCH
+  void toLocal( unsigned n,
+		const double * xg, const double * yg, const double * zg,
+		double * xl, double * yl, double * zl ) const
+  {
+    double R[3][3], T[3];
+    copy( R, T );
+    for( unsigned i = 0; i < n; ++i ) {
+      double x = xg[i] - T[0];
+      double y = yg[i] - T[1];
+      double z = zg[i] - T[2];
+      xl[i] = R[0][0]*x + R[1][0]*y + R[2][0]*z;
+      yl[i] = R[0][1]*x + R[1][1]*y + R[2][1]*z;
+      zl[i] = R[0][2]*x + R[1][2]*y + R[2][2]*z;
+    }
+  }
+
+ private:
+
+  void copy( double R[3][3], double T[3] ) const
+  {
+    for( int j = 0; j < 3; ++j ) {
+      T[j] = fT[j];
+      for( int k = 0; k < 3; ++k )
+	R[j][k] = fR[j][k];
+    }
+  }
+
+  double fR[3][3]; // local to global
+  double fT[3]; // global position of the local origin [mm]
+
+}; // ModTransform
+
+#endif
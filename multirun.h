@@ -0,0 +1,112 @@
+// multirun.h
+// several runs in one process: the run number argument may be a list,
+// the analysis of one run is called for each, with its own output files.
+// The OpenMP threads stay alive between runs, constants that several
+// runs use can be kept in a RunCache.
+
+// int analyseRun( int argc, char* argv[] ); // the old main, run = last arg
+// int main( int argc, char* argv[] ) { return multiRun( argc, argv, analyseRun ); }
+// prog [options] 33095-33110,33120
+
+// static RunCache<T> cache; T & t = cache.get( key, [&]() { return load( key ); } );
+
+#ifndef MULTIRUN_H
+#define MULTIRUN_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <sstream>
+#include <iostream>
+#include <cstdlib> // atoi
+#include <time.h> // clock_gettime
+
+//------------------------------------------------------------------------------
+inline std::vector<int> runList( const std::string & s ) // 33095-33110,33120
+{
+  std::vector<int> runs;
+  std::istringstream tokenizer( s );
+  std::string item;
+  while( getline( tokenizer, item, ',' ) ) {
+    size_t dash = item.find( '-' );
+    if( dash == std::string::npos )
+      runs.push_back( atoi( item.c_str() ) );
+    else
+      for( int r = atoi( item.substr( 0, dash ).c_str() );
+	   r <= atoi( item.substr( dash+1 ).c_str() ); ++r )
+	runs.push_back( r );
+  }
+  return runs;
+}
+
+//------------------------------------------------------------------------------
+template<class F> int multiRun( int argc, char* argv[], F analyseRun )
+{
+  if( argc == 1 ) // the analysis says what is missing
+    return analyseRun( argc, argv );
+
+  std::string last( argv[argc-1] );
+
+  if( last.find_first_of( ",-" ) == std::string::npos || last[0] == '-' )
+    return analyseRun( argc, argv ); // one run
+
+  std::vector<int> runs = runList( last );
+
+  std::vector<char*> args( argv, argv + argc + 1 ); // with the final 0
+
+  int nfail = 0;
+
+  for( size_t ir = 0; ir < runs.size(); ++ir ) {
+
+    std::ostringstream srun;
+    srun << runs[ir];
+    std::string runnum = srun.str();
+    args[argc-1] = (char*) runnum.c_str();
+
+    timespec t0, t9;
+    clock_gettime( CLOCK_MONOTONIC, &t0 );
+
+    std::cout << std::endl << "multi-run: run " << runs[ir]
+	      << " (" << ir+1 << " of " << runs.size() << ")" << std::endl;
+
+    int status = analyseRun( argc, &args[0] );
+
+    clock_gettime( CLOCK_MONOTONIC, &t9 );
+
+    std::cout << "multi-run: run " << runs[ir]
+	      << ( status ? " failed" : " done" )
+	      << " after " << t9.tv_sec - t0.tv_sec + 1e-9 * ( t9.tv_nsec - t0.tv_nsec ) << " s"
+	      << std::endl;
+
+    if( status ) ++nfail;
+
+  }
+
+  std::cout << std::endl << "multi-run: " << runs.size() - nfail << " of "
+	    << runs.size() << " runs done" << std::endl;
+
+  return nfail > 0;
+}
+
+//------------------------------------------------------------------------------
+template<class T> class RunCache { // loaded once per key, for all runs
+
+ public:
+
+  template<class L> T & get( const std::string & key, L load )
+  {
+    typename std::map<std::string,T>::iterator it = fMap.find( key );
+    if( it != fMap.end() ) {
+      std::cout << "cached: " << key << std::endl;
+      return it->second;
+    }
+    return fMap.insert( std::make_pair( key, load() ) ).first->second;
+  }
+
+ private:
+
+  std::map<std::string,T> fMap;
+
+}; // RunCache
+
+#endif
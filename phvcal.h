@@ -0,0 +1,64 @@
+// phvcal.h
+// pixel pulse height -> Vcal DAC of the PSI46 modules, inverse of the
+// decorrelated Weibull gain fit. One copy, used by quad and quad3D and
+// timed by kernbench.
+
+// double q = PHtoVcal( ph, a0, a1, a2, a3, a4, a5 ); // small Vcal
+
+#ifndef PHVCAL_H
+#define PHVCAL_H
+
+#include <cmath>
+#include <iostream>
+
+//------------------------------------------------------------------------------
+// inverse decorrelated Weibull PH -> large Vcal DAC
+inline double PHtoVcal( double ph, double a0, double a1, double a2, double a3, double a4, double a5 )
+{
+  // modph2ps decorrelated: ph = a4 - a3*exp(-t^a2), t = a0 + q/a1
+
+  //return ph; // test !!
+
+  double Ared = ph - a4; // a4 is asymptotic maximum
+
+  if( Ared >= 0 ) {
+    Ared = -0.1; // avoid overflow
+  }
+
+  // large Vcal = ( (-ln(-(A-a4)/a3))^1/a2 - a0 )*a1
+
+  if( a3 < 1E-9 ) {
+    //std::cout << "PHtoVcal zero a3  " << a3 << std::endl;
+    return ph;
+  }
+  else if( -Ared > a3 ) {
+    //std::cout << "PHtoVcal small a3  " << a3 << "  " << -Ared << std::endl;
+    return ph;
+  }
+
+  double vc =
+    a1 * ( pow( -log( -Ared / a3 ), 1/a2 ) - a0 );
+
+  if( vc > 999 )
+    std::cout << "overflow " << vc << ", Ared " << Ared << ", a3 " << a3 << std::endl;
+
+  if( vc != vc ) {
+
+    std::cout << "PHtoVcal NaN at "
+	      << "  " << a0
+	      << "  " << a1
+	      << "  " << a2
+	      << "  " << a3
+	      << "  " << a4
+	      << "  " << a5
+	      << std::endl;
+
+    return ph;
+
+  }
+
+  return vc * a5; // small Vcal
+  //return vc; // large Vcal
+}
+
+#endif
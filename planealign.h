@@ -0,0 +1,241 @@
+// planealign.h
+// alignment of a turned, tilted and rotated plane from track - cluster
+// candidates kept in memory: all iterations in one job
+
+// PlaneAlign ap; // start values from the align file
+// per link: ap.add( c ); // loose window
+// end: ap.iterate( coarse, niter, "DUT" );
+
+#ifndef PLANEALIGN_H
+#define PLANEALIGN_H
+
+#include <vector>
+#include <string>
+#include <cmath>
+#include <iostream>
+#include <iomanip>
+
+struct AlignCand {
+  float xm, ym, zm; // track point [mm]
+  float sx, sy; // track slopes
+  float cx, cy; // cluster in track orientation [mm]
+  float dalx, daly; // time dependent shift [mm]
+};
+
+struct LinFit { // straight line y = a + b*x
+  double n, sx, sy, sxx, sxy;
+  LinFit() : n(0), sx(0), sy(0), sxx(0), sxy(0) {}
+  void add( double x, double y ) { ++n; sx += x; sy += y; sxx += x*x; sxy += x*y; }
+  double slope() const {
+    double d = n*sxx - sx*sx;
+    return d > 0 ? ( n*sxy - sx*sy ) / d : 0;
+  }
+};
+
+class PlaneAlign {
+
+ public:
+
+  double alx, aly; // [mm]
+  double rot; // [rad]
+  double tilt, turn; // [deg]
+  double z; // [mm]
+
+  double ux, uy; // x4 = ux*x3 + alx
+  double cutx, cuty; // final link cuts [mm]
+  bool rotfromx; // rot from dx vs y, else from dy vs x
+  bool zfromx; // z from dx vs tx, else from dy vs ty
+  double minturn, mintilt; // [deg] not aligned below
+
+  unsigned maxcand;
+  std::vector<AlignCand> cand;
+
+  PlaneAlign() : alx(0), aly(0), rot(0), tilt(0), turn(0), z(0),
+    ux(1), uy(1), cutx(0.1), cuty(0.1), rotfromx(0), zfromx(0),
+    minturn(0.3), mintilt(0.3), maxcand(4000000) { update(); }
+
+  bool add( const AlignCand & c )
+  {
+    if( cand.size() >= maxcand ) return 0;
+    cand.push_back( c );
+    return 1;
+  }
+
+  // intersect track with plane, same transform as in the event loop,
+  // call update() after changing the angles
+
+  void residuals( const AlignCand & c,
+		  double & dx, double & dy,
+		  double & x1, double & y2, double & x3, double & y3 ) const
+  {
+    double zA = z - c.zm;
+    double zc = ( Nz*zA - Ny*c.ym - Nx*c.xm ) / ( Nx*c.sx + Ny*c.sy + Nz );
+    double xc = c.xm + c.sx * zc;
+    double yc = c.ym + c.sy * zc;
+    double dzc = zc + c.zm - z;
+
+    x1 = co*xc - so*dzc;
+    double z1 = so*xc + co*dzc;
+    y2 = ca*yc + sa*z1;
+    x3 = cf*x1 + sf*y2;
+    y3 =-sf*x1 + cf*y2;
+
+    dx = c.cx - ( ux*x3 + alx + c.dalx );
+    dy = c.cy - ( uy*y3 + aly + c.daly );
+  }
+
+  // coarse: peak search within +-wcoarse first (alignment iteration 0)
+
+  bool iterate( bool coarse, int niter, const std::string & name,
+		double wcoarse = 20 )
+  {
+    using namespace std;
+
+    cout << endl << name << " in-memory alignment from "
+	 << cand.size() << " candidates" << endl;
+
+    if( cand.size() < 999 ) {
+      cout << "  too few" << endl;
+      return 0;
+    }
+
+    double dx, dy, x1, y2, x3, y3;
+
+    if( coarse ) {
+
+      update();
+
+      double bin = 0.1; // [mm]
+      int nb = 2*wcoarse/bin;
+      vector<int> hx( nb, 0 );
+      vector<int> hy( nb, 0 );
+
+      for( unsigned i = 0; i < cand.size(); ++i ) {
+	residuals( cand[i], dx, dy, x1, y2, x3, y3 );
+	int ix = ( dx + wcoarse ) / bin;
+	int iy = ( dy + wcoarse ) / bin;
+	if( ix >= 0 && ix < nb ) ++hx[ix];
+	if( iy >= 0 && iy < nb ) ++hy[iy];
+      }
+
+      int mx = 0;
+      int my = 0;
+      for( int ib = 1; ib < nb; ++ib ) {
+	if( hx[ib] > hx[mx] ) mx = ib;
+	if( hy[ib] > hy[my] ) my = ib;
+      }
+      alx += -wcoarse + ( mx + 0.5 ) * bin;
+      aly += -wcoarse + ( my + 0.5 ) * bin;
+
+      cout << "  coarse " << alx << ", " << aly << endl;
+
+    } // coarse
+
+    for( int it = 0; it < niter; ++it ) {
+
+      update();
+
+      // windows shrink 4, 2, 1
+
+      double scl = it < 2 ? 4 / double( 1 << it ) : 1;
+      double wx = scl * cutx;
+      double wy = scl * cuty;
+
+      double n = 0;
+      double sdx = 0, sdy = 0, sdx2 = 0, sdy2 = 0;
+      LinFit frot, fturn, ftilt, fz;
+
+      for( unsigned i = 0; i < cand.size(); ++i ) {
+
+	const AlignCand & c = cand[i];
+	residuals( c, dx, dy, x1, y2, x3, y3 );
+
+	if( fabs(dx) > wx || fabs(dy) > wy ) continue;
+
+	++n;
+	sdx += dx;
+	sdy += dy;
+	sdx2 += dx*dx;
+	sdy2 += dy*dy;
+
+	double rx = ux*dx; // residuals in track orientation
+	double ry = uy*dy;
+
+	if( rotfromx )
+	  frot.add( y3, rx );
+	else
+	  frot.add( x3, ry );
+	fturn.add( x1, rx );
+	ftilt.add( y2, ry );
+	if( zfromx )
+	  fz.add( c.sx, rx );
+	else
+	  fz.add( c.sy, ry );
+
+      } // cand
+
+      if( n < 99 ) {
+	cout << "  iteration " << it << ": only " << n << " links" << endl;
+	return 0;
+      }
+
+      double mx = sdx / n;
+      double my = sdy / n;
+      alx += mx;
+      aly += my;
+
+      if( it >= 2 ) { // angles after the shifts settled
+
+	if( rotfromx )
+	  rot += frot.slope();
+	else
+	  rot -= frot.slope();
+
+	if( fabs(turn) > minturn && fabs(so) > 1E-6 )
+	  turn += fturn.slope() / wt / so;
+
+	if( fabs(tilt) > mintilt && fabs(sa) > 1E-6 )
+	  tilt += ftilt.slope() / wt / sa;
+
+	z += fz.slope();
+
+      }
+
+      cout << "  iteration " << it
+	   << setw(9) << n << " links"
+	   << ", rms " << setprecision(3) << sqrt( fabs( sdx2/n - mx*mx ) )*1E3
+	   << ", " << sqrt( fabs( sdy2/n - my*my ) )*1E3 << " um"
+	   << setprecision(6)
+	   << ": " << alx << ", " << aly
+	   << ", rot " << rot
+	   << ", tilt " << tilt
+	   << ", turn " << turn
+	   << ", z " << z
+	   << endl;
+
+    } // it
+
+    return 1;
+  }
+
+  void update() // trig for the current angles
+  {
+    wt = atan(1.0) / 45.0; // pi/180 deg
+    co = cos( turn*wt );
+    so = sin( turn*wt );
+    ca = cos( tilt*wt );
+    sa = sin( tilt*wt );
+    cf = cos( rot );
+    sf = sin( rot );
+    Nx =-ca*so;
+    Ny = sa;
+    Nz =-ca*co;
+  }
+
+ private:
+
+  double wt, co, so, ca, sa, cf, sf, Nx, Ny, Nz;
+
+}; // PlaneAlign
+
+#endif
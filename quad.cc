@@ -4,6 +4,7 @@
 // eudecoder
 
 // quad -l 59999 185
+// quad -G 185 // track fit also with GBL: compare, GBL records in mille.bin.gbl
 
 // D C B A <-- beam
 
@@ -25,6 +26,13 @@
 #include <TMatrixD.h>
 #include <TMath.h>
 #include "MilleBinary.h"
+#include "alignsolver.h"
+#include "fourfit.h" // fixed-size GBL fit
+#include "millefile.h"
+#include "histfit.h" // Landau x Gauss
+#include "stageprof.h"
+#include "telecore.h" // clustering, hot pixels
+#include "phvcal.h" // PH -> Vcal
 
 using namespace std;
 using namespace gbl;
@@ -55,56 +63,6 @@ struct cluster {
 pixel pb[66560]; // global declaration: vector of pixels with hit
 int fNHit; // global
 
-//------------------------------------------------------------------------------
-// inverse decorrelated Weibull PH -> large Vcal DAC
-double PHtoVcal( double ph, double a0, double a1, double a2, double a3, double a4, double a5, int mod )
-{
-  // modph2ps decorrelated: ph = a4 - a3*exp(-t^a2), t = a0 + q/a1
-
-  //return ph; // test !!
-
-  double Ared = ph - a4; // a4 is asymptotic maximum
-
-  if( Ared >= 0 ) {
-    Ared = -0.1; // avoid overflow
-  }
-
-  // large Vcal = ( (-ln(-(A-a4)/a3))^1/a2 - a0 )*a1
-
-  if( a3 < 1E-9 ) {
-    //cout << "PHtoVcal zero a3  " << a3 << endl;
-    return ph;
-  }
-  else if( -Ared > a3 ) {
-    //cout << "PHtoVcal small a3  " << a3 << "  " << -Ared << " mod " << mod << endl;
-    return ph;
-  }
-
-  double vc =
-    a1 * ( pow( -log( -Ared / a3 ), 1/a2 ) - a0 );
-
-  if( vc > 999 )
-    cout << "overflow " << vc << ", Ared " << Ared << ", a3 " << a3 << endl;
-
-  if( vc != vc ) {
-
-    cout << "PHtoVcal NaN at "
-	 << "  " << a0
-	 << "  " << a1
-	 << "  " << a2
-	 << "  " << a3
-	 << "  " << a4
-	 << "  " << a5
-	 << endl;
-
-    return ph;
-
-  }
-
-  return vc * a5; // small Vcal
-  //return vc; // large Vcal
-}
-
 //------------------------------------------------------------------------------
 vector<cluster> getClus()
 {
@@ -116,48 +74,9 @@ vector<cluster> getClus()
   const int fCluCut = 1; // clustering: 1 = no gap (15.7.2012)
   //const int fCluCut = 2;
 
-  vector<cluster> v;
-  if( fNHit == 0 ) return v;
-
-  int* gone = new int[fNHit];
-
-  for( int i = 0; i < fNHit; ++i )
-    gone[i] = 0;
-
-  int seed = 0;
+  return clusterPixels<cluster>( pb, fNHit, NearSquare( fCluCut ), []( cluster & c ) {
 
-  while( seed < fNHit ) {
-
-    // start a new cluster
-
-    cluster c;
-    c.vpix.push_back( pb[seed] );
-    gone[seed] = 1;
-
-    // let it grow as much as possible:
-
-    int growing;
-    do{
-      growing = 0;
-      for( int i = 0; i < fNHit; ++i ) {
-        if( !gone[i] ){ // unused pixel
-          for( unsigned int p = 0; p < c.vpix.size(); ++p ) { // vpix in cluster so far
-            int dr = c.vpix.at(p).row - pb[i].row;
-            int dc = c.vpix.at(p).col - pb[i].col;
-            if( (   dr>=-fCluCut) && (dr<=fCluCut) 
-		&& (dc>=-fCluCut) && (dc<=fCluCut) ) {
-              c.vpix.push_back(pb[i]);
-	      gone[i] = 1;
-              growing = 1;
-              break; // important!
-            }
-          } // loop over vpix
-        } // not gone
-      } // loop over all pix
-    }
-    while( growing );
-
-    // added all I could. determine position and append it to the list of clusters:
+    // added all I could. determine position:
 
     c.sumA = 0;
     c.charge = 0;
@@ -213,18 +132,7 @@ vector<cluster> getClus()
     c.ncol = maxx-minx+1;
     c.nrow = maxy-miny+1;
 
-    v.push_back(c); // add cluster to vector
-
-    // look for a new seed = used pixel:
-
-    while( (++seed < fNHit) && gone[seed] );
-
-  } // while over seeds
-
-  // nothing left, return clusters
-
-  delete gone;
-  return v;
+  } );
 }
 
 //------------------------------------------------------------------------------
@@ -243,9 +151,6 @@ TMatrixD Jac5( double ds ) // for GBL
   return jac;
 }
 
-//------------------------------------------------------------------------------
-Double_t landau_gauss_peak(TH1* h);
-
 
 //------------------------------------------------------------------------------
 bool isFiducial( double x, double y)
@@ -413,6 +318,8 @@ int main( int argc, char* argv[] )
   // further arguments:
 
   int lev = 999222111; // last event
+  string milleFileName( "mille.bin" );
+  bool lgbl = 0; // validate the track fit with GBL
 
   for( int i = 1; i < argc; ++i ) {
 
@@ -426,6 +333,14 @@ int main( int argc, char* argv[] )
     if( !strcmp( argv[i], "-e" ) )
       writeEfficiency = true;
 
+    // own Mille file per job, for pede to read them all
+    if( !strcmp( argv[i], "-m" ) )
+      milleFileName = argv[++i];
+
+    // also fit with GBL, compare, GBL records into <mille file>.gbl
+    if( !strcmp( argv[i], "-G" ) )
+      lgbl = 1;
+
   } // argc
 
   // alignments:
@@ -576,6 +491,19 @@ int main( int argc, char* argv[] )
   wscatSi[0] = 1.0 / ( tetSi * tetSi ); // weight
   wscatSi[1] = 1.0 / ( tetSi * tetSi );
 
+  // track fit with fixed sizes, inverted once per run:
+
+  FourFit fourfit( dz, resx, resy, tetSi );
+
+  // Jacobians and point list for GBL (-G), reused for every track:
+
+  TMatrixD jacUnit( 5, 5 );
+  jacUnit.UnitMatrix();
+  TMatrixD jacdz = Jac5( dz ); // plane to plane, fixed per run
+
+  vector<GblPoint> listOfPoints;
+  listOfPoints.reserve(4);
+
   // global labels for Pede:
 
   vector<int> labelsA( 6 );
@@ -610,7 +538,20 @@ int main( int argc, char* argv[] )
   labelsD[4] = 23; // tx
   labelsD[5] = 24; // ty
 
-  MilleBinary * mille = new MilleBinary( "mille.bin" );
+  MilleFile mille( milleFileName );
+
+  MilleBinary * gblmille = 0;
+  if( lgbl )
+    gblmille = new MilleBinary( milleFileName + ".gbl" );
+
+  // built-in solution of the same alignment problem from the same records,
+  // A and D are reference:
+
+  AlignSolver solver( 24 );
+  for( int i = 0; i < 6; ++i ) {
+    solver.fix( labelsA[i] );
+    solver.fix( labelsD[i] );
+  }
 
   // Landau peak cuts: Mon 27.7.2015
 
@@ -707,6 +648,10 @@ int main( int argc, char* argv[] )
   }
 
 
+  StageProf prof( "quad" );
+  prof.setRun( run );
+  prof.mark( "setup" );
+
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
   // gain parameters for mod roc col row:
 
@@ -817,6 +762,8 @@ int main( int argc, char* argv[] )
 
   } // mod
 
+  prof.mark( "gains" );
+
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
   // (re-)create root file:
 
@@ -1353,8 +1300,22 @@ int main( int argc, char* argv[] )
 
   int n4 = 0;
   int nmille = 0;
+  int ngbl = 0; // -G
+  int ngblndf = 0;
+  double gbldev[3] = { 0, 0, 0 }; // chisq, residual, covariance
+
+  prof.mark( "histos" );
+
+  int sdecode = prof.stage( "decode" );
+  int sclus = prof.stage( "clustering" );
+  int strack = prof.stage( "tracking" );
+  int soutput = prof.stage( "output" );
+  int salign = prof.stage( "alignment" );
 
   do {
+
+    prof.lap( sdecode );
+
     // Get next event:
     DetectorEvent evt = reader->GetDetectorEvent();
 
@@ -1441,7 +1402,7 @@ int main( int argc, char* argv[] )
 	  double a3 = p3[mod][roc][col][row];
 	  double a4 = p4[mod][roc][col][row];
 	  double a5 = p5[mod][roc][col][row];
-	  cal = PHtoVcal( adc, a0, a1, a2, a3, a4, a5, mod ) * ke[mod][roc]; // [ke]
+	  cal = PHtoVcal( adc, a0, a1, a2, a3, a4, a5 ) * ke[mod][roc]; // [ke]
 	}
 	
 	hpxdig[mod].Fill( adc );
@@ -1517,6 +1478,8 @@ int main( int argc, char* argv[] )
 
       fNHit = npx; // for cluster search
 
+      prof.lap( sclus );
+
       cl[mod] = getClus();
 
       if( ldb ) cout << "A clusters " << cl[mod].size() << endl;
@@ -1537,10 +1500,14 @@ int main( int argc, char* argv[] )
 	}
       }
 
+      prof.lap( sdecode );
+
     } // planes = mod
 
     ++event_nr;
 
+    prof.lap( strack );
+
     // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
     // A-B cluster correlations:
 
@@ -1984,7 +1951,7 @@ int main( int argc, char* argv[] )
       double xA = xm - ym*fx[A] - tx[A]*xm;
       double yA = ym + xm*fy[A] - ty[A]*ym;
 
-      TMatrixD derivA( 2, 6 ); // -alignment derivatives x,y
+      double derivA[2][6]; // -alignment derivatives x,y
 
       derivA[0][0] = 1.0; // -dresidx/dalignx
       derivA[1][0] = 0.0;
@@ -2016,7 +1983,7 @@ int main( int argc, char* argv[] )
 	double xD = xm - ym*fx[D] - tx[D]*xm;
 	double yD = ym + xm*fy[D] - ty[D]*ym;
 
-	TMatrixD derivD( 2, 6 ); // alignment derivatives x,y
+	double derivD[2][6]; // alignment derivatives x,y
 
 	derivD[0][0] = 1.0; // dresidx/dalignx
 	derivD[1][0] = 0.0;
@@ -2193,7 +2160,7 @@ int main( int argc, char* argv[] )
 	  double xB = xm - ym*fx[B] - tx[B]*xm;
 	  double yB = ym + xm*fy[B] - ty[B]*ym;
 
-	  TMatrixD derivB( 2, 6 ); // alignment derivatives x,y
+	  double derivB[2][6]; // alignment derivatives x,y
 
 	  derivB[0][0] = 1.0; // dresidx/dalignx
 	  derivB[1][0] = 0.0;
@@ -2278,7 +2245,7 @@ int main( int argc, char* argv[] )
 	    double xC = xm - ym*fx[C] - tx[C]*xm;
 	    double yC = ym + xm*fy[C] - ty[C]*ym;
 
-	    TMatrixD derivC( 2, 6 ); // alignment derivatives x,y
+	    double derivC[2][6]; // alignment derivatives x,y
 
 	    derivC[0][0] = 1.0; // dresidx/dalignx
 	    derivC[1][0] = 0.0;
@@ -2380,103 +2347,96 @@ int main( int argc, char* argv[] )
 	      }
 	    }
 
-	    // GBL track fit:
-
-	    vector<GblPoint> listOfPoints;
-	    listOfPoints.reserve(4);
-	    vector<double> sPoint;
-
-	    // plane A:
-
-	    TMatrixD jacPointToPoint(5, 5);
-	    jacPointToPoint.UnitMatrix();
-	    GblPoint *point = new GblPoint(jacPointToPoint);
-	    meas[0] = 0;
-	    meas[1] = 0;
-	    point->addMeasurement( proL2m, meas, measPrec );
-	    point->addScatterer( scat, wscatSi );
-	    point->addGlobals( labelsA, derivA ); // for MillePede alignment
-	    listOfPoints.push_back(*point);
-	    delete point;
-
-	    // B:
-
-	    jacPointToPoint = Jac5( dz );
-	    point = new GblPoint(jacPointToPoint);
-	    meas[0] = dx3;
-	    meas[1] = dy3;
-	    point->addMeasurement( proL2m, meas, measPrec );
-	    point->addScatterer( scat, wscatSi );
-	    point->addGlobals( labelsB, derivB ); // for MillePede alignment
-	    listOfPoints.push_back(*point);
-	    delete point;
-
-	    // C:
-
-	    jacPointToPoint = Jac5( dz );
-	    point = new GblPoint(jacPointToPoint);
-	    meas[0] = xC - xavg3C;
-	    meas[1] = yC - yavg3C;
-	    point->addMeasurement( proL2m, meas, measPrec );
-	    point->addScatterer( scat, wscatSi );
-	    point->addGlobals( labelsC, derivC ); // for MillePede alignment
-	    listOfPoints.push_back(*point);
-	    delete point;
-
-	    // D:
-
-	    jacPointToPoint = Jac5( dz );
-	    point = new GblPoint(jacPointToPoint);
-	    meas[0] = 0;
-	    meas[1] = 0;
-	    point->addMeasurement( proL2m, meas, measPrec );
-	    //point->addScatterer( scat, wscatSi );
-	    point->addGlobals( labelsD, derivD ); // for MillePede alignment
-	    listOfPoints.push_back(*point);
-	    delete point;
-
-	    // track fit:
-
-	    GblTrajectory traj( listOfPoints, 0 ); // 0 = no magnetic field
-	    //traj.printPoints();
-
-	    double Chi2;
-	    int Ndf;
-	    double lostWeight;
-
-	    traj.fit( Chi2, Ndf, lostWeight );
-
-	    double probchi = TMath::Prob( Chi2, Ndf );
-
-	    hchi2.Fill( Chi2 );
-	    hprob.Fill( probchi );
+	    // track fit, the GBL problem with fixed sizes:
 
-	    //cout << " Fit: " << Chi2 << ", " << Ndf << ", " << lostWeight << endl;
+	    double mx[4] = { 0, dx3, xC - xavg3C, 0 }; // measured residuals A,B,C,D
+	    double my[4] = { 0, dy3, yC - yavg3C, 0 };
 
-	    //traj.printTrajectory();
-	    //traj.printPoints();
+	    fourfit.fit( mx, my );
 
-	    TVectorD aCorrection(5);
-	    TMatrixDSym aCovariance(5);
+	    double probchi = TMath::Prob( fourfit.chi2, fourfit.ndf );
+
+	    hchi2.Fill( fourfit.chi2 );
+	    hprob.Fill( probchi );
 
 	    // at plane C:
 
-	    int ipos = 3; // starts at 1
-	    traj.getResults( ipos, aCorrection, aCovariance );
+	    //double uC, sC, covC[3]; // offset, slope, covariance
+	    //fourfit.getResults( 2, 0, uC, sC, covC );
+	    //cout << "  sigma(x) = " << sqrt(covC[2])*1E3 << " um" << endl;
+
+	    const vector<int> * labels[4] = { &labelsA, &labelsB, &labelsC, &labelsD };
+	    const int * lab[4] = { labelsA.data(), labelsB.data(), labelsC.data(), labelsD.data() };
+	    const double * der[4] = { derivA[0], derivB[0], derivC[0], derivD[0] };
 
-	    //cout << " corrections: " << endl;
-	    //aCorrection.Print();
-	    //cout << " covariance: " << endl;
-	    //aCovariance.Print();
-	    //cout << "  sigma(x) = " << sqrt(aCovariance(3,3))*1E3 << " um";
-	    //cout << ", sigma(y) = " << sqrt(aCovariance(4,4))*1E3 << " um";
-	    //cout << endl;
+	    if( lgbl ) { // same track with GBL, for comparison
+
+	      listOfPoints.clear(); // keeps capacity
+
+	      for( int ipt = 0; ipt < 4; ++ipt ) {
+		GblPoint point( ipt ? jacdz : jacUnit );
+		meas[0] = mx[ipt];
+		meas[1] = my[ipt];
+		point.addMeasurement( proL2m, meas, measPrec );
+		if( ipt < 3 ) // not on D
+		  point.addScatterer( scat, wscatSi );
+		point.addGlobals( *labels[ipt], TMatrixD( 2, 6, der[ipt] ) );
+		listOfPoints.push_back( point );
+	      }
+
+	      GblTrajectory traj( listOfPoints, 0 ); // 0 = no magnetic field
+
+	      double Chi2;
+	      int Ndf;
+	      double lostWeight;
+
+	      traj.fit( Chi2, Ndf, lostWeight );
+
+	      ++ngbl;
+	      if( Ndf != fourfit.ndf )
+		++ngblndf;
+
+	      double d = fabs( Chi2 - fourfit.chi2 );
+	      if( d > gbldev[0] ) gbldev[0] = d;
+
+	      for( unsigned ipt = 1; ipt <= 4; ++ipt ) {
+		unsigned int ndata;
+		TVectorD aResiduals(2), aMeasErrors(2), aResErrors(2), aDownWeights(2);
+		traj.getMeasResults( ipt, ndata, aResiduals, aMeasErrors, aResErrors, aDownWeights );
+		for( int ixy = 0; ixy < 2; ++ixy ) {
+		  d = fabs( aResiduals[ixy] - fourfit.res[ipt-1][ixy] );
+		  if( d > gbldev[1] ) gbldev[1] = d;
+		}
+	      }
+
+	      TVectorD aCorrection(5);
+	      TMatrixDSym aCovariance(5);
+	      traj.getResults( 3, aCorrection, aCovariance ); // after C
+
+	      for( int ixy = 0; ixy < 2; ++ixy ) {
+		double uC, sC, covC[3];
+		fourfit.getResults( 2, ixy, uC, sC, covC );
+		double gcov[3] = { aCovariance(1+ixy,1+ixy), aCovariance(1+ixy,3+ixy), aCovariance(3+ixy,3+ixy) };
+		for( int k = 0; k < 3; ++k ) {
+		  d = fabs( gcov[k] - covC[k] ) / sqrt( gcov[0]*gcov[2] );
+		  if( d > gbldev[2] ) gbldev[2] = d;
+		}
+	      }
+
+	      if( probchi > 0.01 )
+		traj.milleOut( *gblmille );
+
+	    } // lgbl
 
 	    // write to MP binary file
 
 	    if( probchi > 0.01 ) { // bias with bad alignment ?
-	      traj.milleOut( *mille );
+	      fourfit.milleOut( mille, 6, lab, der );
 	      ++nmille;
+
+	      // same records into the built-in solver:
+
+	      fourfit.milleOut( solver, 6, lab, der );
 	    }
 	    
 	  } // cl C
@@ -2511,6 +2471,8 @@ int main( int argc, char* argv[] )
     hnADB.Fill( nADB );
     hn4ev.Fill( n4ev );
 
+    prof.endEvent();
+
   } while( reader->NextEvent() && event_nr < lev );
 
   cout << endl << "events " << event_nr << endl;
@@ -2523,8 +2485,12 @@ int main( int argc, char* argv[] )
     }
   }
 
+  prof.start( soutput );
   histoFile->Write();
   histoFile->Close();
+  prof.stop( soutput );
+
+  prof.start( salign );
 
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
   // alignment fits:
@@ -2860,7 +2826,7 @@ int main( int argc, char* argv[] )
       cout << endl << modName[mod] << ":\t";
       if(haveGain[mod]){
 	for(int roc = 0; roc < 16; roc++){
-	  landau_peak[mod][roc] = landau_gauss_peak(&hclq0r[mod][roc]);
+	  landau_peak[mod][roc] = fitLanGauPeak( &hclq0r[mod][roc], 10, 40 );
 	  correction[mod][roc] = 22./landau_peak[mod][roc];
 	  if(!CCSupressed || conversionRun == run){
 	    if(correction[mod][roc] > 0.)ke[mod][roc] *= correction[mod][roc];
@@ -2885,6 +2851,50 @@ int main( int argc, char* argv[] )
   cout << "mille tracks " << nmille << endl;
   cout << endl;
 
+  delete gblmille; // flush and close
+
+  if( lgbl ) {
+    cout << "GBL check of " << ngbl << " track fits, largest deviation:" << endl;
+    cout << "  chisq " << gbldev[0]
+	 << ", residual " << gbldev[1]*1E3 << " um"
+	 << ", covariance at C " << gbldev[2] << " (relative)" << endl;
+    if( ngblndf )
+      cout << "  ndf differs for " << ngblndf << " tracks" << endl;
+    cout << endl;
+  }
+
+  // built-in alignment, same labels and sign as pede:
+
+  vector<double> par;
+  vector<double> err;
+
+  if( solver.solve( par, err ) ) {
+
+    ostringstream solverFileName;
+    solverFileName << "alignsolver_" << run << ".res";
+    ofstream solverFile( solverFileName.str() );
+    solverFile << "Parameter ! built-in solver: as pede inversion, no outlier down-weighting" << endl;
+
+    cout << "built-in alignment from " << solver.tracks() << " tracks"
+	 << " (track parameters eliminated, no outlier down-weighting):" << endl;
+    for( unsigned i = 0; i < par.size(); ++i ) {
+      cout << setw(4) << i+1
+	   << setw(14) << par[i]
+	   << setw(14) << err[i]
+	   << endl;
+      solverFile << setw(11) << i+1
+		 << setw(14) << par[i]
+		 << setw(14) << ( err[i] > 0 ? 0 : -1 )
+		 << setw(14) << err[i]
+		 << endl;
+    }
+    cout << "written to " << solverFileName.str() << endl;
+    cout << endl;
+
+  }
+  else
+    cout << "built-in alignment: singular, need more tracks" << endl;
+
   cout << "Efficiencies:" << endl;
   cout << "Mod\tTotal\t\tupper\t\tlower" << setprecision(6) << endl;
   cout << "A\t" << effAvsw.GetBinContent(14) << "\t" << effAvsx1.GetMean(2) << "\t" << effAvsx0.GetMean(2) << endl;
@@ -2901,90 +2911,12 @@ int main( int argc, char* argv[] )
     effout.close();
   }
 
-  cout << endl << histoFile->GetName() << endl << endl;
-
-  return 0;
-}
-
-
-Double_t fitLandauGauss( Double_t *x, Double_t *par ) {
-
-  static int nn=0;
-  nn++;
-  static double xbin = 1;
-  static double b1 = 0;
-  if( nn == 1 ) { b1 = x[0]; }
-  if( nn == 2 ) { xbin = x[0] - b1; } // bin width needed for normalization
-
-  // Landau:
-  Double_t invsq2pi = 0.3989422804014;   // (2 pi)^(-1/2)
-  Double_t mpshift  = -0.22278298;       // Landau maximum location
-
-  // MP shift correction:
-  double mpc = par[0] - mpshift * par[1]; //most probable value (peak pos)
-
-  //Fit parameters:
-  //par[0] = Most Probable (MP, location) parameter of Landau density
-  //par[1] = Width (scale) parameter of Landau density
-  //par[2] = Total area (integral -inf to inf, normalization constant)
-  //par[3] = Gaussian smearing
-
-  // Control constants
-  Double_t np = 100.0;      // number of convolution steps
-  Double_t sc =   5.0;      // convolution extends to +-sc Gaussian sigmas
-
-  // Range of convolution integral
-  double xlow = x[0] - sc * par[3];
-  double xupp = x[0] + sc * par[3];
-
-  double step = (xupp-xlow) / np;
-
-  // Convolution integral of Landau and Gaussian by sum
-
-  double sum = 0;
-  double xx;
-  double fland;
-
-  for( int i = 1; i <= np/2; i++ ) {
-
-    xx = xlow + ( i - 0.5 ) * step;
-    fland = TMath::Landau( xx, mpc, par[1] ) / par[1];
-    sum += fland * TMath::Gaus( x[0], xx, par[3] );
-
-    xx = xupp - ( i - 0.5 ) * step;
-    fland = TMath::Landau( xx, mpc, par[1] ) / par[1];
-    sum += fland * TMath::Gaus( x[0], xx, par[3] );
-  }
-
-  return( par[2] * invsq2pi * xbin * step * sum / par[3] );
-}
-
-Double_t landau_gauss_peak(TH1* h) {
-
-  double aa = h->GetEntries();//normalization
-
-  // find peak:
-  int ipk = h->GetMaximumBin();
-  double xpk = h->GetBinCenter(ipk);
-  double sm = xpk / 9; // sigma
-  double ns = sm; // noise
+  prof.stop( salign );
 
-  // fit range:
-  int ib0 = h->FindBin(10);
-  int ib9 = h->FindBin(40);
-  double x0 = h->GetBinLowEdge(ib0);
-  double x9 = h->GetBinLowEdge(ib9) + h->GetBinWidth(ib9);
-
-  // create a TF1 with the range from x0 to x9 and 4 parameters
-  TF1 *fitFcn = new TF1( "fitFcn", fitLandauGauss, x0, x9, 4 );
+  cout << endl << histoFile->GetName() << endl << endl;
 
-  // set start values:
-  fitFcn->SetParameter( 0, xpk ); // peak position, defined above
-  fitFcn->SetParameter( 1, sm ); // width
-  fitFcn->SetParameter( 2, aa ); // area
-  fitFcn->SetParameter( 3, ns ); // noise
+  prof.report( cout );
+  prof.write( StageProf::fileNameFor( fname.str() ) );
 
-  h->Fit("fitFcn", "R Q", "ep" );// R = range from fitFcn
-  TF1 *fit = h->GetFunction("fitFcn");
-  return fit->GetParameter(0);
+  return 0;
 }
@@ -0,0 +1,76 @@
+// r4scm.h
+// R4S strip of pixels read out as ROI: column-wise common mode correction
+// and the inverse Fermi gain curve (r4scal.C). One copy, used by scopes and
+// scopes_2017 and timed by kernbench.
+
+// double dph;
+// if( ! r4sDph( vpx, ipx, dph ) ) continue; // outermost rows of the column
+// double vcal = r4sVcal( dph, p0[col][row], p1[col][row], p2[col][row], p3[col][row] );
+
+#ifndef R4SCM_H
+#define R4SCM_H
+
+#include <vector>
+#include <cmath>
+
+//------------------------------------------------------------------------------
+// pulse height of pixel ipx minus the one of the nearer of the first and
+// last row of its column in the ROI. Pixels need col, row, adc.
+// false for the first and last row themselves (Randpixel).
+
+template<class P>
+bool r4sDph( const std::vector<P> & vpx, unsigned ipx, double & dph )
+{
+  int col4 = vpx[ipx].col;
+  int row4 = vpx[ipx].row;
+  double ph4 = vpx[ipx].adc;
+
+  int row1 = row4;
+  int row7 = row4;
+  double ph1 = ph4;
+  double ph7 = ph4;
+
+  for( unsigned jpx = 0; jpx < vpx.size(); ++jpx ) {
+
+    if( jpx == ipx ) continue;
+    if( vpx[jpx].col != col4 ) continue; // want same column
+
+    int jrow = vpx[jpx].row;
+
+    if( jrow < row1 ) {
+      row1 = jrow;
+      ph1 = vpx[jpx].adc;
+    }
+
+    if( jrow > row7 ) {
+      row7 = jrow;
+      ph7 = vpx[jpx].adc;
+    }
+
+  } // jpx
+
+  if( row4 == row1 ) return 0; // Randpixel
+  if( row4 == row7 ) return 0;
+
+  if( row4 - row1 < row7 - row4 )
+    dph = ph4 - ph1;
+  else
+    dph = ph4 - ph7;
+
+  return 1;
+}
+
+//------------------------------------------------------------------------------
+// inverse Fermi: corrected pulse height -> Vcal, constants of the pixel
+
+inline double r4sVcal( double dph, double p0, double p1, double p2, double p3 )
+{
+  double U = ( dph - p3 ) / p2;
+
+  if( U >= 1 )
+    U = 0.9999999; // avoid overflow
+
+  return p0 - p1 * log( (1-U)/U ); // inverse Fermi
+}
+
+#endif
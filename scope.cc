@@ -25,6 +25,9 @@
 #include <set>
 #include <cmath>
 
+#include "telecore.h" // clustering, hot pixels
+#include "stageprof.h"
+
 using namespace std;
 using namespace eudaq;
 
@@ -72,48 +75,9 @@ vector<cluster> getClus()
   const int fCluCut = 1; // clustering: 1 = no gap (15.7.2012)
   //const int fCluCut = 2;
 
-  vector<cluster> v;
-  if( fNHit == 0 ) return v;
-
-  int* gone = new int[fNHit];
-
-  for( int i = 0; i < fNHit; ++i )
-    gone[i] = 0;
-
-  int seed = 0;
-
-  while( seed < fNHit ) {
-
-    // start a new cluster
-
-    cluster c;
-    c.vpix.push_back( pb[seed] );
-    gone[seed] = 1;
+  return clusterPixels<cluster>( pb, fNHit, NearSquare( fCluCut ), []( cluster & c ) {
 
-    // let it grow as much as possible:
-
-    int growing;
-    do {
-      growing = 0;
-      for( int i = 0; i < fNHit; ++i ) {
-        if( !gone[i] ){ // unused pixel
-          for( unsigned int p = 0; p < c.vpix.size(); ++p ) { // vpix in cluster so far
-            int dr = c.vpix.at(p).row - pb[i].row;
-            int dc = c.vpix.at(p).col - pb[i].col;
-            if( (   dr>=-fCluCut) && (dr<=fCluCut) 
-		&& (dc>=-fCluCut) && (dc<=fCluCut) ) {
-              c.vpix.push_back(pb[i]);
-	      gone[i] = 1;
-              growing = 1;
-              break; // important!
-            }
-          } // loop over vpix
-        } // not gone
-      } // loop over all pix
-    }
-    while( growing );
-
-    // added all I could. determine position and append it to the list of clusters:
+    // added all I could. determine position:
 
     c.size = c.vpix.size();
     c.col = 0;
@@ -154,18 +118,7 @@ vector<cluster> getClus()
     c.ncol = maxx-minx+1;
     c.nrow = maxy-miny+1;
 
-    v.push_back(c); // add cluster to vector
-
-    // look for a new seed = used pixel:
-
-    while( (++seed < fNHit) && gone[seed] );
-
-  } // while over seeds
-
-  // nothing left, return clusters
-
-  delete gone;
-  return v;
+  } );
 }
 
 //------------------------------------------------------------------------------
@@ -373,114 +326,14 @@ int main( int argc, char* argv[] )
 
   double zz[9];
 
-  for( int ipl = 0; ipl < 9; ++ipl )
-    nx[ipl] = 0; // missing plane flag
-
-  ifstream geoFile( geoFileName );
-
   cout << endl;
 
-  if( geoFile.bad() || ! geoFile.is_open() ) {
+  if( ! readGeo( geoFileName, 0, 8,
+		 nx, ny, sizex, sizey, zz, ptchx, ptchy, midx, midy ) ) {
     cout << "Error opening " << geoFileName << endl;
     return 1;
   }
 
-  cout << "read geometry from " << geoFileName << endl;
-
-  { // open local scope
-
-    string hash( "#" );
-    string plane( "plane" );
-    string type( "type" );
-    string sizexs( "sizex" );
-    string sizeys( "sizey" );
-    string npixelx( "npixelx" );
-    string npixely( "npixely" );
-    string zpos( "zpos" );
-
-    int ipl = 0;
-    string chiptype;
-
-    while( ! geoFile.eof() ) {
-
-      string line;
-      getline( geoFile, line );
-      cout << line << endl;
-
-      if( line.empty() ) continue;
-
-      stringstream tokenizer( line );
-      string tag;
-      tokenizer >> tag; // leading white space is suppressed
-      if( tag.substr(0,1) == hash ) // comments start with #
-	continue;
-
-      if( tag == plane ) {
-	tokenizer >> ipl;
-	continue;
-      }
-
-      if( ipl < 0 || ipl >= 9 ) {
-	cout << "wrong plane number " << ipl << endl;
-	continue;
-      }
-
-      if( tag == type ) {
-	tokenizer >> chiptype;
-	continue;
-      }
-
-      if( tag == sizexs ) {
-	double val;
-	tokenizer >> val;
-	sizex[ipl] = val;
-	continue;
-      }
-
-      if( tag == sizeys ) {
-	double val;
-	tokenizer >> val;
-	sizey[ipl] = val;
-	continue;
-      }
-
-      if( tag == npixelx ) {
-	int val;
-	tokenizer >> val;
-	nx[ipl] = val;
-	continue;
-      }
-
-      if( tag == npixely ) {
-	int val;
-	tokenizer >> val;
-	ny[ipl] = val;
-	continue;
-      }
-
-      if( tag == zpos ) {
-	double val;
-	tokenizer >> val;
-	zz[ipl] = val;
-	continue;
-      }
-
-      // anything else on the line and in the file gets ignored
-
-    } // while getline
-
-    for( int ipl = 0; ipl < 9; ++ipl ) {
-      if( nx[ipl] == 0 ) continue; // missing plane flag
-      ptchx[ipl] = sizex[ipl] / nx[ipl]; // pixel size
-      ptchy[ipl] = sizey[ipl] / ny[ipl];
-      midx[ipl] = 0.5 * sizex[ipl]; // mid plane
-      midy[ipl] = 0.5 * sizey[ipl]; // mid plane
-    }
-
-  } // geo scope
-
-  geoFile.close();
-
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - 
   // Create a directory based on run number
   stringstream run_number;
@@ -499,6 +352,7 @@ int main( int argc, char* argv[] )
   int aligniteration = 0;
   double alignx[9];
   double aligny[9];
+  double alignz[9];
   double rotx[9];
   double roty[9];
 
@@ -506,74 +360,15 @@ int main( int argc, char* argv[] )
 
   alignFileName << "align_" << run << ".dat";
 
-  ifstream ialignFile( outputDirectory+"/"+alignFileName.str() );
-
   cout << endl;
 
-  if( ialignFile.bad() || ! ialignFile.is_open() ) {
+  if( ! readAlign( outputDirectory+"/"+alignFileName.str(), 0, 8,
+		   aligniteration, alignx, aligny, alignz, rotx, roty ) ) {
     cout << "Error opening " << alignFileName.str() << endl
 	 << "  please do: tele -g " << geoFileName << " " << run << endl
 	 << endl;
     return 1;
   }
-  // can there be instructions between if and else ?
-  else {
-
-    cout << "read alignment from " << alignFileName.str() << endl;
-
-    string hash( "#" );
-    string iteration( "iteration" );
-    string plane( "plane" );
-    string shiftx( "shiftx" );
-    string shifty( "shifty" );
-    string rotxvsy( "rotxvsy" );
-    string rotyvsx( "rotyvsx" );
-
-    int ipl = 0;
-
-    while( ! ialignFile.eof() ) {
-
-      string line;
-      getline( ialignFile, line );
-      cout << line << endl;
-
-      if( line.empty() ) continue;
-
-      stringstream tokenizer( line );
-      string tag;
-      tokenizer >> tag; // leading white space is suppressed
-      if( tag.substr(0,1) == hash ) // comments start with #
-	continue;
-
-      if( tag == iteration ) 
-	tokenizer >> aligniteration;
-
-      if( tag == plane )
-	tokenizer >> ipl;
-
-      if( ipl < 0 || ipl >= 9 ) {
-	cout << "wrong plane number " << ipl << endl;
-	continue;
-      }
-
-      double val;
-      tokenizer >> val;
-      if(      tag == shiftx )
-	alignx[ipl] = val;
-      else if( tag == shifty )
-	aligny[ipl] = val;
-      else if( tag == rotxvsy )
-	rotx[ipl] = val;
-      else if( tag == rotyvsx )
-	roty[ipl] = val;
-
-      // anything else on the line and in the file gets ignored
-
-    } // while getline
-
-  } // alignFile
-
-  ialignFile.close();
 
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
   // hot pixels:
@@ -582,58 +377,10 @@ int main( int argc, char* argv[] )
 
   hotFileName << "hot_" << run << ".dat";
 
-  ifstream ihotFile( outputDirectory+"/"+hotFileName.str() );
-
   set <int> hotset[9];
 
-  if( ihotFile.bad() || ! ihotFile.is_open() ) {
+  if( ! readHotPixels( outputDirectory+"/"+hotFileName.str(), ny, hotset, 0, 5 ) )
     cout << "no " << hotFileName.str() << " (created by tele)" << endl;
-  }
-  else {
-
-    cout << "read hot pixel list from " << hotFileName.str() << endl;
-
-    string hash( "#" );
-    string plane( "plane" );
-    string pix( "pix" );
-
-    int ipl = 0;
-
-    while( ! ihotFile.eof() ) {
-
-      string line;
-      getline( ihotFile, line );
-      cout << line << endl;
-
-      if( line.empty() ) continue;
-
-      stringstream tokenizer( line );
-      string tag;
-      tokenizer >> tag; // leading white space is suppressed
-      if( tag.substr(0,1) == hash ) // comments start with #
-	continue;
-
-      if( tag == plane )
-	tokenizer >> ipl;
-
-      if( ipl < 0 || ipl >= 6 ) {
-	//cout << "wrong plane number " << ipl << endl;
-	continue;
-      }
-
-      if( tag == pix ) {
-	int ix, iy;
-	tokenizer >> ix;
-	tokenizer >> iy;
-	int ipx = ix*ny[ipl]+iy;
-	hotset[ipl].insert(ipx);
-      }
-
-    } // while getline
-
-  } // hotFile
-
-  ihotFile.close();
 
   for( int ipl = 0; ipl < 6; ++ipl )
     cout << ipl << ": hot " << hotset[ipl].size() << endl;
@@ -674,65 +421,11 @@ int main( int argc, char* argv[] )
 
   DUTalignFileName << "alignDUT_" << run << ".dat";
 
-  ifstream iDUTalignFile( outputDirectory+"/"+DUTalignFileName.str() );
-
   cout << endl;
 
-  if( iDUTalignFile.bad() || ! iDUTalignFile.is_open() ) {
+  if( ! readDUTAlign( outputDirectory+"/"+DUTalignFileName.str(), DUTaligniteration,
+		      DUTalignx, DUTaligny, DUTrot, DUTtilt, DUTturn, DUTz, zz[2] ) )
     cout << "no " << DUTalignFileName.str() << ", will bootstrap" << endl;
-  }
-  else {
-
-    cout << "read DUTalignment from " << DUTalignFileName.str() << endl;
-
-    string hash( "#" );
-    string iteration( "iteration" );
-    string alignx( "alignx" );
-    string aligny( "aligny" );
-    string rot( "rot" );
-    string tilt( "tilt" );
-    string turn( "turn" );
-    string dz( "dz" );
-
-    while( ! iDUTalignFile.eof() ) {
-
-      string line;
-      getline( iDUTalignFile, line );
-      cout << line << endl;
-
-      if( line.empty() ) continue;
-
-      stringstream tokenizer( line );
-      string tag;
-      tokenizer >> tag; // leading white space is suppressed
-      if( tag.substr(0,1) == hash ) // comments start with #
-	continue;
-
-      if( tag == iteration ) 
-	tokenizer >> DUTaligniteration;
-
-      double val;
-      tokenizer >> val;
-      if(      tag == alignx )
-	DUTalignx = val;
-      else if( tag == aligny )
-	DUTaligny = val;
-      else if( tag == rot )
-	DUTrot = val;
-      else if( tag == tilt )
-	DUTtilt = val;
-      else if( tag == turn )
-	DUTturn = val;
-      else if( tag == dz )
-	DUTz = val + zz[2];
-
-      // anything else on the line and in the file gets ignored
-
-    } // while getline
-
-  } // alignFile
-
-  iDUTalignFile.close();
 
   if( DUTaligniteration == 0 )
     DUTtilt = DUTtilt0; // from runs.dat
@@ -771,59 +464,13 @@ int main( int argc, char* argv[] )
 
   REFalignFileName << "alignREF_" << run << ".dat";
 
-  ifstream iREFalignFile( outputDirectory+"/"+REFalignFileName.str() );
-
   cout << endl;
 
-  if( iREFalignFile.bad() || ! iREFalignFile.is_open() ) {
-    cout << "no " << REFalignFileName.str() << ", will bootstrap" << endl;
-  }
-  else {
-
-    cout << "read REFalignment from " << REFalignFileName.str() << endl;
-
-    string hash( "#" );
-    string iteration( "iteration" );
-    string alignx( "alignx" );
-    string aligny( "aligny" );
-    string rot( "rot" );
-    string dz( "dz" );
-
-    while( ! iREFalignFile.eof() ) {
-
-      string line;
-      getline( iREFalignFile, line );
-      cout << line << endl;
-
-      if( line.empty() ) continue;
-
-      stringstream tokenizer( line );
-      string tag;
-      tokenizer >> tag; // leading white space is suppressed
-      if( tag.substr(0,1) == hash ) // comments start with #
-	continue;
-
-      if( tag == iteration ) 
-	tokenizer >> REFaligniteration;
-
-      double val;
-      tokenizer >> val;
-      if(      tag == alignx )
-	REFalignx = val;
-      else if( tag == aligny )
-	REFaligny = val;
-      else if( tag == rot )
-	REFrot = val;
-      else if( tag == dz )
-	REFz = val + zz[5];
-
-      // anything else on the line and in the file gets ignored
-
-    } // while getline
-
-  } // alignFile
+  double REFtilt = 0, REFturn = 0; // not in the REF file
 
-  iREFalignFile.close();
+  if( ! readDUTAlign( outputDirectory+"/"+REFalignFileName.str(), REFaligniteration,
+		      REFalignx, REFaligny, REFrot, REFtilt, REFturn, REFz, zz[5] ) )
+    cout << "no " << REFalignFileName.str() << ", will bootstrap" << endl;
 
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
   // MOD:
@@ -842,65 +489,11 @@ int main( int argc, char* argv[] )
 
   MODalignFileName << "alignMOD_" << run << ".dat";
 
-  ifstream iMODalignFile( outputDirectory+"/"+MODalignFileName.str() );
-
   cout << endl;
 
-  if( iMODalignFile.bad() || ! iMODalignFile.is_open() ) {
+  if( ! readDUTAlign( outputDirectory+"/"+MODalignFileName.str(), MODaligniteration,
+		      MODalignx, MODaligny, MODrot, MODtilt, MODturn, MODz, zz[4] ) )
     cout << "no " << MODalignFileName.str() << ", will bootstrap" << endl;
-  }
-  else {
-
-    cout << "read MODalignment from " << MODalignFileName.str() << endl;
-
-    string hash( "#" );
-    string iteration( "iteration" );
-    string alignx( "alignx" );
-    string aligny( "aligny" );
-    string rot( "rot" );
-    string tilt( "tilt" );
-    string turn( "turn" );
-    string dz( "dz" );
-
-    while( ! iMODalignFile.eof() ) {
-
-      string line;
-      getline( iMODalignFile, line );
-      cout << line << endl;
-
-      if( line.empty() ) continue;
-
-      stringstream tokenizer( line );
-      string tag;
-      tokenizer >> tag; // leading white space is suppressed
-      if( tag.substr(0,1) == hash ) // comments start with #
-	continue;
-
-      if( tag == iteration ) 
-	tokenizer >> MODaligniteration;
-
-      double val;
-      tokenizer >> val;
-      if(      tag == alignx )
-	MODalignx = val;
-      else if( tag == aligny )
-	MODaligny = val;
-      else if( tag == rot )
-	MODrot = val;
-      else if( tag == tilt )
-	MODtilt = val;
-      else if( tag == turn )
-	MODturn = val;
-      else if( tag == dz )
-	MODz = val + zz[4];
-
-      // anything else on the line and in the file gets ignored
-
-    } // while getline
-
-  } // alignFile
-
-  iMODalignFile.close();
 
   // normal vector on MOD surface:
   // N = ( 0, 0, -1 ) on MOD, towards -z
@@ -2065,6 +1658,10 @@ int main( int argc, char* argv[] )
   else if( refchip0 == 501 )
     refke = 0.305;
 
+  StageProf prof( "scope" );
+  prof.setRun( run );
+  prof.mark( "setup" );
+
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
   // (re-)create root file:
 
@@ -3294,6 +2891,16 @@ int main( int argc, char* argv[] )
 	      "DUT efficiency vs driplet isolation;driplet isolation [mm];efficiency",
 	      80, 0, 8, -1, 2 );
 
+  prof.mark( "histos" );
+
+  int sdecode = prof.stage( "decode" );
+  int sclus = prof.stage( "clustering" );
+  int sdri = prof.stage( "driplets" );
+  int strip = prof.stage( "triplets" );
+  int smatch = prof.stage( "matching" );
+  int soutput = prof.stage( "output" );
+  int salign = prof.stage( "alignment" );
+
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
   // event loop:
 
@@ -3319,6 +2926,9 @@ int main( int argc, char* argv[] )
   vector <cluster> cl0[9]; // remember from previous event
 
   do {
+
+    prof.lap( sdecode );
+
     // Get next event:
     DetectorEvent evt = reader->GetDetectorEvent();
 
@@ -3549,7 +3159,9 @@ int main( int argc, char* argv[] )
 
       fNHit = npx; // for cluster search
 
+      prof.lap( sclus );
       cl[ipl] = getClus();
+      prof.lap( sdecode );
 
       if( ldbg ) cout << "clusters " << cl[ipl].size() << endl;
 
@@ -3583,6 +3195,8 @@ int main( int argc, char* argv[] )
     // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
     // make driplets 3+5-4:
 
+    prof.lap( sdri );
+
     vector <triplet> driplets;
     vector <triplet> dripletsmod;
 
@@ -4107,6 +3721,8 @@ int main( int argc, char* argv[] )
     // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
     // make triplets 2+0-1:
 
+    prof.lap( strip );
+
     vector <triplet> triplets;
 
     double triCut = 0.1; // [mm]
@@ -4229,6 +3845,10 @@ int main( int argc, char* argv[] )
     // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
     // triplets:
 
+    prof.lap( smatch );
+    prof.count( "triplets", triplets.size() );
+    prof.count( "driplets", driplets.size() );
+
     double xcut = 0.4;
     double ycut = 0.2;
 
@@ -5088,6 +4708,8 @@ int main( int argc, char* argv[] )
 
     ++event_nr;
 
+    prof.endEvent();
+
     if( syncdut )
       cl0[iDUT] = cl[iDUT]; // remember for re-sync
     if( syncref )
@@ -5098,8 +4720,12 @@ int main( int argc, char* argv[] )
   } while( reader->NextEvent() && event_nr < lev );
 
   cout << "done after " << event_nr << " events" << endl;
+  prof.start( soutput );
   histoFile->Write();
   histoFile->Close();
+  prof.stop( soutput );
+
+  prof.start( salign );
 
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
   // MOD alignment:
@@ -5623,9 +5249,14 @@ int main( int argc, char* argv[] )
        << " to " << DUTalignFileName.str()
        << endl;
 
+  prof.stop( salign );
+
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
   // done
 
+  prof.report( cout );
+  prof.write( StageProf::fileNameFor( rootFileName.str() ) );
+
   cout << endl << histoFile->GetName() << endl;
 
   if(useMODasREF)  cout << "Using MOD for efficiency " << endl;
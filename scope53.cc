@@ -28,6 +28,9 @@
 #include <set>
 #include <cmath>
 
+#include "telecore.h" // clustering, hot pixels
+#include "stageprof.h"
+
 using namespace std;
 using namespace eudaq;
 
@@ -67,45 +70,7 @@ vector <cluster> getClusn( vector <pixel> pb, int fCluCut = 1 ) // 1 = no gap
   // returns clusters with pixel coordinates
   // next-neighbour topological clustering (allows fCluCut-1 empty pixels)
 
-  vector <cluster> vc;
-  if( pb.size() == 0 ) return vc;
-
-  int* gone = new int[pb.size()];
-  for( unsigned i = 0; i < pb.size(); ++i )
-    gone[i] = 0;
-
-  unsigned seed = 0;
-
-  while( seed < pb.size() ) {
-
-    // start a new cluster
-
-    cluster c;
-    c.vpix.push_back( pb[seed] );
-    gone[seed] = 1;
-
-    // let it grow as much as possible:
-
-    int growing;
-    do {
-      growing = 0;
-      for( unsigned i = 0; i < pb.size(); ++i ) {
-        if( !gone[i] ){ // unused pixel
-          for( unsigned int p = 0; p < c.vpix.size(); ++p ) { // vpix in cluster so far
-            int dr = c.vpix.at(p).row - pb[i].row;
-            int dc = c.vpix.at(p).col - pb[i].col;
-            if( (   dr>=-fCluCut) && (dr<=fCluCut) 
-		&& (dc>=-fCluCut) && (dc<=fCluCut) ) {
-              c.vpix.push_back(pb[i]);
-	      gone[i] = 1;
-              growing = 1;
-              break; // important!
-            }
-          } // loop over vpix
-        } // not gone
-      } // loop over all pix
-    }
-    while( growing );
+  return clusterPixels<cluster>( pb, NearSquare( fCluCut ), []( cluster & c ) {
 
     // count pixel neighbours:
 
@@ -119,7 +84,7 @@ vector <cluster> getClusn( vector <pixel> pb, int fCluCut = 1 ) // 1 = no gap
 	}
     }
 
-    // added all I could. determine position and append it to the list of clusters:
+    // added all I could. determine position:
 
     c.size = c.vpix.size();
     c.col = 0;
@@ -158,17 +123,7 @@ vector <cluster> getClusn( vector <pixel> pb, int fCluCut = 1 ) // 1 = no gap
     c.nfrm = maxf-minf+1;
     c.mindxy = 999;
 
-    vc.push_back(c); // add cluster to vector
-
-    // look for a new seed = used pixel:
-
-    while( ( ++seed < pb.size() ) && gone[seed] );
-
-  } // while over seeds
-
-  delete[] gone;
-
-  return vc; // vector of clusters
+  } );
 }
 
 //------------------------------------------------------------------------------
@@ -177,47 +132,9 @@ vector <cluster> getClusq( vector <pixel> pb, int fCluCut = 1 ) // 1 = no gap
   // returns clusters with pixel coordinates
   // next-neighbour topological clustering (allows fCluCut-1 empty pixels)
 
-  vector <cluster> vc;
-  if( pb.size() == 0 ) return vc;
-
-  int* gone = new int[pb.size()];
-  for( unsigned i = 0; i < pb.size(); ++i )
-    gone[i] = 0;
-
-  unsigned seed = 0;
-
-  while( seed < pb.size() ) {
-
-    // start a new cluster
-
-    cluster c;
-    c.vpix.push_back( pb[seed] );
-    gone[seed] = 1;
-
-    // let it grow as much as possible:
-
-    int growing;
-    do {
-      growing = 0;
-      for( unsigned i = 0; i < pb.size(); ++i ) {
-        if( !gone[i] ){ // unused pixel
-          for( unsigned int p = 0; p < c.vpix.size(); ++p ) { // vpix in cluster so far
-            int dr = c.vpix.at(p).row - pb[i].row;
-            int dc = c.vpix.at(p).col - pb[i].col;
-            if( (   dr>=-fCluCut) && (dr<=fCluCut) 
-		&& (dc>=-fCluCut) && (dc<=fCluCut) ) {
-              c.vpix.push_back(pb[i]);
-	      gone[i] = 1;
-              growing = 1;
-              break; // important!
-            }
-          } // loop over vpix
-        } // not gone
-      } // loop over all pix
-    }
-    while( growing );
+  return clusterPixels<cluster>( pb, NearSquare( fCluCut ), []( cluster & c ) {
 
-    // added all I could. determine position and append it to the list of clusters:
+    // added all I could. determine position:
 
     c.size = c.vpix.size();
     c.col = 0;
@@ -266,17 +183,7 @@ vector <cluster> getClusq( vector <pixel> pb, int fCluCut = 1 ) // 1 = no gap
     c.nfrm = maxf-minf+1;
     c.mindxy = 999;
 
-    vc.push_back(c); // add cluster to vector
-
-    // look for a new seed = used pixel:
-
-    while( ( ++seed < pb.size() ) && gone[seed] );
-
-  } // while over seeds
-
-  delete gone;
-
-  return vc; // vector of clusters
+  } );
 }
 
 //------------------------------------------------------------------------------
@@ -439,118 +346,14 @@ int main( int argc, char* argv[] )
 
   double zz[9];
 
-  for( int ipl = 0; ipl < 9; ++ipl )
-    nx[ipl] = 0; // missing plane flag
-
-  ifstream geoFile( geoFileName );
-
   cout << endl;
 
-  if( geoFile.bad() || ! geoFile.is_open() ) {
+  if( ! readGeo( geoFileName, 0, 8,
+		 nx, ny, sizex, sizey, zz, ptchx, ptchy, midx, midy ) ) {
     cout << "Error opening " << geoFileName << endl;
     return 1;
   }
 
-  cout << "read geometry from " << geoFileName << endl;
-
-  { // open local scope
-
-    string hash( "#" );
-    string plane( "plane" );
-    string type( "type" );
-    string sizexs( "sizex" );
-    string sizeys( "sizey" );
-    string npixelx( "npixelx" );
-    string npixely( "npixely" );
-    string zpos( "zpos" );
-
-    int ipl = 0;
-    string chiptype;
-
-    while( ! geoFile.eof() ) {
-
-      string line;
-      getline( geoFile, line );
-      cout << line << endl;
-
-      if( line.empty() ) continue;
-
-      istringstream tokenizer( line );
-      string tag;
-      tokenizer >> tag; // leading white space is suppressed
-      if( tag.substr(0,1) == hash ) // comments start with #
-	continue;
-
-      if( tag == plane ) {
-	tokenizer >> ipl;
-	continue;
-      }
-
-      if( ipl < 0 || ipl > 8 ) {
-	cout << "geo wrong plane number " << ipl << endl;
-	continue;
-      }
-
-      if( tag == type ) {
-	tokenizer >> chiptype;
-	continue;
-      }
-
-      if( tag == sizexs ) {
-	double val;
-	tokenizer >> val;
-	sizex[ipl] = val;
-	continue;
-      }
-
-      if( tag == sizeys ) {
-	double val;
-	tokenizer >> val;
-	sizey[ipl] = val;
-	continue;
-      }
-
-      if( tag == npixelx ) {
-	int val;
-	tokenizer >> val;
-	nx[ipl] = val;
-	continue;
-      }
-
-      if( tag == npixely ) {
-	int val;
-	tokenizer >> val;
-	ny[ipl] = val;
-	continue;
-      }
-
-      if( tag == zpos ) {
-	double val;
-	tokenizer >> val;
-	zz[ipl] = val;
-	continue;
-      }
-
-      // anything else on the line and in the file gets ignored
-
-    } // while getline
-
-    for( int ipl = 0; ipl < 9; ++ipl ) {
-      if( nx[ipl] == 0 ) continue; // missing plane flag
-      ptchx[ipl] = sizex[ipl] / nx[ipl]; // pixel size
-      ptchy[ipl] = sizey[ipl] / ny[ipl];
-      midx[ipl] = 0.5 * sizex[ipl]; // mid of plane
-      midy[ipl] = 0.5 * sizey[ipl]; // mid of plane
-    }
-
-  } // geo scope
-
-  cout << endl;
-  for( int ipl = 1; ipl <= 6; ++ipl )
-    cout << ipl << " zz " << zz[ipl] << endl;
-
-  geoFile.close();
-
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
   // read Mimosa telescope alignment:
 
@@ -565,81 +368,24 @@ int main( int argc, char* argv[] )
 
   alignFileName << "align_" << run << ".dat";
 
-  ifstream ialignFile( alignFileName.str() );
-
   cout << endl;
 
-  if( ialignFile.bad() || ! ialignFile.is_open() ) {
+  if( ! readAlign( alignFileName.str(), 1, 6,
+		   aligniteration, alignx, aligny, alignz, rotx, roty ) ) {
     cout << "Error opening " << alignFileName.str() << endl
 	 << "  please do: tele -g " << geoFileName << " " << run << endl
 	 << endl;
     return 1;
   }
-  else {
-
-    cout << "read alignment from " << alignFileName.str() << endl;
-
-    string hash( "#" );
-    string iteration( "iteration" );
-    string plane( "plane" );
-    string shiftx( "shiftx" );
-    string shifty( "shifty" );
-    string shiftz( "shiftz" );
-    string rotxvsy( "rotxvsy" );
-    string rotyvsx( "rotyvsx" );
-
-    int ipl = 1;
-
-    while( ! ialignFile.eof() ) {
-
-      string line;
-      getline( ialignFile, line );
-      cout << line << endl;
-
-      if( line.empty() ) continue;
-
-      istringstream tokenizer( line );
-      string tag;
-      tokenizer >> tag; // leading white space is suppressed
-      if( tag.substr(0,1) == hash ) // comments start with #
-	continue;
-
-      if( tag == iteration ) 
-	tokenizer >> aligniteration;
-
-      if( tag == plane )
-	tokenizer >> ipl;
-
-      if( ipl < 1 || ipl > 6 ) { // Mimosa
-	cout << "align wrong plane number " << ipl << endl;
-	continue;
-      }
-
-      double val;
-      tokenizer >> val;
-      if(      tag == shiftx )
-	alignx[ipl] = val;
-      else if( tag == shifty )
-	aligny[ipl] = val;
-      else if( tag == shiftz )
-	alignz[ipl] = val;
-      else if( tag == rotxvsy )
-	rotx[ipl] = val;
-      else if( tag == rotyvsx )
-	roty[ipl] = val;
-
-      // anything else on the line and in the file gets ignored
-
-    } // while getline
-
-  } // alignFile
-
-  ialignFile.close();
 
   cout << endl;
   for( int ipl = 1; ipl <= 6; ++ipl )
     cout << ipl << " alignz " << alignz[ipl] << endl;
 
+  StageProf prof( "scope53" );
+  prof.setRun( run );
+  prof.mark( "setup" );
+
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
   // (re-)create root file:
 
@@ -656,60 +402,12 @@ int main( int argc, char* argv[] )
 
   hotFileName << "hot_" << run << ".dat";
 
-  ifstream ihotFile( hotFileName.str() );
-
   set <int> hotset[9];
 
   cout << endl;
 
-  if( ihotFile.bad() || ! ihotFile.is_open() ) {
+  if( ! readHotPixels( hotFileName.str(), ny, hotset, 1, 6 ) )
     cout << "no " << hotFileName.str() << " (created by tele)" << endl;
-  }
-  else {
-
-    cout << "read hot pixel list from " << hotFileName.str() << endl;
-
-    string hash( "#" );
-    string plane( "plane" );
-    string pix( "pix" );
-
-    int ipl = 0;
-
-    while( ! ihotFile.eof() ) {
-
-      string line;
-      getline( ihotFile, line );
-      //cout << line << endl;
-
-      if( line.empty() ) continue;
-
-      istringstream tokenizer( line );
-      string tag;
-      tokenizer >> tag; // leading white space is suppressed
-      if( tag.substr(0,1) == hash ) // comments start with #
-	continue;
-
-      if( tag == plane )
-	tokenizer >> ipl;
-
-      if( ipl < 1 || ipl > 6 ) { // Mimosa
-	cout << "hot wrong plane number " << ipl << endl;
-	continue;
-      }
-
-      if( tag == pix ) {
-	int ix, iy;
-	tokenizer >> ix;
-	tokenizer >> iy;
-	int ipx = ix*ny[ipl]+iy;
-	hotset[ipl].insert(ipx);
-      }
-
-    } // while getline
-
-  } // hotFile
-
-  ihotFile.close();
 
   for( int ipl = 0; ipl <= 6; ++ipl )
     cout << "  plane " << ipl << ": hot " << hotset[ipl].size() << endl;
@@ -734,65 +432,11 @@ int main( int argc, char* argv[] )
 
   DUTalignFileName << "alignDUT_" << run << ".dat";
 
-  ifstream iDUTalignFile( DUTalignFileName.str() );
-
   cout << endl;
 
-  if( iDUTalignFile.bad() || ! iDUTalignFile.is_open() ) {
+  if( ! readDUTAlign( DUTalignFileName.str(), DUTaligniteration,
+		      DUTalignx, DUTaligny, DUTrot, DUTtilt, DUTturn, DUTz, zz[3] ) )
     cout << "no " << DUTalignFileName.str() << ", will bootstrap" << endl;
-  }
-  else {
-
-    cout << "read DUTalignment from " << DUTalignFileName.str() << endl;
-
-    string hash( "#" );
-    string iteration( "iteration" );
-    string alignx( "alignx" );
-    string aligny( "aligny" );
-    string rot( "rot" );
-    string tilt( "tilt" );
-    string turn( "turn" );
-    string dz( "dz" );
-
-    while( ! iDUTalignFile.eof() ) {
-
-      string line;
-      getline( iDUTalignFile, line );
-      cout << line << endl;
-
-      if( line.empty() ) continue;
-
-      istringstream tokenizer( line );
-      string tag;
-      tokenizer >> tag; // leading white space is suppressed
-      if( tag.substr(0,1) == hash ) // comments start with #
-	continue;
-
-      if( tag == iteration ) 
-	tokenizer >> DUTaligniteration;
-
-      double val;
-      tokenizer >> val;
-      if(      tag == alignx )
-	DUTalignx = val;
-      else if( tag == aligny )
-	DUTaligny = val;
-      else if( tag == rot )
-	DUTrot = val;
-      else if( tag == tilt )
-	DUTtilt = val;
-      else if( tag == turn )
-	DUTturn = val;
-      else if( tag == dz )
-	DUTz = val + zz[3];
-
-      // anything else on the line and in the file gets ignored
-
-    } // while getline
-
-  } // alignFile
-
-  iDUTalignFile.close();
 
   double DUTalignx0 = DUTalignx; // at time 0
   double DUTaligny0 = DUTaligny;
@@ -966,65 +610,11 @@ int main( int argc, char* argv[] )
 
   MODalignFileName << "alignMOD_" << run << ".dat";
 
-  ifstream iMODalignFile( MODalignFileName.str() );
-
   cout << endl;
 
-  if( iMODalignFile.bad() || ! iMODalignFile.is_open() ) {
+  if( ! readDUTAlign( MODalignFileName.str(), MODaligniteration,
+		      MODalignx, MODaligny, MODrot, MODtilt, MODturn, MODz, zz[5] ) )
     cout << "no " << MODalignFileName.str() << ", will bootstrap" << endl;
-  }
-  else {
-
-    cout << "read MODalignment from " << MODalignFileName.str() << endl;
-
-    string hash( "#" );
-    string iteration( "iteration" );
-    string alignx( "alignx" );
-    string aligny( "aligny" );
-    string rot( "rot" );
-    string tilt( "tilt" );
-    string turn( "turn" );
-    string dz( "dz" );
-
-    while( ! iMODalignFile.eof() ) {
-
-      string line;
-      getline( iMODalignFile, line );
-      cout << line << endl;
-
-      if( line.empty() ) continue;
-
-      istringstream tokenizer( line );
-      string tag;
-      tokenizer >> tag; // leading white space is suppressed
-      if( tag.substr(0,1) == hash ) // comments start with #
-	continue;
-
-      if( tag == iteration ) 
-	tokenizer >> MODaligniteration;
-
-      double val;
-      tokenizer >> val;
-      if(      tag == alignx )
-	MODalignx = val;
-      else if( tag == aligny )
-	MODaligny = val;
-      else if( tag == rot )
-	MODrot = val;
-      else if( tag == tilt )
-	MODtilt = val;
-      else if( tag == turn )
-	MODturn = val;
-      else if( tag == dz )
-	MODz = val + zz[5];
-
-      // anything else on the line and in the file gets ignored
-
-    } // while getline
-
-  } // alignFile
-
-  iMODalignFile.close();
 
   // normal vector on MOD surface:
   // N = ( 0, 0, -1 ) on MOD, towards -z
@@ -2394,6 +1984,16 @@ int main( int argc, char* argv[] )
   TH1I ntrilkHisto( "ntrilk", "track - DUT links;track - DUT links;tracks",
 		    11, -0.5, 10.5 );
 
+  prof.mark( "histos" );
+
+  int sdecode = prof.stage( "decode" );
+  int sclus = prof.stage( "clustering" );
+  int sdri = prof.stage( "driplets" );
+  int strip = prof.stage( "triplets" );
+  int smatch = prof.stage( "matching" );
+  int soutput = prof.stage( "output" );
+  int salign = prof.stage( "alignment" );
+
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
   // event loop:
 
@@ -2419,6 +2019,9 @@ int main( int argc, char* argv[] )
   uint64_t prevTLU = 0;
 
   do {
+
+    prof.lap( sdecode );
+
     // Get next event:
     DetectorEvent evt = reader->GetDetectorEvent();
 
@@ -2613,10 +2216,12 @@ int main( int argc, char* argv[] )
 
       // clustering:
 
+      prof.lap( sclus );
       if( ipl == iDUT )
 	cl[ipl] = getClusq( pb );
       else
 	cl[ipl] = getClusn( pb );
+      prof.lap( sdecode );
 
       if( ldbg ) cout << "    clusters " << cl[ipl].size() << endl;
 
@@ -2913,8 +2518,10 @@ int main( int argc, char* argv[] )
 
       hnpx[iMOD].Fill( pb.size() );
 
+      prof.lap( sclus );
       if( !ierr )
 	cl[iMOD] = getClusq( pb );
+      prof.lap( sdecode );
 
       hncl[iMOD].Fill( cl[iMOD].size() );
 
@@ -2937,6 +2544,8 @@ int main( int argc, char* argv[] )
     // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
     // make driplets 4+6-5:
 
+    prof.lap( sdri );
+
     vector <triplet> driplets;
 
     //double driCut = 0.1; // [mm]
@@ -3243,6 +2852,8 @@ int main( int argc, char* argv[] )
     // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
     // make triplets 1+3-2:
 
+    prof.lap( strip );
+
     vector <triplet> triplets;
 
     //double triCut = 0.1; // [mm]
@@ -3500,6 +3111,10 @@ int main( int argc, char* argv[] )
     // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
     // triplets vs DUT:
 
+    prof.lap( smatch );
+    prof.count( "triplets", triplets.size() );
+    prof.count( "driplets", driplets.size() );
+
     int nmtd = 0;
     int ntrilk = 0;
     int nsix = 0;
@@ -4533,13 +4148,19 @@ int main( int argc, char* argv[] )
 
     ++iev;
 
+    prof.endEvent();
+
   } while( reader->NextEvent() && iev < lev );
 
   delete reader;
 
   cout << "done after " << iev << " events" << endl;
+  prof.start( soutput );
   histoFile.Write();
   //histoFile.Close();
+  prof.stop( soutput );
+
+  prof.start( salign );
 
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
   // MOD alignment:
@@ -5219,9 +4840,14 @@ int main( int argc, char* argv[] )
   else
     cout << "no" << endl;
 
+  prof.stop( salign );
+
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
   // done
 
+  prof.report( cout );
+  prof.write( StageProf::fileNameFor( rootFileName.str() ) );
+
   cout << endl << histoFile.GetName() << endl;
 
   cout << endl;
@@ -0,0 +1,189 @@
+// scope53clus.h
+// RD53A pixels, clusters and triplets of scope53m, the ToT calibration
+// curve and the two cluster positions: one copy, used by scope53m and
+// timed by kernbench. The grouping is clusterPixels of telecore.h.
+
+// using namespace s53;
+// vector <cluster> vcl = getClusq( pb ); // charge weighted
+// vector <cluster> vcl = getClusn( pb ); // neighbour weighted, tot is overwritten
+// int vcal = __calcurve( a, b, c, t, tot );
+
+#ifndef SCOPE53CLUS_H
+#define SCOPE53CLUS_H
+
+#include <vector>
+#include <cmath>
+#include <cstdlib> // abs
+#include <algorithm> // max
+#include <iostream>
+
+#include "telecore.h"
+
+namespace s53 {
+
+struct pixel {
+  int col;
+  int row;
+  int tot;
+  int frm;
+  bool pivot;
+};
+
+struct cluster {
+  std::vector <pixel> vpix; // Armin Burgmeier: list
+  int size;
+  int ncol, nrow, nfrm;
+  double col, row;
+  int signal;
+  double mindxy;
+};
+
+struct triplet {
+  double xm;
+  double ym;
+  double zm;
+  double sx;
+  double sy;
+  bool lk;
+  double ttdmin;
+  unsigned iA;
+  unsigned iB;
+  unsigned iC;
+};
+
+//------------------------------------------------------------------------------
+// Calibration response function: https://cds.cern.ch/record/2649493/files/CLICdp-Note-2018-008.pdf
+// ToT( vcal ) = a vcal + b - \frac{c}{vcal-t}
+// Inverse: 
+// vcal (ToT ) = (a*t + ToT -b +sqrt((b+a*t-ToT)^2+4*a*c))/(2*a)
+// The actual function
+inline int __calcurve(float a,float b,float c,float t, int ToT)
+{ 
+   return std::round((a*t + ToT -b + std::sqrt(std::pow(b+a*t-ToT,2.0)+4.0*a*c))/(2.*a));
+}
+
+//------------------------------------------------------------------------------
+inline std::vector <cluster> getClusn( std::vector <pixel> pb, int fCluCut = 1 ) // 1 = no gap
+{
+  // returns clusters with pixel coordinates
+  // next-neighbour topological clustering (allows fCluCut-1 empty pixels)
+
+  return clusterPixels<cluster>( pb, NearSquare( fCluCut ), []( cluster & c ) {
+
+    // count pixel neighbours:
+
+    for( std::vector <pixel>::iterator p = c.vpix.begin(); p != c.vpix.end(); ++p ) {
+      std::vector <pixel>::iterator q = p;
+      ++q;
+      for( ; q != c.vpix.end(); ++q )
+	if( std::abs( p->col - q->col ) <= 1 &&std::abs( p->row - q->row ) <= 1 ) {
+	  ++p->tot;
+	  ++q->tot;
+	}
+    }
+
+    // added all I could. determine position:
+
+    c.size = c.vpix.size();
+    c.col = 0;
+    c.row = 0;
+    double sumnn = 0;
+    int minx = 999;
+    int maxx = 0;
+    int miny = 999;
+    int maxy = 0;
+    int minf = 999;
+    int maxf = 0;
+
+    for( std::vector<pixel>::iterator p = c.vpix.begin(); p != c.vpix.end(); ++p ) {
+
+      int nn = std::max( 1, p->tot ); // neighbours
+      sumnn += nn;
+      c.col += p->col * nn;
+      c.row += p->row * nn;
+
+      if( p->col > maxx ) maxx = p->col;
+      if( p->col < minx ) minx = p->col;
+      if( p->row > maxy ) maxy = p->row;
+      if( p->row < miny ) miny = p->row;
+      if( p->frm > maxf ) maxf = p->frm;
+      if( p->frm < minf ) minf = p->frm;
+
+    }
+
+    //std::cout << "(cluster with " << c.vpix.size() << " pixels)" << std::endl;
+
+    c.col /= sumnn;
+    c.row /= sumnn;
+    c.signal = sumnn;
+    c.ncol = maxx-minx+1;
+    c.nrow = maxy-miny+1;
+    c.nfrm = maxf-minf+1;
+    c.mindxy = 999;
+
+  } );
+} // getclusn
+
+//------------------------------------------------------------------------------
+inline std::vector <cluster> getClusq( std::vector <pixel> pb, int fCluCut = 1 ) // 1 = no gap
+{
+  // returns clusters with pixel coordinates
+  // next-neighbour topological clustering (allows fCluCut-1 empty pixels)
+
+  return clusterPixels<cluster>( pb, NearSquare( fCluCut ), []( cluster & c ) {
+
+    // added all I could. determine position:
+
+    c.size = c.vpix.size();
+    c.col = 0;
+    c.row = 0;
+    double sumQ = 0;
+    int minx = 999;
+    int maxx = 0;
+    int miny = 999;
+    int maxy = 0;
+    int minf = 999;
+    int maxf = 0;
+
+    for( std::vector<pixel>::iterator p = c.vpix.begin(); p != c.vpix.end(); ++p ) {
+
+      double Qpix = p->tot;
+
+      sumQ += Qpix;
+
+      c.col += p->col*Qpix;
+      c.row += p->row*Qpix;
+
+      if( p->col > maxx ) maxx = p->col;
+      if( p->col < minx ) minx = p->col;
+      if( p->row > maxy ) maxy = p->row;
+      if( p->row < miny ) miny = p->row;
+      if( p->frm > maxf ) maxf = p->frm;
+      if( p->frm < minf ) minf = p->frm;
+
+    }
+
+    //std::cout << "(cluster with " << c.vpix.size() << " pixels)" << std::endl;
+
+    if( sumQ > 0 ) {
+      c.col /= sumQ;
+      c.row /= sumQ;
+    }
+    else {
+      c.col = (*c.vpix.begin()).col;
+      c.row = (*c.vpix.begin()).row;
+      std::cout << "GetClus: cluster with signal" << sumQ << std::endl;
+    }
+
+    c.signal = sumQ;
+    c.ncol = maxx-minx+1;
+    c.nrow = maxy-miny+1;
+    c.nfrm = maxf-minf+1;
+    c.mindxy = 999;
+
+  } );
+} // getclusq
+
+} // s53
+
+#endif
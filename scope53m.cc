@@ -12,6 +12,9 @@
 // uses hot_33485.dat from tele
 // uses alignDUT_33485.dat
 // uses alignMOD_33485.dat
+// scope53m -F 30 33095: follow the raw file during the run, write the root file every 30 s
+// scope53m -a 33095-33110,33120: several runs in one process, DUT gains loaded once
+// OMP_NUM_THREADS=1 scope53m 33095: one worker for clustering and triplets
 //
 // ##########################################
 // Adding DUT calibration (RD53A with BDAQ53)
@@ -41,39 +44,22 @@
 #include <unordered_map>
 #include <stdexcept>
 #include <memory>
+#include <algorithm> // find
+
+#include "planealign.h"
+#include "gridindex.h"
+#include "histshard.h"
+#include "follow.h"
+#include "stageprof.h"
+#include "simconv.h" // synthetic runs from simraw
+#include "multirun.h"
+#include "telecore.h" // clustering, hot pixels, triplets
+#include "scope53clus.h" // pixel, cluster, triplet, calibration curve
+#include "zscan.h"
 
 using namespace std;
 using namespace eudaq;
-
-struct pixel {
-  int col;
-  int row;
-  int tot;
-  int frm;
-  bool pivot;
-};
-
-struct cluster {
-  vector <pixel> vpix; // Armin Burgmeier: list
-  int size;
-  int ncol, nrow, nfrm;
-  double col, row;
-  int signal;
-  double mindxy;
-};
-
-struct triplet {
-  double xm;
-  double ym;
-  double zm;
-  double sx;
-  double sy;
-  bool lk;
-  double ttdmin;
-  unsigned iA;
-  unsigned iB;
-  unsigned iC;
-};
+using namespace s53;
 
 struct CellRelatedHistos
 {
@@ -135,24 +121,67 @@ struct Cut
 {
     unsigned int bcidmin = 9;
     unsigned int bcidmax = 10;
+    // DUT frame (BC-ID) windows evaluated in one pass, [first,last] inclusive:
+    vector < pair <unsigned,unsigned> > frmwin;
 };
 
+const unsigned maxwin = 16; // frame windows per job
+
 Cut cuts;
 
+// DUT pixel profiles, filled for every pixel in the serial decode:
+// shards, merged into the ROOT profiles at snapshots and at the end
+
+struct pixelplots {
+  P1Shard qvsx, bcvsx, bcvst5;
+  P2Shard qvsxy, bcvsxy;
+};
+
+// one event through the pipeline: decoded serially, reconstructed in a
+// worker, then analysed serially in event order
+
+struct evwork {
+  double evsec; // TLU time
+  bool ldbg;
+  vector <pixel> pbs[9]; // pixels per plane
+  vector <int> iplseq; // planes in readout order
+  vector <cluster> cl[9];
+  vector <cluster> clw[maxwin]; // DUT clusters per frame window
+  vector <int> nlkw[maxwin]; // triplet links per windowed cluster
+  PlaneXY pxy[7]; // Mimosa hits, SoA
+  vector <triplet> triplets, driplets;
+
+  void clear() // keeps the capacity
+  {
+    for( int ipl = 0; ipl < 9; ++ipl ) {
+      pbs[ipl].clear();
+      cl[ipl].clear();
+    }
+    for( unsigned iw = 0; iw < maxwin; ++iw ) {
+      clw[iw].clear();
+      nlkw[iw].clear();
+    }
+    iplseq.clear();
+    triplets.clear();
+    driplets.clear();
+  }
+};
+
+// triplet and driplet plots, filled in the workers
+
+struct triplots {
+  H1Shard dx13, dy13, tridx, tridy, tridxc, tridyc, trix, triy, tritx, trity;
+  P1Shard tridxvsx, tridxvsy, tridxvstx, tridxvst3, tridxvst5;
+  P1Shard tridyvsx, tridyvsty, tridyvst3, tridyvst5;
+  H1Shard dx46, dy46, dridx, dridy, dridxc, dridyc, drix, driy, dritx, drity;
+  P1Shard dridxvsy, dridxvstx, dridxvst3, dridxvst5;
+  P1Shard dridyvsx, dridyvsty, dridyvst3, dridyvst5;
+};
+
 //------------------------------------------------------------------------------
 // The function returns the calibration functions for each pixel, where the 
 // pixel is identified by the channel: i_col * NumberRows + i_row
 // x= col, y = row
-// Calibration response function: https://cds.cern.ch/record/2649493/files/CLICdp-Note-2018-008.pdf
-// ToT( vcal ) = a vcal + b - \frac{c}{vcal-t}
-// Inverse: 
-// vcal (ToT ) = (a*t + ToT -b +sqrt((b+a*t-ToT)^2+4*a*c))/(2*a)
-// The actual function
-int __calcurve(float a,float b,float c,float t, int ToT)
-{ 
-   return std::round((a*t + ToT -b + std::sqrt(std::pow(b+a*t-ToT,2.0)+4.0*a*c))/(2.*a));
-}
-
 std::unordered_map<int,std::function<int(int)> > calibration(const std::string & calibration_file, int ntotal_rows)
 {
   using namespace std::placeholders;  // for _1, _2, _3...
@@ -192,230 +221,12 @@ std::unordered_map<int,std::function<int(int)> > calibration(const std::string &
 }
 
 //------------------------------------------------------------------------------
-vector <cluster> getClusn( vector <pixel> pb, int fCluCut = 1 ) // 1 = no gap
-{
-  // returns clusters with pixel coordinates
-  // next-neighbour topological clustering (allows fCluCut-1 empty pixels)
-
-  vector <cluster> vc;
-  if( pb.size() == 0 ) return vc;
-
-  int* gone = new int[pb.size()];
-  for( unsigned i = 0; i < pb.size(); ++i )
-    gone[i] = 0;
-
-  unsigned seed = 0;
-
-  while( seed < pb.size() ) {
-
-    // start a new cluster
-
-    cluster c;
-    c.vpix.push_back( pb[seed] );
-    gone[seed] = 1;
-
-    // let it grow as much as possible:
-
-    int growing;
-    do {
-      growing = 0;
-      for( unsigned i = 0; i < pb.size(); ++i ) {
-        if( !gone[i] ){ // unused pixel
-          for( unsigned int p = 0; p < c.vpix.size(); ++p ) { // vpix in cluster so far
-            int dr = c.vpix.at(p).row - pb[i].row;
-            int dc = c.vpix.at(p).col - pb[i].col;
-            if( (   dr>=-fCluCut) && (dr<=fCluCut) 
-		&& (dc>=-fCluCut) && (dc<=fCluCut) ) {
-              c.vpix.push_back(pb[i]);
-	      gone[i] = 1;
-              growing = 1;
-              break; // important!
-            }
-          } // loop over vpix
-        } // not gone
-      } // loop over all pix
-    }
-    while( growing );
-
-    // count pixel neighbours:
-
-    for( vector <pixel>::iterator p = c.vpix.begin(); p != c.vpix.end(); ++p ) {
-      vector <pixel>::iterator q = p;
-      ++q;
-      for( ; q != c.vpix.end(); ++q )
-	if( abs( p->col - q->col ) <= 1 &&abs( p->row - q->row ) <= 1 ) {
-	  ++p->tot;
-	  ++q->tot;
-	}
-    }
-
-    // added all I could. determine position and append it to the list of clusters:
-
-    c.size = c.vpix.size();
-    c.col = 0;
-    c.row = 0;
-    double sumnn = 0;
-    int minx = 999;
-    int maxx = 0;
-    int miny = 999;
-    int maxy = 0;
-    int minf = 999;
-    int maxf = 0;
-
-    for( vector<pixel>::iterator p = c.vpix.begin(); p != c.vpix.end(); ++p ) {
-
-      int nn = max( 1, p->tot ); // neighbours
-      sumnn += nn;
-      c.col += p->col * nn;
-      c.row += p->row * nn;
-
-      if( p->col > maxx ) maxx = p->col;
-      if( p->col < minx ) minx = p->col;
-      if( p->row > maxy ) maxy = p->row;
-      if( p->row < miny ) miny = p->row;
-      if( p->frm > maxf ) maxf = p->frm;
-      if( p->frm < minf ) minf = p->frm;
-
-    }
-
-    //cout << "(cluster with " << c.vpix.size() << " pixels)" << endl;
-
-    c.col /= sumnn;
-    c.row /= sumnn;
-    c.signal = sumnn;
-    c.ncol = maxx-minx+1;
-    c.nrow = maxy-miny+1;
-    c.nfrm = maxf-minf+1;
-    c.mindxy = 999;
-
-    vc.push_back(c); // add cluster to vector
-
-    // look for a new seed = used pixel:
-
-    while( ( ++seed < pb.size() ) && gone[seed] );
-
-  } // while over seeds
-
-  delete[] gone;
-
-  return vc; // vector of clusters
-
-} // getclusn
-
-//------------------------------------------------------------------------------
-vector <cluster> getClusq( vector <pixel> pb, int fCluCut = 1 ) // 1 = no gap
-{
-  // returns clusters with pixel coordinates
-  // next-neighbour topological clustering (allows fCluCut-1 empty pixels)
-
-  vector <cluster> vc;
-  if( pb.size() == 0 ) return vc;
-
-  int* gone = new int[pb.size()];
-  for( unsigned i = 0; i < pb.size(); ++i )
-    gone[i] = 0;
-
-  unsigned seed = 0;
-
-  while( seed < pb.size() ) {
-
-    // start a new cluster
-
-    cluster c;
-    c.vpix.push_back( pb[seed] );
-    gone[seed] = 1;
-
-    // let it grow as much as possible:
-
-    int growing;
-    do {
-      growing = 0;
-      for( unsigned i = 0; i < pb.size(); ++i ) {
-        if( !gone[i] ){ // unused pixel
-          for( unsigned int p = 0; p < c.vpix.size(); ++p ) { // vpix in cluster so far
-            int dr = c.vpix.at(p).row - pb[i].row;
-            int dc = c.vpix.at(p).col - pb[i].col;
-            if( (   dr>=-fCluCut) && (dr<=fCluCut) 
-		&& (dc>=-fCluCut) && (dc<=fCluCut) ) {
-              c.vpix.push_back(pb[i]);
-	      gone[i] = 1;
-              growing = 1;
-              break; // important!
-            }
-          } // loop over vpix
-        } // not gone
-      } // loop over all pix
-    }
-    while( growing );
-
-    // added all I could. determine position and append it to the list of clusters:
-
-    c.size = c.vpix.size();
-    c.col = 0;
-    c.row = 0;
-    double sumQ = 0;
-    int minx = 999;
-    int maxx = 0;
-    int miny = 999;
-    int maxy = 0;
-    int minf = 999;
-    int maxf = 0;
-
-    for( vector<pixel>::iterator p = c.vpix.begin(); p != c.vpix.end(); ++p ) {
-
-      double Qpix = p->tot;
-
-      sumQ += Qpix;
-
-      c.col += p->col*Qpix;
-      c.row += p->row*Qpix;
-
-      if( p->col > maxx ) maxx = p->col;
-      if( p->col < minx ) minx = p->col;
-      if( p->row > maxy ) maxy = p->row;
-      if( p->row < miny ) miny = p->row;
-      if( p->frm > maxf ) maxf = p->frm;
-      if( p->frm < minf ) minf = p->frm;
-
-    }
-
-    //cout << "(cluster with " << c.vpix.size() << " pixels)" << endl;
-
-    if( sumQ > 0 ) {
-      c.col /= sumQ;
-      c.row /= sumQ;
-    }
-    else {
-      c.col = (*c.vpix.begin()).col;
-      c.row = (*c.vpix.begin()).row;
-      cout << "GetClus: cluster with signal" << sumQ << endl;
-    }
-
-    c.signal = sumQ;
-    c.ncol = maxx-minx+1;
-    c.nrow = maxy-miny+1;
-    c.nfrm = maxf-minf+1;
-    c.mindxy = 999;
-
-    vc.push_back(c); // add cluster to vector
-
-    // look for a new seed = used pixel:
-
-    while( ( ++seed < pb.size() ) && gone[seed] );
-
-  } // while over seeds
-
-  delete gone;
-
-  return vc; // vector of clusters
-
-} // getclusq
-
-//------------------------------------------------------------------------------
-int main( int argc, char* argv[] )
+int analyseRun( int argc, char* argv[] ) // one run, multirun.h
 {
   cout << "main " << argv[0] << " called with " << argc << " arguments" << endl;
 
+  cuts = Cut(); // frame windows from this call only
+
   if( argc == 1 ) {
     cout << "give run number" << endl;
     return 1;
@@ -439,6 +250,9 @@ int main( int argc, char* argv[] )
   int fev = 0; // 1st event
   int lev = 999222111; // last event
   bool ldbmod = 0;
+  bool lzscan = 0;
+  bool lmemalign = 0;
+  double fsnap = 0; // follow mode: snapshot interval [s]
 
   for( int i = 1; i < argc; ++i ) {
 
@@ -451,8 +265,37 @@ int main( int argc, char* argv[] )
     if( !strcmp( argv[i], "-m" ) )
       ldbmod = 1; // debug for module sync
 
+    if( !strcmp( argv[i], "-z" ) )
+      lzscan = 1; // DUT z from scan, from iteration 1 on
+
+    if( !strcmp( argv[i], "-a" ) )
+      lmemalign = 1; // all alignment iterations in memory
+
+    if( !strcmp( argv[i], "-F" ) )
+      fsnap = atof( argv[++i] ); // follow the growing raw file
+
+    if( !strcmp( argv[i], "-w" ) && i+2 < argc-1 ) { // DUT frame window
+      unsigned f0 = atoi( argv[++i] );
+      unsigned f9 = atoi( argv[++i] );
+      if( cuts.frmwin.size() < maxwin && f0 <= f9 )
+	cuts.frmwin.push_back( make_pair( f0, f9 ) );
+    }
+
   } // argc
 
+  if( cuts.frmwin.empty() ) { // all, nominal, nominal +-1, +-2
+    cuts.frmwin.push_back( make_pair( 0, 31 ) );
+    for( unsigned iw = 0; iw < 3; ++iw )
+      cuts.frmwin.push_back( make_pair( cuts.bcidmin - iw, cuts.bcidmax + iw ) );
+  }
+
+  unsigned nwin = cuts.frmwin.size();
+
+  cout << "DUT frame windows:";
+  for( unsigned iw = 0; iw < nwin; ++iw )
+    cout << "  " << cuts.frmwin[iw].first << "-" << cuts.frmwin[iw].second;
+  cout << endl;
+
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
   // runs.dat:
 
@@ -650,118 +493,18 @@ int main( int argc, char* argv[] )
 
   double zz[9];
 
-  for( int ipl = 0; ipl < 9; ++ipl )
-    nx[ipl] = 0; // missing plane flag
-
-  ifstream geoFile( geoFileName );
-
   cout << endl;
 
-  if( geoFile.bad() || ! geoFile.is_open() ) {
+  if( ! readGeo( geoFileName, 0, 8,
+		 nx, ny, sizex, sizey, zz, ptchx, ptchy, midx, midy ) ) {
     cout << "Error opening " << geoFileName << endl;
     return 1;
   }
 
-  cout << "read geometry from " << geoFileName << endl;
-
-  { // open local scope
-
-    string hash( "#" );
-    string plane( "plane" );
-    string type( "type" );
-    string sizexs( "sizex" );
-    string sizeys( "sizey" );
-    string npixelx( "npixelx" );
-    string npixely( "npixely" );
-    string zpos( "zpos" );
-
-    int ipl = 0;
-    string chiptype;
-
-    while( ! geoFile.eof() ) {
-
-      string line;
-      getline( geoFile, line );
-      cout << line << endl;
-
-      if( line.empty() ) continue;
-
-      istringstream tokenizer( line );
-      string tag;
-      tokenizer >> tag; // leading white space is suppressed
-      if( tag.substr(0,1) == hash ) // comments start with #
-	continue;
-
-      if( tag == plane ) {
-	tokenizer >> ipl;
-	continue;
-      }
-
-      if( ipl < 0 || ipl > 8 ) {
-	cout << "geo wrong plane number " << ipl << endl;
-	continue;
-      }
-
-      if( tag == type ) {
-	tokenizer >> chiptype;
-	continue;
-      }
-
-      if( tag == sizexs ) {
-	double val;
-	tokenizer >> val;
-	sizex[ipl] = val;
-	continue;
-      }
-
-      if( tag == sizeys ) {
-	double val;
-	tokenizer >> val;
-	sizey[ipl] = val;
-	continue;
-      }
-
-      if( tag == npixelx ) {
-	int val;
-	tokenizer >> val;
-	nx[ipl] = val;
-	continue;
-      }
-
-      if( tag == npixely ) {
-	int val;
-	tokenizer >> val;
-	ny[ipl] = val;
-	continue;
-      }
-
-      if( tag == zpos ) {
-	double val;
-	tokenizer >> val;
-	zz[ipl] = val;
-	continue;
-      }
-
-      // anything else on the line and in the file gets ignored
-
-    } // while getline
-
-    for( int ipl = 0; ipl < 9; ++ipl ) {
-      if( nx[ipl] == 0 ) continue; // missing plane flag
-      ptchx[ipl] = sizex[ipl] / nx[ipl]; // pixel size
-      ptchy[ipl] = sizey[ipl] / ny[ipl];
-      midx[ipl] = 0.5 * sizex[ipl]; // mid of plane
-      midy[ipl] = 0.5 * sizey[ipl]; // mid of plane
-    }
-
-  } // geo scope
-
   cout << endl;
   for( int ipl = 1; ipl <= 6; ++ipl )
     cout << ipl << " zz " << zz[ipl] << endl;
 
-  geoFile.close();
-
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
   // read Mimosa telescope alignment:
 
@@ -776,76 +519,15 @@ int main( int argc, char* argv[] )
 
   alignFileName << "align_" << run << ".dat";
 
-  ifstream ialignFile( alignFileName.str() );
-
   cout << endl;
 
-  if( ialignFile.bad() || ! ialignFile.is_open() ) {
+  if( ! readAlign( alignFileName.str(), 1, 6, // Mimosa
+		   aligniteration, alignx, aligny, alignz, rotx, roty ) ) {
     cout << "Error opening " << alignFileName.str() << endl
 	 << "  please do: tele -g " << geoFileName << " " << run << endl
 	 << endl;
     return 1;
   }
-  else {
-
-    cout << "read alignment from " << alignFileName.str() << endl;
-
-    string hash( "#" );
-    string iteration( "iteration" );
-    string plane( "plane" );
-    string shiftx( "shiftx" );
-    string shifty( "shifty" );
-    string shiftz( "shiftz" );
-    string rotxvsy( "rotxvsy" );
-    string rotyvsx( "rotyvsx" );
-
-    int ipl = 1;
-
-    while( ! ialignFile.eof() ) {
-
-      string line;
-      getline( ialignFile, line );
-      cout << line << endl;
-
-      if( line.empty() ) continue;
-
-      istringstream tokenizer( line );
-      string tag;
-      tokenizer >> tag; // leading white space is suppressed
-      if( tag.substr(0,1) == hash ) // comments start with #
-	continue;
-
-      if( tag == iteration ) 
-	tokenizer >> aligniteration;
-
-      if( tag == plane )
-	tokenizer >> ipl;
-
-      if( ipl < 1 || ipl > 6 ) { // Mimosa
-	cout << "align wrong plane number " << ipl << endl;
-	continue;
-      }
-
-      double val;
-      tokenizer >> val;
-      if(      tag == shiftx )
-	alignx[ipl] = val;
-      else if( tag == shifty )
-	aligny[ipl] = val;
-      else if( tag == shiftz )
-	alignz[ipl] = val;
-      else if( tag == rotxvsy )
-	rotx[ipl] = val;
-      else if( tag == rotyvsx )
-	roty[ipl] = val;
-
-      // anything else on the line and in the file gets ignored
-
-    } // while getline
-
-  } // alignFile
-
-  ialignFile.close();
 
   cout << endl;
   for( int ipl = 1; ipl <= 6; ++ipl )
@@ -854,6 +536,10 @@ int main( int argc, char* argv[] )
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
   // (re-)create root file:
 
+  StageProf prof( "scope53m" );
+  prof.setRun( run );
+  prof.mark( "setup" );
+
   ostringstream rootFileName; // output string stream
 
   rootFileName << "scopeRD" << run << ".root";
@@ -867,60 +553,12 @@ int main( int argc, char* argv[] )
 
   hotFileName << "hot_" << run << ".dat";
 
-  ifstream ihotFile( hotFileName.str() );
-
   set <int> hotset[9];
 
   cout << endl;
 
-  if( ihotFile.bad() || ! ihotFile.is_open() ) {
+  if( ! readHotPixels( hotFileName.str(), ny, hotset, 1, 6 ) )
     cout << "no " << hotFileName.str() << " (created by tele)" << endl;
-  }
-  else {
-
-    cout << "read hot pixel list from " << hotFileName.str() << endl;
-
-    string hash( "#" );
-    string plane( "plane" );
-    string pix( "pix" );
-
-    int ipl = 0;
-
-    while( ! ihotFile.eof() ) {
-
-      string line;
-      getline( ihotFile, line );
-      //cout << line << endl;
-
-      if( line.empty() ) continue;
-
-      istringstream tokenizer( line );
-      string tag;
-      tokenizer >> tag; // leading white space is suppressed
-      if( tag.substr(0,1) == hash ) // comments start with #
-	continue;
-
-      if( tag == plane )
-	tokenizer >> ipl;
-
-      if( ipl < 1 || ipl > 6 ) { // Mimosa
-	cout << "hot wrong plane number " << ipl << endl;
-	continue;
-      }
-
-      if( tag == pix ) {
-	int ix, iy;
-	tokenizer >> ix;
-	tokenizer >> iy;
-	int ipx = ix*ny[ipl]+iy;
-	hotset[ipl].insert(ipx);
-      }
-
-    } // while getline
-
-  } // hotFile
-
-  ihotFile.close();
 
   for( int ipl = 0; ipl <= 6; ++ipl )
     cout << "  plane " << ipl << ": hot " << hotset[ipl].size() << endl;
@@ -946,65 +584,11 @@ int main( int argc, char* argv[] )
 
   DUTalignFileName << "alignDUT_" << run << ".dat";
 
-  ifstream iDUTalignFile( DUTalignFileName.str() );
-
   cout << endl;
 
-  if( iDUTalignFile.bad() || ! iDUTalignFile.is_open() ) {
+  if( ! readDUTAlign( DUTalignFileName.str(), DUTaligniteration,
+		      DUTalignx, DUTaligny, DUTrot, DUTtilt, DUTturn, DUTz, zz[3] ) )
     cout << "no " << DUTalignFileName.str() << ", will bootstrap" << endl;
-  }
-  else {
-
-    cout << "read DUTalignment from " << DUTalignFileName.str() << endl;
-
-    string hash( "#" );
-    string iteration( "iteration" );
-    string alignx( "alignx" );
-    string aligny( "aligny" );
-    string rot( "rot" );
-    string tilt( "tilt" );
-    string turn( "turn" );
-    string dz( "dz" );
-
-    while( ! iDUTalignFile.eof() ) {
-
-      string line;
-      getline( iDUTalignFile, line );
-      cout << line << endl;
-
-      if( line.empty() ) continue;
-
-      istringstream tokenizer( line );
-      string tag;
-      tokenizer >> tag; // leading white space is suppressed
-      if( tag.substr(0,1) == hash ) // comments start with #
-	continue;
-
-      if( tag == iteration ) 
-	tokenizer >> DUTaligniteration;
-
-      double val;
-      tokenizer >> val;
-      if(      tag == alignx )
-	DUTalignx = val;
-      else if( tag == aligny )
-	DUTaligny = val;
-      else if( tag == rot )
-	DUTrot = val;
-      else if( tag == tilt )
-	DUTtilt = val;
-      else if( tag == turn )
-	DUTturn = val;
-      else if( tag == dz )
-	DUTz = val + zz[3];
-
-      // anything else on the line and in the file gets ignored
-
-    } // while getline
-
-  } // alignFile
-
-  iDUTalignFile.close();
 
   double DUTalignx0 = DUTalignx; // at time 0
   double DUTaligny0 = DUTaligny;
@@ -1028,6 +612,31 @@ int main( int argc, char* argv[] )
 
   const double norm = cos( DUTturn*wt ) * cos( DUTtilt*wt ); // length of Nz
 
+  PlaneAlign dutap; // in-memory alignment, start values
+  dutap.alx = DUTalignx0;
+  dutap.aly = DUTaligny0;
+  dutap.rot = DUTrot;
+  dutap.tilt = DUTtilt;
+  dutap.turn = DUTturn;
+  dutap.z = DUTz;
+  dutap.ux = upsignx;
+  dutap.uy = upsigny;
+  dutap.cutx = 0.150; // as xcutDUT, ycutDUT below
+  dutap.cuty = 0.100;
+  if( rot90 ) {
+    dutap.cutx = 0.100;
+    dutap.cuty = 0.150;
+  }
+  if( fifty ) {
+    dutap.cutx = 0.100;
+    dutap.cuty = 0.100;
+  }
+  if( fabs(DUTturn) > 33 ) // shallow
+    dutap.cutx = 0.300;
+  dutap.rotfromx = rot90 || fifty;
+  dutap.zfromx = rot90 || fifty;
+  double wdutap = DUTaligniteration == 0 ? 20 : 1; // loose window [mm]
+
   double qL = 10; // 33483
   double qR = 20;
 
@@ -1217,6 +826,8 @@ int main( int argc, char* argv[] )
 
   cout << endl;
 
+  prof.mark( "masks" ); // hot and dead pixels
+
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
   // MOD:
 
@@ -1394,65 +1005,11 @@ int main( int argc, char* argv[] )
 
   MODalignFileName << "alignMOD_" << run << ".dat";
 
-  ifstream iMODalignFile( MODalignFileName.str() );
-
   cout << endl;
 
-  if( iMODalignFile.bad() || ! iMODalignFile.is_open() ) {
+  if( ! readDUTAlign( MODalignFileName.str(), MODaligniteration,
+		      MODalignx, MODaligny, MODrot, MODtilt, MODturn, MODz, zz[1] ) )
     cout << "no " << MODalignFileName.str() << ", will bootstrap" << endl;
-  }
-  else {
-
-    cout << "read MODalignment from " << MODalignFileName.str() << endl;
-
-    string hash( "#" );
-    string iteration( "iteration" );
-    string alignx( "alignx" );
-    string aligny( "aligny" );
-    string rot( "rot" );
-    string tilt( "tilt" );
-    string turn( "turn" );
-    string dz( "dz" );
-
-    while( ! iMODalignFile.eof() ) {
-
-      string line;
-      getline( iMODalignFile, line );
-      cout << line << endl;
-
-      if( line.empty() ) continue;
-
-      istringstream tokenizer( line );
-      string tag;
-      tokenizer >> tag; // leading white space is suppressed
-      if( tag.substr(0,1) == hash ) // comments start with #
-	continue;
-
-      if( tag == iteration ) 
-	tokenizer >> MODaligniteration;
-
-      double val;
-      tokenizer >> val;
-      if(      tag == alignx )
-	MODalignx = val;
-      else if( tag == aligny )
-	MODaligny = val;
-      else if( tag == rot )
-	MODrot = val;
-      else if( tag == tilt )
-	MODtilt = val;
-      else if( tag == turn )
-	MODturn = val;
-      else if( tag == dz )
-	MODz = val + zz[1];
-
-      // anything else on the line and in the file gets ignored
-
-    } // while getline
-
-  } // alignFile
-
-  iMODalignFile.close();
 
   // normal vector on MOD surface:
   // N = ( 0, 0, -1 ) on MOD, towards -z
@@ -1473,6 +1030,22 @@ int main( int argc, char* argv[] )
 
   const double normm = cos( MODturn*wt ) * cos( MODtilt*wt ); // length of Nz
 
+  PlaneAlign modap; // in-memory alignment, start values
+  modap.alx = MODalignx;
+  modap.aly = MODaligny;
+  modap.rot = MODrot;
+  modap.tilt = MODtilt;
+  modap.turn = MODturn;
+  modap.z = MODz;
+  modap.ux = -1; // x4m = -x3m
+  modap.cutx = 0.15;
+  modap.cuty = 0.15;
+  modap.minturn = 0.6; // sin > 0.01
+  modap.mintilt = 0.6;
+  double wmodap = MODaligniteration == 0 ? 40 : 1; // loose window [mm]
+
+  prof.mark( "MOD" );
+
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
   // DUT gain:
   int nrows_in_dut = ny[iDUT];
@@ -1481,11 +1054,17 @@ int main( int argc, char* argv[] )
      //nrows_in_dut = 2*ny[iDUT];
      nrows_in_dut = 384;
   }
-  auto calibration_curves = calibration(gain_filename_dut,nrows_in_dut);
+  static RunCache< std::unordered_map<int,std::function<int(int)> > > gains; // same file for many runs
+  ostringstream gainKey;
+  gainKey << gain_filename_dut << " rows " << nrows_in_dut;
+  auto & calibration_curves =
+    gains.get( gainKey.str(), [&]() { return calibration(gain_filename_dut,nrows_in_dut); } );
   std::cout << "Loaded calibration curves for DUT. Active pixels: " 
 	<< calibration_curves.size() << std::endl;
   histoFile.cd();
 
+  prof.mark( "gains" );
+
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
   // book histos:
   int qnbins = 16;
@@ -1667,6 +1246,8 @@ int main( int argc, char* argv[] )
 		      "DUT pixel column after threshold;DUT pixel column;pixels",
 		      400, 0, 400 );
 
+  prof.mark( "planehistos" );
+
   // triplets:
 
   TH1I hdx13( "dx13", "1-3 dx;1-3 dx [mm];cluster pairs", 100, -f, f );
@@ -1721,6 +1302,8 @@ int main( int argc, char* argv[] )
 
   TH1I ntriHisto( "ntri", "triplets;triplets;events", 51, -0.5, 50.5 );
 
+  prof.mark( "trihistos" );
+
   // driplets:
 
   TH1I hdx46( "dx46", "4-6 dx;4-6 dx [mm];cluster pairs", 100, -f, f );
@@ -1772,6 +1355,8 @@ int main( int argc, char* argv[] )
 
   TH1I ndriHisto( "ndri", "driplets;driplets;events", 51, -0.5, 50.5 );
 
+  prof.mark( "drihistos" );
+
   // MOD vs triplets:
 
   TH1I ttdminmod1Histo( "ttdminmod1",
@@ -1914,6 +1499,8 @@ int main( int argc, char* argv[] )
   TH1I ntrimodHisto( "ntrimod", "triplet - MOD links;triplet - MOD links;events",
 		     11, -0.5, 10.5 );
 
+  prof.mark( "modhistos" );
+
   // DUT clusters:
 
   TH2I * dutmodxxHisto = new
@@ -1946,6 +1533,8 @@ int main( int argc, char* argv[] )
 		     "telescope triplets isolation;triplet min #Delta_{xy} [mm];triplet pairs",
 		     150, 0, 15 );
 
+  prof.mark( "dutclhistos" );
+
   // driplets - triplets:
 
   TH1I hsixdx( "sixdx", "six dx;dx [mm];triplet-driplet pairs", 200, -0.2*f, 0.2*f );
@@ -2062,6 +1651,8 @@ int main( int argc, char* argv[] )
     TH2I( "dutxy", "tracks at DUT;x [mm];y [mm];tracks",
 	  240, -12, 12, 120, -6, 6 );
 
+  prof.mark( "sixhistos" );
+
   // DUT vs triplets:
 
   TH1I dutdxaHisto( "dutdxa",
@@ -2128,6 +1719,12 @@ int main( int argc, char* argv[] )
   TProfile dutdxvstx1( "dutdxvstx1",
 		      "DUT #Deltax vs #theta_{x}, x > 0;x track slope [rad];<cluster - track #Deltax> [mm]",
 		      80, -0.002, 0.002, -limx, limx );
+  TProfile dutzscanx( "dutzscanx",
+		      "DUT z scan x;trial DUT z shift [mm];MAD(cluster - track #Deltax) [mm]",
+		      41, -10.25, 10.25, 0, limx );
+  TProfile dutzscany( "dutzscany",
+		      "DUT z scan y;trial DUT z shift [mm];MAD(cluster - track #Deltay) [mm]",
+		      41, -10.25, 10.25, 0, limx );
   TProfile dutdxvsxm( "dutdxvsxm",
 		      "DUT #Deltax vs xmod;x track mod 100 [#mum];<cluster - track #Deltax> [mm]",
 		      50, 0, 100, -limx, limx );
@@ -3024,6 +2621,38 @@ int main( int argc, char* argv[] )
   TH1I ntrilkHisto( "ntrilk", "track - DUT links;track - DUT links;tracks",
 		    11, -0.5, 10.5 );
 
+  prof.mark( "duthistos" );
+
+  // DUT frame windows:
+
+  TProfile effvswin( "effvswin",
+		     "DUT efficiency vs frame window;frame window;efficiency",
+		     nwin, -0.5, nwin-0.5, -1, 2 );
+  TProfile dutnoisevswin( "dutnoisevswin",
+			  "DUT unlinked clusters vs frame window;frame window;<unlinked DUT clusters>/event",
+			  nwin, -0.5, nwin-0.5, -1, 99 );
+  TH1I dutdxcwHisto[maxwin];
+  TH1I dutdycwHisto[maxwin];
+  TH1I dutnclwHisto[maxwin];
+  for( unsigned iw = 0; iw < nwin; ++iw ) {
+    unsigned f0 = cuts.frmwin[iw].first;
+    unsigned f9 = cuts.frmwin[iw].second;
+    effvswin.GetXaxis()->SetBinLabel( iw+1, Form( "%i-%i", f0, f9 ) );
+    dutnoisevswin.GetXaxis()->SetBinLabel( iw+1, Form( "%i-%i", f0, f9 ) );
+    dutdxcwHisto[iw] =
+      TH1I( Form( "dutdxcw%i", iw ),
+	    Form( "DUT - Telescope x cut residual, BC %i-%i;DUT cluster - telescope triplet #Deltax [mm];DUT clusters", f0, f9 ),
+	    400, -0.2, 0.2 );
+    dutdycwHisto[iw] =
+      TH1I( Form( "dutdycw%i", iw ),
+	    Form( "DUT - Telescope y cut residual, BC %i-%i;DUT cluster - telescope triplet #Deltay [mm];DUT clusters", f0, f9 ),
+	    400, -0.2, 0.2 );
+    dutnclwHisto[iw] =
+      TH1I( Form( "dutnclw%i", iw ),
+	    Form( "DUT unlinked clusters, BC %i-%i;unlinked DUT clusters;events", f0, f9 ),
+	    51, -0.5, 50.5 );
+  }
+
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
   // event loop:
 
@@ -3067,10 +2696,130 @@ int main( int argc, char* argv[] )
 
   std::map<int,int> pxdutmap;
 
-  do {
+  prof.mark( "windows" );
+
+  pixelplots pp;
+  pp.qvsx.book( dutpxqvsx );
+  pp.qvsxy.book( *dutpxqvsxy );
+  pp.bcvsx.book( dutpxbcvsx );
+  pp.bcvsxy.book( *dutpxbcvsxy );
+  pp.bcvst5.book( dutpxbcvst5 );
+
+  // event pipeline in batches: the TLU decode runs serially in event
+  // order, a thread pool clusters and builds the triplets of the batch,
+  // then the MOD stream, matching and all other plots run serially in
+  // event order again.
+
+  const int maxbat = 32; // events per batch
+
+  vector <evwork> bat( maxbat );
+
+  // worker plots: one set of shards per batch slot, the sums do not
+  // depend on the thread count or the schedule. Shard and histogram:
+
+  vector <triplots> tbat( maxbat );
+
+  vector < pair < H1Shard triplots::*, TH1 * > > trih1 = {
+    { &triplots::dx13, &hdx13 }, { &triplots::dy13, &hdy13 },
+    { &triplots::tridx, &htridx }, { &triplots::tridy, &htridy },
+    { &triplots::tridxc, &htridxc }, { &triplots::tridyc, &htridyc },
+    { &triplots::trix, &trixHisto }, { &triplots::triy, &triyHisto },
+    { &triplots::tritx, &tritxHisto }, { &triplots::trity, &trityHisto },
+    { &triplots::dx46, &hdx46 }, { &triplots::dy46, &hdy46 },
+    { &triplots::dridx, &hdridx }, { &triplots::dridy, &hdridy },
+    { &triplots::dridxc, &hdridxc }, { &triplots::dridyc, &hdridyc },
+    { &triplots::drix, &drixHisto }, { &triplots::driy, &driyHisto },
+    { &triplots::dritx, &dritxHisto }, { &triplots::drity, &drityHisto } };
+
+  vector < pair < P1Shard triplots::*, TProfile * > > trip1 = {
+    { &triplots::tridxvsx, &tridxvsx }, { &triplots::tridxvsy, &tridxvsy },
+    { &triplots::tridxvstx, &tridxvstx }, { &triplots::tridxvst3, &tridxvst3 },
+    { &triplots::tridxvst5, &tridxvst5 },
+    { &triplots::tridyvsx, &tridyvsx }, { &triplots::tridyvsty, &tridyvsty },
+    { &triplots::tridyvst3, &tridyvst3 }, { &triplots::tridyvst5, &tridyvst5 },
+    { &triplots::dridxvsy, &dridxvsy }, { &triplots::dridxvstx, &dridxvstx },
+    { &triplots::dridxvst3, &dridxvst3 }, { &triplots::dridxvst5, &dridxvst5 },
+    { &triplots::dridyvsx, &dridyvsx }, { &triplots::dridyvsty, &dridyvsty },
+    { &triplots::dridyvst3, &dridyvst3 }, { &triplots::dridyvst5, &dridyvst5 } };
+
+  for( int k = 0; k < maxbat; ++k ) {
+    for( unsigned i = 0; i < trih1.size(); ++i )
+      ( tbat[k].*trih1[i].first ).book( *trih1[i].second );
+    for( unsigned i = 0; i < trip1.size(); ++i )
+      ( tbat[k].*trip1[i].first ).book( *trip1[i].second );
+  }
+
+  auto mergeShards = [&]() { // into the ROOT objects, then empty
+    for( int k = 0; k < maxbat; ++k ) { // in slot order
+      for( unsigned i = 0; i < trih1.size(); ++i ) {
+	( tbat[k].*trih1[i].first ).mergeInto( *trih1[i].second );
+	( tbat[k].*trih1[i].first ).reset();
+      }
+      for( unsigned i = 0; i < trip1.size(); ++i ) {
+	( tbat[k].*trip1[i].first ).mergeInto( *trip1[i].second );
+	( tbat[k].*trip1[i].first ).reset();
+      }
+    }
+    pp.qvsx.mergeInto( dutpxqvsx );
+    pp.qvsxy.mergeInto( *dutpxqvsxy );
+    pp.bcvsx.mergeInto( dutpxbcvsx );
+    pp.bcvsxy.mergeInto( *dutpxbcvsxy );
+    pp.bcvst5.mergeInto( dutpxbcvst5 );
+    pp.qvsx.reset();
+    pp.qvsxy.reset();
+    pp.bcvsx.reset();
+    pp.bcvsxy.reset();
+    pp.bcvst5.reset();
+  };
+
+  RawFollow follow( fsnap );
+
+  follow.onSnapshot( [&]() {
+      mergeShards();
+      histoFile.Write( "", TObject::kOverwrite );
+      cout << "snapshot " << histoFile.GetName() << " at " << iev << " events:";
+      for( unsigned iw = 0; iw < nwin; ++iw )
+	cout << "  BC " << cuts.frmwin[iw].first
+	     << "-" << cuts.frmwin[iw].second
+	     << " eff " << effvswin.GetBinContent(iw+1)*1E2 << " %";
+      cout << endl;
+    } );
+
+  if( follow.on() )
+    cout << "follow data/run" << run << ", snapshot every " << fsnap << " s" << endl;
+
+  int sdecode = prof.stage( "decode" );
+  int sreco = prof.stage( "reconstruct" ); // clustering and triplets, in parallel
+  int sfill = prof.stage( "clusterfill" );
+  int smod = prof.stage( "MOD" );
+  int smatch = prof.stage( "matching" );
+  int soutput = prof.stage( "output" );
+  int salign = prof.stage( "alignment" );
+
+  GridIndex trigridmod; // triplet intercepts at MOD, per event
+  GridIndex trigriddut; // triplet intercepts at DUTz
+  vector<double> trixg, triyg; // reused buffers
+
+  // aligned: triplets are linked only to MOD and DUT clusters near their
+  // intercept, found in a grid. All pair histos then stop at wgridlk.
+
+  bool lmodgrid = MODaligniteration > 1;
+  bool ldutgrid = DUTaligniteration > 1;
+  double wgridlk = 2.5; // [mm] range of the moddx and dutdx histos
+  GridIndex modgrid; // MOD clusters, per event
+  GridIndex dutgrid; // DUT clusters
+  vector<double> modxg, modyg, dutxg, dutyg; // reused buffers
+  vector<int> lkcand; // clusters to compare with a triplet
+
+  // stage A, serial in event order: TLU time, pixels, hot pixel masking
+
+  auto decode = [&]( evwork & ev, int jev ) {
 
     evt = reader->GetDetectorEvent();
 
+    if( evt.IsEORE() )
+      follow.stop(); // run closed
+
     uint64_t evTLU = evt.GetTimestamp(); // 384 MHz = 2.6 ns
 
     double evsec = (evTLU - evTLU0) / fTLU;
@@ -3096,35 +2845,20 @@ int main( int argc, char* argv[] )
 
     bool ldbg = 0;
 
-    if( iev <  0 )
+    if( jev <  0 )
       ldbg = 1;
 
     if( lev < 100 )
       ldbg = 1;
 
-    if( iev < 10 || ldbg )
-      cout << "scope53m processing  " << run << "." << iev << "  taken " << evsec << endl;
-    else if( iev < 100 && iev%10 == 0 )
-      cout << "scope53m processing  " << run << "." << iev << "  taken " << evsec << endl;
-    else if( iev < 1000 && iev%100 == 0 )
-      cout << "scope53m processing  " << run << "." << iev << "  taken " << evsec << endl;
-    else if( iev%1000 == 0 ) {
-      cout << "scope53m processing  " << run << "." << iev
-	   << "  taken " << evsec
-	   << "  modlk " << nmodlk
-	   << "  eff " << ngood*1E2/max(1,ntrck)
-	   << endl;
-      ngood = 0;
-      ntrck = 0;
-      nmodlk = 0;
-    }
+    ev.clear();
+    ev.evsec = evsec;
+    ev.ldbg = ldbg;
 
     StandardEvent sevt = eudaq::PluginManager::ConvertToStandard(evt);
 
     if( ldbg ) cout << "planes " << sevt.NumPlanes() << endl;
 
-    vector < cluster > cl[9];
-
     for( size_t iplane = 0; iplane < sevt.NumPlanes(); ++iplane ) {
 
       const eudaq::StandardPlane &plane = sevt.GetPlane(iplane);
@@ -3149,7 +2883,7 @@ int main( int argc, char* argv[] )
       }
 
       if( ipl < 0 || ipl > 6 ) {
-	cout << "event " << iev << " wrong plane number " << ipl << endl;
+	cout << "event " << jev << " wrong plane number " << ipl << endl;
 	continue;
       }
 
@@ -3249,8 +2983,8 @@ int main( int argc, char* argv[] )
 	    else
 	      difpxqHisto.Fill( px.tot + 0.5 );
 
-	    dutpxqvsx.Fill( ix, px.tot + 0.5 );
-	    dutpxqvsxy->Fill( ix, iy, px.tot + 0.5 );
+	    pp.qvsx.fill( ix, px.tot + 0.5 );
+	    pp.qvsxy.fill( ix, iy, px.tot + 0.5 );
 
 	    if( ix < 128 )
 	      synpxbcHisto.Fill( frm );
@@ -3258,110 +2992,366 @@ int main( int argc, char* argv[] )
 	      linpxbcHisto.Fill( frm );
 	    else
 	      difpxbcHisto.Fill( frm );
-	    dutpxbcvsx.Fill( ix, frm );
-	    dutpxbcvsxy->Fill( ix, iy, frm );
-	    dutpxbcvst5.Fill( evsec, frm ); // long run 34135: not stable
+	    pp.bcvsx.fill( ix, frm );
+	    pp.bcvsxy.fill( ix, iy, frm );
+	    pp.bcvst5.fill( evsec, frm ); // long run 34135: not stable
 
 	    int thr = 0;
 
-	    if( chip0 == -550 ) {
-	      if( ix < 264 ) // lin
-		//thr = 2; // hard enough: linnrowvsym
-		thr = 3; // uniform 1st cluster row
-	      else
-		//thr = 2; // not enough
-		//thr = 5; // better
-		thr = 7; // uniform 1st cluster row
-	    }
+	    if( chip0 == -550 ) {
+	      if( ix < 264 ) // lin
+		//thr = 2; // hard enough: linnrowvsym
+		thr = 3; // uniform 1st cluster row
+	      else
+		//thr = 2; // not enough
+		//thr = 5; // better
+		thr = 7; // uniform 1st cluster row
+	    }
+
+	    if( run == 35088 )
+	      //thr = 1; // 35088 dxc 26
+	      //thr = 3; // 35088 dxc 30
+	      thr = 2; // 35088 dxc 27
+
+	    if( run == 35695 )
+	      thr = 2;
+
+	    if( px.tot < thr ) continue; // offline threshold
+
+	    dutpxcol9Histo.Fill( ix + 0.5 );
+
+	    if( !fifty ) 
+	    {  // 100x25 from ROC to sensor:
+	       px.col = ix/2; // 100 um
+
+	       if( ix%2 == 1 ) 
+               {
+                 px.row = 2*iy + 1; //
+               }
+	       else
+               {
+		 px.row = 2*iy + 0; // see ed53 for shallow angle
+               }
+	       if( chip0 == 182 || chip0 == 211 || chip0 == 512 ) 
+               { // HLL
+		if( ix%2 )
+		  px.row = 2*iy + 1;
+		else
+		  px.row = 2*iy + 0;
+	       }
+	    }
+
+	  } // DUT
+
+	  pb.push_back(px);
+
+	  hcol[ipl].Fill( ix ); // ROC
+	  hrow[ipl].Fill( iy );
+	  hmap[ipl]->Fill( ix, iy ); // after thr
+
+	} // pix
+
+      if( ldbg ) cout << endl;
+
+      hnpxmsk[ipl].Fill( pb.size() ); // after masking
+      if( ipl == iDUT )
+	dutnpxvsev.Fill( jev, pb.size() );
+
+      // clustering in the workers, all planes at once:
+
+      if( find( ev.iplseq.begin(), ev.iplseq.end(), ipl ) == ev.iplseq.end() )
+	ev.iplseq.push_back( ipl );
+      ev.pbs[ipl].swap( pb );
+
+    } // eudaq planes
+
+  }; // decode
+
+  // stage B, in the workers: clustering, isolation, triplets and
+  // driplets. No ROOT objects in here, only the shards of the slot.
+
+  auto reconstruct = [&]( evwork & ev, triplots & tp ) {
+
+    vector <cluster> * cl = ev.cl;
+    vector <cluster> * clw = ev.clw;
+    vector <int> * nlkw = ev.nlkw;
+    const vector <pixel> * pbs = ev.pbs;
+    const vector <int> & iplseq = ev.iplseq;
+    PlaneXY * pxy = ev.pxy;
+    vector <triplet> & triplets = ev.triplets;
+    vector <triplet> & driplets = ev.driplets;
+    double evsec = ev.evsec;
+
+    // clustering: planes, then the DUT frame windows
+
+    for( unsigned k = 0; k < iplseq.size(); ++k ) {
+
+      int ipl = iplseq[k];
+
+      if( ipl == iDUT )
+	cl[ipl] = getClusq( pbs[ipl] );
+      else
+	cl[ipl] = getClusn( pbs[ipl] );
+
+      // cluster isolation:
+
+      for( vector<cluster>::iterator c = cl[ipl].begin(); c != cl[ipl].end(); ++c ) {
+	vector<cluster>::iterator d = c; // upper diagonal
+	++d;
+	for( ; d != cl[ipl].end(); ++d ) {
+	  double dx = d->col - c->col;
+	  double dy = d->row - c->row;
+	  double dxy = sqrt( dx*dx + dy*dy );
+	  if( dxy < c->mindxy ) c->mindxy = dxy;
+	  if( dxy < d->mindxy ) d->mindxy = dxy;
+	}
+      } // cl
+
+    } // planes
+
+    // same DUT pixels, clustered per frame window:
+
+    for( unsigned iw = 0; iw < nwin; ++iw ) {
+      const vector <pixel> & pb = pbs[iDUT];
+      vector <pixel> pbw;
+      for( unsigned ipx = 0; ipx < pb.size(); ++ipx )
+	if( pb[ipx].frm >= (int) cuts.frmwin[iw].first &&
+	    pb[ipx].frm <= (int) cuts.frmwin[iw].second )
+	  pbw.push_back( pb[ipx] );
+      clw[iw] = getClusq( pbw );
+      nlkw[iw].assign( clw[iw].size(), 0 );
+    } // windows
+
+    // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+    // make triplets 1+3-2:
+
+    for( int ipl = 1; ipl <= 6; ++ipl ) {
+      TelePlane p = { ptchx[ipl], ptchy[ipl], midx[ipl], midy[ipl],
+		      alignx[ipl], aligny[ipl], rotx[ipl], roty[ipl],
+		      zz[ipl] + alignz[ipl] };
+      pxy[ipl].fill( p, cl[ipl] ); // all hits at once
+    }
+
+    //double triCut = 0.1; // [mm]
+    double triCut = 0.05; // [mm] like tele
+
+    makeTriplets( pxy[1], pxy[2], pxy[3], 0.005*f, triCut, // angle cut *f?
+
+		  [&]( unsigned, unsigned, double dx2, double dy2 ) {
+		    tp.dx13.fill( dx2 );
+		    tp.dy13.fill( dy2 );
+		  },
+
+		  [&]( unsigned, double xB, double yB, double slpx, double slpy, double dxm, double dym ) {
+
+		    tp.tridx.fill( dxm );
+		    tp.tridy.fill( dym );
+
+		    if( fabs( dym ) < 0.05 ) {
+
+		      tp.tridxc.fill( dxm );
+		      tp.tridxvsx.fill( xB, dxm );
+		      tp.tridxvsy.fill( yB, dxm );
+		      tp.tridxvstx.fill( slpx, dxm );
+		      tp.tridxvst3.fill( evsec, dxm );
+		      tp.tridxvst5.fill( evsec, dxm );
+
+		    } // dy
+
+		    if( fabs( dxm ) < 0.05 ) {
+		      tp.tridyc.fill( dym );
+		      tp.tridyvsx.fill( xB, dym );
+		      tp.tridyvsty.fill( slpy, dym );
+		      tp.tridyvst3.fill( evsec, dym );
+		      tp.tridyvst5.fill( evsec, dym );
+		    }
+		  },
+
+		  [&]( unsigned jA, unsigned jB, unsigned jC,
+		       double avx, double avy, double avz, double slpx, double slpy ) {
+
+		    triplet tri;
+		    tri.xm = avx;
+		    tri.ym = avy;
+		    tri.zm = avz;
+		    tri.sx = slpx;
+		    tri.sy = slpy;
+		    tri.lk = 0;
+		    tri.ttdmin = 99.9; // isolation [mm]
+		    tri.iA = jA;
+		    tri.iB = jB;
+		    tri.iC = jC;
+
+		    triplets.push_back(tri);
+
+		    tp.trix.fill( avx );
+		    tp.triy.fill( avy );
+		    tp.tritx.fill( slpx );
+		    tp.trity.fill( slpy );
+		  } );
+
+    // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+    // make driplets 4+6-5:
+
+    //double driCut = 0.1; // [mm]
+    double driCut = 0.05; // [mm] like tele
+
+    makeTriplets( pxy[4], pxy[5], pxy[6], 0.005, driCut, // angle cut *f?
+
+		  [&]( unsigned, unsigned, double dx2, double dy2 ) {
+		    tp.dx46.fill( dx2 );
+		    tp.dy46.fill( dy2 );
+		  },
+
+		  [&]( unsigned, double xB, double yB, double slpx, double slpy, double dxm, double dym ) {
+
+		    tp.dridx.fill( dxm );
+		    tp.dridy.fill( dym );
+
+		    if( fabs( dym ) < 0.05 ) {
+		      tp.dridxc.fill( dxm );
+		      tp.dridxvsy.fill( yB, dxm );
+		      tp.dridxvstx.fill( slpx, dxm );
+		      tp.dridxvst3.fill( evsec, dxm );
+		      tp.dridxvst5.fill( evsec, dxm );
+		    }
+
+		    if( fabs( dxm ) < 0.05 ) {
+		      tp.dridyc.fill( dym );
+		      tp.dridyvsx.fill( xB, dym );
+		      tp.dridyvsty.fill( slpy, dym );
+		      tp.dridyvst3.fill( evsec, dym );
+		      tp.dridyvst5.fill( evsec, dym );
+		    }
+		  },
+
+		  [&]( unsigned jA, unsigned jB, unsigned jC,
+		       double avx, double avy, double avz, double slpx, double slpy ) {
+
+		    triplet dri;
+
+		    dri.xm = avx;
+		    dri.ym = avy;
+		    dri.zm = avz;
+		    dri.sx = slpx;
+		    dri.sy = slpy;
+		    dri.lk = 0;
+		    dri.ttdmin = 99.9; // isolation [mm]
+		    dri.iA = jA;
+		    dri.iB = jB;
+		    dri.iC = jC;
+
+		    driplets.push_back(dri);
+
+		    tp.drix.fill( avx );
+		    tp.driy.fill( avy );
+		    tp.dritx.fill( slpx );
+		    tp.drity.fill( slpy );
+		  } );
+
+  }; // reconstruct
+
+  int nbat = 0; // events in the batch
+  int kbat = 0; // next one for stage C
+  bool more = 1; // reader has events
+
+  // following a run: next() may wait for the writer, do not hold
+  // decoded events back meanwhile
+
+  int lbat = follow.on() ? 1 : maxbat;
+
+  do {
+
+    if( kbat == nbat ) { // next batch
 
-	    if( run == 35088 )
-	      //thr = 1; // 35088 dxc 26
-	      //thr = 3; // 35088 dxc 30
-	      thr = 2; // 35088 dxc 27
+      prof.lap( sdecode );
 
-	    if( run == 35695 )
-	      thr = 2;
+      nbat = 0;
+      while( nbat < lbat && more ) {
+	decode( bat[nbat], iev + nbat );
+	++nbat;
+	more = follow.next( *reader ) && iev + nbat < lev;
+      }
+      kbat = 0;
 
-	    if( px.tot < thr ) continue; // offline threshold
+      prof.lap( sreco );
 
-	    dutpxcol9Histo.Fill( ix + 0.5 );
+#pragma omp parallel for schedule(dynamic)
+      for( int k = 0; k < nbat; ++k )
+	reconstruct( bat[k], tbat[k] );
 
-	    if( !fifty ) 
-	    {  // 100x25 from ROC to sensor:
-	       px.col = ix/2; // 100 um
+    } // batch
 
-	       if( ix%2 == 1 ) 
-               {
-                 px.row = 2*iy + 1; //
-               }
-	       else
-               {
-		 px.row = 2*iy + 0; // see ed53 for shallow angle
-               }
-	       if( chip0 == 182 || chip0 == 211 || chip0 == 512 ) 
-               { // HLL
-		if( ix%2 )
-		  px.row = 2*iy + 1;
-		else
-		  px.row = 2*iy + 0;
-	       }
-	    }
+    // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+    // stage C, serial in event order:
 
-	  } // DUT
+    prof.lap( sfill );
 
-	  pb.push_back(px);
+    evwork & ev = bat[kbat];
+    ++kbat;
 
-	  hcol[ipl].Fill( ix ); // ROC
-	  hrow[ipl].Fill( iy );
-	  hmap[ipl]->Fill( ix, iy ); // after thr
+    double evsec = ev.evsec;
+    bool ldbg = ev.ldbg;
+    vector <cluster> * cl = ev.cl;
+    vector <int> * nlkw = ev.nlkw;
+    vector <cluster> * clw = ev.clw;
+    const vector <int> & iplseq = ev.iplseq;
+    vector <triplet> & triplets = ev.triplets;
+    vector <triplet> & driplets = ev.driplets;
 
-	} // pix
+    if( iev < 10 || ldbg )
+      cout << "scope53m processing  " << run << "." << iev << "  taken " << evsec << endl;
+    else if( iev < 100 && iev%10 == 0 )
+      cout << "scope53m processing  " << run << "." << iev << "  taken " << evsec << endl;
+    else if( iev < 1000 && iev%100 == 0 )
+      cout << "scope53m processing  " << run << "." << iev << "  taken " << evsec << endl;
+    else if( iev%1000 == 0 ) {
+      cout << "scope53m processing  " << run << "." << iev
+	   << "  taken " << evsec
+	   << "  modlk " << nmodlk
+	   << "  eff " << ngood*1E2/max(1,ntrck)
+	   << endl;
+      ngood = 0;
+      ntrck = 0;
+      nmodlk = 0;
+    }
 
-      if( ldbg ) cout << endl;
+    // cluster histograms, serial in readout order:
 
-      hnpxmsk[ipl].Fill( pb.size() ); // after masking
-      if( ipl == iDUT )
-	dutnpxvsev.Fill( iev, pb.size() );
+    int nplcl = iplseq.size();
 
-      // clustering:
+    for( int k = 0; k < nplcl; ++k ) {
 
-      if( ipl == iDUT )
-	cl[ipl] = getClusq( pb );
-      else
-	cl[ipl] = getClusn( pb );
+      int ipl = iplseq[k];
 
-      if( ldbg ) cout << "    clusters " << cl[ipl].size() << endl;
+      if( ldbg ) cout << "    plane " << ipl << " clusters " << cl[ipl].size() << endl;
 
       hncl[ipl].Fill( cl[ipl].size() );
 
       for( vector<cluster>::iterator c = cl[ipl].begin(); c != cl[ipl].end(); ++c ) {
-
 	hsiz[ipl].Fill( c->size );
 	hncol[ipl].Fill( c->ncol );
 	hnrow[ipl].Fill( c->nrow );
-
-	// cluster isolation:
-
-	vector<cluster>::iterator d = c; // upper diagonal
-	++d;
-	for( ; d != cl[ipl].end(); ++d ) {
-	  double dx = d->col - c->col;
-	  double dy = d->row - c->row;
-	  double dxy = sqrt( dx*dx + dy*dy );
-	  if( dxy < c->mindxy ) c->mindxy = dxy;
-	  if( dxy < d->mindxy ) d->mindxy = dxy;
-	}
-
-      } // cl
+      }
 
       for( vector<cluster>::iterator c = cl[ipl].begin(); c != cl[ipl].end(); ++c )
 	hdxy[ipl].Fill( c->mindxy );
 
-    } // eudaq planes
+    } // planes
+
+    for( unsigned jj = 0; jj < triplets.size(); ++jj ) // TH2: not in the shards
+      trixyHisto->Fill( triplets[jj].xm, triplets[jj].ym );
+    ntriHisto.Fill( triplets.size() );
+
+    for( unsigned jj = 0; jj < driplets.size(); ++jj )
+      drixyHisto->Fill( driplets[jj].xm, driplets[jj].ym );
+    ndriHisto.Fill( driplets.size() );
 
     // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
     // MOD:
 
+    prof.lap( smod );
+
     if( iev >= fev && modrun &&
 	Astream.good() && ! Astream.eof() &&
 	Bstream.good() && ! Bstream.eof()
@@ -3821,244 +3811,6 @@ int main( int argc, char* argv[] )
 
     } // DUT
 
-    // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-    // make triplets 1+3-2:
-
-    vector <triplet> triplets;
-
-    //double triCut = 0.1; // [mm]
-    double triCut = 0.05; // [mm] like tele
-
-    for( vector<cluster>::iterator cA = cl[1].begin(); cA != cl[1].end(); ++cA ) {
-
-      double xA = cA->col*ptchx[1] - alignx[1];
-      double yA = cA->row*ptchy[1] - aligny[1];
-      double xmid = xA - midx[1];
-      double ymid = yA - midy[1];
-      xA = xmid - ymid*rotx[1];
-      yA = ymid + xmid*roty[1];
-
-      double zA = zz[1] + alignz[1];
-      double zC = zz[3] + alignz[3];
-      double zB = zz[2] + alignz[2];
-
-      for( vector<cluster>::iterator cC = cl[3].begin(); cC != cl[3].end(); ++cC ) {
-
-	double xC = cC->col*ptchx[3] - alignx[3];
-	double yC = cC->row*ptchy[3] - aligny[3];
-	double xmid = xC - midx[3];
-	double ymid = yC - midy[3];
-	xC = xmid - ymid*rotx[3];
-	yC = ymid + xmid*roty[3];
-
-	double dx2 = xC - xA;
-	double dy2 = yC - yA;
-	double dzCA = zC - zA;
-	hdx13.Fill( dx2 );
-	hdy13.Fill( dy2 );
-
-	if( fabs( dx2 ) > 0.005*f * dzCA ) continue; // angle cut *f?
-	if( fabs( dy2 ) > 0.005*f * dzCA ) continue; // angle cut
-
-	double avx = 0.5 * ( xA + xC ); // mid
-	double avy = 0.5 * ( yA + yC );
-	double avz = 0.5 * ( zA + zC ); // mid z
- 
-	double slpx = ( xC - xA ) / dzCA; // slope x
-	double slpy = ( yC - yA ) / dzCA; // slope y
-
-	// middle plane B = 2:
-
-	for( vector<cluster>::iterator cB = cl[2].begin(); cB != cl[2].end(); ++cB ) {
-
-	  double xB = cB->col*ptchx[2] - alignx[2];
-	  double yB = cB->row*ptchy[2] - aligny[2];
-	  double xmid = xB - midx[2];
-	  double ymid = yB - midy[2];
-	  xB = xmid - ymid*rotx[2];
-	  yB = ymid + xmid*roty[2];
-
-	  // interpolate track to B:
-
-	  double dz = zB - avz;
-	  double xm = avx + slpx * dz; // triplet at mid
-	  double ym = avy + slpy * dz;
-
-	  double dxm = xB - xm;
-	  double dym = yB - ym;
-	  htridx.Fill( dxm );
-	  htridy.Fill( dym );
-
-	  if( fabs( dym ) < 0.05 ) {
-
-	    htridxc.Fill( dxm );
-	    tridxvsx.Fill( xB, dxm );
-	    tridxvsy.Fill( yB, dxm );
-	    tridxvstx.Fill( slpx, dxm );
-	    tridxvst3.Fill( evsec, dxm );
-	    tridxvst5.Fill( evsec, dxm );
-
-	  } // dy
-
-	  if( fabs( dxm ) < 0.05 ) {
-	    htridyc.Fill( dym );
-	    tridyvsx.Fill( xB, dym );
-	    tridyvsty.Fill( slpy, dym );
-	    tridyvst3.Fill( evsec, dym );
-	    tridyvst5.Fill( evsec, dym );
-	  }
-
-	  // telescope triplet cuts:
-
-	  if( fabs(dxm) > triCut ) continue;
-	  if( fabs(dym) > triCut ) continue;
-
-	  triplet tri;
-	  tri.xm = avx;
-	  tri.ym = avy;
-	  tri.zm = avz;
-	  tri.sx = slpx;
-	  tri.sy = slpy;
-	  tri.lk = 0;
-	  tri.ttdmin = 99.9; // isolation [mm]
-	  tri.iA = distance( cl[1].begin(), cA );
-	  tri.iB = distance( cl[2].begin(), cB );
-	  tri.iC = distance( cl[3].begin(), cC );
-
-	  triplets.push_back(tri);
-
-	  trixHisto.Fill( avx );
-	  triyHisto.Fill( avy );
-	  trixyHisto->Fill( avx, avy );
-	  tritxHisto.Fill( slpx );
-	  trityHisto.Fill( slpy );
-
-	} // cl B
-
-      } // cl C
-
-    } // cl A
-
-    ntriHisto.Fill( triplets.size() );
-
-    // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-    // make driplets 4+6-5:
-
-    vector <triplet> driplets;
-
-    //double driCut = 0.1; // [mm]
-    double driCut = 0.05; // [mm] like tele
-
-    for( vector<cluster>::iterator cA = cl[4].begin(); cA != cl[4].end(); ++cA ) {
-
-      double xA = cA->col*ptchx[4] - alignx[4];
-      double yA = cA->row*ptchy[4] - aligny[4];
-      double zA = zz[4] + alignz[4];
-      double xmid = xA - midx[4];
-      double ymid = yA - midy[4];
-      xA = xmid - ymid*rotx[4];
-      yA = ymid + xmid*roty[4];
-
-      double zC = zz[6] + alignz[6];
-      double zB = zz[5] + alignz[5];
-
-      for( vector<cluster>::iterator cC = cl[6].begin(); cC != cl[6].end(); ++cC ) {
-
-	double xC = cC->col*ptchx[6] - alignx[6];
-	double yC = cC->row*ptchy[6] - aligny[6];
-	double xmid = xC - midx[6];
-	double ymid = yC - midy[6];
-	xC = xmid - ymid*rotx[6];
-	yC = ymid + xmid*roty[6];
-
-	double dx2 = xC - xA;
-	double dy2 = yC - yA;
-	double dzCA = zC - zA; // from 4 to 6 in z
-	hdx46.Fill( dx2 );
-	hdy46.Fill( dy2 );
-
-	if( fabs( dx2 ) > 0.005 * dzCA ) continue; // angle cut *f?
-	if( fabs( dy2 ) > 0.005 * dzCA ) continue; // angle cut
-
-	double avx = 0.5 * ( xA + xC ); // mid
-	double avy = 0.5 * ( yA + yC );
-	double avz = 0.5 * ( zA + zC ); // mid z
- 
-	double slpx = ( xC - xA ) / dzCA; // slope x
-	double slpy = ( yC - yA ) / dzCA; // slope y
-
-	// middle plane B = 5:
-
-	for( vector<cluster>::iterator cB = cl[5].begin(); cB != cl[5].end(); ++cB ) {
-
-	  double xB = cB->col*ptchx[5] - alignx[5];
-	  double yB = cB->row*ptchy[5] - aligny[5];
-	  double xmid = xB - midx[5];
-	  double ymid = yB - midy[5];
-	  xB = xmid - ymid*rotx[5];
-	  yB = ymid + xmid*roty[5];
-
-	  // interpolate track to B:
-
-	  double dz = zB - avz;
-	  double xm = avx + slpx * dz; // driplet at m
-	  double ym = avy + slpy * dz;
-
-	  double dxm = xB - xm;
-	  double dym = yB - ym;
-	  hdridx.Fill( dxm );
-	  hdridy.Fill( dym );
-
-	  if( fabs( dym ) < 0.05 ) {
-	    hdridxc.Fill( dxm );
-	    dridxvsy.Fill( yB, dxm );
-	    dridxvstx.Fill( slpx, dxm );
-	    dridxvst3.Fill( evsec, dxm );
-	    dridxvst5.Fill( evsec, dxm );
-	  }
-
-	  if( fabs( dxm ) < 0.05 ) {
-	    hdridyc.Fill( dym );
-	    dridyvsx.Fill( xB, dym );
-	    dridyvsty.Fill( slpy, dym );
-	    dridyvst3.Fill( evsec, dym );
-	    dridyvst5.Fill( evsec, dym );
-	  }
-
-	  // telescope driplet cuts:
-
-	  if( fabs(dxm) > driCut ) continue;
-	  if( fabs(dym) > driCut ) continue;
-
-	  triplet dri;
-
-	  dri.xm = avx;
-	  dri.ym = avy;
-	  dri.zm = avz;
-	  dri.sx = slpx;
-	  dri.sy = slpy;
-	  dri.lk = 0;
-	  dri.ttdmin = 99.9; // isolation [mm]
-	  dri.iA = distance( cl[4].begin(), cA );
-	  dri.iB = distance( cl[5].begin(), cB );
-	  dri.iC = distance( cl[6].begin(), cC );
-
-	  driplets.push_back(dri);
-
-	  drixHisto.Fill( avx );
-	  driyHisto.Fill( avy );
-	  drixyHisto->Fill( avx, avy );
-	  dritxHisto.Fill( slpx );
-	  drityHisto.Fill( slpy );
-
-	} // cl B
-
-      } // cl C
-
-    } // cl A
-
-    ndriHisto.Fill( driplets.size() );
-
     // debug for Mod sync:
 
     if( ldbmod )
@@ -4079,6 +3831,57 @@ int main( int argc, char* argv[] )
     // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
     // triplets vs MOD and DUT:
 
+    prof.lap( smatch );
+    prof.count( "triplets", triplets.size() );
+    prof.count( "driplets", driplets.size() );
+
+    // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+    // grids for tri vs tri isolation:
+
+    double trismax = 0; // max slope, for intercepts off DUTz
+
+    trixg.resize( triplets.size() );
+    triyg.resize( triplets.size() );
+
+    for( unsigned int jj = 0; jj < triplets.size(); ++jj ) {
+      double dz = MODz - triplets[jj].zm;
+      trixg[jj] = triplets[jj].xm + triplets[jj].sx * dz;
+      triyg[jj] = triplets[jj].ym + triplets[jj].sy * dz;
+    }
+    trigridmod.build( trixg, triyg, 1.0 );
+
+    for( unsigned int jj = 0; jj < triplets.size(); ++jj ) {
+      double dz = DUTz - triplets[jj].zm;
+      trixg[jj] = triplets[jj].xm + triplets[jj].sx * dz;
+      triyg[jj] = triplets[jj].ym + triplets[jj].sy * dz;
+      trismax = max( trismax, max( fabs( triplets[jj].sx ), fabs( triplets[jj].sy ) ) );
+    }
+    trigriddut.build( trixg, triyg, 1.0 );
+
+    if( lmodgrid ) {
+      modxg.resize( cl[iMOD].size() );
+      modyg.resize( cl[iMOD].size() );
+      for( unsigned ic = 0; ic < cl[iMOD].size(); ++ic ) {
+	modxg[ic] = ( cl[iMOD][ic].col + 0.5 - nx[iMOD]/2 ) * ptchx[iMOD];
+	modyg[ic] = ( cl[iMOD][ic].row + 0.5 - ny[iMOD]/2 ) * ptchy[iMOD];
+      }
+      modgrid.build( modxg, modyg, 1.0 );
+    }
+
+    if( ldutgrid ) {
+      dutxg.resize( cl[iDUT].size() );
+      dutyg.resize( cl[iDUT].size() );
+      for( unsigned ic = 0; ic < cl[iDUT].size(); ++ic ) {
+	dutxg[ic] = ( cl[iDUT][ic].col + 0.5 - nx[iDUT]/2 ) * ptchx[iDUT];
+	dutyg[ic] = ( cl[iDUT][ic].row + 0.5 - ny[iDUT]/2 ) * ptchy[iDUT];
+	if( rot90 ) {
+	  dutxg[ic] = ( cl[iDUT][ic].row + 0.5 - ny[iDUT]/2 ) * ptchy[iDUT];
+	  dutyg[ic] =-( cl[iDUT][ic].col + 0.5 - nx[iDUT]/2 ) * ptchx[iDUT]; // as dutdy
+	}
+      }
+      dutgrid.build( dutxg, dutyg, 1.0 );
+    }
+
     int nmdm = 0;
     int ntrimod = 0;
 
@@ -4117,28 +3920,26 @@ int main( int argc, char* argv[] )
       // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
       // tri vs tri: isolation at MOD
 
-      double ttdminmod = 99.9;
-
-      for( unsigned int jj = 0; jj < triplets.size(); ++jj ) {
+      // only nearby cells, same result as the loop over all triplets
 
-	if( jj == iA ) continue;
+      double ttdminmod =
+	trigridmod.nearest( xB, yB, 99.9, 0,
+			    [&]( int jj ) {
+			      if( jj == int(iA) ) return -1.0;
 
-	double xmj = triplets[jj].xm;
-	double ymj = triplets[jj].ym;
-	double sxj = triplets[jj].sx;
-	double syj = triplets[jj].sy;
+			      double xmj = triplets[jj].xm;
+			      double ymj = triplets[jj].ym;
+			      double sxj = triplets[jj].sx;
+			      double syj = triplets[jj].sy;
 
-	double dz = MODz - triplets[jj].zm;
-	double xj = xmj + sxj * dz; // triplet impact point on MOD
-	double yj = ymj + syj * dz;
+			      double dz = MODz - triplets[jj].zm;
+			      double xj = xmj + sxj * dz; // triplet impact point on MOD
+			      double yj = ymj + syj * dz;
 
-	double dx = xB - xj;
-	double dy = yB - yj;
-	double dd = sqrt( dx*dx + dy*dy );
-	if( dd < ttdminmod )
-	  ttdminmod = dd;
-
-      } // jj
+			      double dx = xB - xj;
+			      double dy = yB - yj;
+			      return sqrt( dx*dx + dy*dy );
+			    } );
 
       ttdminmod1Histo.Fill( ttdminmod );
       ttdminmod2Histo.Fill( ttdminmod );
@@ -4179,7 +3980,22 @@ int main( int argc, char* argv[] )
 
       bool ltrimod = 0;
 
-      for( vector<cluster>::iterator c = cl[iMOD].begin(); c != cl[iMOD].end(); ++c ) {
+      lkcand.clear();
+      if( lmodgrid ) {
+	modgrid.visit( x4m, y4m, wgridlk, [&]( int ic ) { lkcand.push_back( ic ); } );
+	sort( lkcand.begin(), lkcand.end() ); // cluster order
+      }
+      else
+	for( unsigned ic = 0; ic < cl[iMOD].size(); ++ic )
+	  lkcand.push_back( ic );
+
+      for( unsigned kc = 0; kc < lkcand.size(); ++kc ) {
+
+	vector<cluster>::iterator c = cl[iMOD].begin() + lkcand[kc];
+
+	if( lmodgrid && ( fabs( modxg[lkcand[kc]] - x4m ) > wgridlk ||
+			  fabs( modyg[lkcand[kc]] - y4m ) > wgridlk ) )
+	  continue; // in a grid cell nearby, but outside
 
 	double ccol = c->col;
 	double crow = c->row;
@@ -4202,6 +4018,12 @@ int main( int argc, char* argv[] )
 	double moddx = modx - x4m;
 	double moddy = mody - y4m;
 
+	if( lmemalign && fabs( moddx ) < wmodap && fabs( moddy ) < wmodap ) {
+	  AlignCand ac = { float(xmA), float(ymA), float(zmA), float(sxA), float(syA),
+			   float(modx), float(mody), 0, 0 };
+	  modap.add( ac );
+	}
+
 	moddxHisto.Fill( moddx );
 	moddyHisto.Fill( moddy );
 
@@ -4303,6 +4125,9 @@ int main( int argc, char* argv[] )
       double x4 = upsignx*x3 + DUTalignx; // shift to mid
       double y4 = upsigny*y3 + DUTaligny; // shift to mid
 
+      AlignCand actri = { float(xmA), float(ymA), float(zmA), float(sxA), float(syA),
+			  0, 0, float(DUTalignx-DUTalignx0), float(DUTaligny-DUTaligny0) };
+
       double xmod = fmod( 9.000 + x4, 0.100 ); // [0,0.100] mm
       double ymod = fmod( 9.000 + y4, 0.100 ); // [0,0.100] mm
       double xmod2 = fmod( 9.000 + x4, 0.200 ); // [0,0.200] mm
@@ -4318,28 +4143,26 @@ int main( int argc, char* argv[] )
       // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
       // tri vs tri: isolation at DUT
 
-      double ttdmin = 99.9;
+      // grid at DUTz: intercepts at the tilted DUT differ by slope * dzc
 
-      for( unsigned int jj = 0; jj < triplets.size(); ++jj ) {
+      double ttdmin =
+	trigriddut.nearest( xc, yc, 99.9, 2*trismax*fabs( zc + zmA - DUTz ),
+			    [&]( int jj ) {
+			      if( jj == int(iA) ) return -1.0;
 
-	if( jj == iA ) continue;
+			      double xmj = triplets[jj].xm;
+			      double ymj = triplets[jj].ym;
+			      double sxj = triplets[jj].sx;
+			      double syj = triplets[jj].sy;
 
-	double xmj = triplets[jj].xm;
-	double ymj = triplets[jj].ym;
-	double sxj = triplets[jj].sx;
-	double syj = triplets[jj].sy;
+			      double dz = zc + zmA - triplets[jj].zm;
+			      double xj = xmj + sxj * dz; // triplet impact point on DUT
+			      double yj = ymj + syj * dz;
 
-	double dz = zc + zmA - triplets[jj].zm;
-	double xj = xmj + sxj * dz; // triplet impact point on DUT
-	double yj = ymj + syj * dz;
-
-	double dx = xc - xj;
-	double dy = yc - yj;
-	double dd = sqrt( dx*dx + dy*dy );
-	if( dd < ttdmin )
-	  ttdmin = dd;
-
-      } // jj
+			      double dx = xc - xj;
+			      double dy = yc - yj;
+			      return sqrt( dx*dx + dy*dy );
+			    } );
 
       ttdmin1Histo.Fill( ttdmin );
       ttdmin2Histo.Fill( ttdmin );
@@ -4350,32 +4173,16 @@ int main( int argc, char* argv[] )
 
       double sixcut = 0.1; // [mm]
 
-      for( unsigned int jB = 0; jB < driplets.size(); ++jB ) { // j = B = downstream
+      // driplets at the DUT intersect:
+
+      matchAt( driplets, zc + zmA, xc, yc,
+	       [&]( unsigned jB, double xd, double yd, double dx, double dy ) { // j = B = downstream
 
-	double xmB = driplets[jB].xm;
-	double ymB = driplets[jB].ym;
-	double zmB = driplets[jB].zm;
 	double sxB = driplets[jB].sx;
 	double syB = driplets[jB].sy;
 
-	// driplet at z DUT:
-	/*
-	  double zB = DUTz - zmB; // z from mid of triplet to mid
-	  double xB = xmB + sxB * zB; // triplet at mid
-	  double yB = ymB + syB * zB;
-	*/
-	// driplet at DUT:
-
-	double zd = zc + zmA - zmB; // z from mid of driplet to DUT intersect
-	double xd = xmB + sxB * zd; // driplet at DUT
-	double yd = ymB + syB * zd;
-
 	// driplet - triplet:
 
-	//double dx = xB - xA; // at DUT
-	//double dy = yB - yA;
-	double dx = xd - xc; // at DUT intersect
-	double dy = yd - yc;
 	//double dxy = sqrt( dx*dx + dy*dy );
 	double dtx = sxB - sxA;
 	double dty = syB - syA;
@@ -4473,6 +4280,10 @@ int main( int argc, char* argv[] )
 	    x4 = x8;
 	    y4 = y8;
 
+	    actri.xm = xa; // six track
+	    actri.ym = ya;
+	    actri.zm = zc + zmA;
+
 	    xmod = fmod( 9.000 + x4, 0.100 ); // [0,0.100] mm
 	    ymod = fmod( 9.000 + y4, 0.100 ); // [0,0.100] mm
 
@@ -4492,7 +4303,7 @@ int main( int argc, char* argv[] )
 
 	} // six match
 
-      } // driplets
+      } ); // driplets
 
       // Coordinates for the cell histograms
       hcell1.add_coordinates(x4*1E3, y4*1E3);
@@ -4543,7 +4354,22 @@ int main( int argc, char* argv[] )
       double dxmin = 99;
       double dymin = 99;
 
-      for( vector<cluster>::iterator c = cl[iDUT].begin(); c != cl[iDUT].end(); ++c ) {
+      lkcand.clear();
+      if( ldutgrid ) {
+	dutgrid.visit( x4, y4, wgridlk, [&]( int ic ) { lkcand.push_back( ic ); } );
+	sort( lkcand.begin(), lkcand.end() ); // cluster order
+      }
+      else
+	for( unsigned ic = 0; ic < cl[iDUT].size(); ++ic )
+	  lkcand.push_back( ic );
+
+      for( unsigned kc = 0; kc < lkcand.size(); ++kc ) {
+
+	vector<cluster>::iterator c = cl[iDUT].begin() + lkcand[kc];
+
+	if( ldutgrid && ( fabs( dutxg[lkcand[kc]] - x4 ) > wgridlk ||
+			  fabs( dutyg[lkcand[kc]] - y4 ) > wgridlk ) )
+	  continue; // in a grid cell nearby, but outside
 
 	double ccol = c->col;
 	double crow = c->row;
@@ -4579,6 +4405,12 @@ int main( int argc, char* argv[] )
 	double dutdy = duty - y4;
 	if( rot90 ) dutdy = -duty - y4;
 
+	if( lmemalign && fabs( dutdx ) < wdutap && fabs( dutdy ) < wdutap ) {
+	  actri.cx = dutx;
+	  actri.cy = rot90 ? -duty : duty;
+	  dutap.add( actri );
+	}
+
 	dutdxHisto.Fill( dutdx );
 	dutdyHisto.Fill( dutdy );
 
@@ -4604,6 +4436,13 @@ int main( int argc, char* argv[] )
 	  dutdxvsx.Fill( x4, dutdx ); // for turn
 	  dutdxvsy.Fill( y4, dutdx ); // for rot
 	  dutdxvstx.Fill( sxA, dutdx );
+	  if( lzscan )
+	    for( int iz = 1; iz <= dutzscanx.GetNbinsX(); ++iz ) {
+	      double zs = dutzscanx.GetBinCenter(iz);
+	      double rx = dutdx - sxA*zs;
+	      if( fabs( rx ) < xcutDUT )
+		dutzscanx.Fill( zs, fabs(rx) );
+	    }
 	  if( x4 < 0 )
 	    dutdxvstx0.Fill( sxA, dutdx );
 	  else
@@ -4632,6 +4471,13 @@ int main( int argc, char* argv[] )
 	  dutdyvsx.Fill( x4, dutdy ); // for rot
 	  dutdyvsy.Fill( y4, dutdy ); // for tilt
 	  dutdyvsty.Fill( syA, dutdy );
+	  if( lzscan )
+	    for( int iz = 1; iz <= dutzscany.GetNbinsX(); ++iz ) {
+	      double zs = dutzscany.GetBinCenter(iz);
+	      double ry = dutdy - syA*zs;
+	      if( fabs( ry ) < ycutDUT )
+		dutzscany.Fill( zs, fabs(ry) );
+	    }
 	  dutdyvsxm.Fill( xmod*1E3, dutdy );
 	  dutdyvsym.Fill( ymod*1E3, dutdy );
 	  dutdyvsxmym->Fill( xmod*1E3, ymod*1E3, dutdy );
@@ -5165,6 +5011,55 @@ int main( int argc, char* argv[] )
 	if( pdmin < iw*0.010 ) // 10 um bins
 	  nm[iw] = 1; // eff
 
+      // same link and nearest pixel per frame window:
+
+      double pdminw[maxwin];
+
+      for( unsigned iw = 0; iw < nwin; ++iw ) {
+
+	pdminw[iw] = 19;
+
+	for( unsigned jc = 0; jc < clw[iw].size(); ++jc ) {
+
+	  cluster * c = &clw[iw][jc];
+
+	  double dutx = ( c->col + 0.5 - nx[iDUT]/2 ) * ptchx[iDUT]; // mm
+	  double duty = ( c->row + 0.5 - ny[iDUT]/2 ) * ptchy[iDUT]; // mm
+	  if( rot90 ) {
+	    dutx = ( c->row + 0.5 - ny[iDUT]/2 ) * ptchy[iDUT]; // mm
+	    duty = ( c->col + 0.5 - nx[iDUT]/2 ) * ptchx[iDUT]; // mm
+	  }
+
+	  double dutdx = dutx - x4;
+	  double dutdy = duty - y4;
+	  if( rot90 ) dutdy = -duty - y4;
+
+	  if( fabs( dutdy ) < ycutDUT )
+	    dutdxcwHisto[iw].Fill( dutdx );
+	  if( fabs( dutdx ) < xcutDUT )
+	    dutdycwHisto[iw].Fill( dutdy );
+	  if( fabs( dutdx ) < xcutDUT && fabs( dutdy ) < ycutDUT )
+	    ++nlkw[iw][jc];
+
+	  for( unsigned ipx = 0; ipx < c->vpix.size(); ++ipx ) {
+
+	    double px = ( c->vpix[ipx].col + 0.5 - nx[iDUT]/2 ) * ptchx[iDUT]; // mm
+	    double py = ( c->vpix[ipx].row + 0.5 - ny[iDUT]/2 ) * ptchy[iDUT]; // mm
+	    if( rot90 ) {
+	      px = ( c->vpix[ipx].row + 0.5 - ny[iDUT]/2 ) * ptchy[iDUT]; // mm
+	      py =-( c->vpix[ipx].col + 0.5 - nx[iDUT]/2 ) * ptchx[iDUT]; // mm
+	    }
+	    double pdx = px - x4;
+	    double pdy = py - y4;
+	    double pdxy = sqrt( pdx*pdx + pdy*pdy );
+	    if( pdxy < pdminw[iw] ) pdminw[iw] = pdxy;
+
+	  } // pix
+
+	} // clw
+
+      } // iw
+
       if( nm[49] )
 	dutxylkHisto->Fill( x4, y4 ); // tracks with cluster link
 
@@ -5273,6 +5168,9 @@ int main( int argc, char* argv[] )
 	      ++ntrck;
 	      ngood += nm[49];
 
+	      for( unsigned iw = 0; iw < nwin; ++iw )
+		effvswin.Fill( iw, pdminw[iw] < 49*0.010 ); // as nm[49]
+
 	      dutpdminHisto.Fill( pdmin );
 
 	      for( int iw = 1; iw < 99; ++iw )
@@ -5312,15 +5210,46 @@ int main( int argc, char* argv[] )
     dutlkvst5.Fill( evsec, nmtd );
     ntrilkHisto.Fill( ntrilk ); // DUT links
 
+    for( unsigned iw = 0; iw < nwin; ++iw ) {
+      int nnoise = 0;
+      for( unsigned jc = 0; jc < nlkw[iw].size(); ++jc )
+	if( nlkw[iw][jc] == 0 )
+	  ++nnoise;
+      dutnclwHisto[iw].Fill( nnoise );
+      dutnoisevswin.Fill( iw, nnoise );
+    }
+
     ++iev;
 
-  } while( reader->NextEvent() && iev < lev );
+    prof.endEvent();
+
+    follow.event();
+
+  } while( kbat < nbat || more );
 
   delete reader;
 
+  mergeShards();
+
   cout << "done after " << iev << " events" << endl;
-  histoFile.Write();
+
+  cout << endl << "DUT frame windows:" << endl;
+  for( unsigned iw = 0; iw < nwin; ++iw )
+    cout << "  BC " << setw(2) << cuts.frmwin[iw].first
+	 << "-" << setw(2) << cuts.frmwin[iw].second
+	 << "  eff " << effvswin.GetBinContent(iw+1)*1E2
+	 << " % of " << effvswin.GetBinEntries(iw+1)
+	 << "  noise " << dutnoisevswin.GetBinContent(iw+1) << " cl/ev"
+	 << "  rms x " << dutdxcwHisto[iw].GetRMS()*1E3
+	 << " y " << dutdycwHisto[iw].GetRMS()*1E3 << " um"
+	 << endl;
+
+  prof.start( soutput );
+  histoFile.Write( "", TObject::kOverwrite ); // over the follow snapshots
   //histoFile->Close();
+  prof.stop( soutput );
+
+  prof.start( salign );
 
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
   // MOD alignment:
@@ -5592,6 +5521,19 @@ int main( int argc, char* argv[] )
 
     } // finer y
 
+    // all iterations from the cached links:
+
+    if( lmemalign && modap.iterate( MODaligniteration == 0, 9, "MOD", wmodap ) ) {
+      newMODalignx = modap.alx;
+      newMODaligny = modap.aly;
+      MODrot = modap.rot;
+      MODtilt = modap.tilt;
+      MODturn = modap.turn;
+      MODz = modap.z;
+      if( MODaligniteration < 2 )
+	MODaligniteration = 2;
+    }
+
     // write new MOD alignment:
 
     ofstream MODalignFile( MODalignFileName.str() );
@@ -5694,6 +5636,7 @@ int main( int argc, char* argv[] )
 	   << endl << " BG " << fgp0->GetParameter(3)
 	   << endl;
       DUTalignx0 += fgp0->GetParameter(1);
+      delete fgp0;
 
     }
     else
@@ -5721,6 +5664,7 @@ int main( int argc, char* argv[] )
 	   << endl << " BG " << fgp0->GetParameter(3)
 	   << endl;
       DUTaligny0 += fgp0->GetParameter(1);
+      delete fgp0;
 
     }
     else
@@ -5879,7 +5823,9 @@ int main( int argc, char* argv[] )
 
     } // tilt
 
-    if( ( rot90 || fifty ) ) {
+    if( lzscan ) // dz from scan below
+      ;
+    else if( rot90 || fifty ) {
 
       // dxvstx => dz:
 
@@ -5952,6 +5898,48 @@ int main( int argc, char* argv[] )
 
   } // iteration > 1
 
+  // z from scan, one iteration earlier than the fits:
+
+  if( lzscan && DUTaligniteration > 0 ) {
+
+    TProfile * zscan = &dutzscany;
+    if( rot90 || fifty )
+      zscan = &dutzscanx;
+
+    int ibest;
+    double dz = zscanbest( *zscan, ibest, 11 );
+
+    cout << endl << zscan->GetTitle();
+    if( ibest == 0 )
+      cout << ": not enough" << endl;
+    else {
+      if( ibest == 1 || ibest == zscan->GetNbinsX() )
+	cout << " at edge of scan";
+      cout << ": z shift " << dz << " mm"
+	   << ", MAD " << zscan->GetBinContent(ibest)*1E3 << " um"
+	   << endl;
+      DUTz += dz;
+    }
+
+  } // zscan
+
+  // all iterations from the cached links, replaces the above:
+
+  bool lmemok = 0;
+
+  if( lmemalign &&
+      dutap.iterate( DUTaligniteration == 0, 9, "DUT", wdutap ) ) {
+    DUTalignx0 = dutap.alx;
+    DUTaligny0 = dutap.aly;
+    DUTrot = dutap.rot;
+    DUTtilt = dutap.tilt;
+    DUTturn = dutap.turn;
+    DUTz = dutap.z;
+    if( DUTaligniteration < 2 )
+      DUTaligniteration = 2;
+    lmemok = 1;
+  }
+
   cout << endl
        << "DUT efficiency " << 100*effvst5.GetMean(2) << "%"
        << " from " << effvst5.GetEntries() << " in-time tracks"
@@ -5974,7 +5962,9 @@ int main( int argc, char* argv[] )
   string ans{"n"};
   string YES{"y"};
 
-  if( ldbmod == 0 && fabs(DUTturn) < 66 )
+  if( lmemok )
+    ans = YES;
+  else if( ldbmod == 0 && fabs(DUTturn) < 66 )
     cin >> ans;
 
   if( ans == YES ) {
@@ -6044,12 +6034,23 @@ int main( int argc, char* argv[] )
       DUThotFile.close();
   }
 
+  prof.stop( salign );
+
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
   // done
 
   cout << endl << histoFile.GetName() << endl;
 
+  prof.report( cout );
+  prof.write( StageProf::fileNameFor( rootFileName.str() ) );
+
   cout << endl;
 
   return 0;
 }
+
+//------------------------------------------------------------------------------
+int main( int argc, char* argv[] )
+{
+  return multiRun( argc, argv, analyseRun ); // last arg: run or run list
+}
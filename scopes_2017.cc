@@ -30,6 +30,12 @@
 #include <fstream> // filestream
 #include <set>
 #include <cmath>
+#include <algorithm> // sort
+
+#include "gridindex.h"
+#include "stageprof.h"
+#include "telecore.h" // clustering, hot pixels
+#include "r4scm.h" // R4S common mode, gain
 
 using namespace std;
 using namespace eudaq;
@@ -80,48 +86,9 @@ vector < cluster > getClus()
   const int fCluCut = 1; // clustering: 1 = no gap (15.7.2012)
   //const int fCluCut = 2;
 
-  vector < cluster > v;
-  if( fNHit == 0 ) return v;
-
-  int* gone = new int[fNHit];
-
-  for( int i = 0; i < fNHit; ++i )
-    gone[i] = 0;
-
-  int seed = 0;
+  return clusterPixels<cluster>( pb, fNHit, NearSquare( fCluCut ), []( cluster & c ) {
 
-  while( seed < fNHit ) {
-
-    // start a new cluster
-
-    cluster c;
-    c.vpix.push_back( pb[seed] );
-    gone[seed] = 1;
-
-    // let it grow as much as possible:
-
-    int growing;
-    do {
-      growing = 0;
-      for( int i = 0; i < fNHit; ++i ) {
-        if( !gone[i] ){ // unused pixel
-          for( unsigned int p = 0; p < c.vpix.size(); ++p ) { // vpix in cluster so far
-            int dr = c.vpix.at(p).row - pb[i].row;
-            int dc = c.vpix.at(p).col - pb[i].col;
-            if( (   dr>=-fCluCut) && (dr<=fCluCut) 
-		&& (dc>=-fCluCut) && (dc<=fCluCut) ) {
-              c.vpix.push_back(pb[i]);
-	      gone[i] = 1;
-              growing = 1;
-              break; // important!
-            }
-          } // loop over vpix
-        } // not gone
-      } // loop over all pix
-    }
-    while( growing );
-
-    // added all I could. determine position and append it to the list of clusters:
+    // added all I could. determine position:
 
     c.size = c.vpix.size();
     c.col = 0;
@@ -162,18 +129,7 @@ vector < cluster > getClus()
     c.ncol = maxx-minx+1;
     c.nrow = maxy-miny+1;
 
-    v.push_back(c); // add cluster to vector
-
-    // look for a new seed = used pixel:
-
-    while( (++seed < fNHit) && gone[seed] );
-
-  } // while over seeds
-
-  // nothing left, return clusters
-
-  delete gone;
-  return v;
+  } );
 }
 
 //------------------------------------------------------------------------------
@@ -357,117 +313,21 @@ int main( int argc, char* argv[] )
   for( int ipl = 0; ipl < 10; ++ipl )
     nx[ipl] = 0; // missing plane flag
 
-  ifstream geoFile( geoFileName );
-
   cout << endl;
 
-  if( geoFile.bad() || ! geoFile.is_open() ) {
+  if( ! readGeo( geoFileName, 0, 8,
+		 nx, ny, sizex, sizey, zz, ptchx, ptchy, midx, midy ) ) {
     cout << "Error opening " << geoFileName << endl;
     return 1;
   }
 
-  cout << "read geometry from " << geoFileName << endl;
-
-  { // open local scope
-
-    string hash( "#" );
-    string plane( "plane" );
-    string type( "type" );
-    string sizexs( "sizex" );
-    string sizeys( "sizey" );
-    string npixelx( "npixelx" );
-    string npixely( "npixely" );
-    string zpos( "zpos" );
-
-    int ipl = 0;
-    string chiptype;
-
-    while( ! geoFile.eof() ) {
-
-      string line;
-      getline( geoFile, line );
-      cout << line << endl;
-
-      if( line.empty() ) continue;
-
-      stringstream tokenizer( line );
-      string tag;
-      tokenizer >> tag; // leading white space is suppressed
-      if( tag.substr(0,1) == hash ) // comments start with #
-	continue;
-
-      if( tag == plane ) {
-	tokenizer >> ipl;
-	continue;
-      }
-
-      if( ipl < 0 || ipl > 9 ) {
-	cout << "wrong plane number " << ipl << endl;
-	continue;
-      }
-
-      if( tag == type ) {
-	tokenizer >> chiptype;
-	continue;
-      }
-
-      if( tag == sizexs ) {
-	double val;
-	tokenizer >> val;
-	sizex[ipl] = val;
-	continue;
-      }
-
-      if( tag == sizeys ) {
-	double val;
-	tokenizer >> val;
-	sizey[ipl] = val;
-	continue;
-      }
-
-      if( tag == npixelx ) {
-	int val;
-	tokenizer >> val;
-	nx[ipl] = val;
-	continue;
-      }
-
-      if( tag == npixely ) {
-	int val;
-	tokenizer >> val;
-	ny[ipl] = val;
-	continue;
-      }
-
-      if( tag == zpos ) {
-	double val;
-	tokenizer >> val;
-	zz[ipl] = val;
-	continue;
-      }
-
-      // anything else on the line and in the file gets ignored
-
-    } // while getline
-
-    for( int ipl = 0; ipl < 10; ++ipl ) {
-      if( nx[ipl] == 0 ) continue; // missing plane flag
-      ptchx[ipl] = sizex[ipl] / nx[ipl]; // pixel size
-      ptchy[ipl] = sizey[ipl] / ny[ipl];
-      midx[ipl] = 0.5 * sizex[ipl]; // mid plane
-      midy[ipl] = 0.5 * sizey[ipl]; // mid plane
-    }
-
-  } // geo scope
-
-  geoFile.close();
-
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
   // alignments:
 
   int aligniteration = 0;
   double alignx[10];
   double aligny[10];
+  double alignz[10];
   double rotx[10];
   double roty[10];
 
@@ -475,73 +335,15 @@ int main( int argc, char* argv[] )
 
   alignFileName << "align_" << run << ".dat";
 
-  ifstream ialignFile( alignFileName.str() );
-
   cout << endl;
 
-  if( ialignFile.bad() || ! ialignFile.is_open() ) {
+  if( ! readAlign( alignFileName.str(), 1, 8,
+		   aligniteration, alignx, aligny, alignz, rotx, roty ) ) {
     cout << "Error opening " << alignFileName.str() << endl
 	 << "  please do: tele -g " << geoFileName << " " << run << endl
 	 << endl;
     return 1;
   }
-  else {
-
-    cout << "read alignment from " << alignFileName.str() << endl;
-
-    string hash( "#" );
-    string iteration( "iteration" );
-    string plane( "plane" );
-    string shiftx( "shiftx" );
-    string shifty( "shifty" );
-    string rotxvsy( "rotxvsy" );
-    string rotyvsx( "rotyvsx" );
-
-    int ipl = 0;
-
-    while( ! ialignFile.eof() ) {
-
-      string line;
-      getline( ialignFile, line );
-      cout << line << endl;
-
-      if( line.empty() ) continue;
-
-      stringstream tokenizer( line );
-      string tag;
-      tokenizer >> tag; // leading white space is suppressed
-      if( tag.substr(0,1) == hash ) // comments start with #
-	continue;
-
-      if( tag == iteration ) 
-	tokenizer >> aligniteration;
-
-      if( tag == plane )
-	tokenizer >> ipl;
-
-      if( ipl < 1 || ipl > 9 ) {
-	cout << "wrong plane number " << ipl << endl;
-	continue;
-      }
-
-      double val;
-      tokenizer >> val;
-      if(      tag == shiftx )
-	alignx[ipl] = val;
-      else if( tag == shifty )
-	aligny[ipl] = val;
-      else if( tag == rotxvsy )
-	rotx[ipl] = val;
-      else if( tag == rotyvsx )
-	roty[ipl] = val;
-
-      // anything else on the line and in the file gets ignored
-
-    } // while getline
-
-  } // alignFile
-
-  ialignFile.close();
 
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
   // hot pixels:
@@ -550,58 +352,10 @@ int main( int argc, char* argv[] )
 
   hotFileName << "hot_" << run << ".dat";
 
-  ifstream ihotFile( hotFileName.str() );
-
   set <int> hotset[10];
 
-  if( ihotFile.bad() || ! ihotFile.is_open() ) {
+  if( ! readHotPixels( hotFileName.str(), ny, hotset, 1, 6 ) )
     cout << "no " << hotFileName.str() << " (created by tele)" << endl;
-  }
-  else {
-
-    cout << "read hot pixel list from " << hotFileName.str() << endl;
-
-    string hash( "#" );
-    string plane( "plane" );
-    string pix( "pix" );
-
-    int ipl = 1;
-
-    while( ! ihotFile.eof() ) {
-
-      string line;
-      getline( ihotFile, line );
-      //cout << line << endl;
-
-      if( line.empty() ) continue;
-
-      stringstream tokenizer( line );
-      string tag;
-      tokenizer >> tag; // leading white space is suppressed
-      if( tag.substr(0,1) == hash ) // comments start with #
-	continue;
-
-      if( tag == plane )
-	tokenizer >> ipl;
-
-      if( ipl < 1 || ipl > 6 ) {
-	//cout << "wrong plane number " << ipl << endl;
-	continue;
-      }
-
-      if( tag == pix ) {
-	int ix, iy;
-	tokenizer >> ix;
-	tokenizer >> iy;
-	int ipx = ix*ny[ipl]+iy;
-	hotset[ipl].insert(ipx);
-      }
-
-    } // while getline
-
-  } // hotFile
-
-  ihotFile.close();
 
   for( int ipl = 1; ipl <= 6; ++ipl )
     cout << ipl << ": hot " << hotset[ipl].size() << endl;
@@ -661,65 +415,11 @@ int main( int argc, char* argv[] )
 
   DUTalignFileName << "alignDUT_" << run << ".dat";
 
-  ifstream iDUTalignFile( DUTalignFileName.str() );
-
   cout << endl;
 
-  if( iDUTalignFile.bad() || ! iDUTalignFile.is_open() ) {
+  if( ! readDUTAlign( DUTalignFileName.str(), DUTaligniteration,
+		      DUTalignx, DUTaligny, DUTrot, DUTtilt, DUTturn, DUTz, zz[3] ) )
     cout << "no " << DUTalignFileName.str() << ", will bootstrap" << endl;
-  }
-  else {
-
-    cout << "read DUTalignment from " << DUTalignFileName.str() << endl;
-
-    string hash( "#" );
-    string iteration( "iteration" );
-    string alignx( "alignx" );
-    string aligny( "aligny" );
-    string rot( "rot" );
-    string tilt( "tilt" );
-    string turn( "turn" );
-    string dz( "dz" );
-
-    while( ! iDUTalignFile.eof() ) {
-
-      string line;
-      getline( iDUTalignFile, line );
-      cout << line << endl;
-
-      if( line.empty() ) continue;
-
-      stringstream tokenizer( line );
-      string tag;
-      tokenizer >> tag; // leading white space is suppressed
-      if( tag.substr(0,1) == hash ) // comments start with #
-	continue;
-
-      if( tag == iteration ) 
-	tokenizer >> DUTaligniteration;
-
-      double val;
-      tokenizer >> val;
-      if(      tag == alignx )
-	DUTalignx = val;
-      else if( tag == aligny )
-	DUTaligny = val;
-      else if( tag == rot )
-	DUTrot = val;
-      else if( tag == tilt )
-	DUTtilt = val;
-      else if( tag == turn )
-	DUTturn = val;
-      else if( tag == dz )
-	DUTz = val + zz[3];
-
-      // anything else on the line and in the file gets ignored
-
-    } // while getline
-
-  } // alignFile
-
-  iDUTalignFile.close();
 
   if( DUTaligniteration <= 1 )
     DUTtilt = DUTtilt0; // from runs.dat
@@ -823,65 +523,11 @@ int main( int argc, char* argv[] )
 
   MODalignFileName << "alignMOD_" << run << ".dat";
 
-  ifstream iMODalignFile( MODalignFileName.str() );
-
   cout << endl;
 
-  if( iMODalignFile.bad() || ! iMODalignFile.is_open() ) {
+  if( ! readDUTAlign( MODalignFileName.str(), MODaligniteration,
+		      MODalignx, MODaligny, MODrot, MODtilt, MODturn, MODz, zz[5] ) )
     cout << "no " << MODalignFileName.str() << ", will bootstrap" << endl;
-  }
-  else {
-
-    cout << "read MODalignment from " << MODalignFileName.str() << endl;
-
-    string hash( "#" );
-    string iteration( "iteration" );
-    string alignx( "alignx" );
-    string aligny( "aligny" );
-    string rot( "rot" );
-    string tilt( "tilt" );
-    string turn( "turn" );
-    string dz( "dz" );
-
-    while( ! iMODalignFile.eof() ) {
-
-      string line;
-      getline( iMODalignFile, line );
-      cout << line << endl;
-
-      if( line.empty() ) continue;
-
-      stringstream tokenizer( line );
-      string tag;
-      tokenizer >> tag; // leading white space is suppressed
-      if( tag.substr(0,1) == hash ) // comments start with #
-	continue;
-
-      if( tag == iteration ) 
-	tokenizer >> MODaligniteration;
-
-      double val;
-      tokenizer >> val;
-      if(      tag == alignx )
-	MODalignx = val;
-      else if( tag == aligny )
-	MODaligny = val;
-      else if( tag == rot )
-	MODrot = val;
-      else if( tag == tilt )
-	MODtilt = val;
-      else if( tag == turn )
-	MODturn = val;
-      else if( tag == dz )
-	MODz = val + zz[5];
-
-      // anything else on the line and in the file gets ignored
-
-    } // while getline
-
-  } // alignFile
-
-  iMODalignFile.close();
 
   // normal vector on MOD surface:
   // N = ( 0, 0, -1 ) on MOD, towards -z
@@ -984,6 +630,10 @@ int main( int argc, char* argv[] )
 
   double mke = 0.367; // [ke] to get mod q0 peak at 22 ke
 
+  StageProf prof( "scopes" );
+  prof.setRun( run );
+  prof.mark( "setup" ); // with masks and gains
+
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
   // (re-)create root file:
 
@@ -2073,6 +1723,31 @@ int main( int argc, char* argv[] )
   vector < cluster > cl0[10]; // remember from previous event
   vector < cluster > cl1[10]; // remember from previous event
 
+  prof.mark( "histos" );
+
+  int sdecode = prof.stage( "decode" );
+  int sclus = prof.stage( "clustering" );
+  int sdri = prof.stage( "driplets" );
+  int strip = prof.stage( "triplets" );
+  int smatch = prof.stage( "matching" );
+  int soutput = prof.stage( "output" );
+  int salign = prof.stage( "alignment" );
+
+  GridIndex dutgrid; // DUT clusters in col, row, per event
+  vector<double> dutcolg, dutrowg; // reused buffers
+  vector<bool> isocDUT; // DUT cluster isolation
+
+  // aligned: tracks are linked only to MOD and DUT clusters near their
+  // intercept, found in a grid. All pair histos then stop at wgridlk.
+
+  bool lmodgrid = MODaligniteration > 1;
+  bool ldutgrid = DUTaligniteration > 1;
+  double wgridlk = 2.5; // [mm] range of the moddx histo
+  GridIndex modlkgrid; // MOD clusters in mm, per event
+  GridIndex dutlkgrid; // DUT clusters in mm
+  vector<double> modxg, modyg, dutxg, dutyg; // reused buffers
+  vector<int> lkcand; // clusters to compare with a track
+
   uint64_t tlutime0 = 0;
   const double fTLU = 384E6; // 384 MHz TLU clock
   uint64_t prevtlutime = 0;
@@ -2083,6 +1758,9 @@ int main( int argc, char* argv[] )
   bool ldbt = 0;
 
   do {
+
+    prof.lap( sdecode );
+
     // Get next event:
     DetectorEvent evt = reader->GetDetectorEvent();
 
@@ -2306,7 +1984,9 @@ int main( int argc, char* argv[] )
 
       fNHit = npx; // for cluster search
 
+      prof.lap( sclus );
       cl[ipl] = getClus();
+      prof.lap( sdecode );
 
       if( ldb ) cout << "clusters " << cl[ipl].size() << endl;
 
@@ -2461,54 +2141,19 @@ int main( int argc, char* argv[] )
 
       for( unsigned ipx = 0; ipx < vpx.size(); ++ipx ) {
 
+	double dph;
+	if( ! r4sDph( vpx, ipx, dph ) ) continue; // Randpixel
+
 	int col4 = vpx[ipx].col;
 	int row4 = vpx[ipx].row;
 	double ph4 = vpx[ipx].adc;
 
-	int row1 = row4;
-	int row7 = row4;
-	double ph1 = ph4;
-	double ph7 = ph4;
-
-	for( unsigned jpx = 0; jpx < vpx.size(); ++jpx ) {
-
-	  if( jpx == ipx ) continue;
-	  if( vpx[jpx].col != col4 ) continue; // want same column
-
-	  int jrow = vpx[jpx].row;
-
-	  if( jrow < row1 ) {
-	    row1 = jrow;
-	    ph1 = vpx[jpx].adc;
-	  }
-
-	  if( jrow > row7 ) {
-	    row7 = jrow;
-	    ph7 = vpx[jpx].adc;
-	  }
-
-	} // jpx
-
-	if( row4 == row1 ) continue; // Randpixel
-	if( row4 == row7 ) continue;
-
-	double dph;
-	if( row4 - row1 < row7 - row4 )
-	  dph = ph4 - ph1;
-	else
-	  dph = ph4 - ph7;
-
 	dutphHisto.Fill( ph4 );
 	dutdphHisto.Fill( dph ); // sig 2.7
 
 	// r4scal.C
 
-	double U = ( dph - p3[col4][row4] ) / p2[col4][row4];
-
-	if( U >= 1 )
-	  U = 0.9999999; // avoid overflow
-
-	double vcal = p0[col4][row4] - p1[col4][row4] * log( (1-U)/U ); // inverse Fermi
+	double vcal = r4sVcal( dph, p0[col4][row4], p1[col4][row4], p2[col4][row4], p3[col4][row4] );
 
 	double q = ke*vcal;
 
@@ -2578,7 +2223,9 @@ int main( int argc, char* argv[] )
 
     fNHit = npx; // for cluster search
 
+    prof.lap( sclus );
     cl[iDUT] = getClus();
+    prof.lap( sdecode );
 
     hncl[iDUT].Fill( cl[iDUT].size() );
 
@@ -2617,6 +2264,8 @@ int main( int argc, char* argv[] )
     //      I CHANGED to 1-2-3 and 4-5-6 !!!
     // make driplets 4+6-5:
 
+    prof.lap( sdri );
+
     vector <triplet> driplets;
 
     double driCut = 0.1; // [mm]
@@ -2753,6 +2402,16 @@ int main( int argc, char* argv[] )
     //double xcutMOD = 0.10;
     //double ycutMOD = 0.10; // 502 in 25463 eff 99.88
       
+    if( lmodgrid ) {
+      modxg.resize( cl0[iMOD].size() );
+      modyg.resize( cl0[iMOD].size() );
+      for( unsigned ic = 0; ic < cl0[iMOD].size(); ++ic ) {
+	modxg[ic] = ( cl0[iMOD][ic].col + 0.5 - nx[iMOD]/2 ) * ptchx[iMOD];
+	modyg[ic] = ( cl0[iMOD][ic].row + 0.5 - ny[iMOD]/2 ) * ptchy[iMOD];
+      }
+      modlkgrid.build( modxg, modyg, 1.0 );
+    }
+
     for( unsigned int jB = 0; jB < driplets.size(); ++jB ) { // jB = downstream
 
       double xmB = driplets[jB].xm;
@@ -2846,7 +2505,22 @@ int main( int argc, char* argv[] )
       // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
       // driplets vs MOD clusters:
 
-      for( vector<cluster>::iterator c = cl0[iMOD].begin(); c != cl0[iMOD].end(); ++c ) {
+      lkcand.clear();
+      if( lmodgrid ) {
+	modlkgrid.visit( x4, y4, wgridlk, [&]( int ic ) { lkcand.push_back( ic ); } );
+	sort( lkcand.begin(), lkcand.end() ); // cluster order
+      }
+      else
+	for( unsigned ic = 0; ic < cl0[iMOD].size(); ++ic )
+	  lkcand.push_back( ic );
+
+      for( unsigned kc = 0; kc < lkcand.size(); ++kc ) {
+
+	vector<cluster>::iterator c = cl0[iMOD].begin() + lkcand[kc];
+
+	if( lmodgrid && ( fabs( modxg[lkcand[kc]] - x4 ) > wgridlk ||
+			  fabs( modyg[lkcand[kc]] - y4 ) > wgridlk ) )
+	  continue; // in a grid cell nearby, but outside
 
 	double ccol = c->col;
 	double crow = c->row;
@@ -3055,6 +2729,8 @@ int main( int argc, char* argv[] )
     // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
     // make triplets 2+0-1:
 
+    prof.lap( strip );
+
     vector <triplet> triplets;
 
     //double triCut = 0.1; // [mm]
@@ -3201,9 +2877,69 @@ int main( int argc, char* argv[] )
     ntriHisto.Fill( triplets.size() );
     if( ldb ) cout << "  triplets " << triplets.size() << endl << flush;
 
+    // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+    // DUT cluster isolation: track independent, once per event
+
+    unsigned ncDUT = cl0[iDUT].size();
+    isocDUT.assign( ncDUT, 1 );
+
+    if( chip0 > 300 ) {
+
+      // [JDC] Just request isolated cluster (no any other cluster nearest than 
+      // 8 columns AND rows: the cluster defines a shadow cross of 8-columns/rows
+      // only the grid cells around the cluster
+
+      dutcolg.resize( ncDUT );
+      dutrowg.resize( ncDUT );
+      for( unsigned ic = 0; ic < ncDUT; ++ic ) {
+	dutcolg[ic] = cl0[iDUT][ic].col;
+	dutrowg[ic] = cl0[iDUT][ic].row;
+      }
+      dutgrid.build( dutcolg, dutrowg, 8 );
+
+      for( unsigned ic = 0; ic < ncDUT; ++ic )
+	dutgrid.visit( dutcolg[ic], dutrowg[ic], 8,
+		       [&]( int jc ) {
+			 if( jc != int(ic) &&
+			     fabs( dutcolg[jc] - dutcolg[ic] ) < 8 &&
+			     fabs( dutrowg[jc] - dutrowg[ic] ) < 8 )
+			   isocDUT[ic] = 0;
+		       } );
+    }
+    else {
+
+      // [JDC] More restrictive condition: not isolated if another cluster is 
+      // found EITHER inside 8 columns OR rows (not local, all pairs)
+
+      for( unsigned ic = 0; ic < ncDUT; ++ic )
+	for( unsigned jc = 0; jc < ncDUT; ++jc ) {
+	  if( jc == ic ) continue;
+	  if( fabs( cl0[iDUT][jc].col - cl0[iDUT][ic].col ) < 8 ) isocDUT[ic] = 0;
+	  if( fabs( cl0[iDUT][jc].row - cl0[iDUT][ic].row ) < 8 ) isocDUT[ic] = 0;
+	}
+    }
+
+    if( ldutgrid ) {
+      dutxg.resize( ncDUT );
+      dutyg.resize( ncDUT );
+      for( unsigned ic = 0; ic < ncDUT; ++ic ) {
+	dutxg[ic] = ( cl0[iDUT][ic].col + 0.5 - nx[iDUT]/2 ) * ptchx[iDUT]; // as cmsx
+	dutyg[ic] = ( cl0[iDUT][ic].row + 0.5 - ny[iDUT]/2 ) * ptchy[iDUT];
+	if( rot90 ) {
+	  dutxg[ic] = ( cl0[iDUT][ic].row + 0.5 - ny[iDUT]/2 ) * ptchy[iDUT];
+	  dutyg[ic] = ( cl0[iDUT][ic].col + 0.5 - nx[iDUT]/2 ) * ptchx[iDUT];
+	}
+      }
+      dutlkgrid.build( dutxg, dutyg, 1.0 );
+    }
+
     // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
     // triplets at the DUT:
 
+    prof.lap( smatch );
+    prof.count( "triplets", triplets.size() );
+    prof.count( "driplets", driplets.size() );
+
     double xcut = 0.1;
     double ycut = 0.1;
     if( fabs(DUTtilt) > 60 )
@@ -3487,32 +3223,28 @@ int main( int argc, char* argv[] )
       double pdmin = 19;
       double clQ0 = 0;
 
-      for( vector<cluster>::iterator c = cl0[iDUT].begin(); c != cl0[iDUT].end(); ++c ) {
+      lkcand.clear();
+      if( ldutgrid ) {
+	dutlkgrid.visit( x4, y4, wgridlk, [&]( int ic ) { lkcand.push_back( ic ); } );
+	sort( lkcand.begin(), lkcand.end() ); // cluster order
+      }
+      else
+	for( unsigned ic = 0; ic < ncDUT; ++ic )
+	  lkcand.push_back( ic );
+
+      for( unsigned kc = 0; kc < lkcand.size(); ++kc ) {
+
+	vector<cluster>::iterator c = cl0[iDUT].begin() + lkcand[kc];
+
+	if( ldutgrid && ( fabs( dutxg[lkcand[kc]] - x4 ) > wgridlk ||
+			  fabs( dutyg[lkcand[kc]] - y4 ) > wgridlk ) )
+	  continue; // in a grid cell nearby, but outside
 
 	double ccol = c->col;
 	double crow = c->row;
 
-	// cluster isolation:
-	bool isoc = 1;
-	for( vector<cluster>::iterator c2 = cl0[iDUT].begin(); c2 != cl0[iDUT].end(); ++c2 ) {
-	  if( c2 == c ) continue;
-          if( chip0 > 300 )
-          {
-              // [JDC] Just request isolated cluster (no any other cluster nearest than 
-              // 8 columns AND rows: the cluster defines a shadow cross of 8-columns/rows
-              if( fabs(c2->col-ccol)<8 && fabs(c2->row-crow)<8)
-              {
-                  isoc=0;
-              }
-          }
-          else
-          {
-              // [JDC] More restrictive condition: not isolated if another cluster is 
-              // found EITHER inside 8 columns OR rows
-              if( fabs( c2->col - ccol ) < 8 ) isoc = 0;
-              if( fabs( c2->row - crow ) < 8 ) isoc = 0;
-          }
-	}
+	// cluster isolation, from above:
+	bool isoc = isocDUT[ c - cl0[iDUT].begin() ];
         
 	double Q0 = c->charge * norm; // cluster charge normalized to vertical incidence
 	double Qx = exp(-Q0/qwid);
@@ -3975,6 +3707,8 @@ int main( int argc, char* argv[] )
 
     ++iev;
 
+    prof.endEvent();
+
     if( syncmod ) { // shift all but MOD
 
       for( int ipl = 0; ipl < 6; ++ipl ) {
@@ -3994,8 +3728,12 @@ int main( int argc, char* argv[] )
   cout << "done after " << iev << " events" << endl;
   cout << "resyncs " << nresync << endl;
 
+  prof.start( soutput );
   histoFile->Write();
   histoFile->Close();
+  prof.stop( soutput );
+
+  prof.start( salign );
 
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
   // MOD alignment:
@@ -4448,8 +4186,13 @@ int main( int argc, char* argv[] )
       hotDUTFile.close();
   }
   
+  prof.stop( salign );
+
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
   // done
 
+  prof.report( cout );
+  prof.write( StageProf::fileNameFor( rootFileName.str() ) );
+
   return 0;
 }
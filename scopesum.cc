@@ -0,0 +1,347 @@
+// run summary from many scope output files, in parallel, with a cache
+// residual widths (Student's t fits), DUT efficiency, charge peak
+
+// make scopesum
+// scopesum scopeRD*.root
+// (writes scopesum.root: graphs vs run, and the table scopesum.dat)
+// (files unchanged since the last call, same mtime, are taken from scopesum.dat)
+// (-c cache.dat: other cache, -o out.root: other output, -j 8: threads, -f: refit all)
+
+#include <TFile.h>
+#include <TH1.h>
+#include <TProfile.h>
+#include <TGraphErrors.h>
+#include <TROOT.h> // EnableThreadSafety
+#include <Math/MinimizerOptions.h>
+
+#include <sys/stat.h> // mtime
+#include <omp.h>
+
+#include <iostream> // cout
+#include <iomanip> // setw
+#include <sstream> // stringstream
+#include <fstream> // files
+#include <vector>
+#include <map>
+#include <cstring> // strcmp
+#include <cmath>
+
+#include "histfit.h" // TP0Fcn, fitLanGauPeak
+
+using namespace std;
+
+// quantities per run, in this order in the cache
+
+const int nq = 9;
+
+const char * qname[nq] = {
+  "dutdx", "dutdy", "moddx", "moddy", "sixdx", "sixdy", // widths
+  "eff", "neff", // DUT efficiency and tracks
+  "qpeak" }; // charge
+
+const char * qhisto[nq] = { // first one found, new names first
+  "dutdxc cmsdxc cmsdx", "dutdyc cmsdyc cmsdy",
+  "moddxc moddx", "moddyc moddy",
+  "sixdxc", "sixdyc",
+  "effvsx", "effvsx",
+  "linq0 cmsq0f" };
+
+struct runsum {
+  string file;
+  long mtime;
+  int run;
+  double q[nq]; // -1 = not in the file
+  double e[nq]; // errors
+};
+
+//------------------------------------------------------------------------------
+int runFromName( const string & file ) // last digits in the file name
+{
+  size_t slash = file.rfind( '/' );
+  string name = slash == string::npos ? file : file.substr( slash+1 );
+  size_t i9 = name.find_last_of( "0123456789" );
+  if( i9 == string::npos ) return 0;
+  size_t i0 = i9;
+  while( i0 > 0 && isdigit( name[i0-1] ) ) --i0;
+  return atoi( name.substr( i0, i9-i0+1 ).c_str() );
+}
+
+//------------------------------------------------------------------------------
+TH1 * getHisto( TFile & f, const char * names ) // first existing name
+{
+  istringstream tokenizer( names );
+  string name;
+  while( tokenizer >> name ) {
+    TH1 * h = (TH1*) f.Get( name.c_str() );
+    if( h ) {
+      h->SetDirectory(0); // ours
+      return h;
+    }
+  }
+  return 0;
+}
+
+//------------------------------------------------------------------------------
+bool fitWidth( TH1 * h, int ifit, double & sig, double & err ) // Student's t + p0
+{
+  if( h->GetEntries() < 100 ) return 0;
+
+  double dx = h->GetBinWidth(1);
+  double nmax = h->GetBinContent( h->GetMaximumBin() );
+  double xmax = h->GetBinCenter( h->GetMaximumBin() );
+  int nb = h->GetNbinsX();
+  double x1 = h->GetBinCenter(1);
+  double x9 = h->GetBinCenter(nb);
+  double bg = 0.5 * ( h->GetBinContent(1) + h->GetBinContent(nb) );
+
+  TF1 tp0Fcn( Form( "tp0sum%i", ifit ), TP0Fcn( dx ), x1, x9, 5 );
+
+  tp0Fcn.SetParameter( 0, xmax ); // peak position
+  tp0Fcn.SetParameter( 1, 4*dx ); // width
+  tp0Fcn.SetParameter( 2, 2.2 ); // nu
+  tp0Fcn.SetParameter( 3, 7*(nmax-bg) ); // N
+  tp0Fcn.SetParameter( 4, bg );
+
+  h->Fit( &tp0Fcn, "R Q N", "" );
+
+  sig = fabs( tp0Fcn.GetParameter(1) );
+  err = tp0Fcn.GetParError(1);
+
+  return 1;
+}
+
+//------------------------------------------------------------------------------
+bool extract( runsum & rs, int ifit ) // open, fit, close
+{
+  for( int iq = 0; iq < nq; ++iq ) {
+    rs.q[iq] = -1;
+    rs.e[iq] = 0;
+  }
+
+  TFile f( rs.file.c_str() );
+
+  if( f.IsZombie() ) return 0;
+
+  for( int iq = 0; iq < nq; ++iq ) {
+
+    string qn( qname[iq] );
+
+    if( qn == "neff" ) continue; // with eff
+
+    TH1 * h = getHisto( f, qhisto[iq] );
+    if( h == 0 ) continue;
+
+    if( qn == "eff" ) { // mean of the profile
+      TProfile * p = (TProfile*) h;
+      double n = p->GetEntries();
+      if( n > 0 ) {
+	double eff = p->GetMean(2);
+	rs.q[iq] = eff;
+	rs.e[iq] = sqrt( eff * ( 1 - eff ) / n );
+	rs.q[iq+1] = n;
+      }
+    }
+    else if( qn == "qpeak" ) {
+      if( h->GetEntries() > 100 ) {
+	double xpk = h->GetBinCenter( h->GetMaximumBin() );
+	rs.q[iq] = fitLanGauPeak( h, 0.6*xpk, 2.5*xpk );
+	TF1 * fit = (TF1*) h->GetListOfFunctions()->Last();
+	if( fit ) rs.e[iq] = fit->GetParError(0);
+      }
+    }
+    else
+      fitWidth( h, ifit*nq+iq, rs.q[iq], rs.e[iq] );
+
+    delete h;
+
+  } // iq
+
+  return 1;
+}
+
+//------------------------------------------------------------------------------
+int main( int argc, char* argv[] )
+{
+  cout << "main " << argv[0] << " called with " << argc << " arguments" << endl;
+
+  if( argc == 1 ) {
+    cout << "give scope root files" << endl;
+    return 1;
+  }
+
+  string cacheFileName( "scopesum.dat" );
+  string outFileName( "scopesum.root" );
+  bool lrefit = 0;
+
+  vector <string> files;
+
+  for( int i = 1; i < argc; ++i ) {
+
+    if( !strcmp( argv[i], "-c" ) )
+      cacheFileName = argv[++i];
+
+    else if( !strcmp( argv[i], "-o" ) )
+      outFileName = argv[++i];
+
+    else if( !strcmp( argv[i], "-j" ) )
+      omp_set_num_threads( atoi( argv[++i] ) );
+
+    else if( !strcmp( argv[i], "-f" ) )
+      lrefit = 1;
+
+    else
+      files.push_back( argv[i] );
+
+  } // argc
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+  // cache: file mtime run quantities errors
+
+  map <string, runsum> cache;
+
+  ifstream cacheFile( cacheFileName );
+
+  if( cacheFile ) {
+
+    string line;
+    while( getline( cacheFile, line ) ) {
+      if( line.empty() || line[0] == '#' ) continue;
+      istringstream tokenizer( line );
+      runsum rs;
+      tokenizer >> rs.file >> rs.mtime >> rs.run;
+      for( int iq = 0; iq < nq; ++iq )
+	tokenizer >> rs.q[iq] >> rs.e[iq];
+      if( tokenizer )
+	cache[rs.file] = rs;
+    }
+    cout << "cache " << cacheFileName << ": " << cache.size() << " files" << endl;
+
+  }
+
+  cacheFile.close();
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+  // which files changed:
+
+  vector <runsum> sums( files.size() );
+  vector <int> todo;
+
+  for( size_t ii = 0; ii < files.size(); ++ii ) {
+
+    struct stat st;
+    if( stat( files[ii].c_str(), &st ) ) {
+      cout << files[ii] << " not found" << endl;
+      sums[ii].file = "";
+      continue;
+    }
+
+    map <string, runsum>::iterator ic = cache.find( files[ii] );
+
+    if( !lrefit && ic != cache.end() && ic->second.mtime == (long) st.st_mtime )
+      sums[ii] = ic->second;
+    else {
+      sums[ii].file = files[ii];
+      sums[ii].mtime = st.st_mtime;
+      sums[ii].run = runFromName( files[ii] );
+      todo.push_back( ii );
+    }
+
+  }
+
+  cout << files.size() << " files, " << todo.size() << " new or changed" << endl;
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+  // extract, one file per thread:
+
+  ROOT::EnableThreadSafety();
+  ROOT::Math::MinimizerOptions::SetDefaultMinimizer( "Minuit2" ); // reentrant
+
+  vector <char> ok( todo.size() ); // not vector<bool>: written by threads
+
+#pragma omp parallel for schedule(dynamic)
+  for( int it = 0; it < (int) todo.size(); ++it ) {
+
+    ok[it] = extract( sums[todo[it]], it );
+
+#pragma omp critical
+    cout << "  " << sums[todo[it]].file << ( ok[it] ? "" : " failed" ) << endl;
+
+  }
+
+  for( size_t it = 0; it < todo.size(); ++it )
+    if( ok[it] )
+      cache[sums[todo[it]].file] = sums[todo[it]];
+    else
+      sums[todo[it]].file = ""; // not in the output
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+  // cache back, with the runs of other calls:
+
+  ofstream ocacheFile( cacheFileName );
+
+  ocacheFile << "# scopesum cache: file mtime run";
+  for( int iq = 0; iq < nq; ++iq )
+    ocacheFile << " " << qname[iq] << " err";
+  ocacheFile << endl;
+
+  for( map <string, runsum>::iterator ic = cache.begin(); ic != cache.end(); ++ic ) {
+    const runsum & rs = ic->second;
+    ocacheFile << rs.file << " " << rs.mtime << " " << rs.run;
+    for( int iq = 0; iq < nq; ++iq )
+      ocacheFile << " " << rs.q[iq] << " " << rs.e[iq];
+    ocacheFile << endl;
+  }
+
+  ocacheFile.close();
+
+  cout << "cache " << cacheFileName << " written" << endl;
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+  // table and graphs vs run, for the files given:
+
+  cout << endl << setw(8) << "run";
+  for( int iq = 0; iq < nq; ++iq )
+    cout << setw(11) << qname[iq];
+  cout << endl;
+
+  vector <double> vrun[nq], vq[nq], ve[nq];
+
+  for( size_t ii = 0; ii < sums.size(); ++ii ) {
+
+    const runsum & rs = sums[ii];
+    if( rs.file.empty() ) continue;
+
+    cout << setw(8) << rs.run;
+    for( int iq = 0; iq < nq; ++iq ) {
+      cout << setw(11) << setprecision(4) << rs.q[iq];
+      if( rs.q[iq] < 0 ) continue;
+      vrun[iq].push_back( rs.run );
+      vq[iq].push_back( rs.q[iq] );
+      ve[iq].push_back( rs.e[iq] );
+    }
+    cout << endl;
+
+  }
+
+  TFile outFile( outFileName.c_str(), "RECREATE" );
+
+  for( int iq = 0; iq < nq; ++iq ) {
+
+    if( vrun[iq].empty() ) continue;
+
+    vector <double> zero( vrun[iq].size() );
+
+    TGraphErrors g( vrun[iq].size(), &vrun[iq][0], &vq[iq][0], &zero[0], &ve[iq][0] );
+    g.SetName( qname[iq] );
+    g.SetTitle( Form( "%s;run;%s", qname[iq], qname[iq] ) );
+    g.SetMarkerStyle(20);
+    g.Write();
+
+  }
+
+  outFile.Close();
+
+  cout << endl << outFileName << endl;
+
+  return 0;
+}
@@ -0,0 +1,72 @@
+#!/bin/bash
+
+# throughput of tele and scope53m on synthetic runs at increasing occupancy,
+# no beam data needed: simraw writes the raw files, true alignment and gains.
+# events/s and the time per stage come from the .prof files.
+#
+# make simbench
+# or: scripts/simbench.sh [geo file] [events] [tracks per event ...]
+
+SCRIPT=$(readlink -f $0)
+SCRIPTPATH=$(dirname "$SCRIPT")
+TOP="$SCRIPTPATH/.."
+
+GEO=${1:-geo_2019_02d.dat}
+NEV=${2:-20000}
+if [ $# -ge 2 ]; then shift 2; else shift $#; fi
+NTRK=${@:-1 2 5 10}
+
+FIFTY=1 # RD53A 50x50 in the geo file, 0 for 100x25
+NOISE=1E-5 # noise occupancy per pixel and frame
+
+mkdir -p simbench/data
+cp -p "$TOP/$GEO" simbench/ || exit 1
+cd simbench
+
+rm -f runs.dat
+
+run=990000
+
+for ntrk in $NTRK; do
+
+    run=$((run+1))
+
+    echo "run $run: $ntrk tracks/event, $NEV events"
+
+    "$TOP/simraw" -g $GEO -l $NEV -t $ntrk -n $NOISE -s $run -w $run > simraw_$run.log || exit 1
+
+    cat >> runs.dat <<EOF
+geo $GEO
+GeV 5.6
+chip 999
+gain_dut gain_$run.dat
+fifty $FIFTY
+rot90 0
+modrun 0
+tilt 0
+turn 0
+run $run
+EOF
+
+    "$TOP/tele" -g $GEO -p 5.6 -l $NEV $run > tele_$run.log || exit 1
+    "$TOP/scope53m" -l $NEV $run < /dev/null > scope53m_$run.log || exit 1
+
+done
+
+# table:
+
+echo
+printf "%8s %6s %12s %12s %12s\n" run tracks "simraw ev/s" "tele ev/s" "scope ev/s"
+
+run=990000
+
+for ntrk in $NTRK; do
+    run=$((run+1))
+    sr=$(awk '$1=="rate" {print $2}' simraw_$run.prof)
+    tr=$(awk '$1=="rate" {print $2}' tele$run.prof)
+    st=$(awk '$1=="rate" {print $2}' scopeRD$run.prof)
+    printf "%8s %6s %12.0f %12.0f %12.0f\n" $run $ntrk $sr $tr $st
+done
+
+echo
+echo "stages: simbench/*.prof"
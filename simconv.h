@@ -0,0 +1,115 @@
+// simconv.h
+// eudaq raw events for the synthetic telescope (simtele.h):
+// one block per plane, read back as StandardPlanes by the converter
+// plugin below. Included by the analysis programs, so that they read
+// data/run0RUN.raw from simraw like beam data.
+
+// writing: DetectorEvent dev( run, iev, tlu );
+//          dev.AddEvent( simRawEvent( run, iev, px, sim ) );
+// reading: nothing to do, ConvertToStandard finds the plugin
+
+// block = uint16 words: ID, npixelx, npixely, frames, pivot, then per
+// pixel col, row, tot, frame + 0x8000 for pivot
+
+#ifndef SIMCONV_H
+#define SIMCONV_H
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+#include "eudaq/DataConverterPlugin.hh"
+#include "eudaq/StandardEvent.hh"
+#include "eudaq/RawDataEvent.hh"
+
+#include "simtele.h"
+
+//------------------------------------------------------------------------------
+inline std::shared_ptr<eudaq::Event>
+simRawEvent( unsigned run, unsigned iev,
+	     const std::vector<SimPixel> px[SimTele::npl], const SimTele & sim )
+{
+  eudaq::RawDataEvent * ev = new eudaq::RawDataEvent( "SIMTEL", run, iev );
+
+  for( int ipl = 0; ipl < SimTele::npl; ++ipl ) {
+
+    if( ! sim.have[ipl] ) continue;
+
+    std::vector<uint16_t> b;
+    b.reserve( 5 + 4*px[ipl].size() );
+    b.push_back( ipl );
+    b.push_back( sim.nxroc( ipl ) );
+    b.push_back( sim.nyroc( ipl ) );
+    b.push_back( ipl == SimTele::iDUT ? sim.nbc : 1 ); // Mimosa frames merged
+    b.push_back( 0 );
+    for( unsigned i = 0; i < px[ipl].size(); ++i ) {
+      const SimPixel & p = px[ipl][i];
+      b.push_back( p.col );
+      b.push_back( p.row );
+      b.push_back( p.tot );
+      b.push_back( p.frm | ( p.pivot ? 0x8000 : 0 ) );
+    }
+    ev->AddBlock( ipl, b );
+
+  }
+
+  return std::shared_ptr<eudaq::Event>( ev );
+}
+
+namespace eudaq {
+
+  class SimTeleConverterPlugin : public DataConverterPlugin {
+
+  public:
+
+    virtual void Initialize( const Event &, const Configuration & ) {}
+
+    virtual unsigned GetTriggerID( const Event & ev ) const
+    {
+      return ev.GetEventNumber();
+    }
+
+    virtual bool GetStandardSubEvent( StandardEvent & sev, const Event & ev ) const
+    {
+      if( ev.IsBORE() || ev.IsEORE() ) return true;
+
+      const RawDataEvent & raw = dynamic_cast<const RawDataEvent &>( ev );
+
+      for( size_t ib = 0; ib < raw.NumBlocks(); ++ib ) {
+
+	const RawDataEvent::data_t & d = raw.GetBlock( ib );
+	unsigned nw = d.size() / 2;
+	if( nw < 5 ) continue;
+
+	std::vector<unsigned> w( nw );
+	for( unsigned i = 0; i < nw; ++i )
+	  w[i] = d[2*i] | ( d[2*i+1] << 8 ); // little endian, as written
+
+	unsigned id = w[0];
+	StandardPlane plane( id, "SIM", id == SimTele::iDUT ? "RD53A" : "MIMOSA26" );
+	plane.SetSizeZS( w[1], w[2], 0, w[3], StandardPlane::FLAG_WITHPIVOT );
+	plane.SetPivotPixel( w[4] );
+
+	for( unsigned i = 5; i+3 < nw; i += 4 )
+	  plane.PushPixel( w[i], w[i+1], w[i+2], bool( w[i+3] & 0x8000 ), w[i+3] & 0x7fff );
+
+	sev.AddPlane( plane );
+
+      } // blocks
+
+      return true;
+    }
+
+  private:
+
+    SimTeleConverterPlugin() : DataConverterPlugin( "SIMTEL" ) {}
+
+    static SimTeleConverterPlugin m_instance;
+
+  }; // SimTeleConverterPlugin
+
+  SimTeleConverterPlugin SimTeleConverterPlugin::m_instance;
+
+} // eudaq
+
+#endif
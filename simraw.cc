@@ -0,0 +1,230 @@
+// synthetic telescope run: Mimosa26 planes 1..6 and an RD53A DUT
+// from a geo file and the alignment, written as eudaq native raw file
+// for tele and scope53m
+
+// make simraw
+// simraw -g geo_2019_02d.dat -p 5.6 -l 20000 -t 1.5 -w 990001
+// (writes data/run990001.raw)
+// (-a align_31226.dat -d alignDUT_31226.dat: alignment to simulate)
+// (-w: also align_990001.dat, alignDUT_990001.dat, gain_990001.dat)
+
+#include "eudaq/FileWriter.hh"
+#include "eudaq/DetectorEvent.hh"
+
+#include <sstream> // stringstream
+#include <fstream> // filestream
+#include <iomanip>
+#include <cstring> // strcmp
+
+#include "simtele.h"
+#include "simconv.h"
+#include "stageprof.h"
+
+using namespace std;
+using namespace eudaq;
+
+//------------------------------------------------------------------------------
+int main( int argc, char* argv[] )
+{
+  cout << "main " << argv[0] << " called with " << argc << " arguments" << endl;
+
+  if( argc < 4 ) {
+    cout << "format: simraw -g geo_year_mon.dat run" << endl;
+    return 1;
+  }
+
+  // run number = last arg
+
+  int run = atoi( argv[argc-1] );
+
+  cout << "run " << run << endl;
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+  // further arguments:
+
+  int lev = 10000; // events
+  string geoFileName{ "geo.dat" };
+  string alignFileName;
+  string DUTalignFileName;
+  unsigned seed = 0;
+  bool lwrite = 0;
+
+  SimTele sim;
+
+  for( int i = 1; i < argc; ++i ) {
+
+    if( !strcmp( argv[i], "-l" ) )
+      lev = atoi( argv[++i] ); // events
+
+    if( !strcmp( argv[i], "-g" ) )
+      geoFileName = argv[++i];
+
+    if( !strcmp( argv[i], "-a" ) )
+      alignFileName = argv[++i]; // telescope alignment
+
+    if( !strcmp( argv[i], "-d" ) )
+      DUTalignFileName = argv[++i]; // DUT alignment
+
+    if( !strcmp( argv[i], "-p" ) )
+      sim.GeV = atof( argv[++i] ); // momentum
+
+    if( !strcmp( argv[i], "-t" ) )
+      sim.ntrk = atof( argv[++i] ); // mean tracks per event
+
+    if( !strcmp( argv[i], "-n" ) )
+      sim.noise = atof( argv[++i] ); // occupancy per pixel and frame
+
+    if( !strcmp( argv[i], "-h" ) )
+      sim.nhot = atoi( argv[++i] ); // hot pixels per plane
+
+    if( !strcmp( argv[i], "-q" ) )
+      sim.thr[SimTele::iDUT] = atof( argv[++i] ); // DUT threshold [100 e]
+
+    if( !strcmp( argv[i], "-s" ) )
+      seed = atoi( argv[++i] ); // random seed
+
+    if( !strcmp( argv[i], "-w" ) )
+      lwrite = 1; // write the true alignment and gains
+
+  } // argc
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+  // geometry and alignment:
+
+  if( ! sim.readGeo( geoFileName ) )
+    return 1;
+
+  cout << "read geometry from " << geoFileName << endl;
+
+  if( ! alignFileName.empty() && sim.readAlign( alignFileName ) )
+    cout << "read alignment from " << alignFileName << endl;
+
+  if( ! DUTalignFileName.empty() && sim.readDUTAlign( DUTalignFileName ) )
+    cout << "read DUT alignment from " << DUTalignFileName << endl;
+
+  for( int ipl = 0; ipl < SimTele::npl; ++ipl )
+    if( sim.have[ipl] )
+      cout << "  plane " << ipl
+	   << " " << sim.type[ipl]
+	   << " " << sim.nx[ipl] << "x" << sim.ny[ipl]
+	   << " z " << sim.zpl( ipl )
+	   << endl;
+
+  cout << "  DUT align " << sim.DUTalignx << ", " << sim.DUTaligny
+       << ", rot " << sim.DUTrot
+       << ", tilt " << sim.DUTtilt
+       << ", turn " << sim.DUTturn
+       << endl;
+  cout << "  " << sim.GeV << " GeV"
+       << ", " << sim.ntrk << " tracks/event"
+       << ", noise " << sim.noise
+       << ", hot " << sim.nhot
+       << endl;
+
+  sim.init( seed );
+
+  if( lwrite ) {
+
+    ostringstream alignName;
+    alignName << "align_" << run << ".dat";
+    ofstream alignFile( alignName.str() );
+    alignFile << "# simulated telescope alignment for run " << run << endl;
+    alignFile << "iteration 9" << endl;
+    for( int ipl = 1; ipl <= 6; ++ipl ) {
+      alignFile << endl;
+      alignFile << "plane " << ipl << endl;
+      alignFile << "shiftx " << sim.alignx[ipl] << endl;
+      alignFile << "shifty " << sim.aligny[ipl] << endl;
+      alignFile << "shiftz " << sim.alignz[ipl] << endl;
+      alignFile << "rotxvsy " << sim.rotx[ipl] << endl;
+      alignFile << "rotyvsx " << sim.roty[ipl] << endl;
+    }
+    alignFile.close();
+    cout << "wrote " << alignName.str() << endl;
+
+    ostringstream DUTalignName;
+    DUTalignName << "alignDUT_" << run << ".dat";
+    ofstream DUTalignFile( DUTalignName.str() );
+    DUTalignFile << "# simulated DUT alignment for run " << run << endl;
+    DUTalignFile << "iteration 9" << endl;
+    DUTalignFile << "alignx " << sim.DUTalignx << endl;
+    DUTalignFile << "aligny " << sim.DUTaligny << endl;
+    DUTalignFile << "rot " << sim.DUTrot << endl;
+    DUTalignFile << "tilt " << sim.DUTtilt << endl;
+    DUTalignFile << "turn " << sim.DUTturn << endl;
+    DUTalignFile << "dz " << sim.DUTz - sim.zz[3] << endl;
+    DUTalignFile.close();
+    cout << "wrote " << DUTalignName.str() << endl;
+
+    ostringstream gainName;
+    gainName << "gain_" << run << ".dat";
+    if( sim.have[SimTele::iDUT] && sim.writeGain( gainName.str() ) )
+      cout << "wrote " << gainName.str() << endl;
+
+  } // lwrite
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+  // events:
+
+  std::unique_ptr<FileWriter> writer( FileWriterFactory::Create( "native" ) );
+  writer->SetFilePattern( "data/run$6R$X" );
+  writer->StartRun( run );
+
+  DetectorEvent bore( run, 0, 0 );
+  bore.SetFlags( Event::FLAG_BORE );
+  bore.AddEvent( std::shared_ptr<Event>( new RawDataEvent( RawDataEvent::BORE( "SIMTEL", run ) ) ) );
+  writer->WriteEvent( bore );
+
+  StageProf prof( "simraw" );
+  prof.setRun( run );
+  int sgen = prof.stage( "generate" );
+  int swrite = prof.stage( "write" );
+
+  const double fTLU = 384E6; // 384 MHz TLU clock
+  uint64_t tlu = 0;
+  vector<SimPixel> px[SimTele::npl];
+
+  for( int iev = 1; iev <= lev; ++iev ) {
+
+    prof.lap( sgen );
+
+    tlu += uint64_t( sim.dt() * fTLU );
+
+    sim.event( px );
+
+    for( int ipl = 0; ipl < SimTele::npl; ++ipl )
+      prof.count( ipl == SimTele::iDUT ? "DUTpixels" : "Mimosapixels", px[ipl].size() );
+
+    prof.lap( swrite );
+
+    DetectorEvent dev( run, iev, tlu );
+    dev.AddEvent( simRawEvent( run, iev, px, sim ) );
+    writer->WriteEvent( dev );
+
+    prof.endEvent();
+
+    if( iev < 100 && iev%10 == 0 )
+      cout << "simraw  " << run << "." << iev << endl;
+    else if( iev%10000 == 0 )
+      cout << "simraw  " << run << "." << iev << endl;
+
+  } // events
+
+  DetectorEvent eore( run, lev+1, tlu );
+  eore.SetFlags( Event::FLAG_EORE );
+  eore.AddEvent( std::shared_ptr<Event>( new RawDataEvent( RawDataEvent::EORE( "SIMTEL", run, lev+1 ) ) ) );
+  writer->WriteEvent( eore );
+
+  writer.reset(); // close the file
+
+  prof.report( cout );
+
+  ostringstream profName;
+  profName << "simraw_" << run << ".prof";
+  prof.write( profName.str() );
+
+  cout << endl << "wrote " << lev << " events to data/run"
+       << setw(6) << setfill('0') << run << ".raw" << endl;
+
+  return 0;
+}
@@ -0,0 +1,539 @@
+// simtele.h
+// synthetic Mimosa26 telescope + RD53A DUT events from a geo file and
+// the alignment files: straight tracks with multiple scattering, charge
+// sharing, noise, hot pixels, RD53A ToT and BCID
+
+// SimTele sim;
+// sim.readGeo( "geo_2019_02d.dat" ); // planes 0 = DUT, 1..6 = Mimosa
+// sim.readAlign( "align_31226.dat" ); // optional, tele format
+// sim.readDUTAlign( "alignDUT_31226.dat" ); // optional, scope format
+// sim.GeV = 5.6; sim.ntrk = 1.5; sim.noise = 1E-5; ...
+// sim.init( seed );
+// per event: sim.event( px ); // vector<SimPixel> px[SimTele::npl]
+
+// Coordinates are the inverse of the ones in tele and scope53m:
+// Mimosa x = col*ptchx - alignx - midx, then rotxvsy, rotyvsx
+// DUT    x = ( col + 0.5 - nx/2 ) * ptchx = x3 + alignx (turn, tilt, rot)
+// The DUT is simulated in sensor pixels and given out in ROC pixels
+// (100x25: two sensor rows per ROC column pair), upsign 1, rot90 0.
+
+#ifndef SIMTELE_H
+#define SIMTELE_H
+
+#include <vector>
+#include <string>
+#include <map>
+#include <random>
+#include <cmath>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+
+#include "telecore.h" // readGeo, readAlign, readDUTAlign
+
+struct SimPixel {
+  int col, row; // ROC pixel
+  int tot; // 1 for Mimosa, ToT 0..15 for RD53A
+  int frm; // BC 0..31 RD53A, 0 Mimosa
+  bool pivot; // Mimosa: row after the pivot row
+};
+
+class SimTele {
+
+ public:
+
+  static const int npl = 7; // eudaq plane ID: 0 = DUT, 1..6 = Mimosa
+  static const int iDUT = 0;
+
+  // geometry:
+
+  bool have[npl];
+  std::string type[npl];
+  int nx[npl], ny[npl];
+  double sizex[npl], sizey[npl], zz[npl];
+
+  // telescope alignment, as in tele:
+
+  double alignx[npl], aligny[npl], alignz[npl];
+  double rotx[npl], roty[npl];
+
+  // DUT alignment, as in scope53m:
+
+  double DUTalignx, DUTaligny, DUTrot; // [mm] [rad]
+  double DUTtilt, DUTturn; // [deg]
+  double DUTz; // [mm]
+
+  // beam:
+
+  double GeV;
+  double ntrk; // mean tracks per event
+  double beamx, beamy; // rms spot [mm]
+  double div; // rms divergence [rad]
+  double rate; // trigger rate [Hz]
+
+  // sensors:
+
+  double xx0[npl]; // x/X0 at normal incidence
+  double thck[npl]; // charge collection depth [mm]
+  double diff[npl]; // diffusion rms [mm]
+  double qmip[npl]; // most probable charge, DUT in 100 e
+  double qwid; // Moyal scale / most probable
+  double thr[npl]; // pixel threshold, same units as qmip
+  double noise; // noise occupancy per pixel and frame
+  int nhot; // hot pixels per plane
+  double hotprob; // hot pixel firing probability per event
+
+  // RD53A response, ToT = a*q + b - c/( q - t ), as in the gain files:
+
+  double gaina, gainb, gainc, gaint;
+  int nbc; // frames per trigger
+  int latency; // frame of in-time hits
+  double walkq; // below this charge the hit comes one BC late
+
+  SimTele() : DUTalignx(0), DUTaligny(0), DUTrot(0), DUTtilt(0), DUTturn(0),
+    DUTz(0), GeV(5.6), ntrk(1.5), beamx(4), beamy(2), div(1E-3), rate(5E3),
+    qwid(0.1), noise(1E-6), nhot(10), hotprob(0.5),
+    gaina(0.1), gainb(-1), gainc(10), gaint(10),
+    nbc(32), latency(15), walkq(25), fDUTzSet(0)
+  {
+    for( int ipl = 0; ipl < npl; ++ipl ) {
+      have[ipl] = 0;
+      nx[ipl] = 0;
+      ny[ipl] = 0;
+      sizex[ipl] = 0;
+      sizey[ipl] = 0;
+      zz[ipl] = 0;
+      alignx[ipl] = 0;
+      aligny[ipl] = 0;
+      alignz[ipl] = 0;
+      rotx[ipl] = 0;
+      roty[ipl] = 0;
+      xx0[ipl] = 7.5E-4; // Mimosa 50 um Si + 50 um kapton
+      thck[ipl] = 0.015; // epi
+      diff[ipl] = 0.008; // clusters of 2..4 pixels
+      qmip[ipl] = 1;
+      thr[ipl] = 0.15;
+    }
+    xx0[iDUT] = 2.0E-3; // RD53A + sensor + PCB
+    thck[iDUT] = 0.150;
+    diff[iDUT] = 0.003;
+    qmip[iDUT] = 100; // 10 ke
+    thr[iDUT] = 12; // 1.2 ke
+  }
+
+  // geo file, read with telecore.h: planes 0..8, the first npl kept.
+  // DUT zpos is relative to plane 3.
+
+  bool readGeo( const std::string & fileName )
+  {
+    int nx9[9], ny9[9];
+    double sizex9[9] = {0}, sizey9[9] = {0}, zz9[9] = {0};
+    double ptchx9[9], ptchy9[9], midx9[9], midy9[9];
+    std::string type9[9];
+
+    if( ! ::readGeo( fileName, 0, 8, nx9, ny9, sizex9, sizey9, zz9,
+		     ptchx9, ptchy9, midx9, midy9, type9 ) ) {
+      std::cout << "Error opening " << fileName << std::endl;
+      return 0;
+    }
+
+    for( int ipl = 0; ipl < npl; ++ipl ) {
+      type[ipl] = type9[ipl];
+      nx[ipl] = nx9[ipl];
+      ny[ipl] = ny9[ipl];
+      sizex[ipl] = sizex9[ipl];
+      sizey[ipl] = sizey9[ipl];
+      zz[ipl] = zz9[ipl];
+      have[ipl] = nx[ipl] > 0 && ny[ipl] > 0;
+    }
+
+    if( ! fDUTzSet ) DUTz = zz[3] + zz9[iDUT];
+    zz[iDUT] = DUTz;
+
+    return 1;
+  }
+
+  // align_RUN.dat from tele, read with telecore.h: planes 1..6
+
+  bool readAlign( const std::string & fileName )
+  {
+    int iteration;
+    double alignx9[9], aligny9[9], alignz9[9], rotx9[9], roty9[9];
+
+    if( ! ::readAlign( fileName, 1, 6, iteration,
+		       alignx9, aligny9, alignz9, rotx9, roty9 ) ) {
+      std::cout << "no " << fileName << std::endl;
+      return 0;
+    }
+
+    for( int ipl = 1; ipl < npl; ++ipl ) {
+      alignx[ipl] = alignx9[ipl];
+      aligny[ipl] = aligny9[ipl];
+      alignz[ipl] = alignz9[ipl];
+      rotx[ipl] = rotx9[ipl];
+      roty[ipl] = roty9[ipl];
+    }
+
+    return 1;
+  }
+
+  // alignDUT_RUN.dat from scope, read with telecore.h, dz after the geo
+
+  bool readDUTAlign( const std::string & fileName )
+  {
+    int iteration;
+    double z = NAN; // stays if there is no dz
+
+    if( ! ::readDUTAlign( fileName, iteration, DUTalignx, DUTaligny,
+			  DUTrot, DUTtilt, DUTturn, z, zz[3] ) ) {
+      std::cout << "no " << fileName << std::endl;
+      return 0;
+    }
+
+    if( ! std::isnan( z ) ) {
+      DUTz = z;
+      zz[iDUT] = DUTz;
+      fDUTzSet = 1;
+    }
+
+    return 1;
+  }
+
+  bool fifty() const // RD53A 50x50, else 100x25 sensor
+  {
+    return fabs( sizex[iDUT]/nx[iDUT] - sizey[iDUT]/ny[iDUT] ) < 1E-3;
+  }
+
+  // call after the parameters are set
+
+  void init( unsigned seed )
+  {
+    fRnd.seed( seed );
+
+    double wt = atan(1.0) / 45.0; // pi/180 deg
+    fco = cos( DUTturn*wt );
+    fso = sin( DUTturn*wt );
+    fca = cos( DUTtilt*wt );
+    fsa = sin( DUTtilt*wt );
+    fcf = cos( DUTrot );
+    fsf = sin( DUTrot );
+    fNx =-fca*fso;
+    fNy = fsa;
+    fNz =-fca*fco;
+
+    // planes along the beam:
+
+    fOrder.clear();
+    for( int ipl = 0; ipl < npl; ++ipl )
+      if( have[ipl] )
+	fOrder.push_back( ipl );
+    for( unsigned i = 0; i < fOrder.size(); ++i )
+      for( unsigned j = i+1; j < fOrder.size(); ++j )
+	if( zpl( fOrder[j] ) < zpl( fOrder[i] ) )
+	  std::swap( fOrder[i], fOrder[j] );
+
+    // hot pixels, ROC coordinates:
+
+    for( int ipl = 0; ipl < npl; ++ipl ) {
+      fHot[ipl].clear();
+      if( ! have[ipl] ) continue;
+      std::uniform_int_distribution<int> icol( 0, nxroc( ipl ) - 1 );
+      std::uniform_int_distribution<int> irow( 0, nyroc( ipl ) - 1 );
+      for( int i = 0; i < nhot; ++i )
+	fHot[ipl].push_back( std::make_pair( icol( fRnd ), irow( fRnd ) ) );
+    }
+  }
+
+  double zpl( int ipl ) const
+  {
+    return ipl == iDUT ? DUTz : zz[ipl] + alignz[ipl];
+  }
+
+  int nxroc( int ipl ) const
+  {
+    if( ipl == iDUT && ! fifty() ) return 2*nx[ipl];
+    return nx[ipl];
+  }
+
+  int nyroc( int ipl ) const
+  {
+    if( ipl == iDUT && ! fifty() ) return ny[ipl]/2;
+    return ny[ipl];
+  }
+
+  // time since the previous trigger [s]
+
+  double dt()
+  {
+    std::exponential_distribution<double> e( rate );
+    return e( fRnd );
+  }
+
+  void event( std::vector<SimPixel> px[npl] )
+  {
+    for( int ipl = 0; ipl < npl; ++ipl )
+      px[ipl].clear();
+
+    std::normal_distribution<double> gauss( 0, 1 );
+    std::uniform_real_distribution<double> flat( 0, 1 );
+
+    double p0 = 0.0136 / GeV; // Highland
+
+    // Mimosa rolling shutter: pivot flag for rows read after the trigger
+
+    int pivot[npl];
+    for( int ipl = 1; ipl < npl; ++ipl )
+      pivot[ipl] = have[ipl] ? int( flat( fRnd ) * ny[ipl] ) : 0;
+
+    std::poisson_distribution<int> ptrk( ntrk );
+    int ntk = ptrk( fRnd );
+
+    for( int itk = 0; itk < ntk; ++itk ) {
+
+      double z0 = zpl( fOrder[0] ) - 10;
+      double x = beamx * gauss( fRnd );
+      double y = beamy * gauss( fRnd );
+      double sx = div * gauss( fRnd );
+      double sy = div * gauss( fRnd );
+
+      for( unsigned k = 0; k < fOrder.size(); ++k ) {
+
+	int ipl = fOrder[k];
+	double zp = zpl( ipl );
+
+	// to the plane:
+
+	x += sx * ( zp - z0 );
+	y += sy * ( zp - z0 );
+	z0 = zp;
+
+	double q = qmip[ipl] * ( 1 + qwid * moyal() );
+
+	if( ipl == iDUT )
+	  depositDUT( x, y, sx, sy, q, px[ipl] );
+	else
+	  depositMim( ipl, x, y, sx, sy, q, pivot[ipl], px[ipl] );
+
+	// scatter:
+
+	double xx = xx0[ipl];
+	if( ipl == iDUT ) xx /= fabs( fca*fco ); // longer path
+	double t0 = p0 * sqrt( xx ) * ( 1 + 0.038*log( xx ) );
+	sx += t0 * gauss( fRnd );
+	sy += t0 * gauss( fRnd );
+
+      } // planes
+
+    } // tracks
+
+    // noise and hot pixels:
+
+    for( int ipl = 0; ipl < npl; ++ipl ) {
+
+      if( ! have[ipl] ) continue;
+
+      int ncol = nxroc( ipl );
+      int nrow = nyroc( ipl );
+      int nfrm = ipl == iDUT ? nbc : 1;
+
+      std::poisson_distribution<int> pnoise( noise * ncol * nrow * nfrm );
+      int nn = pnoise( fRnd );
+      for( int i = 0; i < nn; ++i ) {
+	SimPixel p;
+	p.col = int( flat( fRnd ) * ncol );
+	p.row = int( flat( fRnd ) * nrow );
+	p.tot = ipl == iDUT ? int( flat( fRnd ) * 4 ) : 1; // small
+	p.frm = ipl == iDUT ? int( flat( fRnd ) * nbc ) : 0;
+	p.pivot = ipl == iDUT ? 0 : p.row >= pivot[ipl];
+	px[ipl].push_back( p );
+      }
+
+      for( unsigned i = 0; i < fHot[ipl].size(); ++i ) {
+	if( flat( fRnd ) > hotprob ) continue;
+	SimPixel p;
+	p.col = fHot[ipl][i].first;
+	p.row = fHot[ipl][i].second;
+	p.tot = ipl == iDUT ? 15 : 1;
+	p.frm = ipl == iDUT ? int( flat( fRnd ) * nbc ) : 0;
+	p.pivot = ipl == iDUT ? 0 : p.row >= pivot[ipl];
+	px[ipl].push_back( p );
+      }
+
+    } // planes
+  }
+
+  // RD53A response
+
+  int tot( double q ) const
+  {
+    if( q <= gaint ) return 0;
+    int t = int( gaina*q + gainb - gainc / ( q - gaint ) );
+    if( t < 0 ) return 0;
+    if( t > 15 ) return 15;
+    return t;
+  }
+
+  // gain file for scope53m: col row a b c t, sensor pixels
+
+  bool writeGain( const std::string & fileName ) const
+  {
+    std::ofstream gainFile( fileName );
+    if( ! gainFile ) return 0;
+    for( int col = 0; col < nx[iDUT]; ++col )
+      for( int row = 0; row < ny[iDUT]; ++row )
+	gainFile << col << " " << row
+		 << " " << gaina << " " << gainb
+		 << " " << gainc << " " << gaint
+		 << std::endl;
+    return 1;
+  }
+
+ private:
+
+  // Moyal: -ln( z^2 ), z Gaussian
+
+  double moyal()
+  {
+    std::normal_distribution<double> gauss( 0, 1 );
+    double z = gauss( fRnd );
+    if( fabs( z ) < 1E-9 ) z = 1E-9;
+    return -log( z*z );
+  }
+
+  // charge along the track segment, shared by diffusion.
+  // u0, v0 to u1, v1 in pixel units, pixel i covers [i,i+1)
+
+  void share( double u0, double v0, double u1, double v1, double q,
+	      double su, double sv, int nu, int nv,
+	      std::map<int,double> & qpx )
+  {
+    const int nseg = 8;
+    double r2 = sqrt( 2.0 );
+    for( int is = 0; is < nseg; ++is ) {
+      double f = ( is + 0.5 ) / nseg;
+      double u = u0 + f * ( u1 - u0 );
+      double v = v0 + f * ( v1 - v0 );
+      int i0 = int( floor( u - 3*su ) );
+      int i9 = int( floor( u + 3*su ) );
+      int j0 = int( floor( v - 3*sv ) );
+      int j9 = int( floor( v + 3*sv ) );
+      if( i0 < 0 ) i0 = 0;
+      if( j0 < 0 ) j0 = 0;
+      if( i9 >= nu ) i9 = nu-1;
+      if( j9 >= nv ) j9 = nv-1;
+      if( i9 < i0 || j9 < j0 ) continue; // off the sensor
+      fFv.resize( j9 - j0 + 1 );
+      for( int j = j0; j <= j9; ++j )
+	fFv[j-j0] = 0.5 * ( erf( ( j+1-v ) / sv / r2 ) - erf( ( j-v ) / sv / r2 ) );
+      for( int i = i0; i <= i9; ++i ) {
+	double fu = 0.5 * ( erf( ( i+1-u ) / su / r2 ) - erf( ( i-u ) / su / r2 ) );
+	for( int j = j0; j <= j9; ++j )
+	  qpx[ i*nv + j ] += q / nseg * fu * fFv[j-j0];
+      }
+    }
+  }
+
+  void depositMim( int ipl, double x, double y, double sx, double sy,
+		   double q, int pivot, std::vector<SimPixel> & px )
+  {
+    double ptchx = sizex[ipl] / nx[ipl];
+    double ptchy = sizey[ipl] / ny[ipl];
+
+    double uv[2][2];
+    for( int k = 0; k < 2; ++k ) {
+      double dz = ( k - 0.5 ) * thck[ipl];
+      double X = x + sx * dz;
+      double Y = y + sy * dz;
+      // invert xmid - ymid*rotx, ymid + xmid*roty:
+      double det = 1 + rotx[ipl]*roty[ipl];
+      double xmid = ( X + Y*rotx[ipl] ) / det;
+      double ymid = ( Y - X*roty[ipl] ) / det;
+      uv[k][0] = ( xmid + 0.5*sizex[ipl] + alignx[ipl] ) / ptchx + 0.5;
+      uv[k][1] = ( ymid + 0.5*sizey[ipl] + aligny[ipl] ) / ptchy + 0.5;
+    }
+
+    std::map<int,double> qpx;
+    share( uv[0][0], uv[0][1], uv[1][0], uv[1][1], q,
+	   diff[ipl]/ptchx, diff[ipl]/ptchy, nx[ipl], ny[ipl], qpx );
+
+    for( std::map<int,double>::iterator it = qpx.begin(); it != qpx.end(); ++it ) {
+      if( it->second < thr[ipl] ) continue;
+      SimPixel p;
+      p.col = it->first / ny[ipl];
+      p.row = it->first % ny[ipl];
+      p.tot = 1;
+      p.frm = 0;
+      p.pivot = p.row >= pivot;
+      px.push_back( p );
+    }
+  }
+
+  // intersect with the turned and tilted DUT, as scope53m
+
+  void dutLocal( double xm, double ym, double zm, double sx, double sy,
+		 double dz, double & x4, double & y4 ) const
+  {
+    double z = DUTz + dz; // depth inside the sensor, along the normal
+    double zA = z - zm;
+    double zc = ( fNz*zA - fNy*ym - fNx*xm ) / ( fNx*sx + fNy*sy + fNz );
+    double xc = xm + sx * zc;
+    double yc = ym + sy * zc;
+    double dzc = zc + zm - z;
+
+    double x1 = fco*xc - fso*dzc;
+    double z1 = fso*xc + fco*dzc;
+    double y2 = fca*yc + fsa*z1;
+    double x3 = fcf*x1 + fsf*y2;
+    double y3 =-fsf*x1 + fcf*y2;
+
+    x4 = x3 + DUTalignx;
+    y4 = y3 + DUTaligny;
+  }
+
+  void depositDUT( double x, double y, double sx, double sy,
+		   double q, std::vector<SimPixel> & px )
+  {
+    double ptchx = sizex[iDUT] / nx[iDUT];
+    double ptchy = sizey[iDUT] / ny[iDUT];
+
+    // entry and exit: planes shifted along the normal
+
+    double uv[2][2];
+    for( int k = 0; k < 2; ++k ) {
+      double x4, y4;
+      dutLocal( x, y, DUTz, sx, sy, ( k - 0.5 ) * thck[iDUT] / fabs( fca*fco ), x4, y4 );
+      uv[k][0] = x4 / ptchx + 0.5*nx[iDUT];
+      uv[k][1] = y4 / ptchy + 0.5*ny[iDUT];
+    }
+
+    std::map<int,double> qpx;
+    share( uv[0][0], uv[0][1], uv[1][0], uv[1][1], q,
+	   diff[iDUT]/ptchx, diff[iDUT]/ptchy, nx[iDUT], ny[iDUT], qpx );
+
+    bool fty = fifty();
+
+    for( std::map<int,double>::iterator it = qpx.begin(); it != qpx.end(); ++it ) {
+      double qp = it->second;
+      if( qp < thr[iDUT] ) continue;
+      int pcol = it->first / ny[iDUT];
+      int prow = it->first % ny[iDUT];
+      SimPixel p;
+      p.col = fty ? pcol : 2*pcol + prow%2; // sensor to ROC, as scope53m
+      p.row = fty ? prow : prow/2;
+      p.tot = tot( qp );
+      p.frm = latency + ( qp < walkq ? 1 : 0 );
+      p.pivot = 0;
+      px.push_back( p );
+    }
+  }
+
+  std::mt19937_64 fRnd;
+  std::vector<int> fOrder; // planes sorted in z
+  std::vector<double> fFv; // share() scratch
+  std::vector< std::pair<int,int> > fHot[npl];
+  double fco, fso, fca, fsa, fcf, fsf, fNx, fNy, fNz;
+  bool fDUTzSet;
+
+}; // SimTele
+
+#endif
@@ -0,0 +1,229 @@
+// sixfit.h
+// straight line fit through the six telescope planes with multiple scattering
+// weights depend only on geometry and momentum: computed once, then
+// position and slope at zfit are dot products with the six hits
+
+// SixFitWeights w;
+// sixfit_weights( w, z, res, nsc, zsc, tsc, zfit );
+// sixfit_batch( w, n, u, u0, us, chi2 ); // u[6][n] hits, SoA
+
+#ifndef SIXFIT_H
+#define SIXFIT_H
+
+#include <cmath>
+
+#include "cpudispatch.h"
+
+struct SixFitWeights {
+  double zfit; // [mm]
+  double k0[6]; // position at zfit = sum k0[i]*u[i]
+  double ks[6]; // slope at zfit = sum ks[i]*u[i]
+  double M[6][6]; // chi2 = u^T M u, ndf 4
+  double sig0; // error of position at zfit [mm]
+  double sigs; // error of slope at zfit [rad]
+};
+
+//------------------------------------------------------------------------------
+// Highland angle for x/X0 at momentum p [GeV]
+
+inline double sixfit_theta( double xX0, double p )
+{
+  return 0.0136 / p * sqrt(xX0) * ( 1 + 0.038*log(xX0) );
+}
+
+//------------------------------------------------------------------------------
+// in place inverse of a symmetric positive 6x6 matrix (Gauss-Jordan)
+
+inline bool sixfit_invert( double a[6][6] )
+{
+  int n = 6;
+  double b[6][6];
+  for( int i = 0; i < n; ++i )
+    for( int j = 0; j < n; ++j )
+      b[i][j] = ( i == j );
+
+  for( int i = 0; i < n; ++i ) {
+    double piv = a[i][i];
+    if( fabs(piv) < 1E-30 ) return 0;
+    for( int j = 0; j < n; ++j ) {
+      a[i][j] /= piv;
+      b[i][j] /= piv;
+    }
+    for( int k = 0; k < n; ++k ) {
+      if( k == i ) continue;
+      double fk = a[k][i];
+      for( int j = 0; j < n; ++j ) {
+	a[k][j] -= fk * a[i][j];
+	b[k][j] -= fk * b[i][j];
+      }
+    }
+  }
+
+  for( int i = 0; i < n; ++i )
+    for( int j = 0; j < n; ++j )
+      a[i][j] = b[i][j];
+
+  return 1;
+}
+
+//------------------------------------------------------------------------------
+// z[6] plane positions, res[6] hit resolutions [mm],
+// nsc scatterers at zsc[] with rms angles tsc[] [rad]
+
+inline bool sixfit_weights( SixFitWeights & w,
+			    const double z[6], const double res[6],
+			    int nsc, const double zsc[], const double tsc[],
+			    double zfit )
+{
+  w.zfit = zfit;
+
+  // covariance of hits: resolution + scattering upstream of both
+
+  double V[6][6];
+  for( int i = 0; i < 6; ++i )
+    for( int j = 0; j < 6; ++j ) {
+      V[i][j] = ( i == j ) ? res[i]*res[i] : 0;
+      for( int k = 0; k < nsc; ++k )
+	if( zsc[k] < z[i] && zsc[k] < z[j] )
+	  V[i][j] += tsc[k]*tsc[k] * ( z[i] - zsc[k] ) * ( z[j] - zsc[k] );
+    }
+
+  // covariance of the scattering displacement and angle at zfit with the hits,
+  // variances at zfit:
+
+  double c0[6];
+  double cs[6];
+  double v0 = 0;
+  double vs = 0;
+  for( int i = 0; i < 6; ++i ) {
+    c0[i] = 0;
+    cs[i] = 0;
+  }
+  for( int k = 0; k < nsc; ++k ) {
+    if( zsc[k] >= zfit ) continue;
+    double t2 = tsc[k]*tsc[k];
+    double dk = zfit - zsc[k];
+    v0 += t2 * dk * dk;
+    vs += t2;
+    for( int i = 0; i < 6; ++i )
+      if( zsc[k] < z[i] ) {
+	c0[i] += t2 * dk * ( z[i] - zsc[k] );
+	cs[i] += t2 * ( z[i] - zsc[k] );
+      }
+  }
+
+  double W[6][6]; // V^-1
+  for( int i = 0; i < 6; ++i )
+    for( int j = 0; j < 6; ++j )
+      W[i][j] = V[i][j];
+  if( !sixfit_invert( W ) ) return 0;
+
+  // line u = a + b*(z-zfit): G = (A^T W A)^-1 A^T W
+
+  double A[6][2];
+  for( int i = 0; i < 6; ++i ) {
+    A[i][0] = 1;
+    A[i][1] = z[i] - zfit;
+  }
+
+  double N[2][2] = { { 0, 0 }, { 0, 0 } };
+  double WA[6][2];
+  for( int i = 0; i < 6; ++i )
+    for( int l = 0; l < 2; ++l ) {
+      WA[i][l] = 0;
+      for( int j = 0; j < 6; ++j )
+	WA[i][l] += W[i][j] * A[j][l];
+    }
+  for( int l = 0; l < 2; ++l )
+    for( int m = 0; m < 2; ++m )
+      for( int i = 0; i < 6; ++i )
+	N[l][m] += A[i][l] * WA[i][m];
+
+  double det = N[0][0]*N[1][1] - N[0][1]*N[1][0];
+  if( fabs(det) < 1E-30 ) return 0;
+  double Ni[2][2] = { {  N[1][1]/det, -N[0][1]/det },
+		      { -N[1][0]/det,  N[0][0]/det } };
+
+  double G[2][6];
+  for( int l = 0; l < 2; ++l )
+    for( int i = 0; i < 6; ++i )
+      G[l][i] = Ni[l][0] * WA[i][0] + Ni[l][1] * WA[i][1];
+
+  // M = W (1 - A G): residual weights, chi2 = u^T M u
+
+  double P[6][6]; // 1 - A G
+  for( int i = 0; i < 6; ++i )
+    for( int j = 0; j < 6; ++j )
+      P[i][j] = ( i == j ) - A[i][0]*G[0][j] - A[i][1]*G[1][j];
+
+  for( int i = 0; i < 6; ++i )
+    for( int j = 0; j < 6; ++j ) {
+      w.M[i][j] = 0;
+      for( int k = 0; k < 6; ++k )
+	w.M[i][j] += W[i][k] * P[k][j];
+    }
+
+  // best linear prediction at zfit: line + scattering correlated with the hits
+
+  for( int j = 0; j < 6; ++j ) {
+    w.k0[j] = G[0][j];
+    w.ks[j] = G[1][j];
+    for( int i = 0; i < 6; ++i ) {
+      w.k0[j] += c0[i] * w.M[i][j];
+      w.ks[j] += cs[i] * w.M[i][j];
+    }
+  }
+
+  // errors: k^T V k - 2 k^T c + var at zfit
+
+  double s0 = v0;
+  double ss = vs;
+  for( int i = 0; i < 6; ++i ) {
+    s0 -= 2 * w.k0[i] * c0[i];
+    ss -= 2 * w.ks[i] * cs[i];
+    for( int j = 0; j < 6; ++j ) {
+      s0 += w.k0[i] * V[i][j] * w.k0[j];
+      ss += w.ks[i] * V[i][j] * w.ks[j];
+    }
+  }
+  w.sig0 = sqrt( fabs(s0) );
+  w.sigs = sqrt( fabs(ss) );
+
+  return 1;
+}
+
+//------------------------------------------------------------------------------
+// fit n tracks in one projection, u[ipl][i] = hit of track i in plane ipl
+
+CPU_DISPATCH
+inline void sixfit_batch( const SixFitWeights & w, unsigned n,
+			  const double * const u[6],
+			  double * u0, double * us, double * chi2 )
+{
+  for( unsigned i = 0; i < n; ++i ) {
+    u0[i] = 0;
+    us[i] = 0;
+    chi2[i] = 0;
+  }
+
+  for( int p = 0; p < 6; ++p ) {
+    double k0 = w.k0[p];
+    double ks = w.ks[p];
+    const double * up = u[p];
+    for( unsigned i = 0; i < n; ++i ) { // contiguous, vectorizes
+      u0[i] += k0 * up[i];
+      us[i] += ks * up[i];
+    }
+  }
+
+  for( int p = 0; p < 6; ++p )
+    for( int q = p; q < 6; ++q ) {
+      double m = ( p == q ) ? w.M[p][q] : w.M[p][q] + w.M[q][p];
+      const double * up = u[p];
+      const double * uq = u[q];
+      for( unsigned i = 0; i < n; ++i )
+	chi2[i] += m * up[i] * uq[i];
+    }
+}
+
+#endif
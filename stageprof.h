@@ -0,0 +1,429 @@
+// stageprof.h
+// wall and CPU time per processing stage, per-event latency, counters
+
+// StageProf prof( "tele" );
+// int sdec = prof.stage( "decode" ); // once
+// per event: prof.lap( sdec ); ... prof.lap( sclu ); ... prof.endEvent();
+// more passes over the events (tele: decode all, then track per iteration):
+// int ptrk = prof.pass( "tracking" ); ... prof.endEvent( ptrk ); // own latency
+// or scoped: { StageTimer t( prof, sclu ); ... }
+// prof.count( "triplets", n );
+// end: prof.report( cout ); prof.write( "tele_25447.prof" );
+
+// lap() closes the running stage and opens the next one: fits the long
+// event loops where the stages are consecutive blocks, not scopes.
+
+// memory: peak and current RSS at the end, always.
+// prof.mark( "histos" ) after a block of bookings: RSS and heap taken
+// since the previous mark.
+// Built with -DSTAGEPROF_ALLOC (make -B tele ALLOC=1, main program only):
+// operator new/delete are replaced, heap calls, bytes and live peak per
+// stage, and the resident high-water growth per stage (a getrusage when
+// a stage closes). Off by default: no counters in the allocator and no
+// system call per stage and event in production runs.
+
+#ifndef STAGEPROF_H
+#define STAGEPROF_H
+
+#include <time.h> // clock_gettime
+#include <sys/resource.h> // getrusage
+#include <unistd.h> // sysconf
+#include <malloc.h> // malloc_usable_size
+#include <cstdlib>
+#include <new>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <map>
+#include <cmath>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+
+//------------------------------------------------------------------------------
+struct StageAlloc { // heap counters, zero without STAGEPROF_ALLOC
+
+  std::atomic<long> calls;
+  std::atomic<long> bytes; // allocated, total
+  std::atomic<long> live;
+  std::atomic<long> peak; // live high-water
+
+  void add( void * p )
+  {
+    long n = malloc_usable_size( p );
+    calls.fetch_add( 1, std::memory_order_relaxed );
+    bytes.fetch_add( n, std::memory_order_relaxed );
+    long l = live.fetch_add( n, std::memory_order_relaxed ) + n;
+    long pk = peak.load( std::memory_order_relaxed );
+    while( l > pk && !peak.compare_exchange_weak( pk, l, std::memory_order_relaxed ) );
+  }
+
+  void sub( void * p )
+  {
+    if( p ) live.fetch_sub( malloc_usable_size( p ), std::memory_order_relaxed );
+  }
+
+}; // StageAlloc
+
+inline StageAlloc & stageAlloc()
+{
+  static StageAlloc a; // zero-initialized, usable before main
+  return a;
+}
+
+#ifdef STAGEPROF_ALLOC
+
+// noinline: keeps gcc from pairing the inlined malloc and free
+
+__attribute__((noinline)) void * operator new( std::size_t n )
+{
+  void * p = malloc( n ? n : 1 );
+  if( !p ) throw std::bad_alloc();
+  stageAlloc().add( p );
+  return p;
+}
+
+__attribute__((noinline)) void * operator new( std::size_t n, const std::nothrow_t & ) noexcept
+{
+  void * p = malloc( n ? n : 1 );
+  if( p ) stageAlloc().add( p );
+  return p;
+}
+
+void * operator new[]( std::size_t n ) { return operator new( n ); }
+void * operator new[]( std::size_t n, const std::nothrow_t & t ) noexcept { return operator new( n, t ); }
+
+__attribute__((noinline)) void operator delete( void * p ) noexcept
+{
+  stageAlloc().sub( p );
+  free( p );
+}
+
+void operator delete[]( void * p ) noexcept { operator delete( p ); }
+void operator delete( void * p, std::size_t ) noexcept { operator delete( p ); }
+void operator delete[]( void * p, std::size_t ) noexcept { operator delete( p ); }
+void operator delete( void * p, const std::nothrow_t & ) noexcept { operator delete( p ); }
+void operator delete[]( void * p, const std::nothrow_t & ) noexcept { operator delete( p ); }
+
+#endif
+
+//------------------------------------------------------------------------------
+class StageProf {
+
+ public:
+
+  StageProf( const std::string & prog ) :
+    fProg(prog), fRun(-1), fRunning(-1), fEvents(0), fEvStart(-1)
+  {
+    fWall0 = wall();
+    fCpu0 = cpu();
+    pass( "event" ); // 0: the pass that counts the events
+    fMaxRss = maxrss();
+    fMarkRss = 0; // first mark: all since program start
+    fMarkHeap = 0;
+  }
+
+  static double wall()
+  {
+    timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+  }
+
+  static double cpu() // all threads of the process
+  {
+    timespec ts;
+    clock_gettime( CLOCK_PROCESS_CPUTIME_ID, &ts );
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+  }
+
+  // memory [MB]
+
+  static double maxrss() // resident high-water
+  {
+    rusage ru;
+    getrusage( RUSAGE_SELF, &ru );
+    return ru.ru_maxrss / 1024.0; // kB on Linux
+  }
+
+  static double rss() // resident now
+  {
+    std::ifstream sf( "/proc/self/statm" );
+    long size = 0, res = 0;
+    sf >> size >> res;
+    return res * ( sysconf( _SC_PAGESIZE ) / 1048576.0 );
+  }
+
+  static double heap() { return stageAlloc().live.load() / 1048576.0; }
+  static double heapPeak() { return stageAlloc().peak.load() / 1048576.0; }
+  static bool counting() { return stageAlloc().calls.load() > 0; }
+
+  void mark( const std::string & group ) // memory taken since the previous mark
+  {
+    double r = rss();
+    double h = heap();
+    fGroup.push_back( group );
+    fGroupRss.push_back( r - fMarkRss );
+    fGroupHeap.push_back( h - fMarkHeap );
+    fMarkRss = r;
+    fMarkHeap = h;
+  }
+
+  void setRun( int run ) { fRun = run; }
+
+  int stage( const std::string & name )
+  {
+    for( unsigned i = 0; i < fName.size(); ++i )
+      if( fName[i] == name ) return i;
+    fName.push_back( name );
+    fWall.push_back( 0 );
+    fCpu.push_back( 0 );
+    fCalls.push_back( 0 );
+    fOpen.push_back( -1 );
+    fOpenCpu.push_back( 0 );
+    fAllocs.push_back( 0 );
+    fBytes.push_back( 0 );
+    fGrow.push_back( 0 );
+    fOpenAllocs.push_back( 0 );
+    fOpenBytes.push_back( 0 );
+    return fName.size() - 1;
+  }
+
+  void start( int is )
+  {
+    fOpen[is] = wall();
+    fOpenCpu[is] = cpu();
+#ifdef STAGEPROF_ALLOC
+    fOpenAllocs[is] = stageAlloc().calls.load( std::memory_order_relaxed );
+    fOpenBytes[is] = stageAlloc().bytes.load( std::memory_order_relaxed );
+#endif
+  }
+
+  void stop( int is )
+  {
+    if( fOpen[is] < 0 ) return;
+    fWall[is] += wall() - fOpen[is];
+    fCpu[is] += cpu() - fOpenCpu[is];
+    ++fCalls[is];
+    fOpen[is] = -1;
+#ifdef STAGEPROF_ALLOC
+    fAllocs[is] += stageAlloc().calls.load( std::memory_order_relaxed ) - fOpenAllocs[is];
+    fBytes[is] += stageAlloc().bytes.load( std::memory_order_relaxed ) - fOpenBytes[is];
+    double m = maxrss();
+    if( m > fMaxRss ) { // new high-water since the last stage closed
+      fGrow[is] += m - fMaxRss;
+      fMaxRss = m;
+    }
+#endif
+  }
+
+  void lap( int is ) // is < 0: only close
+  {
+    if( fRunning >= 0 ) stop( fRunning );
+    fRunning = is;
+    if( is < 0 ) return;
+    start( is );
+    if( fEvStart < 0 ) fEvStart = fOpen[is]; // event begins with its first stage
+  }
+
+  int pass( const std::string & name ) // latency histogram per pass
+  {
+    for( unsigned i = 0; i < fPass.size(); ++i )
+      if( fPass[i] == name ) return i;
+    fPass.push_back( name );
+    fLat.push_back( std::vector<long>( nlat, 0 ) );
+    fLatN.push_back( 0 );
+    return fPass.size() - 1;
+  }
+
+  void endEvent( int ip = 0 ) // close the running stage, event latency
+  {
+    lap( -1 );
+    if( ip == 0 ) ++fEvents;
+    if( fEvStart < 0 ) return;
+    double dt = wall() - fEvStart;
+    fEvStart = -1;
+    int il = dt > 1e-6 ? int( 4*log10( dt*1e6 ) ) : 0; // 4 bins per decade from 1 us
+    if( il >= nlat ) il = nlat-1;
+    ++fLat[ip][il];
+    ++fLatN[ip];
+  }
+
+  void count( const std::string & name, double n = 1 ) { fCount[name] += n; }
+
+  // latency quantile from the log bins [s]
+
+  double latency( double q, int ip = 0 ) const
+  {
+    if( fLatN[ip] == 0 ) return 0;
+    double sum = 0;
+    for( int i = 0; i < nlat; ++i ) {
+      sum += fLat[ip][i];
+      if( sum >= q*fLatN[ip] )
+	return 1e-6 * pow( 10, ( i + 1 ) / 4.0 ); // upper edge
+    }
+    return 1e-6 * pow( 10, nlat / 4.0 );
+  }
+
+  void report( std::ostream & os ) const
+  {
+    double wt = wall() - fWall0;
+    double ct = cpu() - fCpu0;
+
+    os << std::endl << fProg << " profile: " << fEvents << " events"
+       << " in " << wt << " s wall, " << ct << " s cpu";
+    if( wt > 0 )
+      os << ", " << fEvents / wt << " events/s";
+    os << std::endl;
+
+    for( unsigned i = 0; i < fName.size(); ++i )
+      os << "  " << std::setw(12) << std::left << fName[i] << std::right
+	 << std::setw(10) << std::setprecision(4) << fWall[i] << " s wall"
+	 << std::setw(10) << fCpu[i] << " s cpu"
+	 << std::setw(7) << std::setprecision(3) << ( ct > 0 ? 100*fCpu[i]/ct : 0 ) << "%"
+	 << std::setw(12) << fCalls[i] << " calls"
+	 << std::setprecision(6) << std::endl;
+
+    for( unsigned ip = 0; ip < fPass.size(); ++ip )
+      if( fLatN[ip] > 0 )
+	os << "  " << fPass[ip] << " latency < " << latency(0.5,ip)*1e6 << " us (50%), "
+	   << latency(0.9,ip)*1e6 << " us (90%), "
+	   << latency(0.99,ip)*1e6 << " us (99%)"
+	   << " from " << fLatN[ip] << std::endl;
+
+    for( std::map<std::string,double>::const_iterator it = fCount.begin();
+	 it != fCount.end(); ++it )
+      os << "  " << it->first << " " << it->second << std::endl;
+
+    os << "  memory: peak RSS " << maxrss() << " MB, RSS now " << rss() << " MB";
+    if( counting() )
+      os << ", heap peak " << heapPeak() << " MB, heap now " << heap() << " MB";
+    os << std::endl;
+
+    if( counting() )
+      for( unsigned i = 0; i < fName.size(); ++i )
+	os << "  " << std::setw(12) << std::left << fName[i] << std::right
+	   << std::setw(10) << std::setprecision(4) << fGrow[i] << " MB peak growth"
+	   << std::setw(12) << fAllocs[i] << " allocs"
+	   << std::setw(10) << fBytes[i] / 1048576.0 << " MB"
+	   << std::setw(10) << ( fEvents > 0 ? double( fAllocs[i] ) / fEvents : 0 ) << " allocs/event"
+	   << std::setprecision(6) << std::endl;
+
+    for( unsigned i = 0; i < fGroup.size(); ++i ) {
+      os << "  " << std::setw(12) << std::left << fGroup[i] << std::right
+	 << std::setw(10) << std::setprecision(4) << fGroupRss[i] << " MB RSS";
+      if( counting() )
+	os << std::setw(10) << fGroupHeap[i] << " MB heap";
+      os << std::setprecision(6) << std::endl;
+    }
+  }
+
+  // key value lines, like the align files
+
+  bool write( const std::string & fileName ) const
+  {
+    std::ofstream pf( fileName );
+    if( !pf ) return 0;
+
+    double wt = wall() - fWall0;
+    double ct = cpu() - fCpu0;
+
+    pf << "# " << fProg << " profile" << std::endl;
+    pf << "program " << fProg << std::endl;
+    pf << "run " << fRun << std::endl;
+    pf << "events " << fEvents << std::endl;
+    pf << "wall " << wt << std::endl;
+    pf << "cpu " << ct << std::endl;
+    pf << "rate " << ( wt > 0 ? fEvents / wt : 0 ) << std::endl;
+    pf << "latency50 " << latency(0.5) << std::endl;
+    pf << "latency90 " << latency(0.9) << std::endl;
+    pf << "latency99 " << latency(0.99) << std::endl;
+    for( unsigned ip = 1; ip < fPass.size(); ++ip )
+      pf << "passlatency " << fPass[ip]
+	 << " " << latency(0.5,ip)
+	 << " " << latency(0.9,ip)
+	 << " " << latency(0.99,ip)
+	 << " " << fLatN[ip]
+	 << std::endl;
+    for( unsigned i = 0; i < fName.size(); ++i )
+      pf << "stage " << fName[i]
+	 << " " << fWall[i]
+	 << " " << fCpu[i]
+	 << " " << ( ct > 0 ? fCpu[i]/ct : 0 )
+	 << " " << fCalls[i]
+	 << std::endl;
+    for( std::map<std::string,double>::const_iterator it = fCount.begin();
+	 it != fCount.end(); ++it )
+      pf << "count " << it->first << " " << it->second << std::endl;
+    pf << "maxrss " << maxrss() << std::endl; // MB
+    pf << "heappeak " << heapPeak() << std::endl;
+    if( counting() )
+      for( unsigned i = 0; i < fName.size(); ++i )
+	pf << "stagemem " << fName[i]
+	   << " " << fGrow[i]
+	   << " " << fAllocs[i]
+	   << " " << fBytes[i] / 1048576.0
+	   << std::endl;
+    for( unsigned i = 0; i < fGroup.size(); ++i )
+      pf << "memgroup " << fGroup[i]
+	 << " " << fGroupRss[i]
+	 << " " << fGroupHeap[i]
+	 << std::endl;
+
+    return 1;
+  }
+
+  // tele_25447.root -> tele_25447.prof
+
+  static std::string fileNameFor( const std::string & rootFileName )
+  {
+    std::string s = rootFileName;
+    size_t i = s.rfind( ".root" );
+    if( i != std::string::npos ) s.erase( i );
+    return s + ".prof";
+  }
+
+ private:
+
+  static const int nlat = 40; // 1 us .. 10^4 s
+
+  std::string fProg;
+  int fRun;
+  double fWall0, fCpu0;
+  std::vector<std::string> fName;
+  std::vector<double> fWall, fCpu;
+  std::vector<long> fCalls;
+  std::vector<double> fOpen, fOpenCpu;
+  int fRunning; // stage opened by lap()
+  std::map<std::string,double> fCount;
+  long fEvents;
+  double fEvStart;
+  std::vector<std::string> fPass; // endEvent( ip )
+  std::vector< std::vector<long> > fLat;
+  std::vector<long> fLatN;
+  std::vector<long> fAllocs, fBytes; // heap per stage
+  std::vector<long> fOpenAllocs, fOpenBytes;
+  std::vector<double> fGrow; // RSS high-water growth per stage [MB], STAGEPROF_ALLOC
+  double fMaxRss;
+  std::vector<std::string> fGroup; // mark()
+  std::vector<double> fGroupRss, fGroupHeap;
+  double fMarkRss, fMarkHeap;
+
+}; // StageProf
+
+//------------------------------------------------------------------------------
+class StageTimer { // scope = stage
+
+ public:
+
+  StageTimer( StageProf & p, int is ) : fP(p), fIs(is) { fP.start( fIs ); }
+  ~StageTimer() { fP.stop( fIs ); }
+
+ private:
+
+  StageProf & fP;
+  int fIs;
+
+}; // StageTimer
+
+#endif
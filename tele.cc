@@ -5,6 +5,7 @@
 
 // make tele
 // tele -g geo_2018_06r.dat -p 5.6 -l 99999 33095
+// tele -g geo_2018_06r.dat -p 5.6 33095-33110,33120: several runs with the same geo in one process
 
 #include "eudaq/FileReader.hh"
 #include "eudaq/PluginManager.hh"
@@ -22,24 +23,19 @@
 #include <map>
 #include <set>
 #include <cmath>
-#include <time.h> // clock_gettime
+
+#include "sixfit.h"
+#include "histshard.h"
+#include "stageprof.h"
+#include "simconv.h" // synthetic runs from simraw
+#include "multirun.h"
+#include "telecore.h" // clustering, hot pixels
+#include "teleclus.h" // pixel, cluster, cluster position
+#include "zscan.h"
 
 using namespace std;
 using namespace eudaq;
-
-struct pixel {
-  int col;
-  int row;
-  int nn;
-};
-
-struct cluster {
-  vector <pixel> vpix;
-  //int size; int ncol, nrow;
-  unsigned scr; // compressed
-  float col, row;
-  float mindxy;
-};
+using namespace tele;
 
 struct triplet {
   double xm;
@@ -54,119 +50,21 @@ struct triplet {
 bool ldbg = 0; // global
 
 //------------------------------------------------------------------------------
-vector<cluster> getClus( vector <pixel> pb, int fCluCut = 1 ) // 1 = no gap
-{
-  // returns clusters with pixel coordinates
-  // next-neighbour topological clustering (allows fCluCut-1 empty pixels)
-
-  vector <cluster> vc;
-  if( pb.size() == 0 ) return vc;
-
-  int * gone = new int[pb.size()];
-  for( unsigned i = 0; i < pb.size(); ++i )
-    gone[i] = 0;
-
-  unsigned seed = 0;
-
-  while( seed < pb.size() ) {
-
-    // start a new cluster:
-
-    cluster c;
-    c.vpix.push_back( pb[seed] );
-    gone[seed] = 1;
-
-    // let it grow as much as possible:
-
-    int growing;
-    do{
-      growing = 0;
-      for( unsigned i = 0; i < pb.size(); ++i ) {
-        if( !gone[i] ){ // unused pixel
-          for( unsigned int p = 0; p < c.vpix.size(); ++p ) { // vpix in cluster so far
-            int dr = c.vpix.at(p).row - pb[i].row;
-            int dc = c.vpix.at(p).col - pb[i].col;
-	    //if( (   dr>=-fCluCut) && (dr<=fCluCut) 
-	    //&& (dc>=-fCluCut) && (dc<=fCluCut) ) { // allow diagonal
-            if( ( abs(dr) <= fCluCut && dc == 0 ) ||
-		( abs(dc) <= fCluCut && dr == 0 ) ) { // only facing neighbours, same resolution
-              c.vpix.push_back(pb[i]);
-	      gone[i] = 1;
-              growing = 1;
-              break; // important!
-            }
-          } // loop over vpix
-        } // not gone
-      } // loop over all pix
-    }
-    while( growing );
-
-    // count pixel neighbours:
-
-    for( vector <pixel>::iterator p = c.vpix.begin(); p != c.vpix.end(); ++p ) {
-      vector <pixel>::iterator q = p;
-      ++q;
-      for( ; q != c.vpix.end(); ++q )
-	if( abs( p->col - q->col ) <= 1 &&abs( p->row - q->row ) <= 1 ) {
-	  ++p->nn;
-	  ++q->nn;
-	}
-    }
-
-    c.col = 0;
-    c.row = 0;
-    int sumnn = 0;
-    int minx = 9999;
-    int maxx = 0;
-    int miny = 9999;
-    int maxy = 0;
-
-    for( vector <pixel>::iterator p = c.vpix.begin(); p != c.vpix.end(); ++p ) {
-
-      int nn = max( 1, p->nn ); // neighbours
-      sumnn += nn;
-      c.col += p->col * nn;
-      c.row += p->row * nn;
-      if( p->col > maxx ) maxx = p->col;
-      if( p->col < minx ) minx = p->col;
-      if( p->row > maxy ) maxy = p->row;
-      if( p->row < miny ) miny = p->row;
-    }
-
-    //cout << "(cluster with " << c.vpix.size() << " pixels)" << endl;
-
-    //c.col /= c.vpix.size();
-    //c.row /= c.vpix.size();
-    c.col /= sumnn; // weighted cluster center
-    c.row /= sumnn;
-
-    //c.size = c.vpix.size();
-    //c.ncol = maxx-minx+1;
-    //c.nrow = maxy-miny+1;
-    c.scr = c.vpix.size() + 1024 * ( (maxx-minx+1) + 1024*(maxy-miny+1) ); // compressed size, ncol nrow
-    c.mindxy = 999;
-
-    c.vpix.clear(); // save space
-
-    vc.push_back(c); // add cluster to vector
-
-    // look for a new seed = unused pixel:
-
-    while( ( ++seed < pb.size() ) && gone[seed] );
-
-  } // while over seeds
-
-  delete gone;
-
-  return vc; // vector of clusters
-
-} // getClus
+struct clusterplots { // per plane, filled in the clustering thread
+  H1Shard ncl, ccol, crow, npix, ncol, nrow, mindxy;
+};
 
 //------------------------------------------------------------------------------
-list < vector <cluster> > oneplane( unsigned ipl, list < vector <pixel> > pxlist )
+list < vector <cluster> > oneplane( unsigned ipl, list < vector <pixel> > pxlist,
+				    clusterplots & cp )
 {
   list < vector < cluster > > clist;
 
+  // cluster plots in batches, in event order:
+
+  const unsigned nbatch = 4096;
+  vector <double> bcol, brow, bnpix, bncol, bnrow, bmindxy;
+
   for( auto ev = pxlist.begin(); ev != pxlist.end(); ++ev ) {
 
     vector <pixel> pb = *ev;
@@ -175,21 +73,36 @@ list < vector <cluster> > oneplane( unsigned ipl, list < vector <pixel> > pxlist
 
     if( ldbg ) cout << ipl << " clusters " << vcl.size() << endl;
 
-    for( vector<cluster>::iterator cA = vcl.begin(); cA != vcl.end(); ++cA ) {
+    isolation( vcl ); // cluster isolation
 
-      // cluster isolation:
+    cp.ncl.fill( vcl.size() );
 
-      vector<cluster>::iterator cD = cA;
-      ++cD;
-      for( ; cD != vcl.end(); ++cD ) {
-	double dx = cD->col - cA->col;
-	double dy = cD->row - cA->row;
-	double dxy = sqrt( dx*dx + dy*dy );
-	if( dxy < cA->mindxy ) cA->mindxy = dxy;
-	if( dxy < cD->mindxy ) cD->mindxy = dxy;
-      }
+    for( vector<cluster>::iterator cA = vcl.begin(); cA != vcl.end(); ++cA ) {
+      bcol.push_back( cA->col );
+      brow.push_back( cA->row );
+      unsigned nrow = cA->scr/(1024*1024);
+      unsigned ncol = (cA->scr - nrow*1024*1024)/1024;
+      unsigned npix = cA->scr % 1024;
+      bnpix.push_back( npix );
+      bncol.push_back( ncol );
+      bnrow.push_back( nrow );
+      bmindxy.push_back( cA->mindxy );
+    }
 
-    } // cl A
+    if( bcol.size() >= nbatch || next( ev ) == pxlist.end() ) {
+      cp.ccol.fill( bcol.size(), bcol.data() );
+      cp.crow.fill( brow.size(), brow.data() );
+      cp.npix.fill( bnpix.size(), bnpix.data() );
+      cp.ncol.fill( bncol.size(), bncol.data() );
+      cp.nrow.fill( bnrow.size(), bnrow.data() );
+      cp.mindxy.fill( bmindxy.size(), bmindxy.data() );
+      bcol.clear();
+      brow.clear();
+      bnpix.clear();
+      bncol.clear();
+      bnrow.clear();
+      bmindxy.clear();
+    }
 
     clist.push_back(vcl);
 
@@ -200,9 +113,12 @@ list < vector <cluster> > oneplane( unsigned ipl, list < vector <pixel> > pxlist
 } // oneplane
 
 //------------------------------------------------------------------------------
-int main( int argc, char* argv[] )
+int analyseRun( int argc, char* argv[] ) // one run, multirun.h
 {
   cout << "main " << argv[0] << " called with " << argc << " arguments" << endl;
+  cout << "vector kernels: " << cpuLevel() << endl;
+
+  ldbg = 0;
 
   if( argc < 4 ) {
     cout << "format: tele -g geo_year_mon.dat run" << endl;
@@ -233,6 +149,7 @@ int main( int argc, char* argv[] )
   int lev = 999222111; // last event
   string geoFileName{ "geo.dat" };
   double mom = 4.8;
+  bool lzscan = 0;
 
   for( int i = 1; i < argc; ++i ) {
 
@@ -245,6 +162,9 @@ int main( int argc, char* argv[] )
     if( !strcmp( argv[i], "-p" ) )
       mom = atof( argv[++i] ); // momentum
 
+    if( !strcmp( argv[i], "-z" ) )
+      lzscan = 1; // z from scan, from iteration 1 on
+
   } // argc
 
   double f = 4.8/mom;
@@ -264,112 +184,12 @@ int main( int argc, char* argv[] )
 
   double zz[9];
 
-  for( int ipl = 0; ipl < 9; ++ipl )
-    nx[ipl] = 0; // missing plane flag
-
-  ifstream geoFile( geoFileName );
-
-  if( geoFile.bad() || ! geoFile.is_open() ) {
+  if( ! readGeo( geoFileName, 1, 6, // Mimosa 1..6
+		 nx, ny, sizex, sizey, zz, ptchx, ptchy, midx, midy ) ) {
     cout << "Error opening " << geoFileName << endl;
     return 1;
   }
 
-  cout << "read geometry from " << geoFileName << endl;
-
-  { // open local scope
-
-    string hash{ "#" };
-    string plane{ "plane" };
-    string type{ "type" };
-    string sizexs{ "sizex" };
-    string sizeys{ "sizey" };
-    string npixelx{ "npixelx" };
-    string npixely{ "npixely" };
-    string zpos{ "zpos" };
-
-    int ipl = 0;
-    string chiptype;
-
-    while( ! geoFile.eof() ) {
-
-      string line;
-      getline( geoFile, line );
-      cout << line << endl;
-
-      if( line.empty() ) continue;
-
-      stringstream tokenizer( line );
-      string tag;
-      tokenizer >> tag; // leading white space is suppressed
-      if( tag.substr(0,1) == hash ) // comments start with #
-	continue;
-
-      if( tag == plane ) {
-	tokenizer >> ipl;
-	continue;
-      }
-
-      if( ipl < 1 || ipl > 6 ) { // Mimosa 1..6
-	cout << "geo wrong plane number " << ipl << endl;
-	continue;
-      }
-
-      if( tag == type ) {
-	tokenizer >> chiptype;
-	continue;
-      }
-
-      if( tag == sizexs ) {
-	double val;
-	tokenizer >> val;
-	sizex[ipl] = val;
-	continue;
-      }
-
-      if( tag == sizeys ) {
-	double val;
-	tokenizer >> val;
-	sizey[ipl] = val;
-	continue;
-      }
-
-      if( tag == npixelx ) {
-	int val;
-	tokenizer >> val;
-	nx[ipl] = val;
-	continue;
-      }
-
-      if( tag == npixely ) {
-	int val;
-	tokenizer >> val;
-	ny[ipl] = val;
-	continue;
-      }
-
-      if( tag == zpos ) {
-	double val;
-	tokenizer >> val;
-	zz[ipl] = val;
-	continue;
-      }
-
-      // anything else on the line and in the file gets ignored
-
-    } // while getline
-
-    for( int ipl = 0; ipl < 9; ++ipl ) {
-      if( nx[ipl] == 0 ) continue; // missing plane flag
-      ptchx[ipl] = sizex[ipl] / nx[ipl]; // pixel size 21.2/1152=18.4
-      ptchy[ipl] = sizey[ipl] / ny[ipl];
-      midx[ipl] = 0.5 * sizex[ipl]; // mid plane
-      midy[ipl] = 0.5 * sizey[ipl]; // mid plane
-    }
-
-  } // geo scope
-
-  geoFile.close();
-
   // for profile plots:
   //double drng = 0.1*f; // narrow spacing
   double drng = 0.2*f; // wide spacing [mm]
@@ -381,60 +201,12 @@ int main( int argc, char* argv[] )
 
   hotFileName << "hot_" << run << ".dat";
 
-  ifstream ihotFile( hotFileName.str() );
-
   set <int> hotset[9];
 
   cout << endl;
-  if( ihotFile.bad() || ! ihotFile.is_open() ) {
-    cout << "no " << hotFileName.str() << ", will be created" << endl;
-  }
-  // can there be instructions between if and else ? no!
-  else {
-
-    cout << "read hot pixel list from " << hotFileName.str() << endl;
 
-    string hash{ "#" };
-    string plane{ "plane" };
-    string pix{ "pix" };
-
-    int ipl = 0;
-
-    while( ! ihotFile.eof() ) {
-
-      string line;
-      getline( ihotFile, line );
-      //cout << line << endl;
-
-      if( line.empty() ) continue;
-
-      stringstream tokenizer( line );
-      string tag;
-      tokenizer >> tag; // leading white space is suppressed
-      if( tag.substr(0,1) == hash ) // comments start with #
-	continue;
-
-      if( tag == plane )
-	tokenizer >> ipl;
-
-      if( ipl < 1 || ipl > 6 ) {
-	cout << "hot pixel wrong plane number " << ipl << endl;
-	continue;
-      }
-
-      if( tag == pix ) {
-	int ix, iy;
-	tokenizer >> ix;
-	tokenizer >> iy;
-	int ipx = ix*ny[ipl]+iy;
-	hotset[ipl].insert(ipx);
-      }
-
-    } // while getline
-
-  } // hotFile
-
-  ihotFile.close();
+  if( ! readHotPixels( hotFileName.str(), ny, hotset, 1, 6 ) )
+    cout << "no " << hotFileName.str() << ", will be created" << endl;
 
   for( int ipl = 0; ipl < 9; ++ipl )
     cout << ipl << ": hot " << hotset[ipl].size() << endl;
@@ -449,90 +221,16 @@ int main( int argc, char* argv[] )
   double rotx[9];
   double roty[9];
 
-  for( int ipl = 0; ipl < 9; ++ipl ) {
-
-    alignx[ipl] = 0.000; // [mm] same sign as dxAB
-    aligny[ipl] = 0.000; // [mm] same sign as dy
-    alignz[ipl] = 0.000; // [mm]
-    rotx[ipl] = 0.0000; // [rad] rot, same     sign dxvsy
-    roty[ipl] = 0.0000; // [rad] rot, opposite sign dyvsx
-
-  }
-
   ostringstream alignFileName; // output string stream
 
   alignFileName << "align_" << run << ".dat";
 
-  ifstream ialignFile( alignFileName.str() );
-
   cout << endl;
-  if( ialignFile.bad() || ! ialignFile.is_open() ) {
+  if( ! readAlign( alignFileName.str(), 1, 6,
+		   aligniteration, alignx, aligny, alignz, rotx, roty ) ) {
     cout << "no " << alignFileName.str() << ", will bootstrap" << endl;
     cout << endl;
   }
-  // can there be instructions between if and else ? no!
-  else {
-
-    cout << "read alignment from " << alignFileName.str() << endl;
-
-    string hash{ "#" };
-    string iteration{ "iteration" };
-    string plane{ "plane" };
-    string shiftx{ "shiftx" };
-    string shifty{ "shifty" };
-    string shiftz{ "shiftz" };
-    string rotxvsy{ "rotxvsy" };
-    string rotyvsx{ "rotyvsx" };
-
-    int ipl = 0;
-
-    while( ! ialignFile.eof() ) {
-
-      string line;
-      getline( ialignFile, line );
-      cout << line << endl;
-
-      if( line.empty() ) continue;
-
-      stringstream tokenizer( line );
-      string tag;
-      tokenizer >> tag; // leading white space is suppressed
-      if( tag.substr(0,1) == hash ) // comments start with #
-	continue;
-
-      if( tag == iteration ) {
-	tokenizer >> aligniteration;
-	continue;
-      }
-
-      if( tag == plane )
-	tokenizer >> ipl;
-
-      if( ipl < 1 || ipl > 6 ) {
-	cout << "align wrong plane number " << ipl << endl;
-	continue;
-      }
-
-      double val;
-      tokenizer >> val;
-      if(      tag == shiftx )
-	alignx[ipl] = val;
-      else if( tag == shifty )
-	aligny[ipl] = val;
-      else if( tag == shiftz )
-	alignz[ipl] = val;
-      else if( tag == rotxvsy )
-	rotx[ipl] = val;
-      else if( tag == rotyvsx )
-	roty[ipl] = val;
-
-      // anything else on the line and in the file gets ignored
-
-    } // while getline
-
-  } // alignFile
-
-  ialignFile.close();
 
   if( aligniteration == 0 ) f *= 3; // wider binning
 
@@ -540,9 +238,22 @@ int main( int argc, char* argv[] )
 
   double DUTz = 0.5 * ( zz[3] + zz[4] ); // 0.5*(304+560) = 432
 
+  // six-plane fit: Mimosa 50 um Si + 50 um kapton, x/X0 = 7.5E-4 per plane
+
+  double sixres[6];
+  double sixtet[6];
+  for( int i = 0; i < 6; ++i ) {
+    sixres[i] = 3.5E-3; // [mm]
+    sixtet[i] = sixfit_theta( 7.5E-4, mom );
+  }
+
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
   // (re-)create root file:
 
+  StageProf prof( "tele" );
+  prof.setRun( run );
+  prof.mark( "setup" );
+
   ostringstream rootFileName; // output string stream
 
   rootFileName << "tele" << run << ".root";
@@ -745,6 +456,8 @@ int main( int argc, char* argv[] )
   TProfile2D * trimadxvsxmym[2];
   TProfile tridxvstx[2];
   TProfile trimadxvstx[2];
+  TProfile trizscanmad[2];
+  TProfile trizscandx[2];
 
   TH1I htridyc[2];
   TH1I htridyci[2];
@@ -861,6 +574,14 @@ int main( int argc, char* argv[] )
 			       Form( "%splet dx vs tx;%splet slope x [mrad];<%splets #Deltax> [#mum]",
 				     tds.c_str(), tds.c_str(), tds.c_str() ),
 			       80, -2, 2, -50, 50 );
+    trizscanmad[itd] = TProfile( Form( "%szscanmad", tds.c_str() ),
+				 Form( "%splet z scan;trial mid plane z shift [mm];%splets MAD(#Deltax,#Deltay) [#mum]",
+				       tds.c_str(), tds.c_str() ),
+				 41, -5.125, 5.125, 0, 50 );
+    trizscandx[itd] = TProfile( Form( "%szscandx", tds.c_str() ),
+				Form( "%splet z scan;trial mid plane z shift [mm];<%splets #Deltax> [#mum]",
+				      tds.c_str(), tds.c_str() ),
+				41, -5.125, 5.125, -50, 50 );
     trimadxvstx[itd] =
       TProfile( Form( "%smadxvstx", tds.c_str() ),
 		Form( "%splet MAD(#Deltax) vs #theta_{x};%splet #theta_{x} [mrad];%splet MAD(#Deltax) [#mum]",
@@ -1195,6 +916,11 @@ int main( int argc, char* argv[] )
   TH1I hsixdxcsid = TH1I( "sixdxcsid", "six dx Si;#Deltax [#mum];triplet-driplet pairs in Si", 400, -200*f, 200*f );
   TH1I hsixdyc = TH1I( "sixdyc", "six dy;#Deltay [#mum];triplet-driplet pairs", 400, -200*f, 200*f );
 
+  TH1I hsixfitchi2x = TH1I( "sixfitchi2x", "six-plane fit #chi^{2} x;#chi^{2} x (ndf 4);six-plane fits", 100, 0, 40 );
+  TH1I hsixfitchi2y = TH1I( "sixfitchi2y", "six-plane fit #chi^{2} y;#chi^{2} y (ndf 4);six-plane fits", 100, 0, 40 );
+  TH1I hsixfitdx = TH1I( "sixfitdx", "six-plane fit - triplet-driplet mean at DUT x;#Deltax [#mum];six-plane fits", 200, -50*f, 50*f );
+  TH1I hsixfitdy = TH1I( "sixfitdy", "six-plane fit - triplet-driplet mean at DUT y;#Deltay [#mum];six-plane fits", 200, -50*f, 50*f );
+
   TH2I * hsixxy = new
     TH2I( "sixxy", "sixplet x-y;sixplet x_{mid} [mm];sixplet y_{mid} [mm];sixplets",
 	  240, -12, 12, 120, -6, 6 );
@@ -1282,13 +1008,19 @@ int main( int argc, char* argv[] )
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
   // event loop:
 
-  timespec ts;
-  clock_gettime( CLOCK_REALTIME, &ts );
-  time_t s0 = ts.tv_sec; // seconds since 1.1.1970
-  long f0 = ts.tv_nsec; // nanoseconds
-  double zeit1 = 0; // read
-  double zeit2 = 0; // clus
-  double zeit3 = 0; // track
+  prof.mark( "histos" );
+
+  int sdecode = prof.stage( "decode" );
+  int sclus = prof.stage( "clustering" );
+  int scorr = prof.stage( "correlations" );
+  int strip = prof.stage( "triplets" );
+  int sextra = prof.stage( "extrapolate" );
+  int smatch = prof.stage( "matching" );
+  int sfits = prof.stage( "fits" );
+  int soutput = prof.stage( "output" );
+  int ptrk = prof.pass( "tracking" ); // latency of the tracking loop per event
+
+  double t0 = StageProf::wall(); // [s]
 
   int iev = 0;
   uint64_t evTLU0 = 0;
@@ -1301,6 +1033,8 @@ int main( int argc, char* argv[] )
 
   do {
 
+    prof.lap( sdecode );
+
     // Get next event:
     DetectorEvent evt = reader->GetDetectorEvent();
 
@@ -1447,19 +1181,18 @@ int main( int argc, char* argv[] )
 
     ++iev;
 
+    prof.endEvent();
+
   } while( reader->NextEvent() && iev < lev ); // event loop
 
   delete reader;
 
-  clock_gettime( CLOCK_REALTIME, &ts );
-  time_t s1 = ts.tv_sec; // seconds since 1.1.1970
-  long f1 = ts.tv_nsec; // nanoseconds
-  zeit1 += s1 - s0 + ( f1 - f0 ) * 1e-9; // read
-
   cout << "read " << iev << " events"
-	 << " in " << s1 - s0 + ( f1 - f0 ) * 1e-9 << " s"
+	 << " in " << StageProf::wall() - t0 << " s"
        << endl;
 
+  prof.mark( "pixels" );
+
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
   // hot pixels:
 
@@ -1511,52 +1244,75 @@ int main( int argc, char* argv[] )
 
   cout << endl << "parallel clustering" << flush;
 
-  clock_gettime( CLOCK_REALTIME, &ts );
-  time_t s2 = ts.tv_sec; // seconds since 1.1.1970
-  long f2 = ts.tv_nsec; // nanoseconds
+  double t2 = StageProf::wall();
+  prof.start( sclus );
 
   list < vector <cluster> > clist[9];
 
+  // final cluster plots: one shard per plane and thread
+
+  clusterplots cp[9];
+  for( unsigned ipl = 1; ipl <= 6; ++ipl ) {
+    cp[ipl].ncl.book( hncl[ipl] );
+    cp[ipl].ccol.book( hccol[ipl] );
+    cp[ipl].crow.book( hcrow[ipl] );
+    cp[ipl].npix.book( hnpix[ipl] );
+    cp[ipl].ncol.book( hncol[ipl] );
+    cp[ipl].nrow.book( hnrow[ipl] );
+    cp[ipl].mindxy.book( hmindxy[ipl] );
+  }
+
   //#pragma omp sections // test, not parallel
 #pragma omp parallel sections
   {
 #pragma omp section
     {
-      clist[1] = oneplane( 1, pxlist[1] );
+      clist[1] = oneplane( 1, pxlist[1], cp[1] );
     }
 #pragma omp section
     {
-      clist[2] = oneplane( 2, pxlist[2] );
+      clist[2] = oneplane( 2, pxlist[2], cp[2] );
     }
 #pragma omp section
     {
-      clist[3] = oneplane( 3, pxlist[3] );
+      clist[3] = oneplane( 3, pxlist[3], cp[3] );
     }
 #pragma omp section
     {
-      clist[4] = oneplane( 4, pxlist[4] );
+      clist[4] = oneplane( 4, pxlist[4], cp[4] );
     }
 #pragma omp section
     {
-      clist[5] = oneplane( 5, pxlist[5] );
+      clist[5] = oneplane( 5, pxlist[5], cp[5] );
     }
 #pragma omp section
     {
-      clist[6] = oneplane( 6, pxlist[6] );
+      clist[6] = oneplane( 6, pxlist[6], cp[6] );
     }
 
   } // parallel
 
-  clock_gettime( CLOCK_REALTIME, &ts );
-  time_t s3 = ts.tv_sec; // seconds since 1.1.1970
-  long f3 = ts.tv_nsec; // nanoseconds
-  zeit2 += s3 - s2 + ( f3 - f2 ) * 1e-9; // cluster
+  prof.stop( sclus );
 
-  cout << " in " << s3 - s2 + ( f3 - f2 ) * 1e-9 << " s" << endl;
+  cout << " in " << StageProf::wall() - t2 << " s" << endl;
+
+  prof.mark( "clusters" );
 
   for( unsigned ipl = 0; ipl < 9; ++ipl )
     pxlist[ipl].clear(); // memory
 
+  // merge in plane order, same contents as filled serially:
+
+  for( unsigned ipl = 1; ipl <= 6; ++ipl ) {
+    cp[ipl].ncl.mergeInto( hncl[ipl] );
+    cp[ipl].ccol.mergeInto( hccol[ipl] );
+    cp[ipl].crow.mergeInto( hcrow[ipl] );
+    cp[ipl].npix.mergeInto( hnpix[ipl] );
+    cp[ipl].ncol.mergeInto( hncol[ipl] );
+    cp[ipl].nrow.mergeInto( hnrow[ipl] );
+    cp[ipl].mindxy.mergeInto( hmindxy[ipl] );
+  }
+
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
   // alignment iterations:
 
@@ -1607,6 +1363,8 @@ int main( int argc, char* argv[] )
       trimadxvsxmym[itd]->Reset();
       tridxvstx[itd].Reset();
       trimadxvstx[itd].Reset();
+      trizscanmad[itd].Reset();
+      trizscandx[itd].Reset();
 
       htridxc1[itd].Reset();
       htridxc111[itd].Reset();
@@ -1712,9 +1470,34 @@ int main( int argc, char* argv[] )
     sixdxyvsxy->Reset();
     hsixdtx.Reset();
     hsixdty.Reset();
+    hsixfitchi2x.Reset();
+    hsixfitchi2y.Reset();
+    hsixfitdx.Reset();
+    hsixfitdy.Reset();
     sixdtvsx.Reset();
     sixdtvsxy->Reset();
 
+    // six-plane fit weights at DUTz for this iteration's z positions:
+
+    double sixz[6];
+    for( int i = 0; i < 6; ++i )
+      sixz[i] = zz[i+1] + alignz[i+1];
+
+    SixFitWeights sixw;
+    bool lsixfit = sixfit_weights( sixw, sixz, sixres, 6, sixz, sixtet, DUTz );
+    if( lsixfit )
+      cout << "six-plane fit at DUT: sigma " << sixw.sig0*1E3 << " um"
+	   << ", slope " << sixw.sigs*1E3 << " mrad" << endl;
+
+    vector <double> sixu[6]; // x hits of matched pairs, SoA
+    vector <double> sixv[6]; // y hits
+    vector <double> sixum; // triplet-driplet mean at DUT
+    vector <double> sixvm;
+    vector <double> u0, us, uchi2; // fit results x
+    vector <double> v0, vs, vchi2; // fit results y
+
+    PlaneXY pxy[7]; // Mimosa hits per event, SoA
+
     // loop over events, correlate planes:
 
     list < vector <cluster> >::iterator evi[9];
@@ -1736,31 +1519,16 @@ int main( int argc, char* argv[] )
       if( nev%10000 == 0 )
 	cout << " " << nev << flush;
 
-      // final cluster plots:
-
-      if( aligniteration == maxiter-1 ) {
-
-	for( unsigned ipl = 1; ipl <= 6; ++ipl ) {
+      // final cluster plots: filled while clustering
 
-	  hncl[ipl].Fill( cl[ipl].size() );
+      prof.lap( scorr );
 
-	  for( vector<cluster>::iterator cA = cl[ipl].begin(); cA != cl[ipl].end(); ++cA ) {
-
-	    hccol[ipl].Fill( cA->col );
-	    hcrow[ipl].Fill( cA->row );
-	    unsigned nrow = cA->scr/(1024*1024);
-	    unsigned ncol = (cA->scr - nrow*1024*1024)/1024;
-	    unsigned npix = cA->scr % 1024;
-	    hnpix[ipl].Fill( npix );
-	    hncol[ipl].Fill( ncol );
-	    hnrow[ipl].Fill( nrow );
-	    hmindxy[ipl].Fill( cA->mindxy );
-
-	  } // clus
-
-	} // planes
-
-      } // laster iter
+      for( unsigned ipl = 1; ipl <= 6; ++ipl ) {
+	TelePlane p = { ptchx[ipl], ptchy[ipl], midx[ipl], midy[ipl],
+			alignx[ipl], aligny[ipl], rotx[ipl], roty[ipl],
+			zz[ipl] + alignz[ipl] };
+	pxy[ipl].fill( p, cl[ipl] ); // all hits at once
+      }
 
       // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
       // cluster pair correlations:
@@ -1778,14 +1546,10 @@ int main( int argc, char* argv[] )
 
 	// A = mid plane:
 
-	for( vector<cluster>::iterator cA = cl[im].begin(); cA != cl[im].end(); ++cA ) {
+	for( unsigned jA = 0; jA < pxy[im].size(); ++jA ) {
 
-	  double xA = cA->col*ptchx[im] - alignx[im];
-	  double yA = cA->row*ptchy[im] - aligny[im];
-	  double xmid = xA - midx[im];
-	  double ymid = yA - midy[im];
-	  xA = xmid - ymid*rotx[im];
-	  yA = ymid + xmid*roty[im];
+	  double xA = pxy[im].x[jA];
+	  double yA = pxy[im].y[jA];
 
 	  for( int ipl = ibeg; ipl <= iend; ++ipl ) {
 
@@ -1793,19 +1557,18 @@ int main( int argc, char* argv[] )
 
 	    double sign = ipl - im; // along track: -1 or 1
 
-	    // B = A +- 1
+	    // B = A +- 1, all residuals to A at once:
 
-	    for( vector<cluster>::iterator cB = cl[ipl].begin(); cB != cl[ipl].end(); ++cB ) {
+	    PlaneXY & hB = pxy[ipl];
+	    hB.residuals( xA, yA );
 
-	      double xB = cB->col*ptchx[ipl] - alignx[ipl];
-	      double yB = cB->row*ptchy[ipl] - aligny[ipl];
-	      double xmid = xB - midx[ipl];
-	      double ymid = yB - midy[ipl];
-	      xB = xmid - ymid*rotx[ipl];
-	      yB = ymid + xmid*roty[ipl];
+	    for( unsigned jB = 0; jB < hB.size(); ++jB ) {
 
-	      double dx = xB - xA;
-	      double dy = yB - yA;
+	      double xB = hB.x[jB];
+	      double yB = hB.y[jB];
+
+	      double dx = hB.dx[jB];
+	      double dy = hB.dy[jB];
 	      hxx[ipl]->Fill( xA, xB );
 	      hdx[ipl].Fill( dx ); // for shift: fixed sign
 	      hdy[ipl].Fill( dy );
@@ -1862,123 +1625,72 @@ int main( int argc, char* argv[] )
 
 	double zD = zz[ipl] + alignz[ipl];
 
-	for( vector<cluster>::iterator cA = cl[ib].begin(); cA != cl[ib].end(); ++cA ) {
-
-	  if( cA->mindxy < isoCut ) continue;
-
-	  double xA = cA->col*ptchx[ib] - alignx[ib];
-	  double yA = cA->row*ptchy[ib] - aligny[ib];
-	  double zA = zz[ib] + alignz[ib];
-	  double xmid = xA - midx[ib];
-	  double ymid = yA - midy[ib];
-	  xA = xmid - ymid*rotx[ib];
-	  yA = ymid + xmid*roty[ib];
-
-	  for( vector<cluster>::iterator cC = cl[ie].begin(); cC != cl[ie].end(); ++cC ) {
-
-	    if( cC->mindxy < isoCut ) continue;
-
-	    double xC = cC->col*ptchx[ie] - alignx[ie];
-	    double yC = cC->row*ptchy[ie] - aligny[ie];
-	    double zC = zz[ie] + alignz[ie];
-	    double xmid = xC - midx[ie];
-	    double ymid = yC - midy[ie];
-	    xC = xmid - ymid*rotx[ie];
-	    yC = ymid + xmid*roty[ie];
-
-	    double dx2 = xC - xA;
-	    double dy2 = yC - yA;
-	    double dzCA = zC - zA;
-
-	    if( fabs( dx2 ) > ang * dzCA ) continue; // angle cut
-	    if( fabs( dy2 ) > ang * dzCA ) continue; // angle cut
-
-	    double xavg2 = 0.5*(xA + xC);
-	    double yavg2 = 0.5*(yA + yC);
-	    double zavg2 = 0.5*(zA + zC);
+	makeTriplets( pxy[ib], pxy[im], pxy[ie], ang, triCut,
 
-	    double slpx = ( xC - xA ) / dzCA; // slope x
-	    double slpy = ( yC - yA ) / dzCA; // slope y
+		      []( unsigned, unsigned, double, double ) {},
 
-	    for( vector<cluster>::iterator cB = cl[im].begin(); cB != cl[im].end(); ++cB ) {
+		      [&]( unsigned jA, unsigned jC, double, double, double, double ) {
+			return cl[ib][jA].mindxy >= isoCut && cl[ie][jC].mindxy >= isoCut;
+		      },
 
-	      double xB = cB->col*ptchx[im] - alignx[im]; // stretch and shift
-	      double yB = cB->row*ptchy[im] - aligny[im];
-	      double zB = zz[im] + alignz[im];
-	      double xmid = xB - midx[im];
-	      double ymid = yB - midy[im];
-	      xB = xmid - ymid*rotx[im];
-	      yB = ymid + xmid*roty[im];
+		      []( unsigned, double, double, double, double, double, double ) {},
 
-	      // interpolate track to B:
+		      [&]( unsigned, unsigned, unsigned,
+			   double avx, double avy, double avz, double slpx, double slpy ) {
 
-	      double dz = zB - zavg2;
-	      double xm = xavg2 + slpx * dz; // triplet at B
-	      double ym = yavg2 + slpy * dz;
+			// inter/extrapolate track to D:
 
-	      double dxm = xB - xm;
-	      double dym = yB - ym;
+			double da = zD - avz;
+			double xi = avx + slpx * da; // triplet at D
+			double yi = avy + slpy * da;
 
-	      if( fabs( dxm ) > triCut ) continue;
-	      if( fabs( dym ) > triCut ) continue;
+			// transform into local frame:
 
-	      // inter/extrapolate track to D:
+			double xr = xi + yi*rotx[ipl] + alignx[ipl];
+			double yr = yi - xi*roty[ipl] + aligny[ipl];
 
-	      double da = zD - zavg2;
-	      double xi = xavg2 + slpx * da; // triplet at D
-	      double yi = yavg2 + slpy * da;
+			if( fabs( xr ) > 10.4 ) return; // fiducial
+			if( fabs( yr ) >  5.2 ) return; // fiducial
 
-	      // transform into local frame:
+			// eff pl:
 
-	      double xr = xi + yi*rotx[ipl] + alignx[ipl];
-	      double yr = yi - xi*roty[ipl] + aligny[ipl];
+			int nm = 0;
 
-	      if( fabs( xr ) > 10.4 ) continue; // fiducial
-	      if( fabs( yr ) >  5.2 ) continue; // fiducial
+			for( vector<cluster>::iterator cD = cl[ipl].begin(); cD != cl[ipl].end(); ++cD ) {
 
-	      // eff pl:
+			  double xD = cD->col*ptchx[ipl] - midx[ipl];
+			  double yD = cD->row*ptchy[ipl] - midy[ipl];
 
-	      int nm = 0;
+			  double dx4 = xD - xr;
+			  double dy4 = yD - yr;
 
-	      for( vector<cluster>::iterator cD = cl[ipl].begin(); cD != cl[ipl].end(); ++cD ) {
+			  if( fabs( dy4 ) < effCut ) {
+			    hdx4[ipl].Fill( dx4 );
+			    dx4vsy[ipl].Fill( yr, dx4 );
+			  }
+			  if( fabs( dx4 ) < effCut ) {
+			    hdy4[ipl].Fill( dy4 );
+			    dy4vsx[ipl].Fill( xr, dy4 );
+			  }
 
-		double xD = cD->col*ptchx[ipl] - midx[ipl];
-		double yD = cD->row*ptchy[ipl] - midy[ipl];
+			  if( fabs( dx4 ) > effCut ) continue;
+			  if( fabs( dy4 ) > effCut ) continue;
 
-		double dx4 = xD - xr;
-		double dy4 = yD - yr;
+			  ++nm;
 
-		if( fabs( dy4 ) < effCut ) {
-		  hdx4[ipl].Fill( dx4 );
-		  dx4vsy[ipl].Fill( yr, dx4 );
-		}
-		if( fabs( dx4 ) < effCut ) {
-		  hdy4[ipl].Fill( dy4 );
-		  dy4vsx[ipl].Fill( xr, dy4 );
-		}
+			  if( nm > 0 ) break; // one link is enough
 
-		if( fabs( dx4 ) > effCut ) continue;
-		if( fabs( dy4 ) > effCut ) continue;
+			} // cl D
 
-		++nm;
+			effvsx[ipl].Fill( xr, nm );
 
-		if( nm > 0 ) break; // one link is enough
+			double xmod2 = fmod( xr + sizex[ipl] + 0.5*ptchx[ipl], 2*ptchx[ipl] );
+			double ymod2 = fmod( yr + sizey[ipl] + 0.5*ptchy[ipl], 2*ptchy[ipl] );
+			effvsxm[ipl].Fill( xmod2*1E3, nm );
+			effvsym[ipl].Fill( ymod2*1E3, nm );
+			effvsxmym[ipl]->Fill( xmod2*1E3, ymod2*1E3, nm );
 
-	      } // cl D
-
-	      effvsx[ipl].Fill( xr, nm );
-
-	      double xmod2 = fmod( xr + sizex[ipl] + 0.5*ptchx[ipl], 2*ptchx[ipl] );
-	      double ymod2 = fmod( yr + sizey[ipl] + 0.5*ptchy[ipl], 2*ptchy[ipl] );
-	      effvsxm[ipl].Fill( xmod2*1E3, nm );
-	      effvsym[ipl].Fill( ymod2*1E3, nm );
-	      effvsxmym[ipl]->Fill( xmod2*1E3, ymod2*1E3, nm );
-
-	    } // cl B
-
-	  } // cl C
-
-	} // cl A
+		      } );
 
       } // eff planes
 
@@ -1986,6 +1698,8 @@ int main( int argc, char* argv[] )
       // triplets 2 vs 3-1:
       // driplets 5 vs 6-4:
 
+      prof.lap( strip );
+
       vector <triplet> triplets;
       vector <triplet> driplets;
 
@@ -2006,331 +1720,326 @@ int main( int argc, char* argv[] )
 	double zB = zz[im] + alignz[im];
 	double dzCA = zC - zA;
 
-	for( vector<cluster>::iterator cA = cl[ib].begin(); cA != cl[ib].end(); ++cA ) {
-
-	  double xA = cA->col*ptchx[ib] - alignx[ib];
-	  double yA = cA->row*ptchy[ib] - aligny[ib];
-	  double xmid = xA - midx[ib];
-	  double ymid = yA - midy[ib];
-	  xA = xmid - ymid*rotx[ib];
-	  yA = ymid + xmid*roty[ib];
-
-	  unsigned nrowA = cA->scr/(1024*1024);
-	  unsigned ncolA = (cA->scr - nrowA*1024*1024)/1024;
-	  //unsigned npixA = cA->scr % 1024;
-	  bool goodncolA = 1;
-	  if( ncolA > 4 ) goodncolA = 0;
-	  if( ncolA == 2 && nrowA < 3 ) goodncolA = 0;
-	  bool goodnrowA = 1;
-	  if( nrowA > 4 ) goodnrowA = 0;
-	  if( nrowA == 2 && nrowA < 3 ) goodnrowA = 0;
-
-	  for( vector<cluster>::iterator cC = cl[ie].begin(); cC != cl[ie].end(); ++cC ) {
-
-	    double xC = cC->col*ptchx[ie] - alignx[ie];
-	    double yC = cC->row*ptchy[ie] - aligny[ie];
-	    double xmid = xC - midx[ie];
-	    double ymid = yC - midy[ie];
-	    xC = xmid - ymid*rotx[ie];
-	    yC = ymid + xmid*roty[ie];
-
-	    double dx2 = xC - xA;
-	    double dy2 = yC - yA;
-	    hdxCA[itd].Fill( dx2 );
-	    hdyCA[itd].Fill( dy2 );
-	    if( fabs( dy2 ) < 0.001 * dzCA )
-	      dxCAvsx[itd].Fill( xC, dx2 );
-	    if( fabs( dx2 ) < 0.001 * dzCA )
-	      dyCAvsy[itd].Fill( yC, dy2 );
-
-	    if( fabs( dx2 ) > ang * dzCA ) continue; // angle cut
-	    if( fabs( dy2 ) > ang * dzCA ) continue; // angle cut
-
-	    double xavg2 = 0.5*(xA + xC);
-	    double yavg2 = 0.5*(yA + yC);
-	    double zavg2 = 0.5*(zA + zC);
-
-	    double slpx = ( xC - xA ) / dzCA; // slope x
-	    double slpy = ( yC - yA ) / dzCA; // slope y
+	// per pair and per B, from one callback to the next:
+
+	vector<cluster>::iterator cA, cC;
+	unsigned nrowA = 0, ncolA = 0, nrowC = 0, ncolC = 0;
+	bool goodncolA = 1, goodnrowA = 1, goodncolC = 1, goodnrowC = 1;
+	double xr = 0, yr = 0; // track at B, local frame
+	double xmod1 = 0, ymod1 = 0, xmod2 = 0, ymod2 = 0, xmod4 = 0, ymod4 = 0;
+	unsigned nrowB = 0, ncolB = 0, npixB = 0;
+
+	makeTriplets( pxy[ib], pxy[im], pxy[ie], ang, tricut,
+
+		      [&]( unsigned, unsigned jC, double dx2, double dy2 ) {
+			double xC = pxy[ie].x[jC];
+			double yC = pxy[ie].y[jC];
+			hdxCA[itd].Fill( dx2 );
+			hdyCA[itd].Fill( dy2 );
+			if( fabs( dy2 ) < 0.001 * dzCA )
+			  dxCAvsx[itd].Fill( xC, dx2 );
+			if( fabs( dx2 ) < 0.001 * dzCA )
+			  dyCAvsy[itd].Fill( yC, dy2 );
+		      },
+
+		      [&]( unsigned jA, unsigned jC, double xm, double ym, double, double ) {
+
+			cA = cl[ib].begin() + jA;
+			cC = cl[ie].begin() + jC;
+
+			nrowA = cA->scr/(1024*1024);
+			ncolA = (cA->scr - nrowA*1024*1024)/1024;
+			//npixA = cA->scr % 1024;
+			goodncolA = 1;
+			if( ncolA > 4 ) goodncolA = 0;
+			if( ncolA == 2 && nrowA < 3 ) goodncolA = 0;
+			goodnrowA = 1;
+			if( nrowA > 4 ) goodnrowA = 0;
+			if( nrowA == 2 && nrowA < 3 ) goodnrowA = 0;
 
-	    // interpolate track to B:
+			nrowC = cC->scr/(1024*1024);
+			ncolC = (cC->scr - nrowC*1024*1024)/1024;
+			//npixC = cC->scr % 1024;
+			goodncolC = 1;
+			if( ncolC > 4 ) goodncolC = 0;
+			if( ncolC == 2 && nrowC < 3 ) goodncolC = 0;
+			goodnrowC = 1;
+			if( nrowC > 4 ) goodnrowC = 0;
+			if( nrowC == 2 && nrowC < 3 ) goodnrowC = 0;
+
+			// transform into local frame:
+
+			xr = xm + ym*rotx[im] + alignx[im];
+			yr = ym - xm*roty[im] + aligny[im];
+
+			xmod1 = fmod( xr + sizex[im] + 0.5*ptchx[im], 1*ptchx[im] );
+			ymod1 = fmod( yr + sizey[im] + 0.5*ptchy[im], 1*ptchy[im] );
+			xmod2 = fmod( xr + sizex[im] + 0.5*ptchx[im], 2*ptchx[im] );
+			ymod2 = fmod( yr + sizey[im] + 0.5*ptchy[im], 2*ptchy[im] );
+			xmod4 = fmod( xr + sizex[im] + 0.5*ptchx[im], 4*ptchx[im] );
+			ymod4 = fmod( yr + sizey[im] + 0.5*ptchy[im], 4*ptchy[im] );
+
+			return true;
+		      },
+
+		      [&]( unsigned jB, double, double, double slpx, double slpy,
+			   double dxm, double dym ) {
+
+			vector<cluster>::iterator cB = cl[im].begin() + jB;
+
+			htridx[itd].Fill( dxm*1E3 );
+			htridy[itd].Fill( dym*1E3 );
 
-	    double dz = zB - zavg2;
-	    double xm = xavg2 + slpx * dz; // triplet at B
-	    double ym = yavg2 + slpy * dz;
-
-	    // transform into local frame:
-
-	    double xr = xm + ym*rotx[im] + alignx[im];
-	    double yr = ym - xm*roty[im] + aligny[im];
-
-	    double xmod1 = fmod( xr + sizex[im] + 0.5*ptchx[im], 1*ptchx[im] );
-	    double ymod1 = fmod( yr + sizey[im] + 0.5*ptchy[im], 1*ptchy[im] );
-	    double xmod2 = fmod( xr + sizex[im] + 0.5*ptchx[im], 2*ptchx[im] );
-	    double ymod2 = fmod( yr + sizey[im] + 0.5*ptchy[im], 2*ptchy[im] );
-	    double xmod4 = fmod( xr + sizex[im] + 0.5*ptchx[im], 4*ptchx[im] );
-	    double ymod4 = fmod( yr + sizey[im] + 0.5*ptchy[im], 4*ptchy[im] );
-
-	    unsigned nrowC = cC->scr/(1024*1024);
-	    unsigned ncolC = (cC->scr - nrowC*1024*1024)/1024;
-	    //unsigned npixC = cC->scr % 1024;
-	    bool goodncolC = 1;
-	    if( ncolC > 4 ) goodncolC = 0;
-	    if( ncolC == 2 && nrowC < 3 ) goodncolC = 0;
-	    bool goodnrowC = 1;
-	    if( nrowC > 4 ) goodnrowC = 0;
-	    if( nrowC == 2 && nrowC < 3 ) goodnrowC = 0;
+			bool iso = 1;
+			if( cA->mindxy < isoCut ) iso = 0;
+			if( cC->mindxy < isoCut ) iso = 0;
+			if( cB->mindxy < isoCut ) iso = 0;
 
-	    for( vector<cluster>::iterator cB = cl[im].begin(); cB != cl[im].end(); ++cB ) {
+			nrowB = cB->scr/(1024*1024);
+			ncolB = (cB->scr - nrowB*1024*1024)/1024;
+			npixB = cB->scr % 1024;
 
-	      double xB = cB->col*ptchx[im] - alignx[im]; // stretch and shift
-	      double yB = cB->row*ptchy[im] - aligny[im];
-	      double xmid = xB - midx[im];
-	      double ymid = yB - midy[im];
-	      xB = xmid - ymid*rotx[im];
-	      yB = ymid + xmid*roty[im];
+			if( ncolB > 99 )
+			  cout << "scrB " << cB->scr
+			       << ", nrow " << nrowB
+			       << ", ncol " << ncolB
+			       << ", npix " << npixB
+			       << endl;
 
-	      double dxm = xB - xm;
-	      double dym = yB - ym;
+			bool goodncolB = 1;
+			if( ncolB > 4 ) goodncolB = 0;
+			if( ncolB == 2 && nrowB < 3 ) goodncolB = 0;
+			bool goodnrowB = 1;
+			if( nrowB > 4 ) goodnrowB = 0;
+			if( nrowB == 2 && nrowB < 3 ) goodnrowB = 0;
 
-	      htridx[itd].Fill( dxm*1E3 );
-	      htridy[itd].Fill( dym*1E3 );
+			// z scan: mid plane residuals for trial z shifts of the mid plane
 
-	      bool iso = 1;
-	      if( cA->mindxy < isoCut ) iso = 0;
-	      if( cC->mindxy < isoCut ) iso = 0;
-	      if( cB->mindxy < isoCut ) iso = 0;
+			if( lzscan )
+			  for( int iz = 1; iz <= trizscanmad[itd].GetNbinsX(); ++iz ) {
+			    double zs = trizscanmad[itd].GetBinCenter(iz);
+			    double rx = dxm - slpx*zs;
+			    double ry = dym - slpy*zs;
+			    if( fabs( rx ) < 0.05 && fabs( ry ) < 0.05 ) {
+			      trizscanmad[itd].Fill( zs, fabs(rx)*1E3 );
+			      trizscanmad[itd].Fill( zs, fabs(ry)*1E3 );
+			      trizscandx[itd].Fill( zs, rx*1E3 );
+			    }
+			  }
 
-	      unsigned nrowB = cB->scr/(1024*1024);
-	      unsigned ncolB = (cB->scr - nrowB*1024*1024)/1024;
-	      unsigned npixB = cB->scr % 1024;
+			if( fabs( dym ) < 0.02 ) {
 
-	      if( ncolB > 99 )
-		cout << "scrB " << cB->scr
-		     << ", nrow " << nrowB
-		     << ", ncol " << ncolB
-		     << ", npix " << npixB
-		     << endl;
+			  htridxc[itd].Fill( dxm*1E3 );
+			  if( iso ) htridxci[itd].Fill( dxm*1E3 );
 
-	      bool goodncolB = 1;
-	      if( ncolB > 4 ) goodncolB = 0;
-	      if( ncolB == 2 && nrowB < 3 ) goodncolB = 0;
-	      bool goodnrowB = 1;
-	      if( nrowB > 4 ) goodnrowB = 0;
-	      if( nrowB == 2 && nrowB < 3 ) goodnrowB = 0;
+			  tridxvsx[itd].Fill( xr, dxm*1E3 );
+			  tridxvsy[itd].Fill( yr, dxm*1E3 );
+			  tridxvstx[itd].Fill( slpx*1E3, dxm*1E3 ); // adjust zpos, same sign
 
-	      if( fabs( dym ) < 0.02 ) {
+			  tridxvsxm[itd].Fill( xmod2*1E3, dxm*1E3 );
 
-		htridxc[itd].Fill( dxm*1E3 );
-		if( iso ) htridxci[itd].Fill( dxm*1E3 );
+			  trimadxvsxm[itd].Fill( xmod2*1E3, fabs(dxm)*1E3 );
+			  trimadxvsxmym[itd]->Fill( xmod2*1E3, ymod2*1E3, fabs(dxm)*1E3 );
+			  trimadxvstx[itd].Fill( slpx*1E3, fabs(dxm)*1E3 ); // U-shape
 
-		tridxvsx[itd].Fill( xr, dxm*1E3 );
-		tridxvsy[itd].Fill( yr, dxm*1E3 );
-		tridxvstx[itd].Fill( slpx*1E3, dxm*1E3 ); // adjust zpos, same sign
+			  if( fabs( slpx ) < 0.001 ) {
 
-		tridxvsxm[itd].Fill( xmod2*1E3, dxm*1E3 );
+			    htridxct[itd].Fill( dxm*1E3 ); // 3.95
 
-		trimadxvsxm[itd].Fill( xmod2*1E3, fabs(dxm)*1E3 );
-		trimadxvsxmym[itd]->Fill( xmod2*1E3, ymod2*1E3, fabs(dxm)*1E3 );
-		trimadxvstx[itd].Fill( slpx*1E3, fabs(dxm)*1E3 ); // U-shape
+			    if( goodncolA && goodncolC ) { // position bias?
 
-		if( fabs( slpx ) < 0.001 ) {
+			      htridxctg[itd].Fill( dxm*1E3 ); // 3.70 (24%)
 
-		  htridxct[itd].Fill( dxm*1E3 ); // 3.95
+			      if( goodncolB )
+				htridxctgg[itd].Fill( dxm*1E3 ); // 3.13 thr 4, 3.70 thr 5
 
-		  if( goodncolA && goodncolC ) { // position bias?
+			    } // good A, C
 
-		    htridxctg[itd].Fill( dxm*1E3 ); // 3.70 (24%)
+			    {
 
-		    if( goodncolB )
-		      htridxctgg[itd].Fill( dxm*1E3 ); // 3.13 thr 4, 3.70 thr 5
+			      htrixm[itd].Fill( xmod1*1E3 );
 
-		  } // good A, C
+			      if(      ncolB == 1 ) {
+				htridxc1[itd].Fill( dxm*1E3 ); // 2.40
+				htrixm1[itd].Fill( xmod1*1E3 );
+			      }
+			      else if( ncolB == 2 ) {
+				htridxc2[itd].Fill( dxm*1E3 ); // 4.14
+				htrixm2[itd].Fill( xmod1*1E3 );
+			      }
 
-		  {
+			      else if( ncolB == 3 ) {
+				htridxc3[itd].Fill( dxm*1E3 ); // 3.30
+				htrixm3[itd].Fill( xmod1*1E3 );
+			      }
 
-		    htrixm[itd].Fill( xmod1*1E3 );
+			      else if( ncolB == 4 ) {
+				htridxc4[itd].Fill( dxm*1E3 ); // 3.23
+				htrixm4[itd].Fill( xmod1*1E3 );
+			      }
 
-		    if(      ncolB == 1 ) {
-		      htridxc1[itd].Fill( dxm*1E3 ); // 2.40
-		      htrixm1[itd].Fill( xmod1*1E3 );
-		    }
-		    else if( ncolB == 2 ) {
-		      htridxc2[itd].Fill( dxm*1E3 ); // 4.14
-		      htrixm2[itd].Fill( xmod1*1E3 );
-		    }
+			      else if( ncolB == 5 )
+				htridxc5[itd].Fill( dxm*1E3 ); // 5.59
 
-		    else if( ncolB == 3 ) {
-		      htridxc3[itd].Fill( dxm*1E3 ); // 3.30
-		      htrixm3[itd].Fill( xmod1*1E3 );
-		    }
+			      else
+				htridxc6[itd].Fill( dxm*1E3 ); // 
 
-		    else if( ncolB == 4 ) {
-		      htridxc4[itd].Fill( dxm*1E3 ); // 3.23
-		      htrixm4[itd].Fill( xmod1*1E3 );
-		    }
+			      if( ncolB == 2 ) {
 
-		    else if( ncolB == 5 )
-		      htridxc5[itd].Fill( dxm*1E3 ); // 5.59
+				if(      nrowB == 1 )
+				  htridxc21[itd].Fill( dxm*1E3 ); // 4.93
 
-		    else
-		      htridxc6[itd].Fill( dxm*1E3 ); // 
+				else if( nrowB == 2 )
+				  htridxc22[itd].Fill( dxm*1E3 ); // 4.26 most
 
-		    if( ncolB == 2 ) {
+				else if( nrowB == 3 )
+				  htridxc23[itd].Fill( dxm*1E3 ); // 3.27
 
-		      if(      nrowB == 1 )
-			htridxc21[itd].Fill( dxm*1E3 ); // 4.93
+				else if( nrowB == 4 )
+				  htridxc24[itd].Fill( dxm*1E3 ); // 2.35
 
-		      else if( nrowB == 2 )
-			htridxc22[itd].Fill( dxm*1E3 ); // 4.26 most
+				else
+				  htridxc25[itd].Fill( dxm*1E3 ); // 
 
-		      else if( nrowB == 3 )
-			htridxc23[itd].Fill( dxm*1E3 ); // 3.27
+				if( nrowB == 2 ) {
 
-		      else if( nrowB == 4 )
-			htridxc24[itd].Fill( dxm*1E3 ); // 2.35
+				  if( npixB == 3 )
+				    htridxc223[itd].Fill( dxm*1E3 ); // 4.16
+				  else
+				    htridxc224[itd].Fill( dxm*1E3 ); // 4.32 most
 
-		      else
-			htridxc25[itd].Fill( dxm*1E3 ); // 
+				}
 
-		      if( nrowB == 2 ) {
+			      } // col 2
 
-			if( npixB == 3 )
-			  htridxc223[itd].Fill( dxm*1E3 ); // 4.16
-			else
-			  htridxc224[itd].Fill( dxm*1E3 ); // 4.32 most
-
-		      }
-
-		    } // col 2
-
-		  } // good A && good C
+			    } // good A && good C
 
-		  if( ncolA == 1 && ncolB == 1 &&  ncolC == 1 )
-		    htridxc111[itd].Fill( dxm*1E3 ); // 1.7
+			    if( ncolA == 1 && ncolB == 1 &&  ncolC == 1 )
+			      htridxc111[itd].Fill( dxm*1E3 ); // 1.7
 
-		} // slpx
+			  } // slpx
 
-	      } // dy
+			} // dy
 
-	      if( fabs( dxm ) < 0.02 ) {
+			if( fabs( dxm ) < 0.02 ) {
 
-		htridyc[itd].Fill( dym*1E3 );
-		if( iso ) htridyci[itd].Fill( dym*1E3 );
-		tridyvsx[itd].Fill( xr, dym*1E3 );
-		tridyvsy[itd].Fill( yr, dym*1E3 );
-		tridyvsym[itd].Fill( ymod2*1E3, dym*1E3 );
-		trimadyvsym[itd].Fill( ymod2*1E3, fabs(dym)*1E3 );
-		trimadyvsxmym[itd]->Fill( xmod2*1E3, ymod2*1E3, fabs(dym)*1E3 );
-		tridyvsty[itd].Fill( slpy*1E3, dym*1E3 );
-		trimadyvsty[itd].Fill( slpy*1E3, fabs(dym)*1E3 ); // U-shape
-		if( fabs( slpy ) < 0.001 )
-		  htridyct[itd].Fill( dym*1E3 );
-
-		if( fabs( slpy ) < 0.001 ) {
+			  htridyc[itd].Fill( dym*1E3 );
+			  if( iso ) htridyci[itd].Fill( dym*1E3 );
+			  tridyvsx[itd].Fill( xr, dym*1E3 );
+			  tridyvsy[itd].Fill( yr, dym*1E3 );
+			  tridyvsym[itd].Fill( ymod2*1E3, dym*1E3 );
+			  trimadyvsym[itd].Fill( ymod2*1E3, fabs(dym)*1E3 );
+			  trimadyvsxmym[itd]->Fill( xmod2*1E3, ymod2*1E3, fabs(dym)*1E3 );
+			  tridyvsty[itd].Fill( slpy*1E3, dym*1E3 );
+			  trimadyvsty[itd].Fill( slpy*1E3, fabs(dym)*1E3 ); // U-shape
+			  if( fabs( slpy ) < 0.001 )
+			    htridyct[itd].Fill( dym*1E3 );
 
-		  if(      nrowB == 1 )
-		    htridyc1[itd].Fill( dym*1E3 ); // 
-		  else if( nrowB == 2 )
-		    htridyc2[itd].Fill( dym*1E3 ); // 
-		  else if( nrowB == 3 )
-		    htridyc3[itd].Fill( dym*1E3 ); // 
-		  else if( nrowB == 4 )
-		    htridyc4[itd].Fill( dym*1E3 ); // 
-		  else if( nrowB == 5 )
-		    htridyc5[itd].Fill( dym*1E3 ); // 
-		  else
-		    htridyc6[itd].Fill( dym*1E3 ); // 
+			  if( fabs( slpy ) < 0.001 ) {
 
-		  if( goodnrowA && goodnrowB && goodnrowC )
-		    htridycg[itd].Fill( dym*1E3 ); // 
+			    if(      nrowB == 1 )
+			      htridyc1[itd].Fill( dym*1E3 ); // 
+			    else if( nrowB == 2 )
+			      htridyc2[itd].Fill( dym*1E3 ); // 
+			    else if( nrowB == 3 )
+			      htridyc3[itd].Fill( dym*1E3 ); // 
+			    else if( nrowB == 4 )
+			      htridyc4[itd].Fill( dym*1E3 ); // 
+			    else if( nrowB == 5 )
+			      htridyc5[itd].Fill( dym*1E3 ); // 
+			    else
+			      htridyc6[itd].Fill( dym*1E3 ); // 
 
-		} // slpy
+			    if( goodnrowA && goodnrowB && goodnrowC )
+			      htridycg[itd].Fill( dym*1E3 ); // 
 
-	      } // dx
+			  } // slpy
 
-	      // cut x and y:
+			} // dx
 
-	      if( fabs( dxm ) < tricut &&
-		  fabs( dym ) < tricut ) {
+		      },
 
-		hncolB[itd].Fill( ncolB );
-		hnrowB[itd].Fill( nrowB );
-		hnpixB[itd].Fill( npixB );
+		      [&]( unsigned jA, unsigned jB, unsigned jC,
+			   double avx, double avy, double avz, double slpx, double slpy ) {
 
-		if(      npixB == 1 )
-		  hnpx1map[itd]->Fill( xmod1*1E3, ymod1*1E3 );
-		else if( npixB == 2 )
-		  hnpx2map[itd]->Fill( xmod1*1E3, ymod1*1E3 );
+			double xA = pxy[ib].x[jA];
+			double yA = pxy[ib].y[jA];
+			double xB = pxy[im].x[jB];
+			double yB = pxy[im].y[jB];
+			double xC = pxy[ie].x[jC];
+			double yC = pxy[ie].y[jC];
 
-		if( fabs( slpx ) < 0.001 )
-		  ncolBvsxm[itd].Fill( xmod2*1E3, ncolB );
+			hncolB[itd].Fill( ncolB );
+			hnrowB[itd].Fill( nrowB );
+			hnpixB[itd].Fill( npixB );
 
-		if( fabs( slpy ) < 0.001 )
-		  nrowBvsym[itd].Fill( ymod2*1E3, nrowB );
+			if(      npixB == 1 )
+			  hnpx1map[itd]->Fill( xmod1*1E3, ymod1*1E3 );
+			else if( npixB == 2 )
+			  hnpx2map[itd]->Fill( xmod1*1E3, ymod1*1E3 );
 
-		if( fabs( slpx ) < 0.001 && fabs( slpy ) < 0.001 )
-		  npixBvsxmym[itd]->Fill( xmod4*1E3, ymod4*1E3, npixB );
+			if( fabs( slpx ) < 0.001 )
+			  ncolBvsxm[itd].Fill( xmod2*1E3, ncolB );
 
-		if( goodnrowA && goodnrowC && goodncolA && goodncolC ) // better resolution
-		  npixBgvsxmym[itd]->Fill( xmod4*1E3, ymod4*1E3, npixB );
+			if( fabs( slpy ) < 0.001 )
+			  nrowBvsym[itd].Fill( ymod2*1E3, nrowB );
 
-		// store triplets:
+			if( fabs( slpx ) < 0.001 && fabs( slpy ) < 0.001 )
+			  npixBvsxmym[itd]->Fill( xmod4*1E3, ymod4*1E3, npixB );
 
-		triplet tri;
-		tri.xm = xavg2;
-		tri.ym = yavg2;
-		tri.zm = zavg2;
-		tri.sx = slpx;
-		tri.sy = slpy;
+			if( goodnrowA && goodnrowC && goodncolA && goodncolC ) // better resolution
+			  npixBgvsxmym[itd]->Fill( xmod4*1E3, ymod4*1E3, npixB );
 
-		vector <double> ux(3);
-		ux[0] = xA;
-		ux[1] = xB;
-		ux[2] = xC;
-		tri.vx = ux;
+			// store triplets:
 
-		vector <double> uy(3);
-		uy[0] = yA;
-		uy[1] = yB;
-		uy[2] = yC;
-		tri.vy = uy;
+			triplet tri;
+			tri.xm = avx;
+			tri.ym = avy;
+			tri.zm = avz;
+			tri.sx = slpx;
+			tri.sy = slpy;
 
-		if( itd )
-		  driplets.push_back(tri);
-		else
-		  triplets.push_back(tri);
+			vector <double> ux(3);
+			ux[0] = xA;
+			ux[1] = xB;
+			ux[2] = xC;
+			tri.vx = ux;
 
-		htrix[itd].Fill( xavg2 );
-		htriy[itd].Fill( yavg2 );
-		htrixy[itd]->Fill( xavg2, yavg2 );
-		htritx[itd].Fill( slpx*1E3 );
-		htrity[itd].Fill( slpy*1E3 );
-
-		// check z spacing: A-B as baseline
-
-		double dzAB = zB - zA;
-		double ax = ( xB - xA ) / dzAB; // slope x
-		double ay = ( yB - yA ) / dzAB; // slope y
-		double dz = zC - zB;
-		double xk = xB + ax * dz; // at C
-		double yk = yB + ay * dz; // at C
-		double dx = xC - xk;
-		double dy = yC - yk;
-		tridxCvsx[itd].Fill( xk, dx*1E3 );
-		tridxCvsy[itd].Fill( yk, dx*1E3 );
-		tridyCvsx[itd].Fill( xk, dy*1E3 );
-		tridyCvsy[itd].Fill( yk, dy*1E3 );
-		tridxCvsax[itd].Fill( ax*1E3, dx*1E3 ); // adjust zpos, same sign
-		tridyCvsay[itd].Fill( ay*1E3, dy*1E3 );
-
-	      } // triplet
+			vector <double> uy(3);
+			uy[0] = yA;
+			uy[1] = yB;
+			uy[2] = yC;
+			tri.vy = uy;
 
-	    } // cl B
-
-	  } // cl C
-
-	} // cl A
+			if( itd )
+			  driplets.push_back(tri);
+			else
+			  triplets.push_back(tri);
+
+			htrix[itd].Fill( avx );
+			htriy[itd].Fill( avy );
+			htrixy[itd]->Fill( avx, avy );
+			htritx[itd].Fill( slpx*1E3 );
+			htrity[itd].Fill( slpy*1E3 );
+
+			// check z spacing: A-B as baseline
+
+			double dzAB = zB - zA;
+			double ax = ( xB - xA ) / dzAB; // slope x
+			double ay = ( yB - yA ) / dzAB; // slope y
+			double dz = zC - zB;
+			double xk = xB + ax * dz; // at C
+			double yk = yB + ay * dz; // at C
+			double dx = xC - xk;
+			double dy = yC - yk;
+			tridxCvsx[itd].Fill( xk, dx*1E3 );
+			tridxCvsy[itd].Fill( yk, dx*1E3 );
+			tridyCvsx[itd].Fill( xk, dy*1E3 );
+			tridyCvsy[itd].Fill( yk, dy*1E3 );
+			tridxCvsax[itd].Fill( ax*1E3, dx*1E3 ); // adjust zpos, same sign
+			tridyCvsay[itd].Fill( ay*1E3, dy*1E3 );
+
+		      } );
 
       } // triplets and driplets
 
@@ -2338,8 +2047,13 @@ int main( int argc, char* argv[] )
       ntrivsev.Fill( nev, triplets.size() );
       hndri.Fill( driplets.size() );
 
+      prof.count( "triplets", triplets.size() );
+      prof.count( "driplets", driplets.size() );
+
       // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
       // extrapolate triplets to each downstream plane
+
+      prof.lap( sextra );
       // dy vs ty: dz
 
       for( unsigned int iA = 0; iA < triplets.size(); ++iA ) { // i = A = upstream
@@ -2358,17 +2072,16 @@ int main( int argc, char* argv[] )
 	  double xA = avxA + slxA * zA; // triplet at mid
 	  double yA = avyA + slyA * zA;
 
-	  for( vector<cluster>::iterator cC = cl[ipl].begin(); cC != cl[ipl].end(); ++cC ) {
+	  PlaneXY & hC = pxy[ipl];
+	  hC.residuals( xA, yA ); // all hits at once
 
-	    double xC = cC->col*ptchx[ipl] - alignx[ipl];
-	    double yC = cC->row*ptchy[ipl] - aligny[ipl];
-	    double xmid = xC - midx[ipl];
-	    double ymid = yC - midy[ipl];
-	    xC = xmid - ymid*rotx[ipl];
-	    yC = ymid + xmid*roty[ipl];
+	  for( unsigned jC = 0; jC < hC.size(); ++jC ) {
 
-	    double dx = xC - xA;
-	    double dy = yC - yA;
+	    double xC = hC.x[jC];
+	    double yC = hC.y[jC];
+
+	    double dx = hC.dx[jC];
+	    double dy = hC.dy[jC];
 	    hexdx[ipl].Fill( dx*1E3 );
 	    hexdy[ipl].Fill( dy*1E3 );
 	    if( fabs( dy ) < 0.5 ) {
@@ -2409,17 +2122,16 @@ int main( int argc, char* argv[] )
 	  double xB = avxB + slxB * zB; // driplet at mid
 	  double yB = avyB + slyB * zB;
 
-	  for( vector<cluster>::iterator cC = cl[ipl].begin(); cC != cl[ipl].end(); ++cC ) {
+	  PlaneXY & hC = pxy[ipl];
+	  hC.residuals( xB, yB ); // all hits at once
+
+	  for( unsigned jC = 0; jC < hC.size(); ++jC ) {
 
-	    double xC = cC->col*ptchx[ipl] - alignx[ipl];
-	    double yC = cC->row*ptchy[ipl] - aligny[ipl];
-	    double xmid = xC - midx[ipl];
-	    double ymid = yC - midy[ipl];
-	    xC = xmid - ymid*rotx[ipl];
-	    yC = ymid + xmid*roty[ipl];
+	    double xC = hC.x[jC];
+	    double yC = hC.y[jC];
 
-	    double dx = xC - xB;
-	    double dy = yC - yB;
+	    double dx = hC.dx[jC];
+	    double dy = hC.dy[jC];
 	    hexdx[ipl].Fill( dx*1E3 );
 	    hexdy[ipl].Fill( dy*1E3 );
 	    if( fabs( dy ) < 0.5 ) {
@@ -2444,6 +2156,8 @@ int main( int argc, char* argv[] )
       // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
       // match triplets and driplets, measure offset
 
+      prof.lap( smatch );
+
       for( unsigned int iA = 0; iA < triplets.size(); ++iA ) { // i = A = upstream
 
 	double avxA = triplets[iA].xm;
@@ -2518,6 +2232,15 @@ int main( int argc, char* argv[] )
 
 	  if( fabs(dy) < 0.100 && fabs(dx) < 0.100 ) {
 
+	    for( int i = 0; i < 3; ++i ) {
+	      sixu[i].push_back( triplets[iA].vx[i] );
+	      sixv[i].push_back( triplets[iA].vy[i] );
+	      sixu[i+3].push_back( driplets[jB].vx[i] );
+	      sixv[i+3].push_back( driplets[jB].vy[i] );
+	    }
+	    sixum.push_back( 0.5*(xA+xB) );
+	    sixvm.push_back( 0.5*(yA+yB) );
+
 	    hsixxy->Fill( xA, yA );
 	    sixdxyvsxy->Fill( xA, yA, dxy );
 
@@ -2532,35 +2255,68 @@ int main( int argc, char* argv[] )
 
       } // triplets
 
-    } // events
+      // six-plane fits for all matched pairs of this event:
 
-    cout << endl;
+      unsigned nsix = sixum.size();
+
+      if( lsixfit && nsix > 0 ) {
+
+	const double * pu[6];
+	const double * pv[6];
+	for( int i = 0; i < 6; ++i ) {
+	  pu[i] = sixu[i].data();
+	  pv[i] = sixv[i].data();
+	}
+
+	u0.resize( nsix ); // keeps capacity
+	us.resize( nsix );
+	uchi2.resize( nsix );
+	v0.resize( nsix );
+	vs.resize( nsix );
+	vchi2.resize( nsix );
+
+	sixfit_batch( sixw, nsix, pu, u0.data(), us.data(), uchi2.data() );
+	sixfit_batch( sixw, nsix, pv, v0.data(), vs.data(), vchi2.data() );
+
+	for( unsigned i = 0; i < nsix; ++i ) {
+	  hsixfitchi2x.Fill( uchi2[i] );
+	  hsixfitchi2y.Fill( vchi2[i] );
+	  hsixfitdx.Fill( ( u0[i] - sixum[i] )*1E3 );
+	  hsixfitdy.Fill( ( v0[i] - sixvm[i] )*1E3 );
+	}
+
+      } // nsix
 
-    clock_gettime( CLOCK_REALTIME, &ts );
-    time_t s3 = ts.tv_sec; // seconds since 1.1.1970
-    long f3 = ts.tv_nsec; // nanoseconds
-    zeit3 += s3 - s2 + ( f3 - f2 ) * 1e-9; // track
+      for( int i = 0; i < 6; ++i ) {
+	sixu[i].clear(); // keep capacity
+	sixv[i].clear();
+      }
+      sixum.clear();
+      sixvm.clear();
+
+      prof.endEvent( ptrk );
+
+    } // events
 
-    clock_gettime( CLOCK_REALTIME, &ts );
-    time_t s9 = ts.tv_sec; // seconds since 1.1.1970
-    long f9 = ts.tv_nsec; // nanoseconds
+
+    cout << endl;
 
     cout << endl
 	 << "done after " << iev << " events"
-	 << " in " << s9 - s0 + ( f9 - f0 ) * 1e-9 << " s"
-	 << " (read " << zeit1
-	 << " s, cluster " << zeit2
-	 << " s, tracking " << zeit3 << " s)"
+	 << " in " << StageProf::wall() - t0 << " s"
 	 << endl;
 
     // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
     // alignment fits:
 
     if( maxiter == aligniteration + 1 ) {      
+      StageTimer tout( prof, soutput );
       histoFile->Write(); // before fitting
       histoFile->Close();
     }
 
+    prof.start( sfits );
+
     cout << endl << "alignment fits:" << endl;
 
     for( int ipl = 1; ipl <= 6; ++ipl ) {
@@ -2594,6 +2350,7 @@ int main( int argc, char* argv[] )
 	   << endl;
 
       alignx[ipl] += fgp0x->GetParameter(1);
+      delete fgp0x;
 
       // dy:
 
@@ -2620,6 +2377,7 @@ int main( int argc, char* argv[] )
 	   << endl;
 
       aligny[ipl] += fgp0y->GetParameter(1);
+      delete fgp0y;
 
       // x-y rotation:
 
@@ -2649,9 +2407,42 @@ int main( int argc, char* argv[] )
 
     } // ipl
 
+    // z-shift from scan: outer planes move by the full mid plane shift
+
+    if( lzscan && aligniteration >= 1 ) {
+
+      for( int itd = 0; itd < 2; ++itd ) {
+
+	int ipl = 3+3*itd; // 3 or 6
+	int ibest;
+	double dz = zscanbest( trizscanmad[itd], ibest, 99 );
+
+	cout << endl << trizscanmad[itd].GetTitle();
+	if( ibest == 0 ) {
+	  cout << ": not enough" << endl;
+	  continue;
+	}
+	if( ibest == 1 || ibest == trizscanmad[itd].GetNbinsX() )
+	  cout << " at edge of scan";
+
+	alignz[ipl-2] -= dz;
+	alignz[ipl]   -= dz;
+	cout << " dz " << dz
+	     << ", MAD " << trizscanmad[itd].GetBinContent(ibest)
+	     << " um, mean " << trizscandx[itd].GetBinContent(ibest)
+	     << " um, plane " << ipl-2
+	     << " new zpos " << zz[ipl-2] + alignz[ipl-2]
+	     << ", plane " << ipl
+	     << " new zpos " << zz[ipl] + alignz[ipl]
+	     << endl;
+
+      } // itd
+
+    }
+
     // z-shift:
 
-    if( aligniteration >= 3 ) {
+    else if( aligniteration >= 3 ) {
 
       for( int itd = 0; itd < 2; ++itd ) { // upstream and downstream
 
@@ -2752,6 +2543,8 @@ int main( int argc, char* argv[] )
 	alignx[ipl] += fgp0x->GetParameter(1);
 	aligny[ipl] += fgp0y->GetParameter(1);
       }
+      delete fgp0x;
+      delete fgp0y;
 
     } // aligniteration
 
@@ -2796,6 +2589,8 @@ int main( int argc, char* argv[] )
 
     } // aligniteration
 
+    prof.stop( sfits );
+
   } // aligniterations
 
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -2828,7 +2623,19 @@ int main( int argc, char* argv[] )
 
   cout << endl << histoFile->GetName() << endl;
 
+  prof.report( cout );
+  prof.write( StageProf::fileNameFor( rootFileName.str() ) );
+
+  histoFile->Close(); // closed after the last iteration already
+  delete histoFile; // with its histograms: the next run starts clean
+
   cout << endl;
 
   return 0;
 }
+
+//------------------------------------------------------------------------------
+int main( int argc, char* argv[] )
+{
+  return multiRun( argc, argv, analyseRun ); // last arg: run or run list
+}
@@ -0,0 +1,116 @@
+// teleclus.h
+// Mimosa pixels and clusters of tele: position weighted by the number of
+// next neighbours, and the cluster isolation. One copy, used by tele and
+// timed by kernbench. The grouping is clusterPixels of telecore.h.
+
+// using namespace tele;
+// vector <cluster> vcl = getClus( pb );
+// isolation( vcl ); // mindxy [pixels]
+
+#ifndef TELECLUS_H
+#define TELECLUS_H
+
+#include <vector>
+#include <cmath>
+#include <cstdlib> // abs
+#include <algorithm> // max
+
+#include "telecore.h"
+
+namespace tele {
+
+struct pixel {
+  int col;
+  int row;
+  int nn;
+};
+
+struct cluster {
+  std::vector <pixel> vpix;
+  //int size; int ncol, nrow;
+  unsigned scr; // compressed
+  float col, row;
+  float mindxy;
+};
+
+//------------------------------------------------------------------------------
+inline std::vector<cluster> getClus( std::vector <pixel> pb, int fCluCut = 1 ) // 1 = no gap
+{
+  // returns clusters with pixel coordinates
+  // next-neighbour topological clustering (allows fCluCut-1 empty pixels)
+
+  return clusterPixels<cluster>( pb, NearFacing( fCluCut ), []( cluster & c ) {
+
+    // count pixel neighbours:
+
+    for( std::vector <pixel>::iterator p = c.vpix.begin(); p != c.vpix.end(); ++p ) {
+      std::vector <pixel>::iterator q = p;
+      ++q;
+      for( ; q != c.vpix.end(); ++q )
+	if( std::abs( p->col - q->col ) <= 1 &&std::abs( p->row - q->row ) <= 1 ) {
+	  ++p->nn;
+	  ++q->nn;
+	}
+    }
+
+    c.col = 0;
+    c.row = 0;
+    int sumnn = 0;
+    int minx = 9999;
+    int maxx = 0;
+    int miny = 9999;
+    int maxy = 0;
+
+    for( std::vector <pixel>::iterator p = c.vpix.begin(); p != c.vpix.end(); ++p ) {
+
+      int nn = std::max( 1, p->nn ); // neighbours
+      sumnn += nn;
+      c.col += p->col * nn;
+      c.row += p->row * nn;
+      if( p->col > maxx ) maxx = p->col;
+      if( p->col < minx ) minx = p->col;
+      if( p->row > maxy ) maxy = p->row;
+      if( p->row < miny ) miny = p->row;
+    }
+
+    //cout << "(cluster with " << c.vpix.size() << " pixels)" << endl;
+
+    //c.col /= c.vpix.size();
+    //c.row /= c.vpix.size();
+    c.col /= sumnn; // weighted cluster center
+    c.row /= sumnn;
+
+    //c.size = c.vpix.size();
+    //c.ncol = maxx-minx+1;
+    //c.nrow = maxy-miny+1;
+    c.scr = c.vpix.size() + 1024 * ( (maxx-minx+1) + 1024*(maxy-miny+1) ); // compressed size, ncol nrow
+    c.mindxy = 999;
+
+    c.vpix.clear(); // save space
+
+  } );
+} // getClus
+
+//------------------------------------------------------------------------------
+// distance to the nearest other cluster of the plane [pixels]
+
+inline void isolation( std::vector <cluster> & vcl )
+{
+  for( std::vector<cluster>::iterator cA = vcl.begin(); cA != vcl.end(); ++cA ) {
+
+    std::vector<cluster>::iterator cD = cA;
+    ++cD;
+    for( ; cD != vcl.end(); ++cD ) {
+      double dx = cD->col - cA->col;
+      double dy = cD->row - cA->row;
+      double dxy = sqrt( dx*dx + dy*dy );
+      if( dxy < cA->mindxy ) cA->mindxy = dxy;
+      if( dxy < cD->mindxy ) cD->mindxy = dxy;
+    }
+
+  } // cl A
+}
+
+} // tele
+
+#endif
@@ -0,0 +1,575 @@
+// telecore.h
+// shared pieces of the per-event chain, kept here so the programs and
+// kernbench run the same code. What is here and who uses it:
+//   setup      readGeo, readAlign, readDUTAlign (also MOD and REF): tele,
+//              the scope* programs, edg53, evd, simtele.h
+//              readHotPixels: tele, the scope* programs, edg53, evd
+//   cluster    clusterPixels (grouping only): all programs, tele and
+//              scope53m through teleclus.h and scope53clus.h
+//   transform  TelePlane (Mimosa col, row -> x, y), PlaneXY (all hits of
+//              a plane, batch): tele, scope53m
+//   track      makeTriplets: tele, scope53m; tripletAt, matchAt: scope53m
+// Not here: the quad alignment files (quad, quad3D, evds), decoding (per program, simconv.h for raw), the DUT and module
+// transforms (planealign.h, modtransform.h), the six-plane fit (sixfit.h),
+// the grid queries (gridindex.h).
+
+// vector <cluster> vc = clusterPixels<cluster>( pb, NearSquare( 1 ), []( cluster & c ) { ... } );
+// vector <cluster> vc = clusterPixels<cluster>( pb, fNHit, NearFacing( 1 ), finish ); // pixel pb[]
+// set <int> hotset[9]; readHotPixels( "hot_33095.dat", ny, hotset, 1, 6 );
+// readGeo( "geo_2019_02d.dat", 1, 6, nx, ny, sizex, sizey, zz, ptchx, ptchy, midx, midy );
+// readAlign( "align_33095.dat", 1, 6, iteration, alignx, aligny, alignz, rotx, roty );
+// readDUTAlign( "alignDUT_33095.dat", iteration, alignx, aligny, rot, tilt, turn, z, zz[3] );
+// TelePlane tp{ ptchx, ptchy, midx, midy, alignx, aligny, rotx, roty, z }; tp.xy( c, x, y );
+// PlaneXY pxy[7]; pxy[ipl].fill( tp[ipl], cl[ipl] ); // per event, pxy[ipl].x[i]
+// makeTriplets( pxy[1], pxy[2], pxy[3], acut, triCut, pair, mid, found );
+// makeTriplets( pxy[1], pxy[2], pxy[3], acut, triCut, pair, cand, mid, found );
+
+// pixel needs col and row, cluster needs vector <pixel> vpix.
+// The pixels of a cluster come in the order of the old loops,
+// positions and sums are the same to the last bit.
+
+#ifndef TELECORE_H
+#define TELECORE_H
+
+#include <vector>
+#include <set>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <cmath>
+
+#include "cpudispatch.h"
+
+//------------------------------------------------------------------------------
+// neighbour tests for the grouping, cut 1 = no gap
+
+struct NearSquare { // diagonal neighbours too
+  int cut;
+  NearSquare( int c ) : cut(c) {}
+  template<class P> bool operator()( const P & a, const P & b ) const
+  {
+    int dr = a.row - b.row;
+    int dc = a.col - b.col;
+    return dr >= -cut && dr <= cut && dc >= -cut && dc <= cut;
+  }
+};
+
+struct NearFacing { // only facing neighbours, same resolution in x and y
+  int cut;
+  NearFacing( int c ) : cut(c) {}
+  template<class P> bool operator()( const P & a, const P & b ) const
+  {
+    int dr = a.row - b.row;
+    int dc = a.col - b.col;
+    return ( dc == 0 && dr >= -cut && dr <= cut ) ||
+      ( dr == 0 && dc >= -cut && dc <= cut );
+  }
+};
+
+//------------------------------------------------------------------------------
+// next-neighbour topological clustering of npx pixels:
+// a seed grows by every unused pixel near any pixel of the cluster so far,
+// finish( c ) fills the position, then the next unused pixel seeds
+
+template<class C, class P, class Near, class Finish>
+std::vector<C> clusterPixels( const P * pb, unsigned npx, Near near, Finish finish )
+{
+  std::vector<C> vc;
+  if( npx == 0 ) return vc;
+
+  std::vector<char> gone( npx, 0 );
+
+  unsigned seed = 0;
+
+  while( seed < npx ) {
+
+    // start a new cluster:
+
+    vc.push_back( C() );
+    C & c = vc.back();
+    c.vpix.push_back( pb[seed] );
+    gone[seed] = 1;
+
+    // let it grow as much as possible:
+
+    int growing;
+    do {
+      growing = 0;
+      for( unsigned i = 0; i < npx; ++i ) {
+	if( gone[i] ) continue;
+	for( unsigned p = 0; p < c.vpix.size(); ++p ) // vpix in cluster so far
+	  if( near( c.vpix[p], pb[i] ) ) {
+	    c.vpix.push_back( pb[i] );
+	    gone[i] = 1;
+	    growing = 1;
+	    break; // important!
+	  }
+      } // loop over all pix
+    }
+    while( growing );
+
+    finish( c );
+
+    // look for a new seed = unused pixel:
+
+    while( ( ++seed < npx ) && gone[seed] );
+
+  } // while over seeds
+
+  return vc;
+}
+
+template<class C, class P, class Near, class Finish>
+std::vector<C> clusterPixels( const std::vector<P> & pb, Near near, Finish finish )
+{
+  return clusterPixels<C>( pb.data(), pb.size(), near, finish );
+}
+
+//------------------------------------------------------------------------------
+// aligned telescope plane: cluster col, row [pixels] -> x, y [mm]:
+// shift, then rotation about the plane centre, as in the align files
+
+struct TelePlane {
+  double ptchx, ptchy; // [mm]
+  double midx, midy; // [mm]
+  double alignx, aligny; // [mm]
+  double rotx, roty; // [rad]
+  double z; // zz + alignz [mm]
+
+  template<class C> void xy( const C & c, double & x, double & y ) const
+  {
+    double x0 = c.col*ptchx - alignx;
+    double y0 = c.row*ptchy - aligny;
+    double xmid = x0 - midx;
+    double ymid = y0 - midy;
+    x = xmid - ymid*rotx;
+    y = ymid + xmid*roty;
+  }
+
+  // batch, SoA: same arithmetic in a plain loop, vectorized for the
+  // widest unit of the node. Members to locals first, else every store
+  // could change them and the loop stays scalar.
+
+  CPU_DISPATCH
+  void xy( unsigned n, const double * col, const double * row,
+	   double * x, double * y ) const
+  {
+    const double px = ptchx, py = ptchy;
+    const double ax = alignx, ay = aligny;
+    const double mx = midx, my = midy;
+    const double rx = rotx, ry = roty;
+    for( unsigned i = 0; i < n; ++i ) {
+      double xmid = col[i]*px - ax - mx;
+      double ymid = row[i]*py - ay - my;
+      x[i] = xmid - ymid*rx;
+      y[i] = ymid + xmid*ry;
+    }
+  }
+};
+
+//------------------------------------------------------------------------------
+// hits of one plane in an event, SoA, capacity kept from event to event:
+// fill once per event, then every pairing reads x[i], y[i] of cl[i];
+// residuals( xt, yt ) gives dx[i] = x[i] - xt, dy[i] for a track point
+
+struct PlaneXY {
+  std::vector<double> col, row, x, y, dx, dy;
+  double z; // [mm]
+
+  template<class C> void fill( const TelePlane & tp, const std::vector<C> & cl )
+  {
+    unsigned n = cl.size();
+    col.resize( n );
+    row.resize( n );
+    for( unsigned i = 0; i < n; ++i ) {
+      col[i] = cl[i].col;
+      row[i] = cl[i].row;
+    }
+    x.resize( n );
+    y.resize( n );
+    tp.xy( n, col.data(), row.data(), x.data(), y.data() );
+    z = tp.z;
+  }
+
+  unsigned size() const { return x.size(); }
+
+  void residuals( double xt, double yt )
+  {
+    dx.resize( x.size() );
+    dy.resize( x.size() );
+    residuals( x.size(), x.data(), y.data(), xt, yt, dx.data(), dy.data() );
+  }
+
+  CPU_DISPATCH
+  static void residuals( unsigned n, const double * x, const double * y,
+			 double xt, double yt, double * dx, double * dy )
+  {
+    for( unsigned i = 0; i < n; ++i ) {
+      dx[i] = x[i] - xt;
+      dy[i] = y[i] - yt;
+    }
+  }
+};
+
+//------------------------------------------------------------------------------
+// triplets from the outer planes A, C and the middle plane B:
+// A-C pairs within the angle cut acut [rad], B within triCut [mm]
+// of the A-C line. Callbacks, in loop order:
+//   pair( jA, jC, dx, dy )                    every A-C pair
+//   cand( jA, jC, xm, ym, slpx, slpy )        every pair in the cut, track
+//                                             at B, false skips the pair
+//   mid( jB, xB, yB, slpx, slpy, dxm, dym )   every B of such a pair
+//   found( jA, jB, jC, avx, avy, avz, slpx, slpy )   every triplet
+// B residuals per pair in one batch, into hB.dx, hB.dy.
+
+template<class Pair, class Cand, class Mid, class Found>
+void makeTriplets( const PlaneXY & hA, PlaneXY & hB, const PlaneXY & hC,
+		   double acut, double triCut,
+		   Pair pair, Cand cand, Mid mid, Found found )
+{
+  double zA = hA.z;
+  double zB = hB.z;
+  double zC = hC.z;
+
+  for( unsigned jA = 0; jA < hA.size(); ++jA ) {
+
+    double xA = hA.x[jA];
+    double yA = hA.y[jA];
+
+    for( unsigned jC = 0; jC < hC.size(); ++jC ) {
+
+      double xC = hC.x[jC];
+      double yC = hC.y[jC];
+
+      double dx2 = xC - xA;
+      double dy2 = yC - yA;
+      double dzCA = zC - zA;
+      pair( jA, jC, dx2, dy2 );
+
+      if( fabs( dx2 ) > acut * dzCA ) continue; // angle cut
+      if( fabs( dy2 ) > acut * dzCA ) continue;
+
+      double avx = 0.5 * ( xA + xC ); // mid
+      double avy = 0.5 * ( yA + yC );
+      double avz = 0.5 * ( zA + zC ); // mid z
+
+      double slpx = ( xC - xA ) / dzCA; // slope x
+      double slpy = ( yC - yA ) / dzCA; // slope y
+
+      // interpolate track to B:
+
+      double dz = zB - avz;
+      double xm = avx + slpx * dz;
+      double ym = avy + slpy * dz;
+
+      if( ! cand( jA, jC, xm, ym, slpx, slpy ) ) continue;
+
+      hB.residuals( xm, ym );
+
+      for( unsigned jB = 0; jB < hB.size(); ++jB ) {
+
+	double dxm = hB.dx[jB];
+	double dym = hB.dy[jB];
+	mid( jB, hB.x[jB], hB.y[jB], slpx, slpy, dxm, dym );
+
+	if( fabs(dxm) > triCut ) continue;
+	if( fabs(dym) > triCut ) continue;
+
+	found( jA, jB, jC, avx, avy, avz, slpx, slpy );
+
+      } // cl B
+
+    } // cl C
+
+  } // cl A
+
+} // makeTriplets
+
+// all pairs in the cut
+
+template<class Pair, class Mid, class Found>
+void makeTriplets( const PlaneXY & hA, PlaneXY & hB, const PlaneXY & hC,
+		   double acut, double triCut, Pair pair, Mid mid, Found found )
+{
+  makeTriplets( hA, hB, hC, acut, triCut, pair,
+		[]( unsigned, unsigned, double, double, double, double ) { return true; },
+		mid, found );
+}
+
+//------------------------------------------------------------------------------
+// triplet (xm, ym, zm, sx, sy) at z [mm]
+
+template<class T> void tripletAt( const T & t, double z, double & x, double & y )
+{
+  double dz = z - t.zm;
+  x = t.xm + t.sx * dz;
+  y = t.ym + t.sy * dz;
+}
+
+// track point xc, yc at z against all driplets:
+// f( jB, xd, yd, dx, dy ) with the driplet xd, yd at z, dx = xd - xc
+
+template<class T, class F>
+void matchAt( const std::vector<T> & plets, double z, double xc, double yc, F f )
+{
+  for( unsigned jB = 0; jB < plets.size(); ++jB ) {
+    double xd, yd;
+    tripletAt( plets[jB], z, xd, yd );
+    f( jB, xd, yd, xd - xc, yd - yc );
+  }
+}
+
+//------------------------------------------------------------------------------
+// hot pixel list as written by tele: plane ipl, then pix col row lines,
+// pixels into hotset[ipl] as col*ny[ipl]+row for planes ipl1..ipl9.
+// false if there is no such file.
+
+inline bool readHotPixels( const std::string & fileName, const int * ny,
+			   std::set<int> * hotset, int ipl1, int ipl9 )
+{
+  std::ifstream hotFile( fileName );
+
+  if( hotFile.bad() || ! hotFile.is_open() )
+    return 0;
+
+  std::cout << "read hot pixel list from " << fileName << std::endl;
+
+  int ipl = -1;
+  int nwrong = 0;
+
+  std::string line;
+  while( getline( hotFile, line ) ) {
+
+    std::istringstream tokenizer( line );
+    std::string tag;
+    tokenizer >> tag; // leading white space is suppressed
+    if( tag.empty() || tag[0] == '#' ) // comments start with #
+      continue;
+
+    if( tag == "plane" )
+      tokenizer >> ipl;
+
+    else if( tag == "pix" ) {
+      if( ipl < ipl1 || ipl > ipl9 ) {
+	++nwrong;
+	continue;
+      }
+      int ix, iy;
+      tokenizer >> ix >> iy;
+      hotset[ipl].insert( ix*ny[ipl] + iy );
+    }
+
+  } // while getline
+
+  if( nwrong )
+    std::cout << "  " << nwrong << " hot pixels outside planes "
+	      << ipl1 << " to " << ipl9 << std::endl;
+
+  return 1;
+}
+
+//------------------------------------------------------------------------------
+// geometry file: plane, then type, sizex, sizey [mm], npixelx, npixely,
+// zpos [mm] for planes ipl1..ipl9, each line echoed.
+// nx = 0 flags a missing plane, pitch and mid for the others,
+// the chip types into type[] if given. false if there is no such file.
+
+inline bool readGeo( const std::string & fileName, int ipl1, int ipl9,
+		     int * nx, int * ny, double * sizex, double * sizey,
+		     double * zz, double * ptchx, double * ptchy,
+		     double * midx, double * midy, std::string * type = 0 )
+{
+  for( int ipl = 0; ipl < 9; ++ipl )
+    nx[ipl] = 0; // missing plane flag
+
+  std::ifstream geoFile( fileName );
+
+  if( geoFile.bad() || ! geoFile.is_open() )
+    return 0;
+
+  std::cout << "read geometry from " << fileName << std::endl;
+
+  int ipl = 0;
+  std::string chiptype;
+
+  std::string line;
+  while( getline( geoFile, line ) ) {
+
+    std::cout << line << std::endl;
+
+    std::istringstream tokenizer( line );
+    std::string tag;
+    tokenizer >> tag; // leading white space is suppressed
+    if( tag.empty() || tag[0] == '#' ) // comments start with #
+      continue;
+
+    if( tag == "plane" ) {
+      tokenizer >> ipl;
+      continue;
+    }
+
+    if( ipl < ipl1 || ipl > ipl9 ) {
+      std::cout << "geo wrong plane number " << ipl << std::endl;
+      continue;
+    }
+
+    if(      tag == "type" ) {
+      tokenizer >> chiptype;
+      if( type ) type[ipl] = chiptype;
+    }
+    else if( tag == "sizex" )
+      tokenizer >> sizex[ipl];
+    else if( tag == "sizey" )
+      tokenizer >> sizey[ipl];
+    else if( tag == "npixelx" )
+      tokenizer >> nx[ipl];
+    else if( tag == "npixely" )
+      tokenizer >> ny[ipl];
+    else if( tag == "zpos" )
+      tokenizer >> zz[ipl];
+
+    // anything else on the line and in the file gets ignored
+
+  } // while getline
+
+  for( int ipl = 0; ipl < 9; ++ipl ) {
+    if( nx[ipl] == 0 ) continue; // missing plane flag
+    ptchx[ipl] = sizex[ipl] / nx[ipl]; // pixel size 21.2/1152=18.4
+    ptchy[ipl] = sizey[ipl] / ny[ipl];
+    midx[ipl] = 0.5 * sizex[ipl]; // mid plane
+    midy[ipl] = 0.5 * sizey[ipl]; // mid plane
+  }
+
+  return 1;
+}
+
+//------------------------------------------------------------------------------
+// telescope alignment as written by tele: iteration, then per plane
+// shiftx, shifty, shiftz [mm], rotxvsy, rotyvsx [rad] for planes ipl1..ipl9,
+// each line echoed. All planes start at zero.
+// false if there is no such file.
+
+inline bool readAlign( const std::string & fileName, int ipl1, int ipl9,
+		       int & iteration, double * alignx, double * aligny,
+		       double * alignz, double * rotx, double * roty )
+{
+  iteration = 0;
+
+  for( int ipl = 0; ipl < 9; ++ipl ) {
+    alignx[ipl] = 0.000; // [mm] same sign as dxAB
+    aligny[ipl] = 0.000; // [mm] same sign as dy
+    alignz[ipl] = 0.000; // [mm]
+    rotx[ipl] = 0.0000; // [rad] rot, same     sign dxvsy
+    roty[ipl] = 0.0000; // [rad] rot, opposite sign dyvsx
+  }
+
+  std::ifstream alignFile( fileName );
+
+  if( alignFile.bad() || ! alignFile.is_open() )
+    return 0;
+
+  std::cout << "read alignment from " << fileName << std::endl;
+
+  int ipl = 0;
+
+  std::string line;
+  while( getline( alignFile, line ) ) {
+
+    std::cout << line << std::endl;
+
+    std::istringstream tokenizer( line );
+    std::string tag;
+    tokenizer >> tag; // leading white space is suppressed
+    if( tag.empty() || tag[0] == '#' ) // comments start with #
+      continue;
+
+    if( tag == "iteration" ) {
+      tokenizer >> iteration;
+      continue;
+    }
+
+    if( tag == "plane" )
+      tokenizer >> ipl;
+
+    if( ipl < ipl1 || ipl > ipl9 ) {
+      std::cout << "align wrong plane number " << ipl << std::endl;
+      continue;
+    }
+
+    double val;
+    tokenizer >> val;
+    if(      tag == "shiftx" )
+      alignx[ipl] = val;
+    else if( tag == "shifty" )
+      aligny[ipl] = val;
+    else if( tag == "shiftz" )
+      alignz[ipl] = val;
+    else if( tag == "rotxvsy" )
+      rotx[ipl] = val;
+    else if( tag == "rotyvsx" )
+      roty[ipl] = val;
+
+    // anything else on the line and in the file gets ignored
+
+  } // while getline
+
+  return 1;
+}
+
+//------------------------------------------------------------------------------
+// DUT alignment as written by scope: iteration, alignx, aligny [mm],
+// rot [rad], tilt, turn [deg], dz [mm] behind the plane at z3, each line
+// echoed. z = z3 + dz, values not in the file are left as they are.
+// The MOD and REF files have the same tags. false if there is no such file.
+
+inline bool readDUTAlign( const std::string & fileName, int & iteration,
+			  double & alignx, double & aligny, double & rot,
+			  double & tilt, double & turn, double & z, double z3 )
+{
+  std::ifstream alignFile( fileName );
+
+  if( alignFile.bad() || ! alignFile.is_open() )
+    return 0;
+
+  std::cout << "read alignment from " << fileName << std::endl;
+
+  std::string line;
+  while( getline( alignFile, line ) ) {
+
+    std::cout << line << std::endl;
+
+    std::istringstream tokenizer( line );
+    std::string tag;
+    tokenizer >> tag; // leading white space is suppressed
+    if( tag.empty() || tag[0] == '#' ) // comments start with #
+      continue;
+
+    if( tag == "iteration" ) {
+      tokenizer >> iteration;
+      continue;
+    }
+
+    double val;
+    tokenizer >> val;
+    if(      tag == "alignx" )
+      alignx = val;
+    else if( tag == "aligny" )
+      aligny = val;
+    else if( tag == "rot" )
+      rot = val;
+    else if( tag == "tilt" )
+      tilt = val;
+    else if( tag == "turn" )
+      turn = val;
+    else if( tag == "dz" )
+      z = val + z3;
+
+    // anything else on the line and in the file gets ignored
+
+  } // while getline
+
+  return 1;
+}
+
+#endif
@@ -0,0 +1,40 @@
+// zscan.h
+// z alignment from a scan: residuals r - slope*zs are filled into a profile
+// of |residual| vs trial shift zs, the best shift is at its minimum
+
+// if( lzscan ) for( iz ) p.Fill( zs, fabs( r - slope*zs ) ); // per track
+// double dz = zscanbest( p, ibest, 99 ); // end of run, bins with > 99 entries
+
+#ifndef ZSCAN_H
+#define ZSCAN_H
+
+#include <TProfile.h>
+
+//------------------------------------------------------------------------------
+// trial shift with the smallest mean |residual|, parabola through neighbours.
+// Only bins with more than nmin entries count, ibest = 0 if there is none.
+
+inline double zscanbest( TProfile & p, int & ibest, int nmin )
+{
+  ibest = 0;
+  double mbest = 1E9;
+  for( int ib = 1; ib <= p.GetNbinsX(); ++ib )
+    if( p.GetBinEntries(ib) > nmin && p.GetBinContent(ib) < mbest ) {
+      mbest = p.GetBinContent(ib);
+      ibest = ib;
+    }
+  if( ibest == 0 ) return 0;
+
+  double dz = p.GetBinCenter(ibest);
+  if( ibest > 1 && ibest < p.GetNbinsX() &&
+      p.GetBinEntries(ibest-1) > nmin && p.GetBinEntries(ibest+1) > nmin ) {
+    double m0 = p.GetBinContent(ibest-1);
+    double m2 = p.GetBinContent(ibest+1);
+    double d2 = m0 - 2*mbest + m2;
+    if( d2 > 0 )
+      dz -= 0.5 * p.GetBinWidth(ibest) * ( m2 - m0 ) / d2;
+  }
+  return dz;
+}
+
+#endif